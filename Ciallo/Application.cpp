@@ -5,17 +5,37 @@
 
 #include "Device.hpp"
 #include "MainPassRenderer.hpp"
+#include "CanvasFormat.hpp"
+#include "CanvasFormatBenchmark.hpp"
+#include "CanvasInteraction.hpp"
 #include "CanvasPanel.hpp"
 #include "CanvasRenderer.hpp"
 #include "Drawing.hpp"
+#include "DrawingExporter.hpp"
+#include "DrawingList.hpp"
+#include "FalloffCurve.hpp"
 #include "Image.hpp"
+#include "InputCapture.hpp"
 #include "Project.hpp"
+#include "ProjectFile.hpp"
 #include "Layer.hpp"
 #include "Stroke.hpp"
+#include "StrokeLod.hpp"
 #include "Brush.hpp"
+#include "BrushCabinet.hpp"
+#include "BrushTable.hpp"
 #include "CtxUtilities.hpp"
+#include "CurveFitting.hpp"
+#include "FillRegion.hpp"
+#include "GpuReadback.hpp"
+#include "RedoUndo.hpp"
+#include "Simplification.hpp"
+#include "Stabilizer.hpp"
+#include "StrokeArrangement.hpp"
+#include "Thumbnail.hpp"
+#include "UploadScheduler.hpp"
 
-void ciallo::Application::run()
+void ciallo::Application::run(const std::filesystem::path& projectPath)
 {
 	// --- Move these to somewhere else someday ---------------------------------
 	auto window = std::make_unique<vulkan::Window>(1024u, 1024u, "Ciallo  - Laboratory Version");
@@ -35,28 +55,70 @@ void ciallo::Application::run()
 
 	vulkan::MainPassRenderer mainPassRenderer(window.get(), m_device.get());
 	// -----------------------------------------------------------------------------
-	Project project = createDefaultProject();
+	Project project = projectPath.empty() ? createDefaultProject() : openProject(projectPath);
+	std::filesystem::path savePath = projectPath.empty() ? DefaultProjectPath : projectPath;
 	entt::registry& r = project.registry();
 	r.ctx().emplace<vulkan::Device*>(m_device.get());
+	m_jobSystem = std::make_unique<JobSystem>();
+	r.ctx().emplace<JobSystem*>(m_jobSystem.get());
+	// Checked before the first autosave of this session overwrites it.
+	bool offerRestore = std::filesystem::exists(AutosavePath);
+	bool restoreRequested = false;
+	m_autosaver = std::make_unique<Autosaver>(*m_jobSystem, AutosavePath);
+	m_autosaver->connect(r);
+	m_readback = std::make_unique<GpuReadback>(m_device.get(), m_jobSystem.get());
+	r.ctx().emplace<GpuReadback*>(m_readback.get());
+	m_uploads = std::make_unique<UploadScheduler>(m_device.get());
+	r.ctx().emplace<UploadScheduler*>(m_uploads.get());
 	auto& commandBuffers = r.ctx().emplace<CommandBuffers>();
 	commandBuffers.setMain(cb);
-	ArticulatedLineEngine engine(m_device.get());
+	RedoUndo::connect(project);
+	StrokeLodBuilder::connect(r);
+	LayerRenderer::connect(r);
+	FalloffLutBaker::connect(r);
+	StrokeCurveFitter::connect(r);
+	StrokeArrangementBuilder::connect(r);
+	FillRegionBuilder::connect(r);
+	ThumbnailBuilder::connect(r);
+	for (entt::entity e : r.view<StrokeCpo>())
+	{
+		StrokeLodBuilder::build(r, e);
+	}
 	// -----------------------------------------------------------------------------
 
 	vk::UniqueSemaphore presentImageAvailableSemaphore = m_device->device().createSemaphoreUnique({});
 	window->show();
+	InputCapture inputCapture(*window);
+	CanvasInteraction canvasInteraction(inputCapture);
 
-	auto canvasRenderer = std::make_unique<rendering::CanvasRenderer>(m_device.get());
+	auto canvasRenderer = std::make_unique<rendering::CanvasRenderer>(m_device.get(), *m_uploads);
+	r.ctx().emplace<BrushTable*>(canvasRenderer->m_brushTable.get());
+	canvasRenderer->manageResidency(r, m_jobSystem.get());
+	canvasRenderer->m_brushTable->connect(r);
+	gui::BrushCabinet brushCabinet;
+	bool showBrushCabinet = true;
+	gui::DrawingList drawingList;
+	bool showDrawings = false;
+	auto formatBenchmark = std::make_unique<CanvasFormatBenchmark>(m_device.get());
+	bool showFormatBenchmark = false;
+	StabilizerBenchmark stabilizerBenchmark;
+	bool showStabilizer = false;
+	bool showTransform = false;
+	bool showFillRegions = false;
+	bool showRenderGraph = false;
 
-	m_device->device().waitIdle();
+	// Work submitted during setup, not the whole device.
+	m_device->timeline().last().wait(m_device->device());
 
 	// main loop, uni-buffer synchronized rendering 
+	vulkan::GpuPoint frameDone; // of the previous frame
 	while (!window->shouldClose())
 	{
 		window->pollEvents();
+		// CPU side preprocessing overlaps with GPU finishing the previous frame.
+		StrokeLodBuilder::dispatch(r);
 		vk::Result _;
-		_ = m_device->device().waitForFences(mainPassRenderer.renderingCompleteFence(), VK_TRUE,
-		                                     std::numeric_limits<uint64_t>::max());
+		frameDone.wait(m_device->device());
 
 		uint32_t index;
 		try
@@ -75,22 +137,217 @@ void ciallo::Application::run()
 		{
 			throw std::runtime_error("Failed to acquire swap chain image!");
 		}
-		m_device->device().resetFences(mainPassRenderer.renderingCompleteFence());
+
+		// Previous frame is done, safe to touch its buffers.
+		StrokeLodBuilder::update(r);
+		ViewportCuller::update(r);
+		if (restoreRequested)
+		{
+			restoreRequested = false;
+			try
+			{
+				restoreAutosave(project);
+			}
+			catch (std::exception& e)
+			{
+				spdlog::error("Failed to restore {}: {}", AutosavePath, e.what());
+			}
+		}
+		StrokeArrangementBuilder::update(r);
+		FillRegionBuilder::update(r);
+		m_autosaver->update(r);
+		m_readback->update();
+		FalloffLutBaker::update(r);
+		canvasRenderer->m_articulated->updateFalloff(*m_uploads);
+		// Uploads recorded so far, setup's included, go to the transfer queue and are usable from the acquire on.
+		m_uploads->flush();
 
 		vk::CommandBufferBeginInfo cbbi{vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr};
 		cb.begin(cbbi);
+		vulkan::GpuPoint uploadsAcquired = m_uploads->acquire(cb);
 		ImGui_ImplVulkan_NewFrame();
 		window->imguiNewFrame();
 		ImGui::NewFrame();
 		ImGui::DockSpaceOverViewport(ImGui::GetMainViewport());
 		// --start imgui recording------------------------------------------------------
 		entt::entity tempe = r.view<CanvasPanelCpo>()[0];
-		canvasRenderer->render(cb, &r.get<GPUImageCpo>(r.get<CanvasPanelCpo>(tempe).drawing).image);
+		entt::entity drawing = r.get<CanvasPanelCpo>(tempe).drawing;
+		canvasRenderer->render(r, cb, drawing);
+		// Nobody looks at thumbnails while the list is closed.
+		if (showDrawings) ThumbnailBuilder::update(r, cb, drawing);
 		CanvasPanelDrawer::update(r);
+		canvasInteraction.update(project, brushCabinet.selected());
+		RedoUndoLog& redoUndoLog = RedoUndo::log(project);
+		bool undo = ImGui::GetIO().KeyCtrl && !ImGui::GetIO().KeyShift && ImGui::IsKeyPressed(ImGuiKey_Z);
+		bool redo = ImGui::GetIO().KeyCtrl && (ImGui::IsKeyPressed(ImGuiKey_Y) ||
+			ImGui::GetIO().KeyShift && ImGui::IsKeyPressed(ImGuiKey_Z));
+		bool save = ImGui::GetIO().KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_S);
 		if (ImGui::BeginMainMenuBar())
 		{
+			if (ImGui::BeginMenu("File"))
+			{
+				save |= ImGui::MenuItem("Save", "Ctrl+S");
+				ImGui::TextDisabled("%s", savePath.string().c_str());
+				ImGui::EndMenu();
+			}
+			if (ImGui::BeginMenu("Edit"))
+			{
+				undo |= ImGui::MenuItem("Undo", "Ctrl+Z", false, redoUndoLog.canUndo());
+				redo |= ImGui::MenuItem("Redo", "Ctrl+Y", false, redoUndoLog.canRedo());
+				ImGui::Separator();
+				ImGui::MenuItem("Transform", nullptr, &showTransform);
+				if (ImGui::MenuItem("Fit Stroke Curves"))
+				{
+					auto unfitted = r.view<StrokeCpo>(entt::exclude<StrokeCurveCpo>);
+					StrokeCurveFitter::fit(r, {unfitted.begin(), unfitted.end()});
+				}
+				if (ImGui::MenuItem("Simplify Strokes", nullptr, false, !canvasInteraction.drawing()))
+				{
+					// Strokes of projects made before capture simplified them, one undoable step.
+					auto strokes = r.view<StrokeCpo>();
+					std::vector<entt::entity> simplified{strokes.begin(), strokes.end()};
+					for (entt::entity e : simplified)
+					{
+						if (!r.all_of<Modifying<StrokeCpo>>(e)) r.emplace<Modifying<StrokeCpo>>(e);
+						if (!r.all_of<Modifying<StrokeCurveCpo>>(e)) r.emplace<Modifying<StrokeCurveCpo>>(e);
+					}
+					StrokeSimplifier::simplify(r, simplified, SimplificationMethod::DouglasPeucker,
+					                           StrokeSimplifier::DefaultTolerance);
+					RedoUndo::commit(project, "Simplify Strokes");
+				}
+				ImGui::EndMenu();
+			}
+			if (ImGui::BeginMenu("Brush"))
+			{
+				ImGui::MenuItem("Brush Cabinet", nullptr, &showBrushCabinet);
+				ImGui::MenuItem("Stabilizer", nullptr, &showStabilizer);
+				ImGui::Separator();
+				bool fillTool = canvasInteraction.tool == CanvasTool::Fill;
+				if (ImGui::MenuItem("Fill Tool", nullptr, &fillTool))
+				{
+					canvasInteraction.tool = fillTool ? CanvasTool::Fill : CanvasTool::Brush;
+				}
+				ImGui::EndMenu();
+			}
+			if (ImGui::BeginMenu("Canvas"))
+			{
+				CanvasFormat current = canvasFormatOf(r, drawing);
+				for (CanvasFormat format : CanvasFormats)
+				{
+					bool supported = canvasFormatSupported(m_device->physicalDevice(), format);
+					if (ImGui::MenuItem(canvasFormatName(format), nullptr, format == current, supported))
+					{
+						r.emplace_or_replace<CanvasFormatCpo>(drawing, format);
+					}
+				}
+				// Display only, blending and exports are untouched. Gamma formats are copied as is.
+				CanvasDisplayPass& display = *canvasRenderer->m_display;
+				ImGui::BeginDisabled(!linearLight(current));
+				ImGui::SliderFloat("Exposure", &display.exposure, 0.125f, 8.0f, "%.3f",
+				                   ImGuiSliderFlags_Logarithmic);
+				bool floatFormat = current == CanvasFormat::Rgba16Float || current == CanvasFormat::Rgba32Float;
+				ImGui::BeginDisabled(!floatFormat);
+				ImGui::MenuItem("Tone Map", nullptr, &display.toneMap);
+				ImGui::EndDisabled();
+				ImGui::EndDisabled();
+				ImGui::Separator();
+				ImGui::MenuItem("Drawings", nullptr, &showDrawings);
+				ImGui::MenuItem("Format Benchmark", nullptr, &showFormatBenchmark);
+				bool arrangement = r.all_of<StrokeArrangementCpo>(drawing);
+				if (ImGui::MenuItem("Stroke Arrangement", nullptr, &arrangement))
+				{
+					if (arrangement)
+					{
+						StrokeArrangementBuilder::enable(r, drawing);
+					}
+					else
+					{
+						StrokeArrangementBuilder::disable(r, drawing);
+					}
+				}
+				ImGui::MenuItem("Fill Regions", nullptr, &showFillRegions);
+				ImGui::MenuItem("Render Graph", nullptr, &showRenderGraph);
+				bool tileBinning = canvasRenderer->m_strokeAccumulator->mode == StrokeAccumulator::Mode::TileBinning;
+				if (ImGui::MenuItem("Airbrush Tile Binning", nullptr, &tileBinning))
+				{
+					canvasRenderer->m_strokeAccumulator->mode = tileBinning
+						                                            ? StrokeAccumulator::Mode::TileBinning
+						                                            : StrokeAccumulator::Mode::Raster;
+				}
+				ImGui::EndMenu();
+			}
 			ImGui::EndMainMenuBar();
 		}
+		if (offerRestore)
+		{
+			ImGui::OpenPopup("Restore Autosave");
+			offerRestore = false;
+		}
+		if (ImGui::BeginPopupModal("Restore Autosave", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+		{
+			ImGui::Text("An autosave of a previous session was found at %s.", AutosavePath);
+			if (ImGui::Button("Restore"))
+			{
+				restoreRequested = true;
+				ImGui::CloseCurrentPopup();
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Discard")) ImGui::CloseCurrentPopup();
+			ImGui::EndPopup();
+		}
+		if (undo) RedoUndo::undo(project);
+		if (redo) RedoUndo::redo(project);
+		if (save)
+		{
+			try
+			{
+				ProjectFile::save(project, savePath);
+				spdlog::info("Saved {}", savePath.string());
+			}
+			catch (std::exception& e)
+			{
+				spdlog::error("Failed to save {}: {}", savePath.string(), e.what());
+			}
+		}
+		if (showFormatBenchmark)
+		{
+			formatBenchmark->drawWindow(r, drawing, *canvasRenderer->m_articulatedLine, &showFormatBenchmark);
+		}
+		if (showBrushCabinet)
+		{
+			brushCabinet.draw(project, &showBrushCabinet);
+		}
+		if (showDrawings)
+		{
+			entt::entity picked = drawingList.draw(r, drawing, &showDrawings);
+			// Shown from next frame on, a stroke being drawn stays in the drawing it started in.
+			auto* panel = r.try_get<CanvasPanelCpo>(tempe);
+			if (panel && picked != entt::null && picked != drawing && !canvasInteraction.drawing())
+			{
+				if (!r.all_of<GPUImageCpo>(picked)) addDrawingImage(r, picked);
+				panel->drawing = picked;
+			}
+		}
+		if (showStabilizer)
+		{
+			stabilizerBenchmark.drawWindow(canvasInteraction.stabilizer, &showStabilizer);
+		}
+		if (showTransform)
+		{
+			canvasRenderer->m_transformer->drawWindow(project, drawing, &showTransform);
+		}
+		else if (canvasRenderer->m_transformer->active())
+		{
+			canvasRenderer->m_transformer->end(r);
+		}
+		if (showFillRegions)
+		{
+			FillRegionBuilder::drawWindow(r, drawing, &showFillRegions);
+		}
+		if (showRenderGraph)
+		{
+			canvasRenderer->m_graph->drawDebug(&showRenderGraph);
+		}
 
 		static bool show_demo_window = true;
 		if (show_demo_window)
@@ -124,6 +381,10 @@ void ciallo::Application::run()
 			ImGui::DragFloat(fmt::format("Width##a{}", i).c_str(), &al.at(i).width, 0.001f, 0.0f, 0.1f);
 		}
 		al[3] = al[0];
+		ImGui::Text("Falloff curve, distance to alpha");
+		auto& falloff = canvasRenderer->m_articulated->falloff.controlPoints;
+		ImGui::DragFloat2("Control point 1##a", reinterpret_cast<float*>(&falloff[1]), 0.01f, 0.0f, 1.0f);
+		ImGui::DragFloat2("Control point 2##a", reinterpret_cast<float*>(&falloff[2]), 0.01f, 0.0f, 1.0f);
 
 		ImGui::Separator();
 
@@ -141,22 +402,50 @@ void ciallo::Application::run()
 			ImGui::DragFloat(fmt::format("Width##b{}", i).c_str(), &ed.at(i).width, 0.001f, 0.0f, 0.1f);
 		}
 		ed[3] = ed[0];
+
+		ImGui::Separator();
+
+		ImGui::Text("Wave drawn by Continuous Airbrush Engine (NDC space)");
+		ImGui::Text("Integral of dots at spacing, instead of stamping them");
+		auto& airbrush = *canvasRenderer->m_continuousAirbrush;
+		int integral = static_cast<int>(airbrush.integral);
+		ImGui::RadioButton("Tabulated falloff", &integral, static_cast<int>(ContinuousAirbrushEngine::Integral::Tabulated));
+		ImGui::SameLine();
+		ImGui::RadioButton("Closed form 1-d^2", &integral, static_cast<int>(ContinuousAirbrushEngine::Integral::ClosedForm));
+		airbrush.integral = static_cast<ContinuousAirbrushEngine::Integral>(integral);
+		ImGui::DragFloat("Spacing##c", &airbrush.spacing, 0.0001f, 0.0001f, 0.1f, "%.4f");
+		ImGui::SliderFloat("Hardness##c", &airbrush.hardness, 0.0f, 1.0f);
+		static int comparedSegment = 0;
+		ImGui::SliderInt("Compared segment", &comparedSegment, 0, static_cast<int>(airbrush.vertices.size()) - 2);
+		static std::optional<ContinuousAirbrushEngine::Comparison> comparison;
+		if (ImGui::Button("Compare with dense stamping"))
+		{
+			comparison = airbrush.compare(airbrush.vertices.at(comparedSegment),
+			                              airbrush.vertices.at(comparedSegment + 1),
+			                              r.get<GPUImageCpo>(drawing).image.extent2D());
+		}
+		if (comparison)
+		{
+			ImGui::Text("Alpha error max %.4f mean %.4f", comparison->maxError, comparison->meanError);
+			ImGui::Text("Fragments stamped %.0f integral %.0f", comparison->stampedFragments,
+			            comparison->integralFragments);
+		}
 		ImGui::End();
 		// -----------------------------------------------------------------------------
 		ImGui::EndFrame();
 		ImGui::Render();
 		mainPassRenderer.render(cb, index, ImGui::GetDrawData());
 		cb.end();
-		std::vector<vk::PipelineStageFlags> waitStages{vk::PipelineStageFlagBits::eColorAttachmentOutput};
-
+		std::vector<vk::SemaphoreSubmitInfo> waits{
+			{*presentImageAvailableSemaphore, 0, vk::PipelineStageFlagBits2::eColorAttachmentOutput},
+			uploadsAcquired.waitInfo()
+		};
 		std::vector<vk::Semaphore> signalAfterRenderingSemaphores = {mainPassRenderer.renderingCompleteSemaphore()};
-		vk::SubmitInfo si{
-			*presentImageAvailableSemaphore,
-			waitStages,
-			cb,
-			signalAfterRenderingSemaphores
+		std::vector<vk::SemaphoreSubmitInfo> signals{
+			{signalAfterRenderingSemaphores[0], 0, vk::PipelineStageFlagBits2::eAllCommands}
 		};
-		m_device->queue().submit(si, mainPassRenderer.renderingCompleteFence());
+		frameDone = m_device->submit(cb, waits, signals);
+		m_readback->submitted(frameDone);
 
 		auto swapchain = window->swapchain();
 		vk::PresentInfoKHR pi{
@@ -185,15 +474,89 @@ void ciallo::Application::run()
 	m_device->device().waitIdle();
 }
 
-ciallo::Project ciallo::Application::createDefaultProject() const
+int ciallo::Application::runHeadless(const ExportOptions& options)
 {
-	Project project;
+	// Failures end up in the exit code, a script running the export has nothing else to go by.
+	try
+	{
+		// No surface: any device with a graphics and compute queue does, software drivers included.
+		m_instance = std::make_shared<vulkan::Instance>();
+		vk::PhysicalDevice physicalDevice = vulkan::Instance::pickPhysicalDevice(*m_instance, nullptr);
+		uint32_t queueIndex = vulkan::Instance::findRequiredQueueFamily(physicalDevice, nullptr);
+		m_device = std::make_shared<vulkan::Device>(*m_instance, physicalDevice, queueIndex, false);
+		spdlog::info("Exporting on {}", physicalDevice.getProperties().deviceName.data());
+		m_jobSystem = std::make_unique<JobSystem>();
+
+		Project project = DrawingExporter::load(options.project, *m_jobSystem);
+		size_t failed;
+		{
+			DrawingExporter exporter(m_device.get(), m_jobSystem.get(), options.inFlight);
+			exporter.prepare(project.registry());
+			failed = exporter.exportAll(project.registry(), options);
+		}
+		if (failed > 0) spdlog::error("{} drawings failed to export", failed);
+		return failed == 0 ? 0 : 1;
+	}
+	catch (std::exception& e)
+	{
+		spdlog::error("Export of {} failed: {}", options.project.string(), e.what());
+		return 1;
+	}
+}
+
+ciallo::Project ciallo::Application::openProject(const std::filesystem::path& path) const
+{
+	Project project = ProjectFile::load(path);
 	entt::registry& r = project.registry();
-	// Canvas panel and drawing
+	auto drawings = r.view<DrawingTag>();
+	if (drawings.begin() == drawings.end())
+	{
+		throw std::runtime_error(fmt::format("Project {} has no drawing!", path.string()));
+	}
+	// The first drawing with layers is shown, a file without layers gets one to draw in.
+	auto stacked = r.view<DrawingTag, LayerStackCpo>();
+	entt::entity drawing = stacked.begin() != stacked.end() ? *stacked.begin() : *drawings.begin();
+	if (!r.all_of<LayerStackCpo>(drawing))
+	{
+		entt::entity layer = r.create();
+		r.emplace<LayerCpo>(layer);
+		r.emplace<LayerStackCpo>(drawing).layers.push_back(layer);
+	}
+	addCanvasPanel(r, drawing);
+	return project;
+}
+
+void ciallo::Application::restoreAutosave(Project& project) const
+{
+	entt::registry& r = project.registry();
+	// Read before anything is cleared, a broken autosave leaves the current project as it is.
+	auto snapshot = RegistrySnapshot::decompress(RegistrySnapshot::read(AutosavePath), *m_jobSystem);
+	// GPU resources of the current project go with its entities. Systems stay connected and pick the restored
+	// components up like any new ones.
+	m_device->device().waitIdle();
+	r.clear();
+	RedoUndo::reset(project);
+	RegistrySnapshot::restore(r, snapshot);
+	for (auto&& [e, panel] : r.view<CanvasPanelCpo>().each())
+	{
+		if (r.valid(panel.drawing) && !r.all_of<GPUImageCpo>(panel.drawing)) addDrawingImage(r, panel.drawing);
+	}
+	auto panels = r.view<CanvasPanelCpo>();
+	auto drawings = r.view<DrawingTag>();
+	if (panels.begin() == panels.end() && drawings.begin() != drawings.end()) addCanvasPanel(r, *drawings.begin());
+	spdlog::info("Restored {}", AutosavePath);
+}
+
+void ciallo::Application::addCanvasPanel(entt::registry& r, entt::entity drawing) const
+{
 	entt::entity canvasPanel = r.create();
-	entt::entity drawing = r.create();
 	auto& canvasPanelCpo = r.emplace<CanvasPanelCpo>(canvasPanel);
 	canvasPanelCpo.drawing = drawing;
+	addDrawingImage(r, drawing);
+}
+
+void ciallo::Application::addDrawingImage(entt::registry& r, entt::entity drawing) const
+{
 	auto& vulkanImageCpo = r.emplace<GPUImageCpo>(drawing);
 	vk::SamplerCreateInfo samplerCreateInfo{};
 	vk::UniqueSampler sampler = m_device->device().createSamplerUnique(samplerCreateInfo);
@@ -203,7 +566,7 @@ ciallo::Project ciallo::Application::createDefaultProject() const
 	                                     vk::SampleCountFlagBits::e1,
 	                                     vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst |
 	                                     vk::ImageUsageFlagBits::eColorAttachment |
-	                                     vk::ImageUsageFlagBits::eTransferSrc);
+	                                     vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eStorage);
 	auto start = std::chrono::high_resolution_clock::now();
 
 	m_device->executeImmediately([&vulkanImageCpo](vk::CommandBuffer cb)
@@ -216,6 +579,20 @@ ciallo::Project ciallo::Application::createDefaultProject() const
 
 	vk::ImageView imageView = vulkanImageCpo.image.imageView();
 	vulkanImageCpo.id = ImGui_ImplVulkan_AddTexture(*sampler, imageView, VK_IMAGE_LAYOUT_GENERAL);
+}
+
+ciallo::Project ciallo::Application::createDefaultProject() const
+{
+	Project project;
+	entt::registry& r = project.registry();
+	// Canvas panel and drawing
+	entt::entity drawing = r.create();
+	r.emplace<DrawingTag>(drawing);
+	r.emplace<ViewRectCpo>(drawing, A4PaperViewRect);
+	// Half float avoids banding of layered strokes and blends in linear light.
+	bool halfFloat = canvasFormatSupported(m_device->physicalDevice(), CanvasFormat::Rgba16Float);
+	r.emplace<CanvasFormatCpo>(drawing, halfFloat ? CanvasFormat::Rgba16Float : CanvasFormat::Rgba8Unorm);
+	addCanvasPanel(r, drawing);
 
 	const int n = 1024;
 	std::vector<geom::Point> line;
@@ -226,6 +603,21 @@ ciallo::Project ciallo::Application::createDefaultProject() const
 		geom::Point p = {A4PaperViewRect.max.x * ratio, A4PaperViewRect.max.y/2.0f * glm::sin(ratio*2.0f*pi) + A4PaperViewRect.max.y/2.0f};
 		line.push_back(p);
 	}
+	entt::entity layer = r.create();
+	r.emplace<LayerCpo>(layer);
+	r.emplace<LayerStackCpo>(drawing).layers.push_back(layer);
+
+	entt::entity brush = r.create();
+	r.emplace<BrushTag>(brush);
+	r.emplace<ColorCpo>(brush, glm::vec4{0.2f, 0.3f, 0.8f, 0.6f});
+	r.emplace<AirbrushCpo>(brush);
+
+	entt::entity stroke = r.create();
+	joinLayer(r, stroke, layer);
+	auto& strokeCpo = r.emplace<StrokeCpo>(stroke);
+	strokeCpo.brush = brush;
+	strokeCpo.position = std::move(line);
+	strokeCpo.thickness = std::vector<float>(n, 0.001f);
 
 	return project;
 }
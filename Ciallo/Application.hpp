@@ -1,10 +1,17 @@
 ﻿#pragma once
+#include <filesystem>
+
 #include "Instance.hpp"
 #include "Device.hpp"
+#include "GpuReadback.hpp"
+#include "JobSystem.hpp"
 #include "Project.hpp"
+#include "RegistrySnapshot.hpp"
+#include "UploadScheduler.hpp"
 
 namespace ciallo
 {
+struct ExportOptions;
 
 class Application
 {
@@ -17,12 +24,31 @@ public:
 	Application& operator=(Application&& other) = default;
 	~Application() = default;
 
-	void run();
+	// Opens the project file at projectPath, or a default project when it is empty.
+	void run(const std::filesystem::path& projectPath = {});
+	// Export drawings of a project without window, swapchain or ImGui. Returns the process exit code.
+	int runHeadless(const ExportOptions& options);
 
 	Project createDefaultProject() const;
+	// Throws std::runtime_error when the file is no valid project.
+	Project openProject(const std::filesystem::path& path) const;
 private:
+	constexpr static const char* DefaultProjectPath = "./project.ciallo";
+	constexpr static const char* AutosavePath = "./autosave.csnp";
+
+	// Replace the content of project with the autosave, between frames.
+	void restoreAutosave(Project& project) const;
+	// Canvas panel showing drawing, with the image it is displayed through.
+	void addCanvasPanel(entt::registry& r, entt::entity drawing) const;
+	// Image a canvas panel displays drawing through.
+	void addDrawingImage(entt::registry& r, entt::entity drawing) const;
+
 	std::shared_ptr<vulkan::Instance> m_instance;
 	std::shared_ptr<vulkan::Device> m_device;
+	std::unique_ptr<JobSystem> m_jobSystem;
+	std::unique_ptr<Autosaver> m_autosaver;
+	std::unique_ptr<GpuReadback> m_readback;
+	std::unique_ptr<UploadScheduler> m_uploads;
 };
 	
 }
@@ -3,12 +3,15 @@
 
 #include "vku.hpp"
 #include "ArticulatedLineRenderer.hpp"
+#include "BrushTable.hpp"
 #include "Stroke.hpp"
 #include "StrokeBufferObjects.hpp"
+#include "StrokeLod.hpp"
 
 namespace ciallo
 {
-	ArticulatedLineEngineTemp::ArticulatedLineEngineTemp(vulkan::Device* device): m_device(*device)
+	ArticulatedLineEngineTemp::ArticulatedLineEngineTemp(vulkan::Device* device, UploadScheduler& uploads):
+		m_device(*device)
 	{
 		m_vertShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eVertex,
 		                                    "./shaders/articulatedLineTemp.vert.spv");
@@ -17,20 +20,52 @@ namespace ciallo
 		m_geomShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eGeometry,
 		                                    "./shaders/articulatedLineTemp.geom.spv");
 		genPipelineLayout();
-		genPipelineDynamic();
+		genPipelineDynamic(device->physicalDevice());
 		genVertexBuffer(*device);
+		genFalloffLut(device);
+		updateFalloff(uploads);
 	}
 
 	void ArticulatedLineEngineTemp::genPipelineLayout()
 	{
+		vku::DescriptorSetLayoutMaker layoutMaker;
+		layoutMaker.image(0, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment, 1);
+		m_descriptorSetLayout = layoutMaker.createUnique(m_device);
+
 		vku::PipelineLayoutMaker maker;
+		maker.descriptorSetLayout(*m_descriptorSetLayout);
 		m_pipelineLayout = maker.createUnique(m_device);
 	}
 
-	void ArticulatedLineEngineTemp::genPipelineDynamic()
+	void ArticulatedLineEngineTemp::genFalloffLut(vulkan::Device* device)
+	{
+		m_sampler = vku::SamplerMaker()
+		            .magFilter(vk::Filter::eLinear)
+		            .minFilter(vk::Filter::eLinear)
+		            .addressModeU(vk::SamplerAddressMode::eClampToEdge)
+		            .createUnique(m_device);
+		m_falloffLut = FalloffLutBaker::createLut(*device);
+
+		vku::DescriptorSetMaker maker;
+		maker.layout(*m_descriptorSetLayout);
+		m_descriptorSet = maker.create(m_device, device->descriptorPool())[0];
+
+		vku::DescriptorSetUpdater updater;
+		updater.beginDescriptorSet(m_descriptorSet)
+		       .beginImages(0, 0, vk::DescriptorType::eCombinedImageSampler)
+		       .image(*m_sampler, m_falloffLut.imageView(), vk::ImageLayout::eGeneral); // as UploadScheduler leaves it
+		updater.update(m_device);
+	}
+
+	void ArticulatedLineEngineTemp::updateFalloff(UploadScheduler& uploads)
+	{
+		if (m_bakedFalloff == falloff) return;
+		FalloffLutBaker::upload(uploads, m_falloffLut, FalloffLutBaker::bake(falloff.curve()));
+		m_bakedFalloff = falloff;
+	}
+
+	void ArticulatedLineEngineTemp::genPipelineDynamic(vk::PhysicalDevice physicalDevice)
 	{
-		std::vector<vk::Format> colorAttachmentsFormats{vk::Format::eR8G8B8A8Unorm};
-		vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
 		vku::PipelineMaker maker;
 		maker.topology(vk::PrimitiveTopology::eLineStrip)
 		     .dynamicState(vk::DynamicState::eViewport)
@@ -44,12 +79,23 @@ namespace ciallo
 		     .vertexAttribute(0, 0, vk::Format::eR32G32Sfloat, 0)
 		     .vertexAttribute(1, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Vertex, color))
 		     .vertexAttribute(2, 0, vk::Format::eR32Sfloat, offsetof(Vertex, width));
-		m_pipeline = maker.createUnique(m_device, nullptr, *m_pipelineLayout, renderingCreateInfo);
+		for (CanvasFormat format : supportedCanvasFormats(physicalDevice))
+		{
+			std::vector colorAttachmentsFormats{toVkFormat(format)};
+			vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
+			m_pipelines[toVkFormat(format)] = maker.createUnique(m_device, nullptr, *m_pipelineLayout,
+			                                                     renderingCreateInfo);
+		}
 	}
 
 	void ArticulatedLineEngineTemp::renderDynamic(vk::CommandBuffer cb, const vulkan::Image* target)
 	{
-		m_vertBuffer.uploadLocal(vertices.data(), VK_WHOLE_SIZE);
+		std::vector<Vertex> uploaded = vertices;
+		for (Vertex& v : uploaded)
+		{
+			v.color = canvasColor(fromVkFormat(target->format()), v.color);
+		}
+		m_vertBuffer.uploadLocal(uploaded.data(), VK_WHOLE_SIZE);
 		vk::Rect2D area{{0, 0}, target->extent2D()};
 		vk::RenderingAttachmentInfo renderingAttachmentInfo{target->imageView(), target->imageLayout()};
 		std::vector colorAttachments{renderingAttachmentInfo};
@@ -63,7 +109,8 @@ namespace ciallo
 		cb.setScissor(0, zeroScissor);
 		std::vector<vk::Buffer> vertexBuffers{m_vertBuffer};
 		cb.bindVertexBuffers(0, vertexBuffers, {0});
-		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *m_pipeline);
+		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *m_pipelines.at(target->format()));
+		cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *m_pipelineLayout, 0, m_descriptorSet, nullptr);
 		cb.draw(4, 1, 0, 0);
 		cb.endRendering();
 	}
@@ -118,7 +165,8 @@ namespace ciallo
 		}
 	}
 
-	ArticulatedLineEngine::ArticulatedLineEngine(vulkan::Device* device):m_device(device)
+	ArticulatedLineEngine::ArticulatedLineEngine(vulkan::Device* device, vk::DescriptorSetLayout brushTableLayout):
+		m_device(device)
 	{
 		vk::Device d = device->device();
 		auto vertShaderData = vulkan::ShaderModule::loadSpv("./shaders/articulatedLine.vert.spv");
@@ -138,15 +186,11 @@ namespace ciallo
 		fragShader = d.createShaderModuleUnique(fragInfo);
 		vku::DescriptorSetLayoutMaker strokeDsMaker;
 		strokeDescriptorSetLayout = strokeDsMaker.createUnique(d);
-		vku::DescriptorSetLayoutMaker brushDsMaker;
-		brushDsMaker.buffer(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eFragment, 1);
-		brushDescriptorSetLayout = brushDsMaker.createUnique(d);
 		// TODO: descriptor set layout
-		std::vector<vk::DescriptorSetLayout> layouts{*strokeDescriptorSetLayout, *brushDescriptorSetLayout};
-		vk::PipelineLayoutCreateInfo info{{}, layouts, {}};
+		std::vector<vk::DescriptorSetLayout> layouts{*strokeDescriptorSetLayout, brushTableLayout};
+		vk::PushConstantRange brushIndexRange{vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32_t)};
+		vk::PipelineLayoutCreateInfo info{{}, layouts, brushIndexRange};
 		pipelineLayout = d.createPipelineLayoutUnique(info);
-		std::vector<vk::Format> colorAttachmentsFormats{vk::Format::eR8G8B8A8Unorm};
-		vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
 		vku::PipelineMaker maker;
 		maker.topology(vk::PrimitiveTopology::eLineStrip)
 		     .dynamicState(vk::DynamicState::eViewport)
@@ -160,7 +204,12 @@ namespace ciallo
 		     .vertexAttribute(0, 0, vk::Format::eR32G32Sfloat, 0)
 		     .vertexBinding(1, sizeof(float))
 		     .vertexAttribute(1, 1, vk::Format::eR32Sfloat, 0);
-		pipeline = maker.createUnique(d, nullptr, *pipelineLayout, renderingCreateInfo);
+		for (CanvasFormat format : supportedCanvasFormats(device->physicalDevice()))
+		{
+			std::vector colorAttachmentsFormats{toVkFormat(format)};
+			vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
+			pipelines[toVkFormat(format)] = maker.createUnique(d, nullptr, *pipelineLayout, renderingCreateInfo);
+		}
 	}
 
 	void ArticulatedLineEngine::assignBrushRenderingData(entt::registry& r, entt::entity brushE,
@@ -202,13 +251,18 @@ namespace ciallo
 		r.remove<ArticulatedLineBrushCpo>(e);
 	}
 
-	void ArticulatedLineEngine::render(entt::registry& r, entt::entity brushE, entt::entity strokeE, vk::CommandBuffer cb)
+	void ArticulatedLineEngine::render(entt::registry& r, entt::entity brushE, entt::entity strokeE, vk::CommandBuffer cb,
+	                                   vk::Format format, float pixelsPerMeter)
 	{
 		auto& strokeCpo = r.get<ArticulatedLineStrokeCpo>(strokeE);
-		auto& brushCpo = r.get<ArticulatedLineBrushCpo>(brushE);
 
-		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, brushCpo.pipeline);
-		cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, brushCpo.pipelineLayout, 1, *brushCpo.descriptorSet, {});
+		// Pipeline of the brush is picked by attachment format.
+		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipelines.at(format));
+		// The table is the same for every brush, only the index changes between strokes.
+		cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *pipelineLayout, 1,
+		                      r.ctx().at<BrushTable*>()->descriptorSet(), {});
+		cb.pushConstants<uint32_t>(*pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0,
+		                           BrushTable::index(r, brushE));
 
 		std::vector<vk::Buffer> vbs;
 		for(auto& buffer : strokeCpo.vertexBuffers)
@@ -216,7 +270,16 @@ namespace ciallo
 			vbs.push_back(buffer);
 		}
 		cb.bindVertexBuffers({}, vbs, {});
-		
+
+		auto* lod = r.try_get<StrokeLodCpo>(strokeE);
+		auto* bounds = r.try_get<StrokeBoundsCpo>(strokeE);
+		if (lod && bounds && lod->indexBuffer.allocated())
+		{
+			uint32_t level = lod->selectLevel(*bounds, pixelsPerMeter);
+			cb.bindIndexBuffer(lod->indexBuffer, 0, vk::IndexType::eUint32);
+			cb.drawIndexed(lod->indexCount(level), 1, lod->firstIndex(level), 0, 0);
+			return;
+		}
 		uint32_t vertCount = r.get<StrokeCpo>(strokeE).position.size();
 		cb.draw(vertCount, {}, {}, {});
 	}
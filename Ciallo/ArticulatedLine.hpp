@@ -1,6 +1,8 @@
 #pragma once
 
+#include "CanvasFormat.hpp"
 #include "Device.hpp"
+#include "FalloffCurve.hpp"
 #include "Image.hpp"
 #include "ShaderModule.hpp"
 
@@ -29,13 +31,24 @@ namespace ciallo
 		vulkan::ShaderModule m_geomShader;
 		vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
 		vk::UniquePipelineLayout m_pipelineLayout;
-		vk::UniquePipeline m_pipeline;
+		// One per canvas format, dynamic rendering bakes attachment format into pipeline.
+		std::unordered_map<vk::Format, vk::UniquePipeline> m_pipelines;
 		vulkan::Buffer m_vertBuffer;
+		vk::DescriptorSet m_descriptorSet;
+		vk::UniqueSampler m_sampler;
+		vulkan::Image m_falloffLut;
+		std::optional<FalloffCurveCpo> m_bakedFalloff; // curve in m_falloffLut
 	public:
 		std::vector<Vertex> vertices; // delete it after...
-		explicit ArticulatedLineEngineTemp(vulkan::Device* device);
+		// Close to the former fixed profile of hardness 0.98.
+		FalloffCurveCpo falloff{{glm::vec2{0.0f, 1.0f}, glm::vec2{0.85f, 1.0f}, glm::vec2{1.0f, 0.8f}, glm::vec2{1.0f, 0.0f}}};
+		// The falloff LUT goes through uploads, it is ready for frames acquiring uploads after the next flush.
+		ArticulatedLineEngineTemp(vulkan::Device* device, UploadScheduler& uploads);
 		void genPipelineLayout();
-		void genPipelineDynamic();
+		void genFalloffLut(vulkan::Device* device);
+		// Bake falloff again if it was edited. Called where FalloffLutBaker::update is, before the flush.
+		void updateFalloff(UploadScheduler& uploads);
+		void genPipelineDynamic(vk::PhysicalDevice physicalDevice);
 		void renderDynamic(vk::CommandBuffer cb, const vulkan::Image* target);
 		void genVertexBuffer(VmaAllocator allocator);
 	public:
@@ -53,18 +66,23 @@ namespace ciallo
 		vk::UniqueShaderModule geomShader;
 		vk::UniqueShaderModule fragShader;
 		vk::UniqueDescriptorSetLayout strokeDescriptorSetLayout;
-		vk::UniqueDescriptorSetLayout brushDescriptorSetLayout;
-		vk::UniquePipelineLayout pipelineLayout;
-		vk::UniquePipeline pipeline;
+		vk::UniquePipelineLayout pipelineLayout; // set 1 is BrushTable, push constant is brush index
+		// One per canvas format.
+		std::unordered_map<vk::Format, vk::UniquePipeline> pipelines;
 
 		vulkan::Device* m_device;
 	public:
-		explicit ArticulatedLineEngine(vulkan::Device* d);
+		ArticulatedLineEngine(vulkan::Device* d, vk::DescriptorSetLayout brushTableLayout);
 
 		void assignBrushRenderingData(entt::registry& r, entt::entity brushE, const ArticulatedLineSettings& settings);
 		void assignStrokeRenderingData(entt::registry& r, entt::entity strokeE, const ArticulatedLineSettings& settings);
 		void removeRenderingData(entt::registry& r, entt::entity e);
-		void render(entt::registry& r, entt::entity brushE, entt::entity strokeE, vk::CommandBuffer cb);
+		/**
+		 * \brief Format is the one of the color attachment, level of detail is picked for its pixelsPerMeter.
+		 * Brush is read from BrushTable in registry ctx by its index.
+		 */
+		void render(entt::registry& r, entt::entity brushE, entt::entity strokeE, vk::CommandBuffer cb,
+		            vk::Format format, float pixelsPerMeter);
 		std::vector<vulkan::Buffer> createVertexBuffers(entt::registry& r, entt::entity strokeE,  const ArticulatedLineSettings& settings);
 	};
 }
@@ -14,6 +14,6 @@ namespace ciallo
 		// owned by engine, only engine knows how to construct this component.
 		vk::Pipeline pipeline;
 		vk::PipelineLayout pipelineLayout;
-		vk::UniqueDescriptorSet descriptorSet;
+		// Parameters live in BrushTable, no descriptor set per brush.
 	};
 }
@@ -1,2 +1,691 @@
 #include "pch.hpp"
 #include "BezierTransformer.hpp"
+
+#include <unordered_set>
+
+#include "vku.hpp"
+#include "CanvasFormat.hpp"
+#include "CanvasInteraction.hpp"
+#include "CurveFitting.hpp"
+#include "Drawing.hpp"
+#include "JobSystem.hpp"
+#include "Layer.hpp"
+#include "RedoUndo.hpp"
+#include "Stroke.hpp"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <immintrin.h>
+#define CIALLO_TRANSFORM_SSE 1
+#endif
+
+namespace ciallo::geom
+{
+	static_assert(sizeof(Point) == 2 * sizeof(float), "Points are processed as interleaved float2.");
+
+	namespace
+	{
+		constexpr float Binomial[BezierTransformer::MaxLatticeSize][BezierTransformer::MaxLatticeSize]{
+			{1.0f, 0.0f, 0.0f, 0.0f},
+			{1.0f, 1.0f, 0.0f, 0.0f},
+			{1.0f, 2.0f, 1.0f, 0.0f},
+			{1.0f, 3.0f, 3.0f, 1.0f},
+		};
+
+		// Powers by repeated products, 0^0 stays 1 at the lattice border.
+		void bernstein(float t, uint32_t degree, float* basis)
+		{
+			float s = 1.0f - t;
+			for (uint32_t i = 0; i <= degree; ++i)
+			{
+				float b = Binomial[degree][i];
+				for (uint32_t k = 0; k < i; ++k) b *= t;
+				for (uint32_t k = i; k < degree; ++k) b *= s;
+				basis[i] = b;
+			}
+		}
+
+#ifdef CIALLO_TRANSFORM_SSE
+		void bernstein(__m128 t, uint32_t degree, __m128* basis)
+		{
+			__m128 s = _mm_sub_ps(_mm_set1_ps(1.0f), t);
+			for (uint32_t i = 0; i <= degree; ++i)
+			{
+				__m128 b = _mm_set1_ps(Binomial[degree][i]);
+				for (uint32_t k = 0; k < i; ++k) b = _mm_mul_ps(b, t);
+				for (uint32_t k = i; k < degree; ++k) b = _mm_mul_ps(b, s);
+				basis[i] = b;
+			}
+		}
+
+		// Four interleaved points to x and y lanes.
+		void load(const float* in, __m128& x, __m128& y)
+		{
+			__m128 a = _mm_loadu_ps(in);
+			__m128 b = _mm_loadu_ps(in + 4);
+			x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		}
+
+		void store(float* out, __m128 x, __m128 y)
+		{
+			_mm_storeu_ps(out, _mm_unpacklo_ps(x, y));
+			_mm_storeu_ps(out + 4, _mm_unpackhi_ps(x, y));
+		}
+#endif
+
+		// Unit square (0,0) (1,0) (1,1) (0,1) onto quad, Heckbert's closed form.
+		glm::mat3 squareToQuad(const std::array<glm::vec2, 4>& q)
+		{
+			glm::vec2 s = q[0] - q[1] + q[2] - q[3];
+			glm::vec2 d1 = q[1] - q[2];
+			glm::vec2 d2 = q[3] - q[2];
+			float g = 0.0f, h = 0.0f;
+			float det = d1.x * d2.y - d2.x * d1.y;
+			if ((s.x != 0.0f || s.y != 0.0f) && det != 0.0f)
+			{
+				g = (s.x * d2.y - d2.x * s.y) / det;
+				h = (d1.x * s.y - s.x * d1.y) / det;
+			}
+			glm::vec2 u = q[1] - q[0] + g * q[1];
+			glm::vec2 v = q[3] - q[0] + h * q[3];
+			return {u.x, u.y, g, v.x, v.y, h, q[0].x, q[0].y, 1.0f};
+		}
+	}
+
+	BezierTransformer BezierTransformer::affine(glm::vec2 translation, float rotation, glm::vec2 scale,
+	                                            glm::vec2 pivot)
+	{
+		float c = glm::cos(rotation), s = glm::sin(rotation);
+		glm::mat2 linear{c * scale.x, s * scale.x, -s * scale.y, c * scale.y};
+		glm::vec2 offset = pivot + translation - linear * pivot;
+
+		BezierTransformer t;
+		t.m_mode = Mode::Affine;
+		t.m_matrix = glm::mat3(linear);
+		t.m_matrix[2] = glm::vec3(offset, 1.0f);
+		return t;
+	}
+
+	BezierTransformer BezierTransformer::perspective(const std::array<glm::vec2, 4>& from,
+	                                                 const std::array<glm::vec2, 4>& to)
+	{
+		BezierTransformer t;
+		t.m_mode = Mode::Perspective;
+		t.m_matrix = squareToQuad(to) * glm::inverse(squareToQuad(from));
+		return t;
+	}
+
+	BezierTransformer BezierTransformer::lattice(glm::vec2 min, glm::vec2 max, glm::uvec2 size)
+	{
+		BezierTransformer t;
+		t.m_mode = Mode::Lattice;
+		t.m_latticeMin = min;
+		t.m_latticeMax = glm::max(max, min + std::numeric_limits<float>::epsilon());
+		t.m_latticeSize = glm::clamp(size, glm::uvec2(2u), glm::uvec2(MaxLatticeSize));
+		// Evenly spaced Bezier control points reproduce the identity.
+		for (uint32_t y = 0; y < t.m_latticeSize.y; ++y)
+		{
+			for (uint32_t x = 0; x < t.m_latticeSize.x; ++x)
+			{
+				glm::vec2 uv = glm::vec2(x, y) / glm::vec2(t.m_latticeSize - 1u);
+				t.latticePoint(x, y) = glm::mix(t.m_latticeMin, t.m_latticeMax, uv);
+			}
+		}
+		return t;
+	}
+
+	float BezierTransformer::thicknessScale() const
+	{
+		if (m_mode != Mode::Affine) return 1.0f;
+		return glm::sqrt(glm::abs(glm::determinant(glm::mat2(m_matrix))));
+	}
+
+	Point BezierTransformer::operator()(const Point& p) const
+	{
+		Point out;
+		apply({&p, 1}, {&out, 1});
+		return out;
+	}
+
+	void BezierTransformer::apply(std::span<const Point> in, std::span<Point> out) const
+	{
+		assert(in.size() == out.size());
+		const float* src = reinterpret_cast<const float*>(in.data());
+		float* dst = reinterpret_cast<float*>(out.data());
+		if (m_mode == Mode::Lattice)
+		{
+			applyLattice(src, dst, in.size());
+		}
+		else
+		{
+			applyMatrix(src, dst, in.size());
+		}
+	}
+
+	void BezierTransformer::applyMatrix(const float* in, float* out, size_t count) const
+	{
+		const glm::mat3& m = m_matrix;
+		bool projective = m_mode == Mode::Perspective;
+		size_t i = 0;
+#ifdef CIALLO_TRANSFORM_SSE
+		const __m128 m00 = _mm_set1_ps(m[0][0]), m01 = _mm_set1_ps(m[0][1]), m02 = _mm_set1_ps(m[0][2]);
+		const __m128 m10 = _mm_set1_ps(m[1][0]), m11 = _mm_set1_ps(m[1][1]), m12 = _mm_set1_ps(m[1][2]);
+		const __m128 m20 = _mm_set1_ps(m[2][0]), m21 = _mm_set1_ps(m[2][1]), m22 = _mm_set1_ps(m[2][2]);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x, y;
+			load(in + 2 * i, x, y);
+			__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m10, y)), m20);
+			__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, x), _mm_mul_ps(m11, y)), m21);
+			if (projective)
+			{
+				__m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, x), _mm_mul_ps(m12, y)), m22);
+				rx = _mm_div_ps(rx, w);
+				ry = _mm_div_ps(ry, w);
+			}
+			store(out + 2 * i, rx, ry);
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			glm::vec3 p = m * glm::vec3(in[2 * i], in[2 * i + 1], 1.0f);
+			if (projective) p /= p.z;
+			out[2 * i] = p.x;
+			out[2 * i + 1] = p.y;
+		}
+	}
+
+	void BezierTransformer::applyLattice(const float* in, float* out, size_t count) const
+	{
+		const uint32_t nx = m_latticeSize.x - 1u, ny = m_latticeSize.y - 1u;
+		const glm::vec2 invExtent = 1.0f / (m_latticeMax - m_latticeMin);
+		size_t i = 0;
+#ifdef CIALLO_TRANSFORM_SSE
+		const __m128 minX = _mm_set1_ps(m_latticeMin.x), minY = _mm_set1_ps(m_latticeMin.y);
+		const __m128 invX = _mm_set1_ps(invExtent.x), invY = _mm_set1_ps(invExtent.y);
+		std::array<__m128, MaxLatticeSize * MaxLatticeSize> px, py;
+		for (uint32_t k = 0; k < m_lattice.size(); ++k)
+		{
+			px[k] = _mm_set1_ps(m_lattice[k].x);
+			py[k] = _mm_set1_ps(m_lattice[k].y);
+		}
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x, y;
+			load(in + 2 * i, x, y);
+			__m128 bu[MaxLatticeSize], bv[MaxLatticeSize];
+			bernstein(_mm_mul_ps(_mm_sub_ps(x, minX), invX), nx, bu);
+			bernstein(_mm_mul_ps(_mm_sub_ps(y, minY), invY), ny, bv);
+			__m128 rx = _mm_setzero_ps(), ry = _mm_setzero_ps();
+			for (uint32_t v = 0; v <= ny; ++v)
+			{
+				__m128 rowX = _mm_setzero_ps(), rowY = _mm_setzero_ps();
+				for (uint32_t u = 0; u <= nx; ++u)
+				{
+					rowX = _mm_add_ps(rowX, _mm_mul_ps(bu[u], px[v * MaxLatticeSize + u]));
+					rowY = _mm_add_ps(rowY, _mm_mul_ps(bu[u], py[v * MaxLatticeSize + u]));
+				}
+				rx = _mm_add_ps(rx, _mm_mul_ps(bv[v], rowX));
+				ry = _mm_add_ps(ry, _mm_mul_ps(bv[v], rowY));
+			}
+			store(out + 2 * i, rx, ry);
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			glm::vec2 uv = (glm::vec2(in[2 * i], in[2 * i + 1]) - m_latticeMin) * invExtent;
+			float bu[MaxLatticeSize], bv[MaxLatticeSize];
+			bernstein(uv.x, nx, bu);
+			bernstein(uv.y, ny, bv);
+			glm::vec2 p{0.0f, 0.0f};
+			for (uint32_t v = 0; v <= ny; ++v)
+			{
+				glm::vec2 row{0.0f, 0.0f};
+				for (uint32_t u = 0; u <= nx; ++u) row += bu[u] * latticePoint(u, v);
+				p += bv[v] * row;
+			}
+			out[2 * i] = p.x;
+			out[2 * i + 1] = p.y;
+		}
+	}
+}
+
+namespace ciallo
+{
+	namespace
+	{
+		constexpr vk::ShaderStageFlags PreviewStages = vk::ShaderStageFlagBits::eVertex |
+			vk::ShaderStageFlagBits::eFragment;
+		constexpr uint32_t WorkGroupSize = 256;
+		// Bounds of a straight line still span a lattice and a quad.
+		constexpr float MinExtent = 1e-4f; // 0.1mm
+
+		std::vector<entt::entity> selectStrokes(entt::registry& r, entt::entity drawing, bool topLayerOnly)
+		{
+			std::vector<entt::entity> strokes;
+			auto* stack = r.try_get<LayerStackCpo>(drawing);
+			if (!stack || stack->layers.empty()) return strokes;
+			std::unordered_set<entt::entity> layers;
+			if (topLayerOnly)
+			{
+				layers.insert(stack->layers.back());
+			}
+			else
+			{
+				layers.insert(stack->layers.begin(), stack->layers.end());
+			}
+			for (auto&& [e, stroke, member] : r.view<StrokeCpo, LayerMemberCpo>(entt::exclude<LiveStrokeCpo>).each())
+			{
+				if (layers.contains(member.layer)) strokes.push_back(e);
+			}
+			return strokes;
+		}
+
+		const char* modeName(geom::BezierTransformer::Mode mode)
+		{
+			switch (mode)
+			{
+			case geom::BezierTransformer::Mode::Affine: return "Affine";
+			case geom::BezierTransformer::Mode::Perspective: return "Perspective";
+			case geom::BezierTransformer::Mode::Lattice: return "Lattice";
+			}
+			return "";
+		}
+	}
+
+	StrokeTransformer::StrokeTransformer(vulkan::Device* device): m_device(device)
+	{
+		m_compShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eCompute,
+		                                    "./shaders/strokeTransform.comp.spv");
+		m_vertShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eVertex,
+		                                    "./shaders/strokeTransformPreview.vert.spv");
+		m_fragShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eFragment,
+		                                    "./shaders/strokeTransformPreview.frag.spv");
+		VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+		m_params = vulkan::Buffer(*device, info, sizeof(Params), vk::BufferUsageFlagBits::eUniformBuffer);
+		genDescriptorSet(device->descriptorPool());
+		genPipelines();
+		upload();
+	}
+
+	void StrokeTransformer::genDescriptorSet(vk::DescriptorPool pool)
+	{
+		vku::DescriptorSetLayoutMaker layoutMaker;
+		layoutMaker.buffer(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 1)
+		           .buffer(1, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 1)
+		           .buffer(2, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eCompute, 1);
+		m_descriptorSetLayout = layoutMaker.createUnique(m_device->device());
+
+		vku::DescriptorSetMaker maker;
+		maker.layout(*m_descriptorSetLayout);
+		m_descriptorSet = maker.create(m_device->device(), pool)[0];
+	}
+
+	void StrokeTransformer::genPipelines()
+	{
+		vk::Device device = m_device->device();
+		vku::PipelineLayoutMaker compLayoutMaker;
+		compLayoutMaker.descriptorSetLayout(*m_descriptorSetLayout);
+		m_compPipelineLayout = compLayoutMaker.createUnique(device);
+
+		vku::ComputePipelineMaker compMaker{};
+		compMaker.shader(vk::ShaderStageFlagBits::eCompute, m_compShader);
+		m_compPipeline = compMaker.createUnique(device, nullptr, *m_compPipelineLayout);
+
+		vku::PipelineLayoutMaker previewLayoutMaker;
+		previewLayoutMaker.pushConstantRange(PreviewStages, 0, sizeof(PushConstant));
+		m_previewPipelineLayout = previewLayoutMaker.createUnique(device);
+
+		// Premultiplied over.
+		vku::PipelineMaker previewMaker;
+		previewMaker.topology(vk::PrimitiveTopology::eLineList)
+		            .dynamicState(vk::DynamicState::eViewport)
+		            .dynamicState(vk::DynamicState::eScissor)
+		            .shader(vk::ShaderStageFlagBits::eVertex, m_vertShader)
+		            .shader(vk::ShaderStageFlagBits::eFragment, m_fragShader)
+		            .cullMode(vk::CullModeFlagBits::eNone)
+		            .vertexBinding(0, sizeof(geom::Point))
+		            .vertexAttribute(0, 0, vk::Format::eR32G32Sfloat, 0)
+		            .blendBegin(VK_TRUE)
+		            .blendSrcColorBlendFactor(vk::BlendFactor::eOne)
+		            .blendDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+		            .blendSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+		            .blendDstAlphaBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha);
+		for (CanvasFormat format : supportedCanvasFormats(m_device->physicalDevice()))
+		{
+			std::vector colorAttachmentsFormats{toVkFormat(format)};
+			vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
+			m_previewPipelines[toVkFormat(format)] = previewMaker.createUnique(
+				device, nullptr, *m_previewPipelineLayout, renderingCreateInfo);
+		}
+	}
+
+	void StrokeTransformer::updateDescriptorSet()
+	{
+		vku::DescriptorSetUpdater updater;
+		updater.beginDescriptorSet(m_descriptorSet)
+		       .beginBuffers(0, 0, vk::DescriptorType::eStorageBuffer)
+		       .buffer(m_source)
+		       .beginBuffers(1, 0, vk::DescriptorType::eStorageBuffer)
+		       .buffer(m_deformed)
+		       .beginBuffers(2, 0, vk::DescriptorType::eUniformBuffer)
+		       .buffer(m_params);
+		updater.update(m_device->device());
+	}
+
+	void StrokeTransformer::pack(entt::registry& r)
+	{
+		m_packed.clear();
+		m_packedIndices.clear();
+		glm::vec2 min{std::numeric_limits<float>::max()}, max{std::numeric_limits<float>::lowest()};
+		for (entt::entity e : m_strokes)
+		{
+			const auto& stroke = r.get<StrokeCpo>(e);
+			auto first = static_cast<uint32_t>(m_packed.size());
+			m_packed.insert(m_packed.end(), stroke.position.begin(), stroke.position.end());
+			for (uint32_t i = 1; i < stroke.position.size(); ++i)
+			{
+				m_packedIndices.push_back(first + i - 1);
+				m_packedIndices.push_back(first + i);
+			}
+			for (const geom::Point& p : stroke.position)
+			{
+				min = glm::min(min, {p.x(), p.y()});
+				max = glm::max(max, {p.x(), p.y()});
+			}
+		}
+		if (m_packed.empty()) min = max = glm::vec2(0.0f);
+		m_boundsMin = min;
+		m_boundsMax = glm::max(max, min + MinExtent);
+		m_uploadPending = true;
+		resetHandles();
+	}
+
+	void StrokeTransformer::upload()
+	{
+		// Previous frame is finished, buffers and descriptor set are free to change.
+		VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+		vk::DeviceSize vertexCount = std::max<size_t>(m_packed.size(), 1024);
+		if (!m_source.allocated() || m_source.size() < vertexCount * sizeof(geom::Point))
+		{
+			vk::DeviceSize capacity = std::bit_ceil(vertexCount) * sizeof(geom::Point);
+			m_source = vulkan::Buffer(*m_device, info, capacity, vk::BufferUsageFlagBits::eStorageBuffer);
+			m_deformed = vulkan::Buffer(*m_device, vulkan::MemoryAuto, capacity,
+			                            vk::BufferUsageFlagBits::eStorageBuffer |
+			                            vk::BufferUsageFlagBits::eVertexBuffer);
+			updateDescriptorSet();
+		}
+		vk::DeviceSize indexCount = std::max<size_t>(m_packedIndices.size(), 2048);
+		if (!m_indices.allocated() || m_indices.size() < indexCount * sizeof(uint32_t))
+		{
+			m_indices = vulkan::Buffer(*m_device, info, std::bit_ceil(indexCount) * sizeof(uint32_t),
+			                           vk::BufferUsageFlagBits::eIndexBuffer);
+		}
+		if (!m_packed.empty()) m_source.uploadLocal(m_packed.data(), m_packed.size() * sizeof(geom::Point));
+		if (!m_packedIndices.empty())
+		{
+			m_indices.uploadLocal(m_packedIndices.data(), m_packedIndices.size() * sizeof(uint32_t));
+		}
+		m_uploadPending = false;
+	}
+
+	void StrokeTransformer::resetHandles()
+	{
+		m_translation = {0.0f, 0.0f};
+		m_rotation = 0.0f;
+		m_scale = {1.0f, 1.0f};
+		m_corners = {
+			m_boundsMin, glm::vec2{m_boundsMax.x, m_boundsMin.y}, m_boundsMax, glm::vec2{m_boundsMin.x, m_boundsMax.y}
+		};
+		m_deformation = geom::BezierTransformer::lattice(m_boundsMin, m_boundsMax, m_latticeSize);
+		updateDeformation();
+	}
+
+	void StrokeTransformer::updateDeformation()
+	{
+		switch (m_mode)
+		{
+		case geom::BezierTransformer::Mode::Affine:
+			m_deformation = geom::BezierTransformer::affine(m_translation, m_rotation, m_scale,
+			                                                (m_boundsMin + m_boundsMax) * 0.5f);
+			break;
+		case geom::BezierTransformer::Mode::Perspective:
+			m_deformation = geom::BezierTransformer::perspective({
+				m_boundsMin, glm::vec2{m_boundsMax.x, m_boundsMin.y}, m_boundsMax,
+				glm::vec2{m_boundsMin.x, m_boundsMax.y}
+			}, m_corners);
+			break;
+		case geom::BezierTransformer::Mode::Lattice:
+			// Lattice points are edited in place.
+			break;
+		}
+		m_deformPending = true;
+	}
+
+	void StrokeTransformer::begin(entt::registry& r, std::vector<entt::entity> strokes)
+	{
+		end(r);
+		std::erase_if(strokes, [&r](entt::entity e) { return !r.valid(e) || !r.all_of<StrokeCpo>(e); });
+		if (strokes.empty()) return;
+		m_strokes = std::move(strokes);
+		for (entt::entity e : m_strokes)
+		{
+			r.emplace_or_replace<TransformingTag>(e);
+		}
+		m_changed.connect(r, entt::collector.update<StrokeCpo>().where<TransformingTag>());
+		pack(r);
+	}
+
+	void StrokeTransformer::commit(Project& project)
+	{
+		if (!active()) return;
+		entt::registry& r = project.registry();
+		// Control points of curves go through affine maps exactly, other curves are dropped by the patch.
+		bool keepCurves = m_deformation.mode() == geom::BezierTransformer::Mode::Affine;
+		float thicknessScale = m_deformation.thicknessScale();
+
+		// Fetch components on this thread, workers touch nothing but their own stroke.
+		std::vector<StrokeCpo*> strokeCpos;
+		std::vector<std::optional<StrokeCurveCpo>> curves(m_strokes.size());
+		for (size_t i = 0; i < m_strokes.size(); ++i)
+		{
+			entt::entity e = m_strokes[i];
+			if (!r.all_of<Modifying<StrokeCpo>>(e)) r.emplace<Modifying<StrokeCpo>>(e);
+			// Captures the curve before it is moved out, the patch below drops it or it is replaced.
+			if (!r.all_of<Modifying<StrokeCurveCpo>>(e)) r.emplace<Modifying<StrokeCurveCpo>>(e);
+			strokeCpos.push_back(&r.get<StrokeCpo>(e));
+			auto* curve = r.try_get<StrokeCurveCpo>(e);
+			if (keepCurves && curve) curves[i] = std::move(*curve);
+		}
+
+		const geom::BezierTransformer& deformation = m_deformation;
+		r.ctx().at<JobSystem*>()->parallelFor(strokeCpos.size(), [&](size_t i)
+		{
+			StrokeCpo& stroke = *strokeCpos[i];
+			deformation.apply(stroke.position);
+			for (float& thickness : stroke.thickness) thickness *= thicknessScale;
+			if (!curves[i]) return;
+			deformation.apply(curves[i]->spline.controlPoints);
+			for (float& thickness : curves[i]->spline.thickness) thickness *= thicknessScale;
+		});
+
+		for (size_t i = 0; i < m_strokes.size(); ++i)
+		{
+			r.patch<StrokeCpo>(m_strokes[i]);
+			// After the patch, which drops stale curves.
+			if (curves[i]) r.emplace_or_replace<StrokeCurveCpo>(m_strokes[i], std::move(*curves[i]));
+		}
+		RedoUndo::commit(project, "Transform Strokes");
+		// Carry on from the committed strokes.
+		m_changed.clear();
+		pack(r);
+	}
+
+	void StrokeTransformer::end(entt::registry& r)
+	{
+		for (entt::entity e : m_strokes)
+		{
+			if (r.valid(e)) r.remove<TransformingTag>(e);
+		}
+		m_strokes.clear();
+		m_packed.clear();
+		m_packedIndices.clear();
+		m_changed.disconnect();
+	}
+
+	void StrokeTransformer::deform(entt::registry& r, vk::CommandBuffer cb)
+	{
+		if (!active()) return;
+		// Strokes changed under the session, by redo undo for example. Handles start over from them.
+		auto lost = std::ranges::remove_if(m_strokes, [&r](entt::entity e)
+		{
+			return !r.valid(e) || !r.all_of<StrokeCpo, TransformingTag>(e);
+		});
+		bool changed = !lost.empty() || !m_changed.empty();
+		m_strokes.erase(lost.begin(), lost.end());
+		m_changed.clear();
+		if (m_strokes.empty())
+		{
+			end(r);
+			return;
+		}
+		if (changed) pack(r);
+		if (m_uploadPending) upload();
+		if (!m_deformPending || m_packed.empty()) return;
+
+		Params params{};
+		const glm::mat3& matrix = m_deformation.matrix();
+		for (int c = 0; c < 3; ++c)
+		{
+			params.matrix[c] = glm::vec4(matrix[c], 0.0f);
+		}
+		params.latticeMin = m_deformation.latticeMin();
+		params.latticeMax = m_deformation.latticeMax();
+		params.latticeSize = m_deformation.latticeSize();
+		params.mode = static_cast<uint32_t>(m_deformation.mode());
+		params.count = static_cast<uint32_t>(m_packed.size());
+		const auto& lattice = m_deformation.latticePoints();
+		for (size_t i = 0; i < lattice.size(); ++i)
+		{
+			params.lattice[i] = glm::vec4(lattice[i], 0.0f, 0.0f);
+		}
+		m_params.uploadLocal(&params, sizeof(Params));
+
+		cb.bindPipeline(vk::PipelineBindPoint::eCompute, *m_compPipeline);
+		cb.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *m_compPipelineLayout, 0, m_descriptorSet, {});
+		cb.dispatch((params.count + WorkGroupSize - 1) / WorkGroupSize, 1, 1);
+		m_deformPending = false;
+	}
+
+	void StrokeTransformer::render(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing,
+	                               const vulkan::Image& target)
+	{
+		if (!active() || m_packedIndices.empty() || m_uploadPending) return;
+		auto pipeline = m_previewPipelines.find(target.format());
+		auto* view = r.try_get<ViewRectCpo>(drawing);
+		if (pipeline == m_previewPipelines.end() || !view) return;
+
+		vk::Rect2D area{{0, 0}, target.extent2D()};
+		vk::RenderingAttachmentInfo renderingAttachmentInfo{target.imageView(), vk::ImageLayout::eGeneral};
+		std::vector colorAttachments{renderingAttachmentInfo};
+		cb.beginRendering({{}, area, 1, 0, colorAttachments, {}, {}});
+		vk::Viewport fullViewport{
+			0, 0, static_cast<float>(target.width()), static_cast<float>(target.height()), 0.0f, 1.0f
+		};
+		cb.setViewport(0, fullViewport);
+		cb.setScissor(0, area);
+		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline->second);
+		PushConstant pushConstant{view->min, view->max, previewColor};
+		cb.pushConstants<PushConstant>(*m_previewPipelineLayout, PreviewStages, 0, pushConstant);
+		cb.bindVertexBuffers(0, m_deformed.buffer(), {0});
+		cb.bindIndexBuffer(m_indices, 0, vk::IndexType::eUint32);
+		cb.drawIndexed(static_cast<uint32_t>(m_packedIndices.size()), 1, 0, 0, 0);
+		cb.endRendering();
+	}
+
+	bool StrokeTransformer::drawHandles()
+	{
+		bool changed = false, released = false;
+		auto handle = [&](bool edited)
+		{
+			changed |= edited;
+			released |= ImGui::IsItemDeactivatedAfterEdit();
+		};
+		glm::vec2 extent = m_boundsMax - m_boundsMin;
+		float speed = glm::max(extent.x, extent.y) * 0.002f;
+		switch (m_mode)
+		{
+		case geom::BezierTransformer::Mode::Affine:
+			handle(ImGui::DragFloat2("Translation", &m_translation.x, speed, 0.0f, 0.0f, "%.5f"));
+			handle(ImGui::SliderAngle("Rotation", &m_rotation, -180.0f, 180.0f));
+			handle(ImGui::DragFloat2("Scale", &m_scale.x, 0.005f, 0.01f, 100.0f));
+			break;
+		case geom::BezierTransformer::Mode::Perspective:
+			for (size_t i = 0; i < m_corners.size(); ++i)
+			{
+				handle(ImGui::DragFloat2(std::format("Corner {}", i).c_str(), &m_corners[i].x, speed, 0.0f, 0.0f,
+				                         "%.5f"));
+			}
+			break;
+		case geom::BezierTransformer::Mode::Lattice:
+		{
+			const uint32_t minSize = 2, maxSize = geom::BezierTransformer::MaxLatticeSize;
+			if (ImGui::SliderScalarN("Lattice Size", ImGuiDataType_U32, &m_latticeSize.x, 2, &minSize, &maxSize))
+			{
+				resetHandles();
+			}
+			glm::uvec2 size = m_deformation.latticeSize();
+			for (uint32_t y = 0; y < size.y; ++y)
+			{
+				for (uint32_t x = 0; x < size.x; ++x)
+				{
+					handle(ImGui::DragFloat2(std::format("Point {} {}", x, y).c_str(),
+					                         &m_deformation.latticePoint(x, y).x, speed, 0.0f, 0.0f, "%.5f"));
+				}
+			}
+			break;
+		}
+		}
+		if (changed) updateDeformation();
+		return released;
+	}
+
+	void StrokeTransformer::drawWindow(Project& project, entt::entity drawing, bool* open)
+	{
+		entt::registry& r = project.registry();
+		if (!ImGui::Begin("Transform", open))
+		{
+			ImGui::End();
+			return;
+		}
+		if (ImGui::Button("Select Top Layer")) begin(r, selectStrokes(r, drawing, true));
+		ImGui::SameLine();
+		if (ImGui::Button("Select Drawing")) begin(r, selectStrokes(r, drawing, false));
+		if (!active())
+		{
+			ImGui::TextUnformatted("Nothing selected.");
+			ImGui::End();
+			return;
+		}
+		ImGui::Text("%zu strokes, %zu vertices", m_strokes.size(), m_packed.size());
+		if (ImGui::BeginCombo("Mode", modeName(m_mode)))
+		{
+			for (auto mode : {
+				     geom::BezierTransformer::Mode::Affine, geom::BezierTransformer::Mode::Perspective,
+				     geom::BezierTransformer::Mode::Lattice
+			     })
+			{
+				if (ImGui::Selectable(modeName(mode), mode == m_mode))
+				{
+					m_mode = mode;
+					resetHandles();
+				}
+			}
+			ImGui::EndCombo();
+		}
+		// Dragging previews on GPU, every release is one redo undo step.
+		if (drawHandles()) commit(project);
+		if (ImGui::Button("Done")) end(r);
+		ImGui::End();
+	}
+}
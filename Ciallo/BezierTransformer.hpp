@@ -1,9 +1,169 @@
 #pragma once
 
+#include <array>
+#include <span>
+
+#include "Buffer.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "Project.hpp"
+#include "ShaderModule.hpp"
+
 namespace ciallo::geom
 {
+	/**
+	 * \brief Deformation of the plane, applied to stroke vertices and Bezier control points alike.
+	 * Affine maps commute with Bezier evaluation, so curves stay exact under them. Perspective is a homography,
+	 * Lattice is a free-form deformation by a tensor product Bezier patch over a rectangle, both only exact on
+	 * vertices.
+	 */
 	class BezierTransformer
 	{
+	public:
+		enum class Mode
+		{
+			Affine,
+			Perspective,
+			Lattice,
+		};
+
+		constexpr static uint32_t MaxLatticeSize = 4; // control points per axis, cubic at most
+
+	private:
+		Mode m_mode = Mode::Affine;
+		glm::mat3 m_matrix{1.0f}; // homogeneous, affine and perspective
+		glm::vec2 m_latticeMin{0.0f, 0.0f};
+		glm::vec2 m_latticeMax{1.0f, 1.0f};
+		glm::uvec2 m_latticeSize{2u, 2u};
+		std::array<glm::vec2, MaxLatticeSize * MaxLatticeSize> m_lattice{}; // row major, x fastest
+
+		void applyMatrix(const float* in, float* out, size_t count) const;
+		void applyLattice(const float* in, float* out, size_t count) const;
+	public:
+		// Scale about pivot, then rotate about it, then translate.
+		static BezierTransformer affine(glm::vec2 translation, float rotation, glm::vec2 scale, glm::vec2 pivot);
+		// Maps quad from onto quad to, corners in the same winding.
+		static BezierTransformer perspective(const std::array<glm::vec2, 4>& from, const std::array<glm::vec2, 4>& to);
+		// Lattice at rest over [min, max], identity until its points are moved.
+		static BezierTransformer lattice(glm::vec2 min, glm::vec2 max, glm::uvec2 size);
+
+		Mode mode() const { return m_mode; }
+		const glm::mat3& matrix() const { return m_matrix; }
+		glm::vec2 latticeMin() const { return m_latticeMin; }
+		glm::vec2 latticeMax() const { return m_latticeMax; }
+		glm::uvec2 latticeSize() const { return m_latticeSize; }
+		glm::vec2& latticePoint(uint32_t x, uint32_t y) { return m_lattice[y * MaxLatticeSize + x]; }
+		const glm::vec2& latticePoint(uint32_t x, uint32_t y) const { return m_lattice[y * MaxLatticeSize + x]; }
+		const std::array<glm::vec2, MaxLatticeSize * MaxLatticeSize>& latticePoints() const { return m_lattice; }
+		// Thickness follows the area change of affine maps, left alone otherwise.
+		float thicknessScale() const;
+
+		Point operator()(const Point& p) const;
+		// In and out are the same size and may be the same span. Batches of four points go through SSE.
+		void apply(std::span<const Point> in, std::span<Point> out) const;
+		void apply(std::span<Point> points) const { apply(points, points); }
 	};
 }
 
+namespace ciallo
+{
+	// Stroke being transformed. Its layer skips it, StrokeTransformer draws it instead until the session ends.
+	struct TransformingTag
+	{
+	};
+
+	/**
+	 * \brief Interactive transform of a selection of strokes.
+	 * The selection is packed into one buffer once. While a handle is dragged, a compute pass deforms the packed
+	 * vertices on GPU and the result is drawn over the canvas as a preview, StrokeCpo is not touched. Releasing the
+	 * handle commits: every stroke is deformed on CPU in parallel, recorded as one redo undo step, and the session
+	 * carries on from the committed strokes.
+	 */
+	class StrokeTransformer
+	{
+		struct Params // std140
+		{
+			glm::vec4 matrix[3]; // columns
+			glm::vec2 latticeMin;
+			glm::vec2 latticeMax;
+			glm::uvec2 latticeSize;
+			uint32_t mode;
+			uint32_t count;
+			glm::vec4 lattice[geom::BezierTransformer::MaxLatticeSize * geom::BezierTransformer::MaxLatticeSize];
+		};
+
+		struct PushConstant
+		{
+			glm::vec2 viewMin;
+			glm::vec2 viewMax;
+			glm::vec4 color;
+		};
+
+		vulkan::Device* m_device;
+		vulkan::ShaderModule m_compShader;
+		vulkan::ShaderModule m_vertShader;
+		vulkan::ShaderModule m_fragShader;
+		vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+		vk::UniquePipelineLayout m_compPipelineLayout;
+		vk::UniquePipelineLayout m_previewPipelineLayout;
+		vk::DescriptorSet m_descriptorSet;
+		vk::UniquePipeline m_compPipeline;
+		std::unordered_map<vk::Format, vk::UniquePipeline> m_previewPipelines;
+
+		vulkan::Buffer m_source; // packed vertices of the selection
+		vulkan::Buffer m_deformed; // written by compute, read as vertices
+		vulkan::Buffer m_indices; // line list over m_deformed
+		vulkan::Buffer m_params;
+
+		std::vector<entt::entity> m_strokes;
+		std::vector<geom::Point> m_packed;
+		std::vector<uint32_t> m_packedIndices;
+		entt::observer m_changed;
+		glm::vec2 m_boundsMin{0.0f, 0.0f};
+		glm::vec2 m_boundsMax{0.0f, 0.0f};
+		bool m_uploadPending = false;
+		bool m_deformPending = false;
+
+		// Handles, reset to identity whenever the session is rebased.
+		geom::BezierTransformer::Mode m_mode = geom::BezierTransformer::Mode::Affine;
+		glm::vec2 m_translation{0.0f, 0.0f};
+		float m_rotation = 0.0f;
+		glm::vec2 m_scale{1.0f, 1.0f};
+		std::array<glm::vec2, 4> m_corners{};
+		glm::uvec2 m_latticeSize{3u, 3u};
+		geom::BezierTransformer m_deformation;
+
+		void genDescriptorSet(vk::DescriptorPool pool);
+		void genPipelines();
+		void updateDescriptorSet();
+		void pack(entt::registry& r);
+		void upload();
+		void resetHandles();
+		void updateDeformation();
+		bool drawHandles();
+	public:
+		glm::vec4 previewColor = {0.1f, 0.5f, 1.0f, 1.0f};
+
+		explicit StrokeTransformer(vulkan::Device* device);
+
+		bool active() const { return !m_strokes.empty(); }
+		const std::vector<entt::entity>& strokes() const { return m_strokes; }
+		const geom::BezierTransformer& deformation() const { return m_deformation; }
+
+		// Start a session on strokes, ending the current one.
+		void begin(entt::registry& r, std::vector<entt::entity> strokes);
+		// Deform StrokeCpo of the selection on CPU and record it, handles go back to identity.
+		void commit(Project& project);
+		// Drop uncommitted handles and give strokes back to their layers.
+		void end(entt::registry& r);
+		/**
+		 * \brief Upload a changed selection and dispatch the compute pass when handles moved.
+		 * Call once per frame after the previous frame is finished, before render, with a barrier from compute
+		 * writes to vertex reads in between.
+		 */
+		void deform(entt::registry& r, vk::CommandBuffer cb);
+		// Preview of deformed strokes into target, in general layout, outside of rendering.
+		void render(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing, const vulkan::Image& target);
+		void drawWindow(Project& project, entt::entity drawing, bool* open);
+	};
+}
@@ -11,4 +11,16 @@ namespace ciallo
 		glm::vec4 color = {0.0f, 0.0f, 0.0f, 1.0f};
 	};
 
+	// Soft brush. Segments of one stroke are merged by coverage before blending, so overlaps never darken.
+	struct AirbrushCpo
+	{
+		float hardness = 0.98f;
+	};
+
+	// Brush stamping dots along the stroke.
+	struct EquidistantDotCpo
+	{
+		float spacing = 0.0005f; // meter
+	};
+
 }
@@ -1,8 +1,146 @@
 #include "pch.hpp"
 #include "BrushCabinet.hpp"
 
+#include "Brush.hpp"
+#include "BrushTable.hpp"
+#include "FalloffCurve.hpp"
+#include "RedoUndo.hpp"
+
 namespace ciallo::gui
 {
-	
-	
-}
\ No newline at end of file
+	namespace
+	{
+		const char* engineName(BrushEngineType type)
+		{
+			switch (type)
+			{
+			case BrushEngineType::ArticulatedLine: return "Line";
+			case BrushEngineType::EquidistantDot: return "Dot";
+			case BrushEngineType::Airbrush: return "Airbrush";
+			}
+			return "";
+		}
+
+		// One widget editing a copy of Cpo, the edit is one redo undo step when the widget is released.
+		template <typename Cpo, typename Widget>
+		void edit(Project& project, entt::entity e, const std::string& stepName, Widget&& widget)
+		{
+			entt::registry& r = project.registry();
+			Cpo value = r.get<Cpo>(e);
+			if (widget(value))
+			{
+				if (!r.all_of<Modifying<Cpo>>(e)) r.emplace<Modifying<Cpo>>(e);
+				r.replace<Cpo>(e, value);
+			}
+			if (ImGui::IsItemDeactivatedAfterEdit()) RedoUndo::commit(project, stepName);
+		}
+	}
+
+	void BrushCabinet::draw(Project& project, bool* open)
+	{
+		if (!ImGui::Begin("Brush Cabinet", open))
+		{
+			ImGui::End();
+			return;
+		}
+		entt::registry& r = project.registry();
+		if (m_selected != entt::null && (!r.valid(m_selected) || !r.all_of<BrushTag>(m_selected)))
+		{
+			m_selected = entt::null;
+		}
+		drawCreation(r);
+		ImGui::Separator();
+		drawList(r);
+		ImGui::Separator();
+		drawSelected(project);
+		ImGui::End();
+	}
+
+	void BrushCabinet::drawCreation(entt::registry& r)
+	{
+		auto create = [&r]
+		{
+			entt::entity e = r.create();
+			r.emplace<BrushTag>(e);
+			r.emplace<ColorCpo>(e);
+			r.emplace<FalloffCurveCpo>(e);
+			return e;
+		};
+		if (ImGui::Button("New Line")) m_selected = create();
+		ImGui::SameLine();
+		if (ImGui::Button("New Dot"))
+		{
+			m_selected = create();
+			r.emplace<EquidistantDotCpo>(m_selected);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("New Airbrush"))
+		{
+			m_selected = create();
+			r.emplace<AirbrushCpo>(m_selected);
+		}
+	}
+
+	void BrushCabinet::drawList(entt::registry& r)
+	{
+		for (entt::entity e : r.view<BrushTag>())
+		{
+			auto* slot = r.try_get<BrushIndexCpo>(e);
+			std::string label = slot
+				                    ? std::format("{} #{}", engineName(BrushTable::engineType(r, e)), slot->index)
+				                    : std::format("{} (pending)", engineName(BrushTable::engineType(r, e)));
+			if (auto* color = r.try_get<ColorCpo>(e))
+			{
+				ImGui::ColorButton(std::format("##color{}", entt::to_integral(e)).c_str(),
+				                   {color->color.r, color->color.g, color->color.b, color->color.a});
+				ImGui::SameLine();
+			}
+			ImGui::PushID(static_cast<int>(entt::to_integral(e)));
+			if (ImGui::Selectable(label.c_str(), m_selected == e)) m_selected = e;
+			ImGui::PopID();
+		}
+	}
+
+	void BrushCabinet::drawSelected(Project& project)
+	{
+		entt::registry& r = project.registry();
+		if (m_selected == entt::null)
+		{
+			ImGui::TextDisabled("No brush selected");
+			return;
+		}
+		entt::entity e = m_selected;
+		if (r.all_of<ColorCpo>(e))
+		{
+			edit<ColorCpo>(project, e, "Brush color", [](ColorCpo& c)
+			{
+				return ImGui::ColorEdit4("Color", reinterpret_cast<float*>(&c.color));
+			});
+		}
+		if (r.all_of<AirbrushCpo>(e))
+		{
+			edit<AirbrushCpo>(project, e, "Brush hardness", [](AirbrushCpo& a)
+			{
+				return ImGui::SliderFloat("Hardness", &a.hardness, 0.0f, 1.0f);
+			});
+		}
+		if (r.all_of<EquidistantDotCpo>(e))
+		{
+			edit<EquidistantDotCpo>(project, e, "Brush spacing", [](EquidistantDotCpo& d)
+			{
+				return ImGui::DragFloat("Spacing", &d.spacing, 0.00001f, 0.00001f, 0.01f, "%.5f m");
+			});
+		}
+		if (r.all_of<FalloffCurveCpo>(e))
+		{
+			for (int i : {1, 2})
+			{
+				edit<FalloffCurveCpo>(project, e, "Brush falloff", [i](FalloffCurveCpo& f)
+				{
+					return ImGui::DragFloat2(std::format("Falloff point {}", i).c_str(),
+					                         reinterpret_cast<float*>(&f.controlPoints[i]), 0.01f, 0.0f, 1.0f);
+				});
+			}
+		}
+	}
+}
@@ -1,9 +1,22 @@
 #pragma once
 
+#include "Project.hpp"
+
 namespace ciallo::gui
 {
+	/**
+	 * \brief Window listing every brush of the project.
+	 * Edits go through redo undo, BrushTable picks them up by its observers.
+	 */
 	class BrushCabinet
 	{
-		std::vector<entt::entity> m_brushes;
+		entt::entity m_selected = entt::null;
+
+		void drawList(entt::registry& r);
+		void drawCreation(entt::registry& r);
+		void drawSelected(Project& project);
+	public:
+		void draw(Project& project, bool* open);
+		entt::entity selected() const { return m_selected; }
 	};
 }
@@ -0,0 +1,203 @@
+#include "pch.hpp"
+#include "BrushTable.hpp"
+
+#include "Brush.hpp"
+#include "FalloffCurve.hpp"
+#include "vku.hpp"
+
+namespace ciallo
+{
+	BrushTable::BrushTable(vulkan::Device* device, UploadScheduler& uploads): m_device(device)
+	{
+		VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+		m_params = vulkan::Buffer(*device, info, MaxBrushes * sizeof(BrushParams),
+		                          vk::BufferUsageFlagBits::eStorageBuffer);
+		m_sampler = vku::SamplerMaker()
+		            .magFilter(vk::Filter::eLinear)
+		            .minFilter(vk::Filter::eLinear)
+		            .addressModeU(vk::SamplerAddressMode::eClampToEdge)
+		            .createUnique(device->device());
+		genDefaultLut(device, uploads);
+		genDescriptorSet(device->descriptorPool());
+		for (uint32_t i = MaxFalloffLuts - 1; i > 0; --i)
+		{
+			m_freeLuts.push_back(i);
+		}
+	}
+
+	void BrushTable::genDefaultLut(vulkan::Device* device, UploadScheduler& uploads)
+	{
+		m_defaultLut = FalloffLutBaker::createLut(*device);
+		FalloffLutBaker::upload(uploads, m_defaultLut, FalloffLutBaker::bake(FalloffCurveCpo{}.curve()));
+	}
+
+	void BrushTable::genDescriptorSet(vk::DescriptorPool pool)
+	{
+		using S = vk::ShaderStageFlagBits;
+		vku::DescriptorSetLayoutMaker layoutMaker;
+		layoutMaker.buffer(0, vk::DescriptorType::eStorageBuffer,
+		                   S::eVertex | S::eGeometry | S::eFragment | S::eCompute, 1)
+		           .image(1, vk::DescriptorType::eCombinedImageSampler, S::eFragment | S::eCompute, MaxFalloffLuts);
+		m_descriptorSetLayout = layoutMaker.createUnique(m_device->device());
+
+		vku::DescriptorSetMaker maker;
+		maker.layout(*m_descriptorSetLayout);
+		m_descriptorSet = maker.create(m_device->device(), pool)[0];
+
+		vku::DescriptorSetUpdater updater(1, MaxFalloffLuts);
+		updater.beginDescriptorSet(m_descriptorSet)
+		       .beginBuffers(0, 0, vk::DescriptorType::eStorageBuffer)
+		       .buffer(m_params)
+		       .beginImages(1, 0, vk::DescriptorType::eCombinedImageSampler);
+		for (uint32_t i = 0; i < MaxFalloffLuts; ++i)
+		{
+			updater.image(*m_sampler, m_defaultLut.imageView(), vk::ImageLayout::eGeneral);
+		}
+		updater.update(m_device->device());
+	}
+
+	void BrushTable::connect(entt::registry& r)
+	{
+		m_ob.connect(r, entt::collector
+		                .group<BrushTag>()
+		                .group<BrushTag, ColorCpo>().update<ColorCpo>().where<BrushTag>()
+		                .group<BrushTag, AirbrushCpo>().update<AirbrushCpo>().where<BrushTag>()
+		                .group<BrushTag, EquidistantDotCpo>().update<EquidistantDotCpo>().where<BrushTag>()
+		                .group<BrushTag, FalloffLutCpo>());
+		r.on_destroy<BrushTag>().connect<&BrushTable::markPending>(*this);
+		r.on_destroy<ColorCpo>().connect<&BrushTable::markPending>(*this);
+		r.on_destroy<AirbrushCpo>().connect<&BrushTable::markPending>(*this);
+		r.on_destroy<EquidistantDotCpo>().connect<&BrushTable::markPending>(*this);
+		r.on_destroy<FalloffLutCpo>().connect<&BrushTable::markPending>(*this);
+		r.on_destroy<BrushIndexCpo>().connect<&BrushTable::release>(*this);
+		for (entt::entity e : r.view<BrushTag>())
+		{
+			m_pending.push_back(e);
+		}
+	}
+
+	void BrushTable::markPending(entt::registry& r, entt::entity e)
+	{
+		m_pending.push_back(e);
+	}
+
+	void BrushTable::release(entt::registry& r, entt::entity e)
+	{
+		const auto& slot = r.get<BrushIndexCpo>(e);
+		m_freeIndices.push_back(slot.index);
+		if (slot.falloffLut != 0)
+		{
+			bindLut(slot.falloffLut, m_defaultLut.imageView());
+			m_freeLuts.push_back(slot.falloffLut);
+		}
+	}
+
+	void BrushTable::bindLut(uint32_t element, vk::ImageView view)
+	{
+		vku::DescriptorSetUpdater updater;
+		updater.beginDescriptorSet(m_descriptorSet)
+		       .beginImages(1, element, vk::DescriptorType::eCombinedImageSampler)
+		       .image(*m_sampler, view, vk::ImageLayout::eGeneral); // as UploadScheduler leaves LUTs
+		updater.update(m_device->device());
+	}
+
+	void BrushTable::write(entt::registry& r, entt::entity e)
+	{
+		if (!r.valid(e)) return;
+		if (!r.all_of<BrushTag>(e))
+		{
+			r.remove<BrushIndexCpo>(e);
+			return;
+		}
+
+		auto* slot = r.try_get<BrushIndexCpo>(e);
+		if (!slot)
+		{
+			uint32_t index;
+			if (!m_freeIndices.empty())
+			{
+				index = m_freeIndices.back();
+				m_freeIndices.pop_back();
+			}
+			else if (m_indexCount < MaxBrushes)
+			{
+				index = m_indexCount++;
+			}
+			else
+			{
+				throw std::runtime_error("Brush table is full!");
+			}
+			slot = &r.emplace<BrushIndexCpo>(e, index, 0u);
+		}
+
+		// Brushes beyond MaxFalloffLuts fall back to the default falloff.
+		auto* lut = r.try_get<FalloffLutCpo>(e);
+		if (lut && slot->falloffLut == 0 && !m_freeLuts.empty())
+		{
+			slot->falloffLut = m_freeLuts.back();
+			m_freeLuts.pop_back();
+		}
+		else if (!lut && slot->falloffLut != 0)
+		{
+			bindLut(slot->falloffLut, m_defaultLut.imageView());
+			m_freeLuts.push_back(slot->falloffLut);
+			slot->falloffLut = 0;
+		}
+		if (lut && slot->falloffLut != 0) bindLut(slot->falloffLut, lut->lut.imageView());
+
+		auto* color = r.try_get<ColorCpo>(e);
+		auto* dot = r.try_get<EquidistantDotCpo>(e);
+		auto* airbrush = r.try_get<AirbrushCpo>(e);
+		BrushParams params{
+			canvasColor(m_format, color ? color->color : ColorCpo{}.color),
+			dot ? dot->spacing : 0.0f,
+			airbrush ? airbrush->hardness : 1.0f,
+			slot->falloffLut,
+			static_cast<uint32_t>(engineType(r, e))
+		};
+		m_params.memoryCopy(&params, slot->index * sizeof(BrushParams), sizeof(BrushParams));
+	}
+
+	bool BrushTable::setCanvasFormat(CanvasFormat format)
+	{
+		bool changed = linearLight(format) != linearLight(m_format);
+		m_format = format;
+		m_rewriteAll = m_rewriteAll || changed;
+		return changed;
+	}
+
+	void BrushTable::update(entt::registry& r)
+	{
+		if (m_rewriteAll)
+		{
+			for (entt::entity e : r.view<BrushTag>())
+			{
+				m_pending.push_back(e);
+			}
+			m_rewriteAll = false;
+		}
+		for (entt::entity e : m_ob)
+		{
+			write(r, e);
+		}
+		m_ob.clear();
+		// Destroyed entities may be pending, write() skips them.
+		for (entt::entity e : m_pending)
+		{
+			write(r, e);
+		}
+		m_pending.clear();
+	}
+
+	BrushEngineType BrushTable::engineType(const entt::registry& r, entt::entity brush)
+	{
+		if (r.all_of<AirbrushCpo>(brush)) return BrushEngineType::Airbrush;
+		if (r.all_of<EquidistantDotCpo>(brush)) return BrushEngineType::EquidistantDot;
+		return BrushEngineType::ArticulatedLine;
+	}
+
+	uint32_t BrushTable::index(const entt::registry& r, entt::entity brush)
+	{
+		return r.get<BrushIndexCpo>(brush).index;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "CanvasFormat.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "UploadScheduler.hpp"
+
+namespace ciallo
+{
+	enum class BrushEngineType : uint32_t
+	{
+		ArticulatedLine,
+		EquidistantDot,
+		Airbrush,
+	};
+
+	// Slots of a brush in BrushTable. Strokes reach their brush on GPU by index, not by descriptor set.
+	struct BrushIndexCpo
+	{
+		uint32_t index;
+		uint32_t falloffLut; // element of the LUT array, 0 is the default falloff
+	};
+
+	/**
+	 * \brief Parameters of every brush packed into one storage buffer, with falloff LUTs in one descriptor array.
+	 * Observers collect changed brushes, only their entries are written in update(). Shaders bind the table
+	 * once and index it with BrushIndexCpo::index, so switching brushes between strokes binds nothing.
+	 */
+	class BrushTable
+	{
+		struct BrushParams
+		{
+			glm::vec4 color;
+			float spacing;
+			float hardness;
+			uint32_t falloffLut;
+			uint32_t engine;
+		};
+
+		vulkan::Device* m_device;
+		vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+		vk::DescriptorSet m_descriptorSet;
+		vk::UniqueSampler m_sampler;
+		vulkan::Buffer m_params; // host visible, MaxBrushes entries
+		vulkan::Image m_defaultLut; // bound to unused elements of the LUT array
+
+		entt::observer m_ob;
+		// Brushes the observer can't see: existing ones at connect, and removal of optional components.
+		std::vector<entt::entity> m_pending;
+		std::vector<uint32_t> m_freeIndices;
+		std::vector<uint32_t> m_freeLuts;
+		uint32_t m_indexCount = 0;
+		CanvasFormat m_format = CanvasFormat::Rgba8Unorm; // colors are written for it
+		bool m_rewriteAll = false;
+
+		void genDescriptorSet(vk::DescriptorPool pool);
+		void genDefaultLut(vulkan::Device* device, UploadScheduler& uploads);
+		void markPending(entt::registry& r, entt::entity e);
+		void release(entt::registry& r, entt::entity e);
+		void write(entt::registry& r, entt::entity e);
+		void bindLut(uint32_t element, vk::ImageView view);
+	public:
+		constexpr static uint32_t MaxBrushes = 4096;
+		constexpr static uint32_t MaxFalloffLuts = 64;
+
+		// The default LUT goes through uploads, it is ready for frames acquiring uploads after the next flush.
+		BrushTable(vulkan::Device* device, UploadScheduler& uploads);
+		BrushTable(const BrushTable& other) = delete;
+		BrushTable& operator=(const BrushTable& other) = delete;
+
+		void connect(entt::registry& r);
+		/**
+		 * \brief Colors are written in the space the canvas format blends in, see canvasColor.
+		 * Returns true when that space changed, the next update() then rewrites every brush.
+		 */
+		bool setCanvasFormat(CanvasFormat format);
+		// Give new brushes their slots and upload changed entries. Call after the previous frame is finished.
+		void update(entt::registry& r);
+
+		// Storage buffer of BrushParams at binding 0, sampler1D array of MaxFalloffLuts in general layout at binding 1.
+		vk::DescriptorSetLayout descriptorSetLayout() const { return *m_descriptorSetLayout; }
+		vk::DescriptorSet descriptorSet() const { return m_descriptorSet; }
+		uint32_t size() const { return m_indexCount - static_cast<uint32_t>(m_freeIndices.size()); }
+
+		static BrushEngineType engineType(const entt::registry& r, entt::entity brush);
+		static uint32_t index(const entt::registry& r, entt::entity brush);
+	};
+}
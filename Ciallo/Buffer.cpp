@@ -57,6 +57,29 @@ namespace ciallo::vulkan
 		vmaUnmapMemory(m_allocator, m_allocation);
 	}
 
+	void* AllocationBase::mappedData() const
+	{
+		VmaAllocationInfo info{};
+		vmaGetAllocationInfo(m_allocator, m_allocation, &info);
+		return info.pMappedData;
+	}
+
+	void AllocationBase::invalidate() const
+	{
+		if (!hostCoherent())
+		{
+			vmaInvalidateAllocation(m_allocator, m_allocation, 0, VK_WHOLE_SIZE);
+		}
+	}
+
+	void AllocationBase::flush() const
+	{
+		if (!hostCoherent())
+		{
+			vmaFlushAllocation(m_allocator, m_allocation, 0, VK_WHOLE_SIZE);
+		}
+	}
+
 	vk::Device AllocationBase::device() const
 	{
 		VmaAllocatorInfo info;
@@ -34,6 +34,12 @@ namespace ciallo::vulkan
 		 */
 		vk::DeviceSize memorySize() const;
 		void memoryCopy(const void* data, vk::DeviceSize offset, vk::DeviceSize size) const;
+		// Persistent mapping, only for allocations created with VMA_ALLOCATION_CREATE_MAPPED_BIT.
+		void* mappedData() const;
+		// Make device writes visible to host before reading mappedData().
+		void invalidate() const;
+		// Make host writes through mappedData() visible to device.
+		void flush() const;
 		template <class VecType> requires std::is_arithmetic_v<VecType>
 		void memorySet(VecType value, vk::DeviceSize offset, uint32_t count);
 	};
@@ -0,0 +1,120 @@
+#include "pch.hpp"
+#include "CanvasDisplay.hpp"
+
+#include "vku.hpp"
+
+namespace ciallo
+{
+	CanvasDisplayPass::CanvasDisplayPass(vulkan::Device* device): m_device(*device)
+	{
+		m_compShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eCompute,
+		                                    "./shaders/canvasDisplay.comp.spv");
+		m_sampler = vku::SamplerMaker().createUnique(m_device);
+		genDescriptorSet(device->descriptorPool());
+		genCompPipeline();
+	}
+
+	void CanvasDisplayPass::genDescriptorSet(vk::DescriptorPool pool)
+	{
+		vku::DescriptorSetLayoutMaker layoutMaker;
+		layoutMaker.image(0, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 1)
+		           .image(1, vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute, 1);
+		m_descriptorSetLayout = layoutMaker.createUnique(m_device);
+
+		vku::DescriptorSetMaker maker;
+		maker.layout(*m_descriptorSetLayout);
+		m_descriptorSet = maker.create(m_device, pool)[0];
+	}
+
+	void CanvasDisplayPass::genCompPipeline()
+	{
+		vku::PipelineLayoutMaker layoutMaker;
+		layoutMaker.descriptorSetLayout(*m_descriptorSetLayout)
+		           .pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant));
+		m_pipelineLayout = layoutMaker.createUnique(m_device);
+
+		vku::ComputePipelineMaker maker{};
+		maker.shader(vk::ShaderStageFlagBits::eCompute, m_compShader);
+		m_pipeline = maker.createUnique(m_device, nullptr, *m_pipelineLayout);
+	}
+
+	vulkan::Image CanvasDisplayPass::createCanvas(vulkan::Device& device, CanvasFormat format, vk::Extent2D extent)
+	{
+		vk::ImageCreateInfo info{};
+		info.imageType = vk::ImageType::e2D;
+		info.format = toVkFormat(format);
+		info.extent = vk::Extent3D{extent.width, extent.height, 1u};
+		info.mipLevels = 1;
+		info.arrayLayers = 1;
+		info.samples = vk::SampleCountFlagBits::e1;
+		info.tiling = vk::ImageTiling::eOptimal;
+		info.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled |
+			vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc |
+			vk::ImageUsageFlagBits::eTransferDst;
+		// Storage usage is only valid for the storage view format.
+		if (storageFormat(format) != info.format)
+		{
+			info.flags = vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage;
+		}
+		info.sharingMode = vk::SharingMode::eExclusive;
+		info.initialLayout = vk::ImageLayout::eUndefined;
+		return vulkan::Image(device.allocator(), vulkan::MemoryAuto, info);
+	}
+
+	CanvasTargetCpo& CanvasDisplayPass::prepareCanvas(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing)
+	{
+		const vulkan::Image& display = r.get<GPUImageCpo>(drawing).image;
+		CanvasFormat format = canvasFormatOf(r, drawing);
+		auto* canvas = r.try_get<CanvasTargetCpo>(drawing);
+		if (canvas && canvas->image.format() == toVkFormat(format) && canvas->image.extent2D() == display.extent2D())
+		{
+			return *canvas;
+		}
+
+		auto* device = r.ctx().at<vulkan::Device*>();
+		// Projects may come from a device supporting more formats, RGBA8 is always there.
+		if (!canvasFormatSupported(device->physicalDevice(), format))
+		{
+			format = CanvasFormat::Rgba8Unorm;
+			r.emplace_or_replace<CanvasFormatCpo>(drawing, format);
+		}
+		auto& target = r.emplace_or_replace<CanvasTargetCpo>(drawing);
+		target.image = createCanvas(*device, format, display.extent2D());
+		target.storageView.reset();
+		if (storageFormat(format) != toVkFormat(format))
+		{
+			target.storageView = target.image.createImageView(storageFormat(format));
+		}
+		target.image.changeLayout(cb, vk::ImageLayout::eGeneral);
+		return target;
+	}
+
+	void CanvasDisplayPass::render(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing)
+	{
+		const auto& canvas = r.get<CanvasTargetCpo>(drawing);
+		const vulkan::Image& display = r.get<GPUImageCpo>(drawing).image;
+		CanvasFormat format = canvasFormatOf(r, drawing);
+		bool floatFormat = format == CanvasFormat::Rgba16Float || format == CanvasFormat::Rgba32Float;
+
+		Mode mode = Mode::Copy;
+		if (linearLight(format))
+		{
+			mode = toneMap && floatFormat ? Mode::ToneMap : Mode::EncodeSrgb;
+		}
+
+		// Previous frame is finished, rewriting the set is safe.
+		vku::DescriptorSetUpdater updater;
+		updater.beginDescriptorSet(m_descriptorSet)
+		       .beginImages(0, 0, vk::DescriptorType::eCombinedImageSampler)
+		       .image(*m_sampler, canvas.image.imageView(), vk::ImageLayout::eGeneral)
+		       .beginImages(1, 0, vk::DescriptorType::eStorageImage)
+		       .image(nullptr, display.imageView(), vk::ImageLayout::eGeneral);
+		updater.update(m_device);
+
+		PushConstant pushConstant{exposure, mode};
+		cb.bindPipeline(vk::PipelineBindPoint::eCompute, *m_pipeline);
+		cb.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *m_pipelineLayout, 0, m_descriptorSet, {});
+		cb.pushConstants<PushConstant>(*m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pushConstant);
+		cb.dispatch((display.width() + 15) / 16, (display.height() + 15) / 16, 1);
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "CanvasFormat.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "ShaderModule.hpp"
+
+namespace ciallo
+{
+	/**
+	 * \brief Composited canvas of a drawing in its CanvasFormatCpo, on drawing entity.
+	 * GPUImageCpo stays the RGBA8 image shown by ImGui, CanvasDisplayPass converts canvas into it.
+	 */
+	struct CanvasTargetCpo
+	{
+		vulkan::Image image;
+		vk::UniqueImageView storageView; // only for formats written through another view, see storageFormat
+
+		vk::ImageView storage() const { return storageView ? *storageView : image.imageView(); }
+	};
+
+	/**
+	 * \brief Display convert pass, canvas of any format into RGBA8 display image.
+	 * Linear light canvases are encoded to sRGB, optionally tone mapped since float canvases go above one.
+	 */
+	class CanvasDisplayPass
+	{
+		enum class Mode : uint32_t
+		{
+			Copy,
+			EncodeSrgb,
+			ToneMap,
+		};
+
+		struct PushConstant
+		{
+			float exposure;
+			Mode mode;
+		};
+
+		vk::Device m_device;
+		vulkan::ShaderModule m_compShader;
+		vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+		vk::UniquePipelineLayout m_pipelineLayout;
+		vk::UniquePipeline m_pipeline;
+		vk::DescriptorSet m_descriptorSet;
+		vk::UniqueSampler m_sampler;
+
+		void genDescriptorSet(vk::DescriptorPool pool);
+		void genCompPipeline();
+	public:
+		float exposure = 1.0f;
+		// Reinhard tone mapping of float canvases, clamped otherwise.
+		bool toneMap = false;
+
+		explicit CanvasDisplayPass(vulkan::Device* device);
+
+		static vulkan::Image createCanvas(vulkan::Device& device, CanvasFormat format, vk::Extent2D extent);
+		/**
+		 * \brief Create or recreate CanvasTargetCpo of drawing to match its format and display image size.
+		 * A new canvas is in general layout.
+		 */
+		static CanvasTargetCpo& prepareCanvas(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing);
+		/**
+		 * \brief Convert canvas into display image.
+		 * Writes into the canvas should be made visible to compute shader before.
+		 */
+		void render(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing);
+	};
+}
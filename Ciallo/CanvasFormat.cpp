@@ -0,0 +1,86 @@
+#include "pch.hpp"
+#include "CanvasFormat.hpp"
+
+namespace ciallo
+{
+	vk::Format toVkFormat(CanvasFormat format)
+	{
+		switch (format)
+		{
+		case CanvasFormat::Rgba8Srgb:
+			return vk::Format::eR8G8B8A8Srgb;
+		case CanvasFormat::Rgba16Float:
+			return vk::Format::eR16G16B16A16Sfloat;
+		case CanvasFormat::Rgba32Float:
+			return vk::Format::eR32G32B32A32Sfloat;
+		default:
+			return vk::Format::eR8G8B8A8Unorm;
+		}
+	}
+
+	CanvasFormat fromVkFormat(vk::Format format)
+	{
+		for (CanvasFormat canvasFormat : CanvasFormats)
+		{
+			if (toVkFormat(canvasFormat) == format) return canvasFormat;
+		}
+		return CanvasFormat::Rgba8Unorm;
+	}
+
+	const char* canvasFormatName(CanvasFormat format)
+	{
+		switch (format)
+		{
+		case CanvasFormat::Rgba8Srgb:
+			return "RGBA8 sRGB";
+		case CanvasFormat::Rgba16Float:
+			return "RGBA16F";
+		case CanvasFormat::Rgba32Float:
+			return "RGBA32F";
+		default:
+			return "RGBA8";
+		}
+	}
+
+	bool linearLight(CanvasFormat format)
+	{
+		return format != CanvasFormat::Rgba8Unorm;
+	}
+
+	float srgbToLinear(float v)
+	{
+		return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+	}
+
+	glm::vec4 canvasColor(CanvasFormat format, const glm::vec4& color)
+	{
+		if (!linearLight(format)) return color;
+		return {srgbToLinear(color.r), srgbToLinear(color.g), srgbToLinear(color.b), color.a};
+	}
+
+	vk::Format storageFormat(CanvasFormat format)
+	{
+		return format == CanvasFormat::Rgba8Srgb ? vk::Format::eR8G8B8A8Unorm : toVkFormat(format);
+	}
+
+	bool canvasFormatSupported(vk::PhysicalDevice physicalDevice, CanvasFormat format)
+	{
+		using F = vk::FormatFeatureFlagBits;
+		vk::FormatFeatureFlags features = physicalDevice.getFormatProperties(toVkFormat(format)).optimalTilingFeatures;
+		vk::FormatFeatureFlags storageFeatures = physicalDevice.getFormatProperties(storageFormat(format)).
+		                                                        optimalTilingFeatures;
+		vk::FormatFeatureFlags required = F::eColorAttachment | F::eColorAttachmentBlend | F::eSampledImage |
+			F::eTransferSrc | F::eTransferDst;
+		return (features & required) == required && (storageFeatures & F::eStorageImage);
+	}
+
+	std::vector<CanvasFormat> supportedCanvasFormats(vk::PhysicalDevice physicalDevice)
+	{
+		std::vector<CanvasFormat> formats;
+		std::ranges::copy_if(CanvasFormats, std::back_inserter(formats), [&](CanvasFormat format)
+		{
+			return canvasFormatSupported(physicalDevice, format);
+		});
+		return formats;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+namespace ciallo
+{
+	enum class CanvasFormat : uint32_t
+	{
+		Rgba8Unorm, // blends in gamma space, as before formats were configurable
+		Rgba8Srgb,
+		Rgba16Float,
+		Rgba32Float,
+	};
+
+	constexpr std::array CanvasFormats{
+		CanvasFormat::Rgba8Unorm, CanvasFormat::Rgba8Srgb, CanvasFormat::Rgba16Float, CanvasFormat::Rgba32Float
+	};
+
+	// On drawing entity. Format of layer targets and the composited canvas, chosen per project.
+	struct CanvasFormatCpo
+	{
+		CanvasFormat format = CanvasFormat::Rgba8Unorm;
+	};
+
+	// Drawings without CanvasFormatCpo keep the format from before formats were configurable.
+	inline CanvasFormat canvasFormatOf(const entt::registry& r, entt::entity drawing)
+	{
+		auto* format = r.try_get<CanvasFormatCpo>(drawing);
+		return format ? format->format : CanvasFormat::Rgba8Unorm;
+	}
+
+	vk::Format toVkFormat(CanvasFormat format);
+	// Inverse of toVkFormat, formats of no canvas are Rgba8Unorm.
+	CanvasFormat fromVkFormat(vk::Format format);
+	const char* canvasFormatName(CanvasFormat format);
+	// Every format but Rgba8Unorm blends in linear light and is encoded to sRGB for display.
+	bool linearLight(CanvasFormat format);
+	float srgbToLinear(float v);
+	// Colors are picked in sRGB as ImGui shows them, linear light formats get them decoded. Alpha is kept.
+	glm::vec4 canvasColor(CanvasFormat format, const glm::vec4& color);
+	// sRGB formats can't be storage images, compute writes them through an UNORM view and encodes itself.
+	vk::Format storageFormat(CanvasFormat format);
+	// Blendable color attachment, sampled image, and storage image directly or through storageFormat.
+	bool canvasFormatSupported(vk::PhysicalDevice physicalDevice, CanvasFormat format);
+	// CanvasFormats the device supports, pipelines are created for these only.
+	std::vector<CanvasFormat> supportedCanvasFormats(vk::PhysicalDevice physicalDevice);
+}
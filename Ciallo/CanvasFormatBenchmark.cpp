@@ -0,0 +1,277 @@
+#include "pch.hpp"
+#include "CanvasFormatBenchmark.hpp"
+
+#include "vku.hpp"
+#include "ArticulatedLineRenderer.hpp"
+#include "Drawing.hpp"
+#include "Image.hpp"
+#include "Layer.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo
+{
+	CanvasFormatBenchmark::CanvasFormatBenchmark(vulkan::Device* device): m_device(*device)
+	{
+		m_vertShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eVertex,
+		                                    "./shaders/formatBenchmark.vert.spv");
+		m_fragShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eFragment,
+		                                    "./shaders/formatBenchmark.frag.spv");
+		genPipelines(device->physicalDevice());
+
+		vk::PhysicalDevice physicalDevice = device->physicalDevice();
+		m_timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+		m_timestampSupported = physicalDevice.getQueueFamilyProperties()[device->queueFamilyIndex()].
+			timestampValidBits > 0;
+		vk::QueryPoolCreateInfo info{
+			{}, vk::QueryType::eTimestamp, static_cast<uint32_t>(CanvasFormats.size()) * TimestampsPerFormat
+		};
+		m_queryPool = m_device.createQueryPoolUnique(info);
+	}
+
+	void CanvasFormatBenchmark::genPipelines(vk::PhysicalDevice physicalDevice)
+	{
+		vku::PipelineLayoutMaker layoutMaker;
+		m_pipelineLayout = layoutMaker.createUnique(m_device);
+
+		vku::PipelineMaker maker;
+		maker.topology(vk::PrimitiveTopology::eTriangleList)
+		     .dynamicState(vk::DynamicState::eViewport)
+		     .dynamicState(vk::DynamicState::eScissor)
+		     .shader(vk::ShaderStageFlagBits::eVertex, m_vertShader)
+		     .shader(vk::ShaderStageFlagBits::eFragment, m_fragShader)
+		     .blendEnable(VK_TRUE)
+		     .cullMode(vk::CullModeFlagBits::eNone);
+		for (CanvasFormat format : supportedCanvasFormats(physicalDevice))
+		{
+			std::vector colorAttachmentsFormats{toVkFormat(format)};
+			vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
+			m_pipelines[toVkFormat(format)] = maker.createUnique(m_device, nullptr, *m_pipelineLayout,
+			                                                     renderingCreateInfo);
+		}
+	}
+
+	namespace
+	{
+		void beginRendering(vk::CommandBuffer cb, const vulkan::Image& target)
+		{
+			vk::Rect2D area{{0, 0}, target.extent2D()};
+			vk::RenderingAttachmentInfo renderingAttachmentInfo{
+				target.imageView(), vk::ImageLayout::eGeneral, {}, {}, {},
+				vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, vk::ClearColorValue{}
+			};
+			std::vector colorAttachments{renderingAttachmentInfo};
+			vk::RenderingInfo renderingInfo{{}, area, 1, 0, colorAttachments, {}, {}};
+			cb.beginRendering(renderingInfo);
+			vk::Viewport fullViewport{
+				0, 0, static_cast<float>(target.width()), static_cast<float>(target.height()), 0.0f, 1.0f
+			};
+			cb.setViewport(0, fullViewport);
+			cb.setScissor(0, area);
+		}
+
+		// Every iteration writes the same image, later ones wait for earlier ones.
+		void attachmentBarrier(vk::CommandBuffer cb)
+		{
+			vk::MemoryBarrier2 barrier{
+				vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+				vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+				vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite
+			};
+			cb.pipelineBarrier2({{}, barrier, {}, {}});
+		}
+	}
+
+	void CanvasFormatBenchmark::recordFill(vk::CommandBuffer cb, const vulkan::Image& target) const
+	{
+		beginRendering(cb, target);
+		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *m_pipelines.at(target.format()));
+		cb.draw(3, overdraw, 0, 0);
+		cb.endRendering();
+	}
+
+	void CanvasFormatBenchmark::recordStrokes(entt::registry& r, vk::CommandBuffer cb, const vulkan::Image& target,
+	                                          ArticulatedLineEngine& engine, float pixelsPerMeter,
+	                                          const std::vector<entt::entity>& strokes) const
+	{
+		beginRendering(cb, target);
+		for (entt::entity stroke : strokes)
+		{
+			engine.render(r, r.get<StrokeCpo>(stroke).brush, stroke, cb, target.format(), pixelsPerMeter);
+		}
+		cb.endRendering();
+	}
+
+	void CanvasFormatBenchmark::run(entt::registry& r, entt::entity drawing, ArticulatedLineEngine& engine)
+	{
+		if (!m_timestampSupported)
+		{
+			throw std::runtime_error("Queue does not support timestamps!");
+		}
+		auto* device = r.ctx().at<vulkan::Device*>();
+		vk::Extent2D extent = r.get<GPUImageCpo>(drawing).image.extent2D();
+		float pixelsPerMeter = r.get<ViewRectCpo>(drawing).pixelsPerMeter(extent.width);
+
+		// Same strokes LayerRenderer would rasterize for the drawing.
+		std::vector<entt::entity> strokes;
+		if (auto* stack = r.try_get<LayerStackCpo>(drawing))
+		{
+			for (auto&& [e, stroke, member] : r.view<StrokeCpo, LayerMemberCpo>().each())
+			{
+				if (std::ranges::find(stack->layers, member.layer) == stack->layers.end()) continue;
+				if (!r.all_of<ArticulatedLineStrokeCpo>(e) || !r.valid(stroke.brush) ||
+					!r.all_of<ArticulatedLineBrushCpo>(stroke.brush))
+					continue;
+				strokes.push_back(e);
+			}
+			sortByLayerOrder(r, strokes);
+		}
+
+		results.clear();
+		std::vector<vulkan::Image> targets;
+		std::vector<vulkan::Image> copies;
+		for (CanvasFormat format : CanvasFormats)
+		{
+			Result& result = results.emplace_back();
+			result.format = format;
+			result.supported = canvasFormatSupported(device->physicalDevice(), format);
+			if (!result.supported) continue;
+			vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment |
+				vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+			targets.emplace_back(device->allocator(), vulkan::MemoryAuto, toVkFormat(format), extent.width,
+			                     extent.height, vk::SampleCountFlagBits::e1, usage);
+			copies.emplace_back(device->allocator(), vulkan::MemoryAuto, toVkFormat(format), extent.width,
+			                    extent.height, vk::SampleCountFlagBits::e1, usage);
+			result.layerBytes = targets.back().size();
+		}
+
+		auto queryCount = static_cast<uint32_t>(CanvasFormats.size()) * TimestampsPerFormat;
+		device->executeImmediately([&](vk::CommandBuffer cb)
+		{
+			cb.resetQueryPool(*m_queryPool, 0, queryCount);
+			size_t imageIndex = 0;
+			for (uint32_t i = 0; i < results.size(); ++i)
+			{
+				if (!results[i].supported) continue;
+				vulkan::Image& target = targets[imageIndex];
+				vulkan::Image& copy = copies[imageIndex];
+				++imageIndex;
+				target.changeLayout(cb, vk::ImageLayout::eGeneral);
+				copy.changeLayout(cb, vk::ImageLayout::eGeneral);
+
+				uint32_t query = i * TimestampsPerFormat;
+				cb.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *m_queryPool, query);
+				for (uint32_t it = 0; it < iterations; ++it)
+				{
+					recordFill(cb, target);
+					attachmentBarrier(cb);
+				}
+				cb.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *m_queryPool, query + 1);
+				for (uint32_t it = 0; it < iterations; ++it)
+				{
+					recordStrokes(r, cb, target, engine, pixelsPerMeter, strokes);
+					attachmentBarrier(cb);
+				}
+				cb.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *m_queryPool, query + 2);
+
+				vk::MemoryBarrier2 copyBarrier{
+					vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eCopy,
+					vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eTransferWrite,
+					vk::PipelineStageFlagBits2::eCopy,
+					vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eTransferWrite
+				};
+				vk::ImageCopy region{
+					{vk::ImageAspectFlagBits::eColor, 0, 0, 1}, {},
+					{vk::ImageAspectFlagBits::eColor, 0, 0, 1}, {},
+					{extent.width, extent.height, 1u}
+				};
+				for (uint32_t it = 0; it < iterations; ++it)
+				{
+					cb.pipelineBarrier2({{}, copyBarrier, {}, {}});
+					cb.copyImage(target, vk::ImageLayout::eGeneral, copy, vk::ImageLayout::eGeneral, region);
+				}
+				cb.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *m_queryPool, query + 3);
+			}
+		});
+
+		std::vector<uint64_t> timestamps(queryCount);
+		vk::Result _ = m_device.getQueryPoolResults(*m_queryPool, 0, queryCount, timestamps.size() * sizeof(uint64_t),
+		                                            timestamps.data(), sizeof(uint64_t),
+		                                            vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+		auto milliseconds = [this](uint64_t begin, uint64_t end)
+		{
+			return static_cast<double>(end - begin) * m_timestampPeriod * 1e-6;
+		};
+		double pixels = static_cast<double>(extent.width) * extent.height;
+		for (uint32_t i = 0; i < results.size(); ++i)
+		{
+			Result& result = results[i];
+			if (!result.supported) continue;
+			const uint64_t* t = &timestamps[i * TimestampsPerFormat];
+			result.fillMs = milliseconds(t[0], t[1]) / iterations;
+			result.strokesMs = milliseconds(t[1], t[2]) / iterations;
+			result.copyMs = milliseconds(t[2], t[3]) / iterations;
+			if (result.fillMs > 0.0) result.fillGPixels = pixels * overdraw / (result.fillMs * 1e6);
+			if (result.copyMs > 0.0) result.bandwidthGBs = 2.0 * result.layerBytes / (result.copyMs * 1e6);
+		}
+	}
+
+	void CanvasFormatBenchmark::drawWindow(entt::registry& r, entt::entity drawing, ArticulatedLineEngine& engine,
+	                                       bool* open)
+	{
+		if (!ImGui::Begin("Canvas Format Benchmark", open))
+		{
+			ImGui::End();
+			return;
+		}
+		constexpr uint32_t minCount = 1, maxCount = 64;
+		ImGui::SliderScalar("Iterations", ImGuiDataType_U32, &iterations, &minCount, &maxCount);
+		ImGui::SliderScalar("Overdraw", ImGuiDataType_U32, &overdraw, &minCount, &maxCount);
+		if (ImGui::Button("Run"))
+		{
+			try
+			{
+				run(r, drawing, engine);
+			}
+			catch (std::exception& e)
+			{
+				spdlog::error("Canvas format benchmark failed: {}", e.what());
+			}
+		}
+
+		if (!results.empty() && ImGui::BeginTable("Results", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			for (const char* header : {
+				     "Format", "Layer MiB", "Fill ms", "Fill GPixel/s", "Strokes ms", "Copy ms", "Copy GB/s"
+			     })
+			{
+				ImGui::TableSetupColumn(header);
+			}
+			ImGui::TableHeadersRow();
+			for (const Result& result : results)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(canvasFormatName(result.format));
+				ImGui::TableNextColumn();
+				if (!result.supported)
+				{
+					ImGui::TextUnformatted("unsupported");
+					continue;
+				}
+				ImGui::Text("%.1f", static_cast<double>(result.layerBytes) / (1024.0 * 1024.0));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", result.fillMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", result.fillGPixels);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", result.strokesMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", result.copyMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", result.bandwidthGBs);
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ArticulatedLine.hpp"
+#include "CanvasFormat.hpp"
+#include "Device.hpp"
+#include "ShaderModule.hpp"
+
+namespace ciallo
+{
+	/**
+	 * \brief Compares canvas formats on this device, so a format can be picked per project.
+	 * For every format, on offscreen targets of the drawing size, GPU timestamps measure fill cost of translucent
+	 * full canvas layers, rasterization of strokes of the drawing, and bandwidth of copying the canvas.
+	 */
+	class CanvasFormatBenchmark
+	{
+		vk::Device m_device;
+		vulkan::ShaderModule m_vertShader;
+		vulkan::ShaderModule m_fragShader;
+		vk::UniquePipelineLayout m_pipelineLayout;
+		std::unordered_map<vk::Format, vk::UniquePipeline> m_pipelines;
+		vk::UniqueQueryPool m_queryPool;
+		float m_timestampPeriod = 1.0f; // nanoseconds per tick
+		bool m_timestampSupported = false;
+
+		constexpr static uint32_t TimestampsPerFormat = 4;
+
+		void genPipelines(vk::PhysicalDevice physicalDevice);
+		void recordFill(vk::CommandBuffer cb, const vulkan::Image& target) const;
+		void recordStrokes(entt::registry& r, vk::CommandBuffer cb, const vulkan::Image& target,
+		                   ArticulatedLineEngine& engine, float pixelsPerMeter,
+		                   const std::vector<entt::entity>& strokes) const;
+	public:
+		struct Result
+		{
+			CanvasFormat format;
+			bool supported = false;
+			vk::DeviceSize layerBytes = 0;
+			double fillMs = 0.0; // per iteration, all overdraw layers
+			double strokesMs = 0.0;
+			double copyMs = 0.0;
+			double fillGPixels = 0.0; // blended pixels per second
+			double bandwidthGBs = 0.0; // copy read and write
+		};
+
+		uint32_t iterations = 8;
+		uint32_t overdraw = 16;
+		std::vector<Result> results;
+
+		explicit CanvasFormatBenchmark(vulkan::Device* device);
+
+		// Blocks until the GPU finished, call it outside of a frame being submitted.
+		void run(entt::registry& r, entt::entity drawing, ArticulatedLineEngine& engine);
+		void drawWindow(entt::registry& r, entt::entity drawing, ArticulatedLineEngine& engine, bool* open);
+	};
+}
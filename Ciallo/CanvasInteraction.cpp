@@ -1,2 +1,251 @@
 #include "pch.hpp"
 #include "CanvasInteraction.hpp"
+
+#include "Brush.hpp"
+#include "CanvasPanel.hpp"
+#include "Drawing.hpp"
+#include "FillRegion.hpp"
+#include "Layer.hpp"
+#include "RedoUndo.hpp"
+#include "Stroke.hpp"
+#include "StrokeArrangement.hpp"
+
+namespace ciallo
+{
+	namespace
+	{
+		std::optional<glm::vec2> toWorld(const entt::registry& r, const CanvasPanelCpo& panel, glm::vec2 screen)
+		{
+			auto* viewRect = r.try_get<ViewRectCpo>(panel.drawing);
+			if (!viewRect || panel.imageScreenSize.x <= 0.0f || panel.imageScreenSize.y <= 0.0f) return std::nullopt;
+			glm::vec2 uv = (screen - panel.imageScreenMin) / panel.imageScreenSize;
+			return viewRect->min + uv * (viewRect->max - viewRect->min);
+		}
+
+		bool insideImage(const CanvasPanelCpo& panel, glm::vec2 screen)
+		{
+			glm::vec2 uv = (screen - panel.imageScreenMin) / panel.imageScreenSize;
+			return uv.x >= 0.0f && uv.y >= 0.0f && uv.x <= 1.0f && uv.y <= 1.0f;
+		}
+	}
+
+	CanvasInteraction::CanvasInteraction(InputCapture& capture): m_capture(&capture)
+	{
+	}
+
+	float CanvasInteraction::thickness(float pressure, float speed) const
+	{
+		float pressureRatio = glm::mix(minPressureRatio, 1.0f, glm::clamp(pressure, 0.0f, 1.0f));
+		float speedRatio = glm::mix(1.0f, speedThinning, glm::clamp(speed / thinningSpeed, 0.0f, 1.0f));
+		return maxThickness * pressureRatio * speedRatio;
+	}
+
+	void CanvasInteraction::begin(entt::registry& r, entt::entity canvasPanel, entt::entity brush,
+	                              const InputSample& s)
+	{
+		const auto& panel = r.get<CanvasPanelCpo>(canvasPanel);
+		auto* stack = r.try_get<LayerStackCpo>(panel.drawing);
+		if (!stack || stack->layers.empty() || !toWorld(r, panel, s.position)) return;
+
+		StrokeCpo stroke;
+		stroke.brush = brush;
+		entt::entity e = r.create();
+		joinLayer(r, e, stack->layers.back());
+		r.emplace<StrokeCpo>(e, std::move(stroke));
+		r.emplace<Constructed<StrokeCpo>>(e);
+		r.emplace<LiveStrokeCpo>(e, canvasPanel);
+		m_liveStroke = e;
+		stabilizer.reset();
+		m_fitter.clear();
+		m_simplifier = geom::StreamingSimplifier(simplifyTolerance / panel.pixelsPerMeter);
+		feed(r, s);
+	}
+
+	void CanvasInteraction::feed(entt::registry& r, const InputSample& s)
+	{
+		m_stabilized.clear();
+		stabilizer.push({s.position, s.pressure, s.time}, m_stabilized);
+		for (const StrokeSample& stabilized : m_stabilized)
+		{
+			append(r, stabilized);
+		}
+	}
+
+	void CanvasInteraction::append(entt::registry& r, const StrokeSample& s)
+	{
+		auto& live = r.get<LiveStrokeCpo>(m_liveStroke);
+		auto& stroke = r.get<StrokeCpo>(m_liveStroke);
+		const auto& panel = r.get<CanvasPanelCpo>(live.canvasPanel);
+		std::optional<glm::vec2> p = toWorld(r, panel, s.position);
+		if (!p) return;
+
+		if (!stroke.position.empty())
+		{
+			float distance = glm::distance(*p, live.lastPosition);
+			if (distance * panel.pixelsPerMeter < minSpacing) return;
+
+			float dt = static_cast<float>(s.time - live.lastTime);
+			if (dt > 0.0f)
+			{
+				float a = 1.0f - glm::exp(-dt / speedSmoothing);
+				live.speed = glm::mix(live.speed, distance / dt, a);
+			}
+		}
+		live.lastTime = s.time;
+		live.lastPosition = *p;
+		geom::Point point{p->x, p->y};
+		float t = thickness(s.pressure, live.speed);
+		// The fitter gets every sample, the stroke only what the simplifier keeps.
+		m_fitter.push(point, t);
+		m_simplifier.push(point, t);
+		// Vertices before the latest are final, the latest either moved forward or was appended.
+		size_t n = m_simplifier.position().size();
+		stroke.position.resize(n);
+		stroke.thickness.resize(n);
+		stroke.position.back() = m_simplifier.position().back();
+		stroke.thickness.back() = m_simplifier.thickness().back();
+	}
+
+	void CanvasInteraction::end(Project& project)
+	{
+		entt::registry& r = project.registry();
+		if (r.valid(r.get<LiveStrokeCpo>(m_liveStroke).canvasPanel))
+		{
+			// Catch up with where the pen lifted.
+			m_stabilized.clear();
+			stabilizer.finish(m_stabilized);
+			for (const StrokeSample& stabilized : m_stabilized)
+			{
+				append(r, stabilized);
+			}
+		}
+		stabilizer.reset();
+
+		entt::entity e = m_liveStroke;
+		m_liveStroke = entt::null;
+		if (r.get<StrokeCpo>(e).position.size() < 2)
+		{
+			// A tap, nothing to draw.
+			r.destroy(e);
+			return;
+		}
+		r.patch<StrokeCpo>(e, [this](StrokeCpo& stroke)
+		{
+			StrokeSimplifier::simplify(stroke, SimplificationMethod::DouglasPeucker, m_simplifier.tolerance());
+		});
+		m_simplifier.clear();
+		// After the patch, which drops stale curves.
+		r.emplace_or_replace<StrokeCurveCpo>(e, m_fitter.spline(), m_fitter.tolerance());
+		r.emplace<Constructed<StrokeCurveCpo>>(e);
+		m_fitter.clear();
+		r.remove<LiveStrokeCpo>(e);
+		RedoUndo::commit(project, "Draw Stroke");
+	}
+
+	void CanvasInteraction::fill(Project& project, entt::entity canvasPanel, entt::entity brush,
+	                             const InputSample& s)
+	{
+		entt::registry& r = project.registry();
+		const auto& panel = r.get<CanvasPanelCpo>(canvasPanel);
+		auto* stack = r.try_get<LayerStackCpo>(panel.drawing);
+		std::optional<glm::vec2> p = toWorld(r, panel, s.position);
+		if (!stack || stack->layers.empty() || !p) return;
+
+		const FillRegionsCpo& regions = FillRegionBuilder::ensure(r, panel.drawing);
+		int32_t region = regions.find(*p);
+		if (region < 0) return;
+		glm::vec4 color = r.all_of<ColorCpo>(brush) ? r.get<ColorCpo>(brush).color : ColorCpo{}.color;
+		// Fills go to the bottom layer, under the line art.
+		entt::entity layer = stack->layers.front();
+
+		// Gap closing only adds edges, so a region never spans two faces of the exact arrangement. Where the
+		// drawing has one, fills seeded in another face are ruled out by point location before any polygon test.
+		const StrokeArrangement* arrangement = StrokeArrangementBuilder::find(r, panel.drawing);
+		std::optional<StrokeArrangement::Face> face;
+		if (arrangement) face = arrangement->locate({p->x, p->y});
+
+		// Filling a filled region recolors it instead of stacking another fill.
+		for (auto&& [e, fillCpo, member] : r.view<FillCpo, LayerMemberCpo>().each())
+		{
+			if (member.layer != layer) continue;
+			if (arrangement && arrangement->locate({fillCpo.seed.x, fillCpo.seed.y}) != face) continue;
+			if (regions.find(fillCpo.seed) != region) continue;
+			if (!r.all_of<Modifying<FillCpo>>(e)) r.emplace<Modifying<FillCpo>>(e);
+			r.patch<FillCpo>(e, [color](FillCpo& f) { f.color = color; });
+			RedoUndo::commit(project, "Recolor Fill");
+			return;
+		}
+
+		entt::entity e = r.create();
+		joinLayer(r, e, layer);
+		r.emplace<FillCpo>(e, *p, color);
+		r.emplace<Constructed<FillCpo>>(e);
+		RedoUndo::commit(project, "Fill");
+	}
+
+	void CanvasInteraction::update(Project& project, entt::entity brush)
+	{
+		entt::registry& r = project.registry();
+		if (brush == entt::null || !r.valid(brush) || !r.all_of<BrushTag>(brush))
+		{
+			auto brushes = r.view<BrushTag>();
+			brush = brushes.empty() ? entt::null : brushes.front();
+		}
+		if (m_liveStroke != entt::null)
+		{
+			if (!r.valid(m_liveStroke) || !r.all_of<StrokeCpo, LiveStrokeCpo>(m_liveStroke))
+			{
+				// Registry was replaced under the pen.
+				m_liveStroke = entt::null;
+				stabilizer.reset();
+			}
+			else if (!r.valid(r.get<LiveStrokeCpo>(m_liveStroke).canvasPanel))
+			{
+				end(project);
+			}
+		}
+
+		bool changed = false;
+		InputSample s;
+		while (m_capture->pop(s))
+		{
+			bool pressed = s.down && !m_down;
+			m_down = s.down;
+			if (m_liveStroke == entt::null)
+			{
+				if (!pressed || brush == entt::null) continue;
+				for (auto [e, panel] : r.view<CanvasPanelCpo>().each())
+				{
+					if (!panel.hovered || !insideImage(panel, s.position)) continue;
+					if (tool == CanvasTool::Fill)
+					{
+						fill(project, e, brush, s);
+					}
+					else
+					{
+						begin(r, e, brush, s);
+					}
+					break;
+				}
+			}
+			else if (s.down)
+			{
+				feed(r, s);
+				changed = true;
+			}
+			else
+			{
+				end(project);
+				changed = false;
+			}
+		}
+		// One update signal per frame, observers rebuild the stroke once.
+		if (changed && m_liveStroke != entt::null) r.patch<StrokeCpo>(m_liveStroke);
+
+		if (uint32_t dropped = m_capture->dropped(); dropped != m_reportedDropped)
+		{
+			spdlog::warn("Input capture dropped {} samples.", dropped - m_reportedDropped);
+			m_reportedDropped = dropped;
+		}
+	}
+}
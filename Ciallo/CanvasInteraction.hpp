@@ -1,8 +1,69 @@
 #pragma once
 
+#include "CurveFitting.hpp"
+#include "InputCapture.hpp"
+#include "Project.hpp"
+#include "Simplification.hpp"
+#include "Stabilizer.hpp"
+
 namespace ciallo
 {
+	// On the stroke entity while it is being drawn.
+	struct LiveStrokeCpo
+	{
+		entt::entity canvasPanel{entt::null};
+		double lastTime = 0.0;
+		glm::vec2 lastPosition{0.0f, 0.0f}; // world coordinate, unit is meter
+		float speed = 0.0f; // smoothed, meter per second
+	};
+
+	enum class CanvasTool
+	{
+		Brush,
+		Fill,
+	};
+
+	/**
+	 * \brief Turns captured samples into strokes.
+	 * Each frame every sample queued since the last frame is appended to the live stroke, so the stroke keeps
+	 * the device rate no matter the frame rate. Samples pass the stabilizer in screen pixels before becoming
+	 * vertices. Thickness follows pressure and thins with speed. Vertices are fitted into curves as they arrive,
+	 * so the finished stroke has its StrokeCurveCpo without a batch fit. The live stroke keeps only vertices the
+	 * streaming simplifier commits, and the finished one is simplified once more as a whole.
+	 * A stroke is one redo undo step, committed on release.
+	 * With the fill tool a press fills the closed region under it with the brush color instead.
+	 */
 	class CanvasInteraction
 	{
+		InputCapture* m_capture;
+		entt::entity m_liveStroke = entt::null;
+		bool m_down = false; // button state of the last drained sample
+		uint32_t m_reportedDropped = 0;
+		std::vector<StrokeSample> m_stabilized; // reused output of stabilizer
+		geom::StreamingBezierFitter m_fitter{StrokeCurveFitter::DefaultTolerance};
+		geom::StreamingSimplifier m_simplifier{0.0f}; // tolerance follows the zoom at begin()
+
+		void begin(entt::registry& r, entt::entity canvasPanel, entt::entity brush, const InputSample& s);
+		void feed(entt::registry& r, const InputSample& s);
+		void append(entt::registry& r, const StrokeSample& s);
+		void end(Project& project);
+		void fill(Project& project, entt::entity canvasPanel, entt::entity brush, const InputSample& s);
+		float thickness(float pressure, float speed) const;
+	public:
+		float maxThickness = 0.0015f; // meter, at full pressure and rest
+		float minPressureRatio = 0.1f; // thickness ratio at zero pressure
+		float speedThinning = 0.5f; // thickness ratio left at thinningSpeed and above
+		float thinningSpeed = 0.5f; // meter per second
+		float speedSmoothing = 0.02f; // seconds, time constant of speed filter
+		float minSpacing = 0.25f; // screen pixel, closer samples are skipped
+		float simplifyTolerance = 0.1f; // screen pixel, max deviation of dropped vertices
+		Stabilizer stabilizer;
+		CanvasTool tool = CanvasTool::Brush;
+
+		explicit CanvasInteraction(InputCapture& capture);
+
+		// Drain samples, call after CanvasPanelDrawer::update. Brush null picks the first brush of the project.
+		void update(Project& project, entt::entity brush);
+		bool drawing() const { return m_liveStroke != entt::null; }
 	};
 }
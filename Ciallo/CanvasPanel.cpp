@@ -1,6 +1,7 @@
 ﻿#include "pch.hpp"
 #include "CanvasPanel.hpp"
 
+#include "Drawing.hpp"
 #include "Image.hpp"
 
 namespace ciallo
@@ -67,10 +68,7 @@ namespace ciallo
 				}
 			}
 
-			if (ImGui::IsItemHovered())
-			{
-				
-			}
+			canvasPanelCpo.hovered = ImGui::IsItemHovered();
 
 			if (io.MouseDown[2] && ImGui::IsItemActive())
 			{
@@ -91,7 +89,23 @@ namespace ciallo
 			};
 			ImGui::SetCursorPosX(imageStartPosition.x);
 			ImGui::SetCursorPosY(imageStartPosition.y);
+			glm::vec2 imageScreenMin = ImGui::GetCursorScreenPos();
 			ImGui::Image(vulkanImageCpo.id, imageSize);
+			canvasPanelCpo.imageScreenMin = imageScreenMin;
+			canvasPanelCpo.imageScreenSize = imageSize;
+
+			// Visible region and screen scale, ViewportCuller fits layer targets to them and CanvasInteraction spaces
+			// input samples by the scale.
+			if (auto* viewRect = r.try_get<ViewRectCpo>(drawingEntity);
+				viewRect && imageSize.x > 0.0f && imageSize.y > 0.0f)
+			{
+				glm::vec2 uvMin = glm::clamp((innerRectMin - imageScreenMin) / imageSize, 0.0f, 1.0f);
+				glm::vec2 uvMax = glm::clamp((innerRectMin + innerRectSize - imageScreenMin) / imageSize, 0.0f, 1.0f);
+				glm::vec2 worldSize = viewRect->max - viewRect->min;
+				canvasPanelCpo.visibleMin = viewRect->min + uvMin * worldSize;
+				canvasPanelCpo.visibleMax = viewRect->min + uvMax * worldSize;
+				canvasPanelCpo.pixelsPerMeter = imageSize.x / worldSize.x;
+			}
 
 			ImGui::End();
 			ImGui::PopStyleVar();
@@ -10,6 +10,16 @@ namespace ciallo
 		glm::vec2 scroll{0.0f, 0.0f};
 		std::vector<entt::entity> onionSkinDrawings = {};
 		std::vector<float> onionSkinDrawingRotations = {};
+
+		// Region of drawing visible in the panel, updated by CanvasPanelDrawer. World coordinate, unit is meter.
+		glm::vec2 visibleMin{0.0f, 0.0f};
+		glm::vec2 visibleMax{0.0f, 0.0f};
+		float pixelsPerMeter = 0.0f; // on screen, zoom included
+
+		// Where the drawing image was put last frame, window client coordinate in pixel. Used by CanvasInteraction.
+		glm::vec2 imageScreenMin{0.0f, 0.0f};
+		glm::vec2 imageScreenSize{0.0f, 0.0f};
+		bool hovered = false;
 	};
 
 	struct CanvasPanelDrawer
@@ -1,41 +1,117 @@
 #pragma once
 #include "ArticulatedLine.hpp"
+#include "BezierTransformer.hpp"
+#include "BrushTable.hpp"
+#include "CanvasDisplay.hpp"
+#include "ContinuousAirbrush.hpp"
 #include "Device.hpp"
 #include "EquidistantDot.hpp"
+#include "FillRegion.hpp"
+#include "FillRenderer.hpp"
 #include "Image.hpp"
+#include "LayerRenderer.hpp"
+#include "LayerResidency.hpp"
+#include "RenderGraph.hpp"
 
 namespace ciallo::rendering
 {
 	class CanvasRenderer
 	{
 	public:
+		std::unique_ptr<BrushTable> m_brushTable;
 		std::unique_ptr<ArticulatedLineEngineTemp> m_articulated;
 		std::unique_ptr<EquidistantDotEngine> m_equidistantDot;
+		std::unique_ptr<ContinuousAirbrushEngine> m_continuousAirbrush;
+		std::unique_ptr<ArticulatedLineEngine> m_articulatedLine;
+		std::unique_ptr<StrokeAccumulator> m_strokeAccumulator;
+		std::unique_ptr<FillRenderer> m_fills;
+		std::unique_ptr<LayerRenderer> m_layers;
+		std::unique_ptr<CanvasDisplayPass> m_display;
+		std::unique_ptr<StrokeTransformer> m_transformer;
+		std::unique_ptr<RenderGraph> m_graph;
+		std::unique_ptr<LayerResidency> m_residency;
 		vulkan::Buffer m_canvasViewProj;
 	public:
-		explicit CanvasRenderer(vulkan::Device* device)
+		CanvasRenderer(vulkan::Device* device, UploadScheduler& uploads)
 		{
-			m_articulated = std::make_unique<ArticulatedLineEngineTemp>(device);
+			m_brushTable = std::make_unique<BrushTable>(device, uploads);
+			m_articulated = std::make_unique<ArticulatedLineEngineTemp>(device, uploads);
 			m_equidistantDot = std::make_unique<EquidistantDotEngine>(device);
+			m_continuousAirbrush = std::make_unique<ContinuousAirbrushEngine>(device);
+			m_articulatedLine = std::make_unique<ArticulatedLineEngine>(device, m_brushTable->descriptorSetLayout());
+			m_strokeAccumulator = std::make_unique<StrokeAccumulator>(device, m_brushTable->descriptorSetLayout());
+			m_fills = std::make_unique<FillRenderer>(device);
+			m_layers = std::make_unique<LayerRenderer>(device, uploads);
+			m_display = std::make_unique<CanvasDisplayPass>(device);
+			m_transformer = std::make_unique<StrokeTransformer>(device);
+			m_graph = std::make_unique<RenderGraph>(device);
 		}
 
-		void render(vk::CommandBuffer cb, const vulkan::Image* target) const
+		// Eviction of layer targets, emplaced into ctx of the registry as a pointer.
+		void manageResidency(entt::registry& r, JobSystem* jobs)
 		{
-			vk::ClearColorValue v;
-			v.setFloat32({0.0f, 0.0f, 0.0f, 1.0f});
-			cb.clearColorImage(*target, target->imageLayout(), v,
-			                   vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0u, 1u, 0u, 1u});
+			m_residency = std::make_unique<LayerResidency>(jobs);
+			r.ctx().emplace<LayerResidency*>(m_residency.get());
+		}
 
-			constexpr vk::MemoryBarrier2 barrier{
-				vk::PipelineStageFlagBits2::eAllCommands,
-				vk::AccessFlagBits2::eMemoryWrite | vk::AccessFlagBits2::eMemoryRead,
-				vk::PipelineStageFlagBits2::eAllCommands,
-				vk::AccessFlagBits2::eMemoryWrite | vk::AccessFlagBits2::eMemoryRead,
-			};
-			cb.pipelineBarrier2({{}, barrier, {}, {}});
+		void render(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing) const
+		{
+			m_brushTable->setCanvasFormat(canvasFormatOf(r, drawing));
+			m_brushTable->update(r);
+			if (m_residency) m_residency->update(r, cb, drawing);
+			// Strokes are drawn and composited in the canvas format, converted for display at last.
+			vulkan::Image& target = CanvasDisplayPass::prepareCanvas(r, cb, drawing).image;
+			vulkan::Image& displayImage = r.get<GPUImageCpo>(drawing).image;
 
-			m_equidistantDot->renderDynamic(cb, target);
-			m_articulated->renderDynamic(cb, target);
+			// Last frame ended with the display pass sampling the canvas, ImGui and thumbnails reading the display.
+			constexpr ResourceAccess DisplayReaders{
+				AccessFragmentSampled.stages | vk::PipelineStageFlagBits2::eBlit,
+				AccessFragmentSampled.access | vk::AccessFlagBits2::eTransferRead
+			};
+			m_graph->reset();
+			auto canvas = m_graph->importImage("Canvas", target, AccessComputeSampled);
+			auto display = m_graph->importImage("Display", displayImage, DisplayReaders);
+			// Composite overwrites the whole canvas, no clear needed. Layers are the size of the canvas.
+			RenderGraph::Pass& composite = m_graph->addPass("Layer Composite").write(canvas, AccessComputeWrite);
+			std::optional<RenderGraph::Resource> stencil;
+			if (!r.view<FillCpo>().empty())
+			{
+				stencil = m_fills->createStencil(*m_graph, target.extent2D());
+				composite.write(*stencil, AccessStencilAttachment);
+			}
+			composite.commands([&, stencil](vk::CommandBuffer passCb)
+			{
+				const vulkan::Image* fillStencil = stencil ? &m_graph->image(*stencil) : nullptr;
+				m_layers->render(r, passCb, drawing, *m_articulatedLine, *m_strokeAccumulator, *m_fills, fillStencil);
+			});
+			if (m_transformer->active())
+			{
+				auto deformed = m_graph->importBuffer("Deformed Strokes", AccessVertexInput);
+				m_graph->addPass("Transform Deform")
+				       .write(deformed, AccessComputeWrite)
+				       .commands([&](vk::CommandBuffer passCb) { m_transformer->deform(r, passCb); })
+				       .keep(); // ends the session once its strokes are gone
+				m_graph->addPass("Transform Preview")
+				       .read(deformed, AccessVertexInput)
+				       .write(canvas, AccessColorAttachment)
+				       .commands([&](vk::CommandBuffer passCb) { m_transformer->render(r, passCb, drawing, target); });
+			}
+			m_graph->addPass("Equidistant Dot")
+			       .write(canvas, AccessColorAttachment)
+			       .commands([&](vk::CommandBuffer passCb) { m_equidistantDot->renderDynamic(passCb, &target); });
+			m_graph->addPass("Continuous Airbrush")
+			       .write(canvas, AccessColorAttachment)
+			       .commands([&](vk::CommandBuffer passCb) { m_continuousAirbrush->renderDynamic(passCb, &target); });
+			m_graph->addPass("Articulated Line")
+			       .write(canvas, AccessColorAttachment)
+			       .commands([&](vk::CommandBuffer passCb) { m_articulated->renderDynamic(passCb, &target); });
+			m_graph->addPass("Canvas Display")
+			       .read(canvas, AccessComputeSampled)
+			       .write(display, AccessComputeWrite)
+			       .commands([&](vk::CommandBuffer passCb) { m_display->render(r, passCb, drawing); });
+			// Sampled by ImGui in the main pass.
+			m_graph->exportResource(display, AccessFragmentSampled);
+			m_graph->execute(cb);
 		}
 	};
 }
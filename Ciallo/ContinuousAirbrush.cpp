@@ -0,0 +1,257 @@
+#include "pch.hpp"
+#include "ContinuousAirbrush.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include "vku.hpp"
+
+namespace ciallo
+{
+	ContinuousAirbrushEngine::ContinuousAirbrushEngine(vulkan::Device* device): m_device(*device)
+	{
+		m_vertShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eVertex,
+		                                    "./shaders/continuousAirbrush.vert.spv");
+		m_fragShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eFragment,
+		                                    "./shaders/continuousAirbrush.frag.spv");
+		m_geomShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eGeometry,
+		                                    "./shaders/continuousAirbrush.geom.spv");
+		genBuffers(*device);
+		genDescriptorSet(device->descriptorPool());
+		genPipelineDynamic(device->physicalDevice());
+	}
+
+	void ContinuousAirbrushEngine::genDescriptorSet(vk::DescriptorPool pool)
+	{
+		vku::DescriptorSetLayoutMaker layoutMaker;
+		layoutMaker.buffer(0, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment, 1);
+		m_descriptorSetLayout = layoutMaker.createUnique(m_device);
+
+		vku::DescriptorSetMaker maker;
+		maker.layout(*m_descriptorSetLayout);
+		m_descriptorSet = maker.create(m_device, pool)[0];
+
+		vku::DescriptorSetUpdater updater;
+		updater.beginDescriptorSet(m_descriptorSet)
+		       .beginBuffers(0, 0, vk::DescriptorType::eStorageBuffer)
+		       .buffer(m_integralTable);
+		updater.update(m_device);
+	}
+
+	void ContinuousAirbrushEngine::genPipelineDynamic(vk::PhysicalDevice physicalDevice)
+	{
+		vku::PipelineLayoutMaker layoutMaker;
+		layoutMaker.descriptorSetLayout(*m_descriptorSetLayout)
+		           .pushConstantRange(vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstant));
+		m_pipelineLayout = layoutMaker.createUnique(m_device);
+
+		vku::PipelineMaker maker;
+		maker.topology(vk::PrimitiveTopology::eLineStrip)
+		     .dynamicState(vk::DynamicState::eViewport)
+		     .dynamicState(vk::DynamicState::eScissor)
+		     .shader(vk::ShaderStageFlagBits::eVertex, m_vertShader)
+		     .shader(vk::ShaderStageFlagBits::eFragment, m_fragShader)
+		     .shader(vk::ShaderStageFlagBits::eGeometry, m_geomShader)
+		     .blendEnable(VK_TRUE)
+		     .cullMode(vk::CullModeFlagBits::eNone)
+		     .vertexBinding(0, sizeof(Vertex))
+		     .vertexAttribute(0, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, pos))
+		     .vertexAttribute(1, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Vertex, color))
+		     .vertexAttribute(2, 0, vk::Format::eR32Sfloat, offsetof(Vertex, width));
+		for (CanvasFormat format : supportedCanvasFormats(physicalDevice))
+		{
+			std::vector colorAttachmentsFormats{toVkFormat(format)};
+			vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
+			m_pipelines[toVkFormat(format)] = maker.createUnique(m_device, nullptr, *m_pipelineLayout,
+			                                                     renderingCreateInfo);
+		}
+	}
+
+	void ContinuousAirbrushEngine::genBuffers(VmaAllocator allocator)
+	{
+		// A wave with growing width and fading color, long enough to show the cost of stamping.
+		for (int i : views::iota(0, 33))
+		{
+			float ratio = static_cast<float>(i) / 32.0f;
+			glm::vec2 pos{-0.8f + 1.6f * ratio, 0.6f + 0.15f * glm::sin(ratio * glm::two_pi<float>())};
+			vertices.push_back({pos, glm::mix(0.01f, 0.04f, ratio), {}, {0.9f, 0.4f, 0.1f, glm::mix(1.0f, 0.2f, ratio)}});
+		}
+
+		VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+		m_vertBuffer = vulkan::Buffer(allocator, info, MaxVertices * sizeof(Vertex),
+		                              vk::BufferUsageFlagBits::eVertexBuffer);
+		m_integralTable = vulkan::Buffer(allocator, info, IntegralTableSize * IntegralTableSize * sizeof(float),
+		                                 vk::BufferUsageFlagBits::eStorageBuffer);
+		updateTable();
+	}
+
+	float ContinuousAirbrushEngine::falloff(float d, float hardness)
+	{
+		float m = glm::pow(1.0f - glm::clamp(d, 0.0f, 1.0f), glm::mix(0.01f, 10.0f, 1.0f - hardness));
+		return glm::smoothstep(0.0f, 1.0f, m);
+	}
+
+	std::vector<float> ContinuousAirbrushEngine::genTable(float hardness)
+	{
+		constexpr uint32_t n = IntegralTableSize;
+		constexpr int substeps = 16;
+		std::vector<float> table(n * n);
+		for (uint32_t i : views::iota(0u, n))
+		{
+			float h = static_cast<float>(i) / static_cast<float>(n - 1);
+			float w = glm::sqrt(glm::max(1.0f - h * h, 0.0f));
+			float step = w / static_cast<float>((n - 1) * substeps);
+			float sum = 0.0f;
+			table[i * n] = 0.0f;
+			// Midpoint rule, accumulated along the row.
+			for (uint32_t j : views::iota(1u, n))
+			{
+				for (int k : views::iota(0, substeps))
+				{
+					float s = (static_cast<float>((j - 1) * substeps + k) + 0.5f) * step;
+					sum += falloff(glm::sqrt(s * s + h * h), hardness) * step;
+				}
+				table[i * n + j] = sum;
+			}
+		}
+		return table;
+	}
+
+	void ContinuousAirbrushEngine::updateTable()
+	{
+		if (m_tableHardness == hardness) return;
+		m_table = genTable(hardness);
+		m_integralTable.uploadLocal(m_table.data(), m_table.size() * sizeof(float));
+		m_tableHardness = hardness;
+	}
+
+	float ContinuousAirbrushEngine::tableIntegral(const std::vector<float>& table, float h, float u)
+	{
+		constexpr float last = static_cast<float>(IntegralTableSize - 1);
+		glm::vec2 f = glm::clamp(glm::vec2(h, u), 0.0f, 1.0f) * last;
+		glm::uvec2 i0 = glm::min(glm::uvec2(f), glm::uvec2(IntegralTableSize - 2));
+		glm::vec2 t = f - glm::vec2(i0);
+		auto at = [&](uint32_t row, uint32_t column) { return table[row * IntegralTableSize + column]; };
+		float a = glm::mix(at(i0.x, i0.y), at(i0.x, i0.y + 1), t.y);
+		float b = glm::mix(at(i0.x + 1, i0.y), at(i0.x + 1, i0.y + 1), t.y);
+		return glm::mix(a, b, t.x);
+	}
+
+	float ContinuousAirbrushEngine::alpha(const Vertex& a, const Vertex& b, glm::vec2 p, float spacing,
+	                                      float hardness, Integral integral, const std::vector<float>& table)
+	{
+		glm::vec2 d = b.pos - a.pos;
+		float length = glm::length(d);
+		if (length <= 0.0f) return 0.0f;
+		glm::vec2 axis = d / length;
+		glm::vec2 normal{-axis.y, axis.x};
+		float x = glm::dot(p - a.pos, axis);
+		float y = glm::dot(p - a.pos, normal);
+		float t = glm::clamp(x / length, 0.0f, 1.0f);
+		// Radius at the projection of p stands for the radius of all dots reaching p.
+		float r = glm::mix(a.width, b.width, t);
+		if (r <= 0.0f) return 0.0f;
+		float h = glm::abs(y) / r;
+		if (h >= 1.0f) return 0.0f;
+		float w = glm::sqrt(1.0f - h * h);
+		// Dots from s = lo to s = hi reach p, in radius units relative to x.
+		float lo = glm::max(-x / r, -w);
+		float hi = glm::min((length - x) / r, w);
+		if (hi <= lo) return 0.0f;
+
+		auto primitive = [&](float s)
+		{
+			float as = glm::abs(s);
+			float v = integral == Integral::ClosedForm
+				          ? (1.0f - h * h) * as - as * as * as / 3.0f
+				          : tableIntegral(table, h, as / w);
+			return glm::sign(s) * v;
+		};
+		float density = glm::mix(a.color.a, b.color.a, t) * r / spacing * (primitive(hi) - primitive(lo));
+		return 1.0f - glm::exp(-density);
+	}
+
+	ContinuousAirbrushEngine::Comparison ContinuousAirbrushEngine::compare(const Vertex& a, const Vertex& b,
+	                                                                   vk::Extent2D extent)
+	{
+		updateTable();
+		auto dotFalloff = [this](float d)
+		{
+			return integral == Integral::ClosedForm ? glm::max(1.0f - d * d, 0.0f) : falloff(d, hardness);
+		};
+
+		float length = glm::distance(a.pos, b.pos);
+		auto dotCount = static_cast<uint32_t>(glm::floor(length / spacing)) + 1;
+		float rMax = glm::max(a.width, b.width);
+		glm::vec2 lo = glm::min(a.pos, b.pos) - rMax;
+		glm::vec2 hi = glm::max(a.pos, b.pos) + rMax;
+
+		constexpr int samples = 64;
+		float maxError = 0.0f, sumError = 0.0f;
+		int covered = 0;
+		for (int i : views::iota(0, samples))
+		{
+			for (int j : views::iota(0, samples))
+			{
+				glm::vec2 p = glm::mix(lo, hi, (glm::vec2(i, j) + 0.5f) / static_cast<float>(samples));
+				float transmittance = 1.0f;
+				for (uint32_t k : views::iota(0u, dotCount))
+				{
+					float t = length > 0.0f ? static_cast<float>(k) * spacing / length : 0.0f;
+					glm::vec2 c = glm::mix(a.pos, b.pos, t);
+					float r = glm::mix(a.width, b.width, t);
+					if (r <= 0.0f) continue;
+					transmittance *= 1.0f - glm::mix(a.color.a, b.color.a, t) * dotFalloff(glm::distance(p, c) / r);
+				}
+				float stamped = 1.0f - transmittance;
+				float analytic = alpha(a, b, p, spacing, hardness, integral, m_table);
+				if (stamped <= 0.0f && analytic <= 0.0f) continue;
+				float error = glm::abs(stamped - analytic);
+				maxError = glm::max(maxError, error);
+				sumError += error;
+				++covered;
+			}
+		}
+
+		// NDC spans 2 on both axes.
+		float pixelArea = static_cast<float>(extent.width) * static_cast<float>(extent.height) / 4.0f;
+		float rMean = 0.5f * (a.width + b.width);
+		return {
+			maxError,
+			covered > 0 ? sumError / static_cast<float>(covered) : 0.0f,
+			static_cast<float>(dotCount) * glm::pi<float>() * rMean * rMean * pixelArea,
+			(length + 2.0f * rMax) * 2.0f * rMax * pixelArea
+		};
+	}
+
+	void ContinuousAirbrushEngine::renderDynamic(vk::CommandBuffer cb, const vulkan::Image* target)
+	{
+		if (vertices.size() < 2) return;
+		if (vertices.size() > MaxVertices) vertices.resize(MaxVertices);
+		updateTable();
+		std::vector<Vertex> uploaded = vertices;
+		for (Vertex& v : uploaded)
+		{
+			v.color = canvasColor(fromVkFormat(target->format()), v.color);
+		}
+		m_vertBuffer.uploadLocal(uploaded.data(), uploaded.size() * sizeof(Vertex));
+
+		vk::Rect2D area{{0, 0}, target->extent2D()};
+		vk::RenderingAttachmentInfo renderingAttachmentInfo{target->imageView(), target->imageLayout()};
+		std::vector colorAttachments{renderingAttachmentInfo};
+		vk::RenderingInfo renderingInfo{{}, area, 1, 0, colorAttachments, {}, {}};
+		cb.beginRendering(renderingInfo);
+		vk::Viewport fullViewport{
+			0, 0, static_cast<float>(target->width()), static_cast<float>(target->height()), 0.0f, 1.0f
+		};
+		cb.setViewport(0, fullViewport);
+		cb.setScissor(0, area);
+		std::vector<vk::Buffer> vertexBuffers{m_vertBuffer};
+		cb.bindVertexBuffers(0, vertexBuffers, {0});
+		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *m_pipelines.at(target->format()));
+		cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *m_pipelineLayout, 0, m_descriptorSet, nullptr);
+		PushConstant pushConstant{spacing, hardness, static_cast<uint32_t>(integral), IntegralTableSize};
+		cb.pushConstants<PushConstant>(*m_pipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, pushConstant);
+		cb.draw(static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+		cb.endRendering();
+	}
+}
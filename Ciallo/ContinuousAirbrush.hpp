@@ -0,0 +1,98 @@
+#pragma once
+
+#include "CanvasFormat.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "ShaderModule.hpp"
+
+namespace ciallo
+{
+	/**
+	 * \brief Airbrush drawn as the integral of dot falloff along every segment, instead of stamped dots.
+	 * Stamping dots of alpha a(d) every spacing gives 1 - prod(1 - a_i) ~ 1 - exp(-sum a_i). Fragment shader
+	 * evaluates sum a_i as an integral over the segment, so cost follows covered pixels instead of dot count times
+	 * dot area. Segments of a line strip split the dots between them, blending one over another adds their sums,
+	 * so joints come out the same as stamping.
+	 */
+	class ContinuousAirbrushEngine
+	{
+	public:
+		struct Vertex
+		{
+			glm::vec2 pos;
+			float width;
+			float _pad0;
+			glm::vec4 color;
+		};
+
+		enum class Integral : uint32_t
+		{
+			// Falloff of hardness, integral is looked up from a table of IntegralTableSize^2.
+			Tabulated,
+			// Falloff 1 - d^2, integral is a polynomial.
+			ClosedForm,
+		};
+
+		// Result of compare, error is measured in alpha.
+		struct Comparison
+		{
+			float maxError;
+			float meanError;
+			float stampedFragments; // dot count times dot area
+			float integralFragments; // area of segment quads
+		};
+
+	private:
+		struct PushConstant
+		{
+			float spacing;
+			float hardness;
+			uint32_t integral;
+			uint32_t tableSize;
+		};
+
+		vk::Device m_device;
+		vulkan::ShaderModule m_vertShader;
+		vulkan::ShaderModule m_fragShader;
+		vulkan::ShaderModule m_geomShader;
+		vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+		vk::UniquePipelineLayout m_pipelineLayout;
+		// One per canvas format.
+		std::unordered_map<vk::Format, vk::UniquePipeline> m_pipelines;
+		vk::DescriptorSet m_descriptorSet;
+		vulkan::Buffer m_vertBuffer;
+		vulkan::Buffer m_integralTable;
+		std::vector<float> m_table;
+		float m_tableHardness = -1.0f;
+
+		void genDescriptorSet(vk::DescriptorPool pool);
+		void genPipelineDynamic(vk::PhysicalDevice physicalDevice);
+		void genBuffers(VmaAllocator allocator);
+		void updateTable();
+
+		static float falloff(float d, float hardness);
+		// Integral of falloff over dots from s = 0 to s = u * sqrt(1 - h^2), radius units, h is distance to axis.
+		static float tableIntegral(const std::vector<float>& table, float h, float u);
+		static std::vector<float> genTable(float hardness);
+	public:
+		constexpr static uint32_t IntegralTableSize = 64;
+		constexpr static uint32_t MaxVertices = 1024;
+
+		std::vector<Vertex> vertices; // line strip, NDC space
+		float spacing = 0.002f; // spacing of the dots being integrated
+		float hardness = 0.5f;
+		Integral integral = Integral::Tabulated;
+
+		explicit ContinuousAirbrushEngine(vulkan::Device* device);
+
+		void renderDynamic(vk::CommandBuffer cb, const vulkan::Image* target);
+		// Alpha of segment at p. Same math as the fragment shader.
+		static float alpha(const Vertex& a, const Vertex& b, glm::vec2 p, float spacing, float hardness,
+		                   Integral integral, const std::vector<float>& table);
+		/**
+		 * \brief Compare segment a-b against dense stamping at spacing, on a grid of samples over the segment.
+		 * Extent turns NDC into pixels for fragment counts.
+		 */
+		Comparison compare(const Vertex& a, const Vertex& b, vk::Extent2D extent);
+	};
+}
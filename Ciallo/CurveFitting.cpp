@@ -0,0 +1,482 @@
+#include "pch.hpp"
+#include "CurveFitting.hpp"
+
+#include "JobSystem.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo::geom
+{
+	namespace
+	{
+		using Vec = glm::vec2;
+
+		Vec toVec(const Point& p)
+		{
+			return {p.x(), p.y()};
+		}
+
+		Point toPoint(Vec v)
+		{
+			return Point{v.x, v.y};
+		}
+
+		template <typename T>
+		T bernstein(const std::array<T, 4>& c, float t)
+		{
+			float s = 1.0f - t;
+			return s * s * s * c[0] + 3.0f * s * s * t * c[1] + 3.0f * s * t * t * c[2] + t * t * t * c[3];
+		}
+
+		Vec derivative(const std::array<Vec, 4>& c, float t)
+		{
+			float s = 1.0f - t;
+			return 3.0f * (s * s * (c[1] - c[0]) + 2.0f * s * t * (c[2] - c[1]) + t * t * (c[3] - c[2]));
+		}
+
+		Vec secondDerivative(const std::array<Vec, 4>& c, float t)
+		{
+			return 6.0f * ((1.0f - t) * (c[2] - 2.0f * c[1] + c[0]) + t * (c[3] - 2.0f * c[2] + c[1]));
+		}
+
+		Vec normalizeOr(Vec v, Vec fallback)
+		{
+			float length = glm::length(v);
+			return length > 0.0f ? v / length : fallback;
+		}
+
+		struct Cubic
+		{
+			std::array<Vec, 4> p;
+			std::array<float, 4> w;
+		};
+
+		void appendCubic(BezierSpline& spline, const Cubic& c)
+		{
+			if (spline.controlPoints.empty())
+			{
+				spline.controlPoints.push_back(toPoint(c.p[0]));
+				spline.thickness.push_back(c.w[0]);
+			}
+			for (size_t i = 1; i < 4; ++i)
+			{
+				spline.controlPoints.push_back(toPoint(c.p[i]));
+				spline.thickness.push_back(c.w[i]);
+			}
+		}
+
+		/*
+		 * Recursive fitting over one run of vertices. Tangents are unit vectors, tHat1 leaves the first vertex
+		 * and tHat2 leaves the last vertex backwards. Error is squared distance, in position and in thickness.
+		 */
+		class Fitter
+		{
+			std::span<const Vec> m_d;
+			std::span<const float> m_w;
+			float m_tolerance2;
+			BezierSpline& m_out;
+			std::vector<size_t>* m_splits;
+			std::vector<float> m_u;
+
+			constexpr static int MaxIterations = 4;
+
+			void chordLengthParameterize(size_t first, size_t last)
+			{
+				m_u.resize(last - first + 1);
+				m_u[0] = 0.0f;
+				for (size_t i = first + 1; i <= last; ++i)
+				{
+					m_u[i - first] = m_u[i - first - 1] + glm::distance(m_d[i], m_d[i - 1]);
+				}
+				float length = m_u.back();
+				for (float& u : m_u) u = length > 0.0f ? u / length : 0.0f;
+			}
+
+			Cubic generate(size_t first, size_t last, Vec tHat1, Vec tHat2) const
+			{
+				Vec d0 = m_d[first], d3 = m_d[last];
+				float c00 = 0.0f, c01 = 0.0f, c11 = 0.0f, x0 = 0.0f, x1 = 0.0f;
+				// thickness normal equations
+				float t11 = 0.0f, t12 = 0.0f, t22 = 0.0f, y1 = 0.0f, y2 = 0.0f;
+				float w0 = m_w[first], w3 = m_w[last];
+				for (size_t i = first; i <= last; ++i)
+				{
+					float u = m_u[i - first], s = 1.0f - u;
+					float b0 = s * s * s, b1 = 3.0f * s * s * u, b2 = 3.0f * s * u * u, b3 = u * u * u;
+					Vec a0 = tHat1 * b1, a1 = tHat2 * b2;
+					c00 += glm::dot(a0, a0);
+					c01 += glm::dot(a0, a1);
+					c11 += glm::dot(a1, a1);
+					Vec rest = m_d[i] - (d0 * (b0 + b1) + d3 * (b2 + b3));
+					x0 += glm::dot(a0, rest);
+					x1 += glm::dot(a1, rest);
+
+					float wRest = m_w[i] - (w0 * b0 + w3 * b3);
+					t11 += b1 * b1;
+					t12 += b1 * b2;
+					t22 += b2 * b2;
+					y1 += b1 * wRest;
+					y2 += b2 * wRest;
+				}
+
+				Cubic c;
+				float chord = glm::distance(d0, d3);
+				float det = c00 * c11 - c01 * c01;
+				float alpha1 = det != 0.0f ? (x0 * c11 - x1 * c01) / det : 0.0f;
+				float alpha2 = det != 0.0f ? (c00 * x1 - c01 * x0) / det : 0.0f;
+				// Degenerate or backwards handles, fall back to Wu and Barsky's heuristic.
+				float epsilon = 1e-6f * chord;
+				if (alpha1 < epsilon || alpha2 < epsilon) alpha1 = alpha2 = chord / 3.0f;
+				c.p = {d0, d0 + tHat1 * alpha1, d3 + tHat2 * alpha2, d3};
+
+				float tDet = t11 * t22 - t12 * t12;
+				if (glm::abs(tDet) > 1e-12f)
+				{
+					c.w = {w0, (y1 * t22 - y2 * t12) / tDet, (t11 * y2 - t12 * y1) / tDet, w3};
+				}
+				else
+				{
+					c.w = {w0, glm::mix(w0, w3, 1.0f / 3.0f), glm::mix(w0, w3, 2.0f / 3.0f), w3};
+				}
+				return c;
+			}
+
+			std::pair<float, size_t> maxError(size_t first, size_t last, const Cubic& c) const
+			{
+				float error = 0.0f;
+				size_t split = (first + last) / 2;
+				for (size_t i = first + 1; i < last; ++i)
+				{
+					float u = m_u[i - first];
+					Vec dp = bernstein(c.p, u) - m_d[i];
+					float dw = bernstein(c.w, u) - m_w[i];
+					float e = glm::max(glm::dot(dp, dp), dw * dw);
+					if (e >= error)
+					{
+						error = e;
+						split = i;
+					}
+				}
+				return {error, split};
+			}
+
+			// One Newton-Raphson step towards the closest point on the curve for every vertex.
+			void reparameterize(size_t first, size_t last, const Cubic& c)
+			{
+				for (size_t i = first; i <= last; ++i)
+				{
+					float& u = m_u[i - first];
+					Vec diff = bernstein(c.p, u) - m_d[i];
+					Vec q1 = derivative(c.p, u);
+					Vec q2 = secondDerivative(c.p, u);
+					float denominator = glm::dot(q1, q1) + glm::dot(diff, q2);
+					if (denominator != 0.0f) u = glm::clamp(u - glm::dot(diff, q1) / denominator, 0.0f, 1.0f);
+				}
+			}
+
+			void emit(size_t first, const Cubic& c)
+			{
+				appendCubic(m_out, c);
+				if (m_splits) m_splits->push_back(first);
+			}
+
+		public:
+			Fitter(std::span<const Vec> d, std::span<const float> w, float tolerance, BezierSpline& out,
+			       std::vector<size_t>* splits):
+				m_d(d), m_w(w), m_tolerance2(tolerance * tolerance), m_out(out), m_splits(splits)
+			{
+			}
+
+			void fit(size_t first, size_t last, Vec tHat1, Vec tHat2)
+			{
+				if (last - first == 1)
+				{
+					float third = glm::distance(m_d[first], m_d[last]) / 3.0f;
+					float w0 = m_w[first], w3 = m_w[last];
+					emit(first, {
+						     {m_d[first], m_d[first] + tHat1 * third, m_d[last] + tHat2 * third, m_d[last]},
+						     {w0, glm::mix(w0, w3, 1.0f / 3.0f), glm::mix(w0, w3, 2.0f / 3.0f), w3}
+					     });
+					return;
+				}
+
+				chordLengthParameterize(first, last);
+				Cubic c = generate(first, last, tHat1, tHat2);
+				auto [error, split] = maxError(first, last, c);
+				if (error <= m_tolerance2)
+				{
+					emit(first, c);
+					return;
+				}
+				// Close enough that better parameters may do, instead of splitting.
+				if (error <= 4.0f * m_tolerance2)
+				{
+					for (int i = 0; i < MaxIterations; ++i)
+					{
+						reparameterize(first, last, c);
+						c = generate(first, last, tHat1, tHat2);
+						std::tie(error, split) = maxError(first, last, c);
+						if (error <= m_tolerance2)
+						{
+							emit(first, c);
+							return;
+						}
+					}
+				}
+
+				Vec back = m_d[split - 1] - m_d[split];
+				Vec center = normalizeOr(m_d[split - 1] - m_d[split + 1], normalizeOr(back, -tHat1));
+				fit(first, split, tHat1, center);
+				fit(split, last, -center, tHat2);
+			}
+		};
+
+		// Consecutive duplicates make zero length chords, drop them.
+		void deduplicate(std::span<const Point> polyline, std::span<const float> thickness, std::vector<Vec>& d,
+		                 std::vector<float>& w)
+		{
+			bool hasThickness = thickness.size() == polyline.size();
+			d.clear();
+			w.clear();
+			for (size_t i = 0; i < polyline.size(); ++i)
+			{
+				Vec p = toVec(polyline[i]);
+				if (!d.empty() && d.back() == p) continue;
+				d.push_back(p);
+				w.push_back(hasThickness ? thickness[i] : 0.0f);
+			}
+		}
+
+		void tessellateCubic(const std::array<Vec, 4>& p, const std::array<float, 4>& w, float tolerance, int depth,
+		                     std::vector<Point>& position, std::vector<float>& thickness)
+		{
+			Vec chord = p[3] - p[0];
+			float length = glm::length(chord);
+			auto distance = [&](Vec q)
+			{
+				if (length == 0.0f) return glm::distance(q, p[0]);
+				return glm::abs(chord.x * (q.y - p[0].y) - chord.y * (q.x - p[0].x)) / length;
+			};
+			bool flat = glm::max(distance(p[1]), distance(p[2])) <= tolerance &&
+				glm::abs(w[1] - glm::mix(w[0], w[3], 1.0f / 3.0f)) <= tolerance &&
+				glm::abs(w[2] - glm::mix(w[0], w[3], 2.0f / 3.0f)) <= tolerance;
+			if (flat || depth == 0)
+			{
+				position.push_back(toPoint(p[3]));
+				thickness.push_back(w[3]);
+				return;
+			}
+
+			// de Casteljau at one half
+			auto half = [](const auto& c)
+			{
+				auto c01 = (c[0] + c[1]) * 0.5f, c12 = (c[1] + c[2]) * 0.5f, c23 = (c[2] + c[3]) * 0.5f;
+				auto c012 = (c01 + c12) * 0.5f, c123 = (c12 + c23) * 0.5f;
+				auto mid = (c012 + c123) * 0.5f;
+				using T = std::decay_t<decltype(c[0])>;
+				return std::pair{std::array<T, 4>{c[0], c01, c012, mid}, std::array<T, 4>{mid, c123, c23, c[3]}};
+			};
+			auto [pl, pr] = half(p);
+			auto [wl, wr] = half(w);
+			tessellateCubic(pl, wl, tolerance, depth - 1, position, thickness);
+			tessellateCubic(pr, wr, tolerance, depth - 1, position, thickness);
+		}
+	}
+
+	Bezier<3> BezierSpline::segment(size_t i) const
+	{
+		auto first = controlPoints.begin() + static_cast<ptrdiff_t>(3 * i);
+		return {first, first + 4};
+	}
+
+	Point BezierSpline::position(size_t segment, float t) const
+	{
+		std::array<Vec, 4> c;
+		for (size_t i = 0; i < 4; ++i) c[i] = toVec(controlPoints[3 * segment + i]);
+		return toPoint(bernstein(c, t));
+	}
+
+	float BezierSpline::thicknessAt(size_t segment, float t) const
+	{
+		std::array<float, 4> c;
+		for (size_t i = 0; i < 4; ++i) c[i] = thickness[3 * segment + i];
+		return bernstein(c, t);
+	}
+
+	void BezierSpline::tessellate(float tolerance, std::vector<Point>& position, std::vector<float>& thickness) const
+	{
+		constexpr int maxDepth = 12;
+		if (controlPoints.empty()) return;
+		position.push_back(controlPoints.front());
+		thickness.push_back(this->thickness.front());
+		for (size_t s = 0; s < segmentCount(); ++s)
+		{
+			std::array<Vec, 4> p;
+			std::array<float, 4> w;
+			for (size_t i = 0; i < 4; ++i)
+			{
+				p[i] = toVec(controlPoints[3 * s + i]);
+				w[i] = this->thickness[3 * s + i];
+			}
+			tessellateCubic(p, w, tolerance, maxDepth, position, thickness);
+		}
+	}
+
+	size_t BezierSpline::memory() const
+	{
+		return controlPoints.capacity() * sizeof(Point) + thickness.capacity() * sizeof(float);
+	}
+
+	BezierSpline fitBezierSpline(std::span<const Point> polyline, std::span<const float> thickness, float tolerance)
+	{
+		std::vector<Vec> d;
+		std::vector<float> w;
+		deduplicate(polyline, thickness, d, w);
+		BezierSpline spline;
+		if (d.size() == 1)
+		{
+			spline.controlPoints.push_back(toPoint(d[0]));
+			spline.thickness.push_back(w[0]);
+		}
+		if (d.size() < 2) return spline;
+
+		Vec tHat1 = normalizeOr(d[1] - d[0], {1.0f, 0.0f});
+		Vec tHat2 = normalizeOr(d[d.size() - 2] - d.back(), -tHat1);
+		Fitter(d, w, tolerance, spline, nullptr).fit(0, d.size() - 1, tHat1, tHat2);
+		return spline;
+	}
+
+	StreamingBezierFitter::StreamingBezierFitter(float tolerance): m_tolerance(tolerance)
+	{
+	}
+
+	void StreamingBezierFitter::push(const Point& p, float thickness)
+	{
+		if (!m_tail.empty() && m_tail.back() == p) return;
+		m_tail.push_back(p);
+		m_tailThickness.push_back(thickness);
+		if (m_tail.size() < 2) return;
+		refit();
+
+		if (m_tailFit.segmentCount() > 1)
+		{
+			commit(m_tailFit.segmentCount() - 1);
+		}
+		else if (m_tail.size() >= MaxTailSize)
+		{
+			commit(1);
+		}
+	}
+
+	void StreamingBezierFitter::refit()
+	{
+		std::vector<Vec> d = m_tail | views::transform(toVec) | ranges::to_vector;
+		Vec tHat1 = m_hasTangent ? m_tangent : normalizeOr(d[1] - d[0], {1.0f, 0.0f});
+		Vec tHat2 = normalizeOr(d[d.size() - 2] - d.back(), -tHat1);
+		m_tailFit = {};
+		m_tailSplits.clear();
+		Fitter(d, m_tailThickness, m_tolerance, m_tailFit, &m_tailSplits).fit(0, d.size() - 1, tHat1, tHat2);
+	}
+
+	void StreamingBezierFitter::commit(size_t segmentCount)
+	{
+		// Joint vertex is shared, only the first committed segment brings its start point.
+		size_t skip = m_committed.controlPoints.empty() ? 0 : 1;
+		size_t count = 3 * segmentCount + 1;
+		m_committed.controlPoints.insert(m_committed.controlPoints.end(), m_tailFit.controlPoints.begin() + skip,
+		                                 m_tailFit.controlPoints.begin() + count);
+		m_committed.thickness.insert(m_committed.thickness.end(), m_tailFit.thickness.begin() + skip,
+		                             m_tailFit.thickness.begin() + count);
+		const Point& end = m_tailFit.controlPoints[count - 1];
+		m_tangent = normalizeOr(toVec(end) - toVec(m_tailFit.controlPoints[count - 2]), m_tangent);
+		m_hasTangent = true;
+
+		size_t first = segmentCount < m_tailSplits.size() ? m_tailSplits[segmentCount] : m_tail.size() - 1;
+		m_tail.erase(m_tail.begin(), m_tail.begin() + static_cast<ptrdiff_t>(first));
+		m_tailThickness.erase(m_tailThickness.begin(), m_tailThickness.begin() + static_cast<ptrdiff_t>(first));
+		m_tailFit.controlPoints.erase(m_tailFit.controlPoints.begin(),
+		                              m_tailFit.controlPoints.begin() + static_cast<ptrdiff_t>(count - 1));
+		m_tailFit.thickness.erase(m_tailFit.thickness.begin(),
+		                          m_tailFit.thickness.begin() + static_cast<ptrdiff_t>(count - 1));
+		m_tailSplits.erase(m_tailSplits.begin(), m_tailSplits.begin() + static_cast<ptrdiff_t>(segmentCount));
+		for (size_t& split : m_tailSplits) split -= first;
+	}
+
+	void StreamingBezierFitter::clear()
+	{
+		m_committed = {};
+		m_tail.clear();
+		m_tailThickness.clear();
+		m_tailFit = {};
+		m_tailSplits.clear();
+		m_hasTangent = false;
+	}
+
+	BezierSpline StreamingBezierFitter::spline() const
+	{
+		BezierSpline spline = m_committed;
+		if (m_tailFit.segmentCount() > 0)
+		{
+			size_t skip = spline.controlPoints.empty() ? 0 : 1;
+			spline.controlPoints.insert(spline.controlPoints.end(), m_tailFit.controlPoints.begin() + skip,
+			                            m_tailFit.controlPoints.end());
+			spline.thickness.insert(spline.thickness.end(), m_tailFit.thickness.begin() + skip,
+			                        m_tailFit.thickness.end());
+		}
+		else if (spline.controlPoints.empty() && !m_tail.empty())
+		{
+			spline.controlPoints.push_back(m_tail.front());
+			spline.thickness.push_back(m_tailThickness.front());
+		}
+		return spline;
+	}
+}
+
+namespace ciallo
+{
+	void StrokeCurveFitter::connect(entt::registry& r)
+	{
+		// Curve is derived, any edit of the polyline makes it stale.
+		r.on_update<StrokeCpo>().connect<&entt::registry::remove<StrokeCurveCpo>>();
+		r.on_destroy<StrokeCpo>().connect<&entt::registry::remove<StrokeCurveCpo>>();
+	}
+
+	StrokeCurveCpo StrokeCurveFitter::fit(const StrokeCpo& stroke, float tolerance)
+	{
+		return {geom::fitBezierSpline(stroke.position, stroke.thickness, tolerance), tolerance};
+	}
+
+	void StrokeCurveFitter::fit(entt::registry& r, const std::vector<entt::entity>& strokes, float tolerance)
+	{
+		std::vector<const StrokeCpo*> strokeCpos = strokes | views::transform([&r](entt::entity e)
+		{
+			return &r.get<const StrokeCpo>(e);
+		}) | ranges::to_vector;
+		std::vector<StrokeCurveCpo> curves(strokes.size());
+
+		r.ctx().at<JobSystem*>()->parallelFor(strokes.size(), [&](size_t i)
+		{
+			curves[i] = fit(*strokeCpos[i], tolerance);
+		});
+
+		size_t before = 0, after = 0;
+		for (size_t i = 0; i < strokes.size(); ++i)
+		{
+			before += strokeCpos[i]->position.size() * sizeof(geom::Point) + strokeCpos[i]->thickness.size() *
+				sizeof(float);
+			after += curves[i].spline.memory();
+			r.emplace_or_replace<StrokeCurveCpo>(strokes[i], std::move(curves[i]));
+		}
+		if (after > 0)
+		{
+			spdlog::info("Fitted {} strokes, {} bytes of polyline to {} bytes of curve, {:.1f}x.", strokes.size(),
+			             before, after, static_cast<double>(before) / static_cast<double>(after));
+		}
+	}
+
+	void StrokeCurveFitter::tessellate(const StrokeCurveCpo& curve, StrokeCpo& stroke)
+	{
+		stroke.position.clear();
+		stroke.thickness.clear();
+		curve.spline.tessellate(curve.tolerance * 0.25f, stroke.position, stroke.thickness);
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <span>
+
+#include "Bezier.hpp"
+
+namespace ciallo::geom
+{
+	/**
+	 * \brief Piecewise cubic Bezier curve, consecutive segments share their end points.
+	 * Segment i uses controlPoints[3i, 3i+3]. Thickness is a parallel 1D cubic Bezier over the same parameter,
+	 * laid out the same way.
+	 */
+	struct BezierSpline
+	{
+		std::vector<Point> controlPoints;
+		std::vector<float> thickness;
+
+		size_t segmentCount() const { return controlPoints.size() < 4 ? 0 : (controlPoints.size() - 1) / 3; }
+		Bezier<3> segment(size_t i) const;
+		Point position(size_t segment, float t) const;
+		float thicknessAt(size_t segment, float t) const;
+		// Segments are split until control points are within tolerance of the chord, in position and thickness.
+		void tessellate(float tolerance, std::vector<Point>& position, std::vector<float>& thickness) const;
+		size_t memory() const;
+	};
+
+	/**
+	 * \brief Schneider's least squares fitting of a piecewise cubic Bezier to a polyline.
+	 * Segments get split at the worst vertex until every vertex is within tolerance of the curve, in position and
+	 * in thickness. Tangents are continuous at the splits.
+	 * \param thickness Optional, zero when its size differs from polyline.
+	 */
+	BezierSpline fitBezierSpline(std::span<const Point> polyline, std::span<const float> thickness, float tolerance);
+
+	/**
+	 * \brief Fitting of a polyline still being captured.
+	 * Vertices since the last committed segment form the tail, which is refitted on every push. Once the tail
+	 * needs more than one segment, all but its last are committed and never change again. The tail is bounded by
+	 * MaxTailSize, so the cost per vertex is bounded as well.
+	 */
+	class StreamingBezierFitter
+	{
+	public:
+		constexpr static size_t MaxTailSize = 128;
+
+	private:
+		float m_tolerance;
+		BezierSpline m_committed;
+		std::vector<Point> m_tail;
+		std::vector<float> m_tailThickness;
+		BezierSpline m_tailFit;
+		std::vector<size_t> m_tailSplits; // first tail vertex of every segment in m_tailFit
+		bool m_hasTangent = false;
+		glm::vec2 m_tangent{0.0f, 0.0f}; // end tangent of committed curve, keeps the tail smooth with it
+
+		void refit();
+		void commit(size_t segmentCount);
+	public:
+		explicit StreamingBezierFitter(float tolerance);
+
+		void push(const Point& p, float thickness = 0.0f);
+		void clear();
+		// Committed segments followed by the fit of the tail.
+		BezierSpline spline() const;
+		const BezierSpline& committed() const { return m_committed; }
+		float tolerance() const { return m_tolerance; }
+	};
+}
+
+namespace ciallo
+{
+	struct StrokeCpo;
+
+	// Stroke as curve, fitted from StrokeCpo within tolerance. Removed whenever StrokeCpo changes.
+	struct StrokeCurveCpo
+	{
+		geom::BezierSpline spline;
+		float tolerance = 0.0f; // meter
+	};
+
+	struct StrokeCurveFitter
+	{
+		constexpr static float DefaultTolerance = 5e-5f; // 0.05mm
+
+		static void connect(entt::registry& r);
+		static StrokeCurveCpo fit(const StrokeCpo& stroke, float tolerance = DefaultTolerance);
+		// Fit strokes in parallel, every worker touches nothing but its own stroke.
+		static void fit(entt::registry& r, const std::vector<entt::entity>& strokes,
+		                float tolerance = DefaultTolerance);
+		// Back to polyline, deviating from the curve by a quarter of its fitting tolerance at most.
+		static void tessellate(const StrokeCurveCpo& curve, StrokeCpo& stroke);
+	};
+}
@@ -5,10 +5,11 @@
 
 namespace ciallo::vulkan
 {
-	Device::Device(vk::Instance instance, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex):
+	Device::Device(vk::Instance instance, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex, bool present):
 		m_physicalDevice(physicalDevice), m_queueFamilyIndex(queueFamilyIndex)
 	{
-		genDevice();
+		genDevice(present);
+		m_timeline = Timeline(*m_device);
 		genCommandPool();
 		genDescriptorPool();
 		genAllocator(instance, physicalDevice, *m_device);
@@ -16,19 +17,46 @@ namespace ciallo::vulkan
 
 	Device::~Device()
 	{
+		// Command buffers of executeAsync are freed with the pool.
+		if (m_device) m_timeline.last().wait(*m_device);
 		vmaDestroyAllocator(m_allocator);
 	}
 
-	void Device::genDevice()
+	void Device::genDevice(bool present)
 	{
 		std::vector<float> priorities{1.0f};
-		vk::DeviceQueueCreateInfo deviceQueueCreateInfo{{}, m_queueFamilyIndex, priorities};
+		std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos{{{}, m_queueFamilyIndex, priorities}};
+		// Transfer only families are served by copy engines, uploads there overlap rendering.
+		m_transferQueueFamilyIndex = m_queueFamilyIndex;
+		auto families = m_physicalDevice.getQueueFamilyProperties();
+		for (const auto&& [i, family] : views::enumerate(families))
+		{
+			constexpr vk::QueueFlags Other = vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute;
+			if (family.queueCount > 0 && (family.queueFlags & vk::QueueFlagBits::eTransfer) &&
+				!(family.queueFlags & Other))
+			{
+				m_transferQueueFamilyIndex = static_cast<uint32_t>(i);
+				queueCreateInfos.emplace_back(vk::DeviceQueueCreateFlags{}, m_transferQueueFamilyIndex, priorities);
+				break;
+			}
+		}
+
+		// Optional extensions are enabled only when available.
+		std::vector<const char*> extensions = Instance::requiredDeviceExtensions(present);
+		for (const auto& extension : m_physicalDevice.enumerateDeviceExtensionProperties())
+		{
+			if (std::string_view(extension.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+			{
+				extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+				m_memoryBudgetSupported = true;
+			}
+		}
 
 		vk::DeviceCreateInfo deviceCreateInfo{
 			{},
-			deviceQueueCreateInfo,
+			queueCreateInfos,
 			{},
-			Instance::m_deviceExtensions,
+			extensions,
 		};
 
 		// Warning: may encounter features do not supported
@@ -37,16 +65,28 @@ namespace ciallo::vulkan
 		                      .setTessellationShader(VK_TRUE)
 		                      .setWideLines(VK_TRUE)
 		                      .setShaderClipDistance(VK_TRUE);
+		vk::PhysicalDeviceFeatures supportedFeatures = m_physicalDevice.getFeatures();
+		auto queueFlags = m_physicalDevice.getQueueFamilyProperties()[m_queueFamilyIndex].queueFlags;
+		// Unbound tiles must read as zero, layers rely on it.
+		m_sparseResidencySupported = supportedFeatures.sparseBinding && supportedFeatures.sparseResidencyImage2D &&
+			(queueFlags & vk::QueueFlagBits::eSparseBinding) &&
+			m_physicalDevice.getProperties().sparseProperties.residencyNonResidentStrict;
+		if (m_sparseResidencySupported)
+		{
+			physicalDeviceFeatures.setSparseBinding(VK_TRUE)
+			                      .setSparseResidencyImage2D(VK_TRUE);
+		}
 		vk::PhysicalDeviceFeatures2 physicalDeviceFeatures2{physicalDeviceFeatures};
 
 		vk::PhysicalDeviceVulkan12Features vulkan12Features{};
-		vulkan12Features.setUniformBufferStandardLayout(VK_TRUE);
+		vulkan12Features.setUniformBufferStandardLayout(VK_TRUE)
+		                .setTimelineSemaphore(VK_TRUE);
 
 		vk::PhysicalDeviceVulkan13Features vulkan13Features{};
 		vulkan13Features.setDynamicRendering(VK_TRUE)
 		                .setSynchronization2(VK_TRUE);
 
-		vk::StructureChain c(deviceCreateInfo, physicalDeviceFeatures2, vulkan13Features);
+		vk::StructureChain c(deviceCreateInfo, physicalDeviceFeatures2, vulkan12Features, vulkan13Features);
 		m_device = m_physicalDevice.createDeviceUnique(c.get<vk::DeviceCreateInfo>());
 	}
 
@@ -90,12 +130,49 @@ namespace ciallo::vulkan
 		info.physicalDevice = physicalDevice;
 		info.device = device;
 		info.instance = instance;
+		info.vulkanApiVersion = VK_API_VERSION_1_3;
+		if (m_memoryBudgetSupported)
+		{
+			info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		}
 
 		vmaCreateAllocator(&info, &m_allocator);
 	}
 
-	void Device::executeImmediately(const std::function<void(vk::CommandBuffer)>& func)
+	GpuPoint Device::submit(vk::CommandBuffer cb, std::span<const vk::SemaphoreSubmitInfo> waits,
+	                        std::span<const vk::SemaphoreSubmitInfo> signals)
+	{
+		GpuPoint point = m_timeline.next();
+		std::vector<vk::SemaphoreSubmitInfo> waitInfos{waits.begin(), waits.end()};
+		// Also keeps the timeline growing, the bind signals a lower value than this submission.
+		if (m_pendingBind) waitInfos.push_back(m_pendingBind->waitInfo());
+		m_pendingBind.reset();
+		std::vector<vk::SemaphoreSubmitInfo> signalInfos{signals.begin(), signals.end()};
+		signalInfos.emplace_back(point.semaphore, point.value, vk::PipelineStageFlagBits2::eAllCommands);
+		vk::CommandBufferSubmitInfo cbInfo{cb};
+		vk::SubmitInfo2 si{{}, waitInfos, cbInfo, signalInfos};
+		queue().submit2(si);
+		return point;
+	}
+
+	GpuPoint Device::bindSparse(vk::BindSparseInfo info)
+	{
+		GpuPoint point = m_timeline.next();
+		vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.setSignalSemaphoreValues(point.value);
+		info.setSignalSemaphores(point.semaphore).setPNext(&timelineInfo);
+		queue().bindSparse(info, nullptr);
+		m_pendingBind = point;
+		return point;
+	}
+
+	GpuPoint Device::executeAsync(const std::function<void(vk::CommandBuffer)>& func)
 	{
+		while (!m_asyncCommandBuffers.empty() && m_asyncCommandBuffers.front().first.reached(*m_device))
+		{
+			m_asyncCommandBuffers.pop_front();
+		}
+
 		vk::CommandBufferAllocateInfo info{
 			*m_commandPool,
 			vk::CommandBufferLevel::ePrimary,
@@ -105,16 +182,23 @@ namespace ciallo::vulkan
 		cb->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
 		func(*cb);
 		cb->end();
+		GpuPoint point = submit(*cb);
+		m_asyncCommandBuffers.emplace_back(point, std::move(cb));
+		return point;
+	}
 
-		vk::UniqueFence fence = m_device->createFenceUnique({});
-		vk::SubmitInfo si{};
-		si.setCommandBuffers(*cb);
-		queue().submit(si, *fence);
-		[[maybe_unused]] auto result = m_device->waitForFences(*fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	void Device::executeImmediately(const std::function<void(vk::CommandBuffer)>& func)
+	{
+		executeAsync(func).wait(*m_device);
 	}
 
 	vk::Queue Device::queue() const
 	{
 		return m_device->getQueue(m_queueFamilyIndex, 0);
 	}
+
+	vk::Queue Device::transferQueue() const
+	{
+		return m_device->getQueue(m_transferQueueFamilyIndex, 0);
+	}
 }
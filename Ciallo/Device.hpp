@@ -1,9 +1,13 @@
 #pragma once
 
+#include <deque>
 #include <functional>
+#include <span>
 #include <vulkan/vulkan.hpp>
 #include <vk_mem_alloc.h>
 
+#include "Timeline.hpp"
+
 namespace ciallo::vulkan
 {
 	/**
@@ -14,10 +18,16 @@ namespace ciallo::vulkan
 	{
 		vk::PhysicalDevice m_physicalDevice;
 		vk::UniqueDevice m_device;
+		Timeline m_timeline; // of queue()
 		vk::UniqueCommandPool m_commandPool;
+		std::deque<std::pair<GpuPoint, vk::UniqueCommandBuffer>> m_asyncCommandBuffers; // oldest first
+		std::optional<GpuPoint> m_pendingBind; // sparse bind the next submit() waits for
 		vk::UniqueDescriptorPool m_descriptorPool;
 		uint32_t m_queueFamilyIndex = std::numeric_limits<uint32_t>::max();
+		uint32_t m_transferQueueFamilyIndex = std::numeric_limits<uint32_t>::max();
 		VmaAllocator m_allocator{};
+		bool m_memoryBudgetSupported = false;
+		bool m_sparseResidencySupported = false;
 
 		constexpr static int MAX_SIZE = 128;
 		std::vector<vk::DescriptorPoolSize> m_descriptorPoolSizes{
@@ -35,7 +45,9 @@ namespace ciallo::vulkan
 		};
 
 	public:
-		explicit Device(vk::Instance instance, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex);
+		// Headless devices, with present false, have no swapchain extension.
+		explicit Device(vk::Instance instance, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+		                bool present = true);
 		Device(const Device& other) = delete;
 		Device(Device&& other) = default;
 		Device& operator=(const Device& other) = delete;
@@ -46,19 +58,44 @@ namespace ciallo::vulkan
 
 	private:
 
-		void genDevice();
+		void genDevice(bool present);
 		void genCommandPool();
 		void genDescriptorPool();
 		void genAllocator(vk::Instance instance, vk::PhysicalDevice physicalDevice, vk::Device device);
 	public:
+		/**
+		 * \brief Submit cb to queue(), signaling the device timeline besides signals.
+		 * Waits and signals may name binary semaphores too, their values are ignored. Waits for sparse binds
+		 * made since the last submission as well.
+		 * \return Point reached once cb completed.
+		 */
+		GpuPoint submit(vk::CommandBuffer cb, std::span<const vk::SemaphoreSubmitInfo> waits = {},
+		                std::span<const vk::SemaphoreSubmitInfo> signals = {});
+		/**
+		 * \brief Queue sparse binds on queue() without waiting, signaling the device timeline.
+		 * Binds are not ordered with submissions, so the next submit() waits for them.
+		 */
+		GpuPoint bindSparse(vk::BindSparseInfo info);
+		// Record and submit without waiting, the command buffer is freed once a later call finds it completed.
+		GpuPoint executeAsync(const std::function<void(vk::CommandBuffer)>& func);
+		// Record, submit and wait for the commands alone, not for the whole device.
 		void executeImmediately(const std::function<void(vk::CommandBuffer)>& func);
 		vk::CommandBuffer createCommandBuffer(vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
 		vk::UniqueDescriptorSet createDescriptorSetUnique(vk::DescriptorSetLayout layout) const;
 		vk::Queue queue() const;
+		const Timeline& timeline() const { return m_timeline; }
 		vk::Device device() const { return *m_device; }
 		vk::PhysicalDevice physicalDevice() const { return m_physicalDevice; }
 		VmaAllocator allocator() const { return m_allocator; }
 		uint32_t queueFamilyIndex() const { return m_queueFamilyIndex; }
+		// Queue of a transfer only family when the device has one, queue() otherwise.
+		vk::Queue transferQueue() const;
+		uint32_t transferQueueFamilyIndex() const { return m_transferQueueFamilyIndex; }
+		bool dedicatedTransferQueue() const { return m_transferQueueFamilyIndex != m_queueFamilyIndex; }
 		vk::DescriptorPool descriptorPool() const { return *m_descriptorPool; }
+		// VK_EXT_memory_budget is enabled, vmaGetHeapBudgets reports driver numbers instead of estimates.
+		bool memoryBudgetSupported() const { return m_memoryBudgetSupported; }
+		// Sparse residency 2D images can be created and bound on queue().
+		bool sparseResidencySupported() const { return m_sparseResidencySupported; }
 	};
 }
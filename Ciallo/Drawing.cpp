@@ -15,6 +15,11 @@ namespace ciallo
 		return (max - min).y * dpi / 0.0254f;
 	}
 
+	float ViewRectCpo::pixelsPerMeter(uint32_t imageWidth) const
+	{
+		return static_cast<float>(imageWidth) / (max - min).x;
+	}
+
 	glm::mat4 ViewRectCpo::projMat() const
 	{
 		return glm::ortho(min.x, max.x, max.y, min.y);
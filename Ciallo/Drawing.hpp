@@ -15,6 +15,8 @@ namespace ciallo
 		// in pixel
 		float width() const;
 		float height() const;
+		// Scale of an image of imageWidth pixels covering the rect.
+		float pixelsPerMeter(uint32_t imageWidth) const;
 
 		glm::mat4 projMat() const;
 	};
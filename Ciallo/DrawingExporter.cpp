@@ -0,0 +1,364 @@
+#include "pch.hpp"
+#include "DrawingExporter.hpp"
+
+#include <charconv>
+
+#include "Brush.hpp"
+#include "Drawing.hpp"
+#include "FalloffCurve.hpp"
+#include "FillRegion.hpp"
+#include "ImageFile.hpp"
+#include "Layer.hpp"
+#include "ProjectFile.hpp"
+#include "RegistrySnapshot.hpp"
+#include "Stroke.hpp"
+#include "StrokeLod.hpp"
+
+namespace ciallo
+{
+	namespace
+	{
+		template <typename T>
+		T parseNumber(std::string_view option, std::string_view text)
+		{
+			T value{};
+			auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+			if (error != std::errc{} || end != text.data() + text.size())
+			{
+				throw std::runtime_error(fmt::format("Invalid value {} of {}!", text, option));
+			}
+			return value;
+		}
+	}
+
+	ExportOptions ExportOptions::parse(std::span<char* const> args)
+	{
+		ExportOptions options;
+		bool hasProject = false;
+		for (size_t i = 0; i < args.size(); ++i)
+		{
+			std::string_view arg = args[i];
+			auto value = [&]() -> std::string_view
+			{
+				if (i + 1 == args.size()) throw std::runtime_error(fmt::format("Missing value of {}!", arg));
+				return args[++i];
+			};
+			if (arg == "--output")
+			{
+				options.output = value();
+			}
+			else if (arg == "--format")
+			{
+				std::string_view format = value();
+				if (format == "png")
+				{
+					options.format = ExportFormat::Png;
+				}
+				else if (format == "exr")
+				{
+					options.format = ExportFormat::Exr;
+				}
+				else
+				{
+					throw std::runtime_error(fmt::format("Unknown format {}!", format));
+				}
+			}
+			else if (arg == "--in-flight")
+			{
+				options.inFlight = parseNumber<uint32_t>(arg, value());
+				if (options.inFlight == 0) throw std::runtime_error("At least one drawing must be in flight!");
+			}
+			else if (arg == "--dpi")
+			{
+				options.dpi = parseNumber<float>(arg, value());
+			}
+			else if (!arg.starts_with("--") && !hasProject)
+			{
+				options.project = arg;
+				hasProject = true;
+			}
+			else
+			{
+				throw std::runtime_error(fmt::format("Unexpected argument {}!", arg));
+			}
+		}
+		if (!hasProject) throw std::runtime_error("No project to export!");
+		return options;
+	}
+
+	const char* ExportOptions::usage()
+	{
+		return "Usage: Ciallo export <project> [--output <dir>] [--format png|exr] [--in-flight <n>] [--dpi <dpi>]\n"
+			"  Renders every drawing of a snapshot (.csnp) or project file without a window.\n"
+			"  Machines without a GPU run it on a software driver, picked by VK_ICD_FILENAMES.\n";
+	}
+
+	DrawingExporter::DrawingExporter(vulkan::Device* device, JobSystem* jobs, uint32_t inFlight):
+		m_device(device), m_jobs(jobs), m_uploads(device)
+	{
+		m_brushTable = std::make_unique<BrushTable>(device, m_uploads);
+		for (uint32_t i = 0; i < std::max(inFlight, 1u); ++i)
+		{
+			auto slot = std::make_unique<Slot>();
+			slot->engine = std::make_unique<ArticulatedLineEngine>(device, m_brushTable->descriptorSetLayout());
+			slot->accumulator = std::make_unique<StrokeAccumulator>(device, m_brushTable->descriptorSetLayout());
+			slot->fills = std::make_unique<FillRenderer>(device);
+			slot->layers = std::make_unique<LayerRenderer>(device, m_uploads);
+			slot->display = std::make_unique<CanvasDisplayPass>(device);
+			slot->graph = std::make_unique<rendering::RenderGraph>(device);
+			slot->cb = device->createCommandBuffer();
+			m_slots.push_back(std::move(slot));
+		}
+	}
+
+	DrawingExporter::~DrawingExporter()
+	{
+		// Encoding jobs reference their slots.
+		for (auto& slot : m_slots)
+		{
+			m_jobs->wait(slot->encoded);
+		}
+		m_device->timeline().last().wait(m_device->device());
+	}
+
+	Project DrawingExporter::load(const std::filesystem::path& path, JobSystem& jobs)
+	{
+		if (path.extension() == ".csnp")
+		{
+			Project project;
+			auto snapshot = RegistrySnapshot::decompress(RegistrySnapshot::read(path), jobs);
+			RegistrySnapshot::restore(project.registry(), snapshot);
+			return project;
+		}
+
+		return ProjectFile::load(path);
+	}
+
+	void DrawingExporter::prepare(entt::registry& r)
+	{
+		r.ctx().emplace<vulkan::Device*>(m_device);
+		r.ctx().emplace<JobSystem*>(m_jobs);
+		r.ctx().emplace<BrushTable*>(m_brushTable.get());
+		r.ctx().emplace<UploadScheduler*>(&m_uploads);
+		m_brushTable->connect(r);
+		StrokeLodBuilder::connect(r);
+		LayerRenderer::connect(r);
+		FalloffLutBaker::connect(r);
+		FillRegionBuilder::connect(r);
+		for (entt::entity e : r.view<StrokeCpo>())
+		{
+			StrokeLodBuilder::build(r, e);
+		}
+		FillRegionBuilder::update(r);
+		m_brushTable->update(r);
+		FalloffLutBaker::update(r);
+		// LUTs of the project and the renderers' own uploads, every slot waits for them in record().
+		m_uploads.flush();
+	}
+
+	void DrawingExporter::release(entt::registry& r, entt::entity drawing)
+	{
+		if (auto* stack = r.try_get<LayerStackCpo>(drawing))
+		{
+			for (entt::entity layer : stack->layers)
+			{
+				if (r.valid(layer)) r.remove<LayerTargetCpo>(layer);
+			}
+		}
+		r.remove<CanvasTargetCpo, GPUImageCpo, FillBufferCpo>(drawing);
+	}
+
+	void DrawingExporter::record(entt::registry& r, Slot& slot, entt::entity drawing, const ExportOptions& options)
+	{
+		auto& view = r.get<ViewRectCpo>(drawing);
+		if (options.dpi > 0.0f) view.dpi = options.dpi;
+		vk::Extent2D extent{
+			std::max(1u, static_cast<uint32_t>(std::ceil(view.width()))),
+			std::max(1u, static_cast<uint32_t>(std::ceil(view.height())))
+		};
+		uint32_t maxExtent = m_device->physicalDevice().getProperties().limits.maxImageDimension2D;
+		if (extent.width > maxExtent || extent.height > maxExtent)
+		{
+			throw std::runtime_error(fmt::format("Drawing of {}x{} pixels is too large, lower its dpi!",
+			                                     extent.width, extent.height));
+		}
+
+		// Canvas follows the size of the display image, see CanvasDisplayPass::prepareCanvas.
+		auto& display = r.emplace_or_replace<GPUImageCpo>(drawing);
+		display.image = vulkan::Image(*m_device, vulkan::MemoryAuto, vk::Format::eR8G8B8A8Unorm, extent.width,
+		                              extent.height, vk::SampleCountFlagBits::e1,
+		                              vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc);
+
+		// Brush colors follow the canvas format, drawings still in flight read the table.
+		if (m_brushTable->setCanvasFormat(canvasFormatOf(r, drawing)))
+		{
+			m_device->timeline().last().wait(m_device->device());
+		}
+		m_brushTable->update(r);
+
+		vk::CommandBuffer cb = slot.cb;
+		cb.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+		std::array uploadWaits{m_uploads.acquire(cb).waitInfo()};
+		display.image.changeLayout(cb, vk::ImageLayout::eGeneral);
+		vulkan::Image& canvas = CanvasDisplayPass::prepareCanvas(r, cb, drawing).image;
+
+		// The slot retired its previous drawing, so the graph's transients are free, as reset() requires.
+		rendering::RenderGraph& graph = *slot.graph;
+		graph.reset();
+		auto canvasResource = graph.importImage("Canvas", canvas, rendering::AccessComputeWrite);
+		rendering::RenderGraph::Pass& composite = graph.addPass("Layer Composite")
+		                                               .write(canvasResource, rendering::AccessComputeWrite);
+		std::optional<rendering::RenderGraph::Resource> stencil;
+		if (!r.view<FillCpo>().empty())
+		{
+			stencil = slot.fills->createStencil(graph, canvas.extent2D());
+			composite.write(*stencil, rendering::AccessStencilAttachment);
+		}
+		composite.commands([&](vk::CommandBuffer passCb)
+		{
+			const vulkan::Image* fillStencil = stencil ? &graph.image(*stencil) : nullptr;
+			slot.layers->render(r, passCb, drawing, *slot.engine, *slot.accumulator, *slot.fills, fillStencil);
+		});
+		// Sampled by the display pass, or copied, whose barrier follows below.
+		graph.exportResource(canvasResource, rendering::AccessComputeSampled);
+		graph.execute(cb);
+
+		const vulkan::Image* source = &canvas;
+		if (options.format == ExportFormat::Png)
+		{
+			slot.display->render(r, cb, drawing);
+			source = &display.image;
+		}
+
+		// Ring slots are reused only after they retire, so the buffer is free to grow here.
+		if (!slot.readback.allocated() || slot.readback.size() < source->size())
+		{
+			VmaAllocationCreateInfo info{
+				VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_AUTO
+			};
+			slot.readback = vulkan::Buffer(*m_device, info, source->size(), vk::BufferUsageFlagBits::eTransferDst);
+		}
+		vk::MemoryBarrier2 before{
+			vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+			vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferRead
+		};
+		cb.pipelineBarrier2({{}, before, {}, {}});
+		vk::BufferImageCopy copy{};
+		copy.setImageExtent({source->width(), source->height(), 1u});
+		copy.setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+		cb.copyImageToBuffer(*source, vk::ImageLayout::eGeneral, slot.readback, copy);
+		vk::MemoryBarrier2 after{
+			vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead
+		};
+		cb.pipelineBarrier2({{}, after, {}, {}});
+		cb.end();
+
+		slot.extent = source->extent2D();
+		slot.format = source->format();
+		slot.fileFormat = options.format;
+		slot.rendered = m_device->submit(cb, uploadWaits);
+		// In flight from here, retire() waits for it.
+		slot.drawing = drawing;
+	}
+
+	void DrawingExporter::poll(Slot& slot, bool wait)
+	{
+		if (slot.drawing == entt::null || slot.encoding) return;
+		vk::Device device = m_device->device();
+		if (wait)
+		{
+			slot.rendered.wait(device);
+		}
+		else if (!slot.rendered.reached(device))
+		{
+			return;
+		}
+
+		slot.readback.invalidate();
+		slot.encoding = true;
+		m_jobs->run(slot.encoded, [&slot]
+		{
+			std::span pixels{
+				static_cast<const std::byte*>(slot.readback.mappedData()),
+				static_cast<size_t>(slot.readback.size())
+			};
+			try
+			{
+				if (slot.fileFormat == ExportFormat::Png)
+				{
+					ImageFile::writePng(slot.path, slot.extent, pixels);
+				}
+				else
+				{
+					ImageFile::writeExr(slot.path, slot.extent, slot.format, pixels);
+				}
+			}
+			catch (std::exception& e)
+			{
+				slot.error = e.what();
+			}
+		});
+	}
+
+	bool DrawingExporter::retire(entt::registry& r, Slot& slot)
+	{
+		if (slot.drawing == entt::null) return true;
+		poll(slot, true);
+		m_jobs->wait(slot.encoded);
+		bool written = slot.error.empty();
+		if (written)
+		{
+			spdlog::info("Exported {}", slot.path.string());
+		}
+		else
+		{
+			spdlog::error("Failed to export {}: {}", slot.path.string(), slot.error);
+		}
+
+		release(r, slot.drawing);
+		slot.drawing = entt::null;
+		slot.encoding = false;
+		slot.error.clear();
+		return written;
+	}
+
+	size_t DrawingExporter::exportAll(entt::registry& r, const ExportOptions& options)
+	{
+		auto view = r.view<DrawingTag, ViewRectCpo>();
+		std::vector<entt::entity> drawings{view.begin(), view.end()};
+		std::filesystem::create_directories(options.output);
+		std::string stem = options.project.stem().string();
+		const char* extension = options.format == ExportFormat::Png ? "png" : "exr";
+
+		size_t failed = 0;
+		for (size_t i = 0; i < drawings.size(); ++i)
+		{
+			// Waits for the drawing this slot took a whole ring ago, usually done by now.
+			Slot& slot = *m_slots[i % m_slots.size()];
+			if (!retire(r, slot)) ++failed;
+			slot.path = options.output / fmt::format("{}_{}.{}", stem, i, extension);
+			try
+			{
+				record(r, slot, drawings[i], options);
+			}
+			catch (std::exception& e)
+			{
+				// Nothing was submitted, the slot stays free for the next drawing.
+				spdlog::error("Failed to export {}: {}", slot.path.string(), e.what());
+				slot.cb.reset();
+				release(r, drawings[i]);
+				++failed;
+			}
+			for (auto& other : m_slots)
+			{
+				poll(*other, false);
+			}
+		}
+		for (auto& slot : m_slots)
+		{
+			if (!retire(r, *slot)) ++failed;
+		}
+		return failed;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <filesystem>
+#include <span>
+
+#include "ArticulatedLine.hpp"
+#include "BrushTable.hpp"
+#include "Buffer.hpp"
+#include "CanvasDisplay.hpp"
+#include "Device.hpp"
+#include "FillRenderer.hpp"
+#include "JobSystem.hpp"
+#include "LayerRenderer.hpp"
+#include "Project.hpp"
+#include "RenderGraph.hpp"
+#include "StrokeAccumulator.hpp"
+#include "UploadScheduler.hpp"
+
+namespace ciallo
+{
+	enum class ExportFormat
+	{
+		Png, // 8 bit display image, sRGB encoded as shown in the canvas panel
+		Exr, // canvas in its own format, linear
+	};
+
+	struct ExportOptions
+	{
+		std::filesystem::path project; // .csnp snapshot, or project file otherwise
+		std::filesystem::path output = ".";
+		ExportFormat format = ExportFormat::Png;
+		uint32_t inFlight = 3; // drawings rendered at once
+		float dpi = 0.0f; // overrides dpi of drawings when positive
+
+		// Arguments after the program name, throws std::runtime_error on invalid ones.
+		static ExportOptions parse(std::span<char* const> args);
+		static const char* usage();
+	};
+
+	/**
+	 * \brief Renders every drawing of a project offscreen and writes one image per drawing, no window involved.
+	 * A ring of slots keeps several drawings in flight. Every slot owns its renderers, command buffer
+	 * and readback buffer, so recording a drawing never touches descriptor sets of one still on the GPU.
+	 * Finished slots are encoded on the job system while the GPU works on the others, and reused once encoded.
+	 * Canvas and layer targets of a drawing are released as soon as its slot retires.
+	 */
+	class DrawingExporter
+	{
+		struct Slot
+		{
+			std::unique_ptr<ArticulatedLineEngine> engine;
+			std::unique_ptr<StrokeAccumulator> accumulator;
+			std::unique_ptr<FillRenderer> fills;
+			std::unique_ptr<LayerRenderer> layers;
+			std::unique_ptr<CanvasDisplayPass> display;
+			std::unique_ptr<rendering::RenderGraph> graph; // transients of the drawing, fill stencil
+			vk::CommandBuffer cb;
+			vulkan::GpuPoint rendered; // on the device timeline
+			vulkan::Buffer readback; // host visible, persistently mapped, grows to the largest drawing
+
+			entt::entity drawing = entt::null;
+			std::filesystem::path path;
+			vk::Extent2D extent;
+			vk::Format format = vk::Format::eUndefined;
+			ExportFormat fileFormat = ExportFormat::Png;
+			bool encoding = false;
+			JobSystem::TaskGroup encoded;
+			std::string error; // written by the encoding job
+		};
+
+		vulkan::Device* m_device;
+		JobSystem* m_jobs;
+		std::unique_ptr<BrushTable> m_brushTable;
+		std::vector<std::unique_ptr<Slot>> m_slots;
+		// Destroyed first, it waits for copies into images of the renderers above.
+		UploadScheduler m_uploads;
+
+		void record(entt::registry& r, Slot& slot, entt::entity drawing, const ExportOptions& options);
+		// Start encoding once the GPU is done, without waiting.
+		void poll(Slot& slot, bool wait);
+		// Wait for GPU and encoding, then free the drawing. False when writing the image failed.
+		bool retire(entt::registry& r, Slot& slot);
+		static void release(entt::registry& r, entt::entity drawing);
+	public:
+		DrawingExporter(vulkan::Device* device, JobSystem* jobs, uint32_t inFlight);
+		DrawingExporter(const DrawingExporter& other) = delete;
+		DrawingExporter& operator=(const DrawingExporter& other) = delete;
+		~DrawingExporter();
+
+		/**
+		 * \brief Load a snapshot or project file for export.
+		 * Project files have no layers, ProjectFile::load puts their strokes into one layer of the first drawing.
+		 */
+		static Project load(const std::filesystem::path& path, JobSystem& jobs);
+		// Systems the renderers rely on are connected and updated once here, r is not edited afterwards.
+		void prepare(entt::registry& r);
+		// Returns count of drawings that failed to export, one failing does not stop the others.
+		size_t exportAll(entt::registry& r, const ExportOptions& options);
+	};
+}
@@ -0,0 +1,110 @@
+#include "pch.hpp"
+#include "DrawingList.hpp"
+
+#include "Device.hpp"
+#include "Drawing.hpp"
+#include "Thumbnail.hpp"
+
+namespace ciallo::gui
+{
+	entt::entity DrawingList::draw(entt::registry& r, entt::entity current, bool* open)
+	{
+		if (!ImGui::Begin("Drawings", open))
+		{
+			ImGui::End();
+			return entt::null;
+		}
+		entt::entity picked = entt::null;
+		const glm::vec2 size{static_cast<float>(ThumbnailBuilder::Size), static_cast<float>(ThumbnailBuilder::Size)};
+		int index = 0;
+		for (entt::entity drawing : r.view<DrawingTag>())
+		{
+			ImGui::PushID(static_cast<int>(drawing));
+			Texture* t = texture(r, drawing);
+			if (t && t->ready)
+			{
+				glm::vec2 extent{static_cast<float>(t->extent.width), static_cast<float>(t->extent.height)};
+				ImGui::Image(t->id, extent, {0.0f, 0.0f}, extent / size);
+			}
+			else
+			{
+				// Drawings never shown have no thumbnail yet.
+				ImGui::Dummy(size);
+			}
+			if (ImGui::IsItemClicked()) picked = drawing;
+			if (ImGui::Selectable(fmt::format("Drawing {}", ++index).c_str(), drawing == current)) picked = drawing;
+			ImGui::PopID();
+		}
+		ImGui::End();
+		return picked;
+	}
+
+	DrawingList::Texture* DrawingList::texture(entt::registry& r, entt::entity drawing)
+	{
+		auto* uploads = r.ctx().at<UploadScheduler*>();
+		auto it = m_textures.find(drawing);
+		if (it != m_textures.end() && it->second.ticket != 0) it->second.ready |= uploads->done(it->second.ticket);
+
+		auto* thumbnail = r.try_get<ThumbnailCpo>(drawing);
+		if (!thumbnail || thumbnail->pixels.empty()) return it != m_textures.end() ? &it->second : nullptr;
+		if (it != m_textures.end() && it->second.version == thumbnail->version) return &it->second;
+
+		if (it == m_textures.end())
+		{
+			// Take over the texture of a drawing that is gone, otherwise make one.
+			auto gone = ranges::find_if(m_textures, [&r](const auto& pair)
+			{
+				return !r.valid(pair.first) || !r.all_of<DrawingTag>(pair.first);
+			});
+			if (gone != m_textures.end())
+			{
+				Texture reused = std::move(gone->second);
+				m_textures.erase(gone);
+				it = m_textures.emplace(drawing, std::move(reused)).first;
+			}
+			else
+			{
+				auto* device = r.ctx().at<vulkan::Device*>();
+				if (!m_sampler)
+				{
+					vk::SamplerCreateInfo samplerCreateInfo{{}, vk::Filter::eLinear, vk::Filter::eLinear};
+					m_sampler = device->device().createSamplerUnique(samplerCreateInfo);
+				}
+				Texture created;
+				created.image = vulkan::Image(*device, vulkan::MemoryAuto, vk::Format::eR8G8B8A8Unorm,
+				                              ThumbnailBuilder::Size, ThumbnailBuilder::Size,
+				                              vk::SampleCountFlagBits::e1,
+				                              vk::ImageUsageFlagBits::eSampled |
+				                              vk::ImageUsageFlagBits::eTransferDst);
+				created.id = ImGui_ImplVulkan_AddTexture(*m_sampler, created.image.imageView(),
+				                                         VK_IMAGE_LAYOUT_GENERAL);
+				it = m_textures.emplace(drawing, std::move(created)).first;
+			}
+			// Contents belong to the previous drawing until the upload below lands.
+			it->second.ready = false;
+			it->second.ticket = 0;
+		}
+
+		Texture& t = it->second;
+		vk::Extent2D extent{
+			std::min(thumbnail->extent.width, ThumbnailBuilder::Size),
+			std::min(thumbnail->extent.height, ThumbnailBuilder::Size)
+		};
+		if (thumbnail->pixels.size() < static_cast<size_t>(thumbnail->extent.width) * thumbnail->extent.height * 4)
+		{
+			return &t;
+		}
+		// Upload takes the whole image tightly packed, rows of the thumbnail are padded to its width. It is flushed
+		// next frame after this one, the last to sample the old contents, is done.
+		std::vector<std::byte> padded(static_cast<size_t>(ThumbnailBuilder::Size) * ThumbnailBuilder::Size * 4);
+		for (uint32_t y : views::iota(0u, extent.height))
+		{
+			auto row = thumbnail->pixels.begin() + static_cast<ptrdiff_t>(y) * thumbnail->extent.width * 4;
+			std::copy_n(row, extent.width * 4, padded.begin() + static_cast<ptrdiff_t>(y) * ThumbnailBuilder::Size * 4);
+		}
+		t.ticket = uploads->upload(t.image, padded);
+		t.extent = extent;
+		t.version = thumbnail->version;
+		return &t;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <chrono>
+#include <unordered_map>
+
+#include "Image.hpp"
+#include "UploadScheduler.hpp"
+
+namespace ciallo::gui
+{
+	/**
+	 * \brief Window listing every drawing of the project by its thumbnail.
+	 * Thumbnails are only built while the window is open, see ThumbnailBuilder.
+	 */
+	class DrawingList
+	{
+		// Host thumbnail copied to the GPU for ImGui, fixed size so its descriptor set is never replaced.
+		struct Texture
+		{
+			vulkan::Image image;
+			ImTextureID id = nullptr;
+			vk::Extent2D extent; // of the thumbnail in the top left of image
+			uint32_t version = 0; // of the thumbnail uploaded last
+			UploadScheduler::Ticket ticket = 0;
+			bool ready = false; // image was filled once, before that it has no layout to sample
+		};
+
+		vk::UniqueSampler m_sampler;
+		// By drawing, textures of destroyed drawings are reused by new ones.
+		std::unordered_map<entt::entity, Texture> m_textures;
+
+		Texture* texture(entt::registry& r, entt::entity drawing);
+	public:
+		// Returns the drawing clicked this frame, null otherwise.
+		entt::entity draw(entt::registry& r, entt::entity current, bool* open);
+	};
+}
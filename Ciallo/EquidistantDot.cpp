@@ -22,16 +22,14 @@ namespace ciallo
 		genAuxiliaryBuffer(*device);
 		genCompDescriptorSet(device->descriptorPool());
 		genCompPipeline();
-		genPipelineDynamic();
+		genPipelineDynamic(device->physicalDevice());
 	}
 
-	void EquidistantDotEngine::genPipelineDynamic()
+	void EquidistantDotEngine::genPipelineDynamic(vk::PhysicalDevice physicalDevice)
 	{
 		vku::PipelineLayoutMaker layoutMaker;
 		m_pipelineLayout = layoutMaker.createUnique(m_device);
 
-		std::vector<vk::Format> colorAttachmentsFormats{vk::Format::eR8G8B8A8Unorm};
-		vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
 		vku::PipelineMaker maker;
 		maker.topology(vk::PrimitiveTopology::eLineStrip)
 		     .dynamicState(vk::DynamicState::eViewport)
@@ -45,7 +43,13 @@ namespace ciallo
 		     .vertexAttribute(0, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, pos))
 		     .vertexAttribute(1, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Vertex, color))
 		     .vertexAttribute(2, 0, vk::Format::eR32Sfloat, offsetof(Vertex, width));
-		m_pipeline = maker.createUnique(m_device, nullptr, *m_pipelineLayout, renderingCreateInfo);
+		for (CanvasFormat format : supportedCanvasFormats(physicalDevice))
+		{
+			std::vector colorAttachmentsFormats{toVkFormat(format)};
+			vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
+			m_pipelines[toVkFormat(format)] = maker.createUnique(m_device, nullptr, *m_pipelineLayout,
+			                                                     renderingCreateInfo);
+		}
 	}
 
 	void EquidistantDotEngine::genCompDescriptorSet(vk::DescriptorPool pool)
@@ -89,7 +93,12 @@ namespace ciallo
 
 	void EquidistantDotEngine::renderDynamic(vk::CommandBuffer cb, const vulkan::Image* target)
 	{
-		m_inputBuffer.uploadLocal(vertices.data(), VK_WHOLE_SIZE);
+		std::vector<Vertex> uploaded = vertices;
+		for (Vertex& v : uploaded)
+		{
+			v.color = canvasColor(fromVkFormat(target->format()), v.color);
+		}
+		m_inputBuffer.uploadLocal(uploaded.data(), VK_WHOLE_SIZE);
 		m_tempBufferForSpacing.uploadLocal(&spacing, VK_WHOLE_SIZE);
 		compute(cb);
 		vk::MemoryBarrier2 drawIndirectBarrier{
@@ -117,7 +126,7 @@ namespace ciallo
 		cb.setScissor(0, zeroScissor);
 		std::vector<vk::Buffer> vertexBuffers{m_vertBuffer};
 		cb.bindVertexBuffers(0, vertexBuffers, {0});
-		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *m_pipeline);
+		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *m_pipelines.at(target->format()));
 		cb.drawIndirect(m_indirectDrawBuffer, 0, 1, {});
 		cb.endRendering();
 	}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "CanvasFormat.hpp"
 #include "Device.hpp"
 #include "Image.hpp"
 #include "ShaderModule.hpp"
@@ -23,7 +24,8 @@ namespace ciallo
 		vulkan::ShaderModule m_fragShader;
 		vulkan::ShaderModule m_geomShader;
 		vk::UniquePipelineLayout m_pipelineLayout;
-		vk::UniquePipeline m_pipeline;
+		// One per canvas format.
+		std::unordered_map<vk::Format, vk::UniquePipeline> m_pipelines;
 
 		vulkan::Buffer m_indirectDrawBuffer;
 		vulkan::Buffer m_vertBuffer; // a large buffer for compute shader to output
@@ -39,7 +41,7 @@ namespace ciallo
 		float spacing = 0.02f;
 		explicit EquidistantDotEngine(vulkan::Device* device);
 
-		void genPipelineDynamic();
+		void genPipelineDynamic(vk::PhysicalDevice physicalDevice);
 
 		void genCompDescriptorSet(vk::DescriptorPool pool);
 		void genCompPipeline();
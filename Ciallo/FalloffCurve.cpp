@@ -0,0 +1,131 @@
+#include "pch.hpp"
+#include "FalloffCurve.hpp"
+
+#include "Brush.hpp"
+#include "Device.hpp"
+#include "vku.hpp"
+
+namespace ciallo
+{
+	geom::Bezier<3> FalloffCurveCpo::curve() const
+	{
+		std::array<geom::Point, 4> points;
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			points[i] = geom::Point{controlPoints[i].x, controlPoints[i].y};
+		}
+		return {points.begin(), points.end()};
+	}
+
+	void FalloffLutBaker::markPending(entt::registry& r, entt::entity e)
+	{
+		pending.push_back(e);
+	}
+
+	void FalloffLutBaker::connect(entt::registry& r)
+	{
+		ob.connect(r, entt::collector
+		              .group<BrushTag, FalloffCurveCpo>().update<FalloffCurveCpo>().where<BrushTag>()
+		              .group<BrushTag, AirbrushCpo>().update<AirbrushCpo>().where<BrushTag>());
+		// Still there when signaled, update() sees what is left.
+		r.on_destroy<FalloffCurveCpo>().connect<&FalloffLutBaker::markPending>();
+		r.on_destroy<AirbrushCpo>().connect<&FalloffLutBaker::markPending>();
+		for (entt::entity e : r.view<BrushTag>())
+		{
+			pending.push_back(e);
+		}
+		auto* device = r.ctx().at<vulkan::Device*>();
+		r.ctx().emplace<Sampler>(vku::SamplerMaker()
+		                         .magFilter(vk::Filter::eLinear)
+		                         .minFilter(vk::Filter::eLinear)
+		                         .addressModeU(vk::SamplerAddressMode::eClampToEdge)
+		                         .createUnique(device->device()));
+	}
+
+	vk::Sampler FalloffLutBaker::sampler(const entt::registry& r)
+	{
+		return *r.ctx().at<Sampler>().sampler;
+	}
+
+	void FalloffLutBaker::update(entt::registry& r)
+	{
+		if (ob.empty() && pending.empty()) return;
+		auto* device = r.ctx().at<vulkan::Device*>();
+		auto* uploads = r.ctx().at<UploadScheduler*>();
+		std::vector<entt::entity> changed{ob.begin(), ob.end()};
+		changed.insert(changed.end(), pending.begin(), pending.end());
+		ob.clear();
+		pending.clear();
+		for (entt::entity e : changed)
+		{
+			if (!r.valid(e) || !r.all_of<BrushTag>(e)) continue;
+			auto* curve = r.try_get<FalloffCurveCpo>(e);
+			auto* airbrush = r.try_get<AirbrushCpo>(e);
+			if (!curve && !airbrush)
+			{
+				r.remove<FalloffLutCpo>(e);
+				continue;
+			}
+			std::optional<float> hardness;
+			if (airbrush) hardness = airbrush->hardness;
+			auto values = bake((curve ? *curve : FalloffCurveCpo{}).curve(), hardness);
+			auto* cached = r.try_get<FalloffLutCpo>(e);
+			if (!cached)
+			{
+				cached = &r.emplace<FalloffLutCpo>(e, createLut(*device));
+			}
+			upload(*uploads, cached->lut, values);
+		}
+	}
+
+	std::vector<float> FalloffLutBaker::bake(const geom::Bezier<3>& curve, std::optional<float> hardness,
+	                                         uint32_t resolution)
+	{
+		// Dense samples over t, x is forced to be monotonic so every texel finds one span.
+		const uint32_t sampleCount = resolution * 4;
+		std::vector<glm::vec2> samples(sampleCount + 1);
+		float maxX = 0.0f;
+		for (uint32_t i = 0; i <= sampleCount; ++i)
+		{
+			geom::Point p = curve(static_cast<float>(i) / static_cast<float>(sampleCount));
+			maxX = glm::max(maxX, p.x());
+			samples[i] = {maxX, p.y()};
+		}
+
+		std::vector<float> values(resolution);
+		size_t span = 0;
+		for (uint32_t i = 0; i < resolution; ++i)
+		{
+			float x = static_cast<float>(i) / static_cast<float>(resolution - 1);
+			// Monotonic in x as well, spans are still found going forward.
+			if (hardness) x = 1.0f - glm::pow(1.0f - x, glm::mix(0.01f, 10.0f, 1.0f - *hardness));
+			while (span + 2 < samples.size() && samples[span + 1].x < x) ++span;
+			glm::vec2 a = samples[span], b = samples[span + 1];
+			float t = b.x > a.x ? glm::clamp((x - a.x) / (b.x - a.x), 0.0f, 1.0f) : 1.0f;
+			values[i] = glm::clamp(glm::mix(a.y, b.y, t), 0.0f, 1.0f);
+		}
+		return values;
+	}
+
+	vulkan::Image FalloffLutBaker::createLut(VmaAllocator allocator, uint32_t resolution)
+	{
+		vk::ImageCreateInfo info{};
+		info.imageType = vk::ImageType::e1D;
+		info.format = Format;
+		info.extent = vk::Extent3D{resolution, 1u, 1u};
+		info.mipLevels = 1;
+		info.arrayLayers = 1;
+		info.samples = vk::SampleCountFlagBits::e1;
+		info.tiling = vk::ImageTiling::eOptimal;
+		info.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+		info.sharingMode = vk::SharingMode::eExclusive;
+		info.initialLayout = vk::ImageLayout::eUndefined;
+		return vulkan::Image(allocator, vulkan::MemoryAuto, info);
+	}
+
+	UploadScheduler::Ticket FalloffLutBaker::upload(UploadScheduler& uploads, vulkan::Image& lut,
+	                                                const std::vector<float>& values)
+	{
+		return uploads.upload(lut, std::as_bytes(std::span(values)));
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Bezier.hpp"
+#include "Image.hpp"
+#include "UploadScheduler.hpp"
+
+namespace ciallo
+{
+	/**
+	 * \brief Falloff of a brush, x is distance to the stroke axis in radius, y is alpha.
+	 * Cubic bezier from (0, 1) to (1, 0), inner control points are user editable. x should not go backward.
+	 */
+	struct FalloffCurveCpo
+	{
+		std::array<glm::vec2, 4> controlPoints = {
+			glm::vec2{0.0f, 1.0f}, glm::vec2{0.6f, 1.0f}, glm::vec2{0.4f, 0.0f}, glm::vec2{1.0f, 0.0f}
+		};
+
+		geom::Bezier<3> curve() const;
+		bool operator==(const FalloffCurveCpo& other) const = default;
+	};
+
+	/**
+	 * \brief FalloffCurveCpo baked into a 1D texture, on brush. Cached until the curve or hardness changes.
+	 * Airbrushes always have one, with their hardness baked in, the default curve if they have none.
+	 */
+	struct FalloffLutCpo
+	{
+		vulkan::Image lut;
+	};
+
+	/**
+	 * \brief Bake falloff curves into FalloffLutCpo, so fragment shaders read one texel pair instead of
+	 * evaluating the curve and the hardness remapping.
+	 */
+	struct FalloffLutBaker
+	{
+		constexpr static uint32_t Resolution = 256;
+		constexpr static vk::Format Format = vk::Format::eR32Sfloat;
+
+		// Linear, clamped to edge. Lives in registry ctx.
+		struct Sampler
+		{
+			vk::UniqueSampler sampler;
+		};
+
+		static inline entt::observer ob;
+		// Brushes the observer can't see: existing ones at connect, and removal of a curve or airbrush.
+		static inline std::vector<entt::entity> pending;
+
+		static void markPending(entt::registry& r, entt::entity e);
+
+		static void connect(entt::registry& r);
+		/**
+		 * \brief Bake brushes with changed curves, uploaded through UploadScheduler in ctx.
+		 * Call while the LUTs are not read and before the frame sampling them acquires its uploads.
+		 */
+		static void update(entt::registry& r);
+		static vk::Sampler sampler(const entt::registry& r);
+
+		/**
+		 * \brief Alpha at distance x = i / (resolution - 1) for texel i.
+		 * With hardness, an airbrush's, the curve is read at 1 - (1 - x)^mix(0.01, 10, 1 - hardness) instead.
+		 */
+		static std::vector<float> bake(const geom::Bezier<3>& curve, std::optional<float> hardness = {},
+		                               uint32_t resolution = Resolution);
+		static vulkan::Image createLut(VmaAllocator allocator, uint32_t resolution = Resolution);
+		// Leaves lut in general layout once the ticket is done.
+		static UploadScheduler::Ticket upload(UploadScheduler& uploads, vulkan::Image& lut,
+		                                      const std::vector<float>& values);
+	};
+}
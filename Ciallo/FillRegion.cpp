@@ -0,0 +1,968 @@
+#include "pch.hpp"
+#include "FillRegion.hpp"
+
+#include <bit>
+#include <chrono>
+#include <map>
+#include <numeric>
+#include <queue>
+#include <set>
+
+#include "CanvasInteraction.hpp"
+#include "Drawing.hpp"
+#include "Layer.hpp"
+#include "LayerRenderer.hpp"
+#include "Simplification.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo::geom
+{
+	namespace
+	{
+		constexpr double VertexQuantum = 1e-7; // meter, graph vertices closer than it are merged
+		constexpr double ParameterEpsilon = 1e-9;
+
+		glm::dvec2 toDvec2(const Point& p)
+		{
+			return {p.x(), p.y()};
+		}
+
+		double cross(glm::dvec2 a, glm::dvec2 b)
+		{
+			return a.x * b.y - a.y * b.x;
+		}
+
+		double shoelace(const std::vector<glm::dvec2>& polygon)
+		{
+			double area = 0.0;
+			for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+			{
+				area += cross(polygon[j], polygon[i]);
+			}
+			return area * 0.5;
+		}
+
+		// Even-odd rule, points on the boundary go either way.
+		template <typename P, typename ToDvec2>
+		bool insidePolygon(const std::vector<P>& polygon, glm::dvec2 p, ToDvec2 toDvec2)
+		{
+			bool inside = false;
+			for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+			{
+				glm::dvec2 a = toDvec2(polygon[i]), b = toDvec2(polygon[j]);
+				if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x)
+				{
+					inside = !inside;
+				}
+			}
+			return inside;
+		}
+
+		std::vector<Point> toPoints(const std::vector<glm::dvec2>& polygon)
+		{
+			return polygon | views::transform([](glm::dvec2 p)
+			{
+				return Point{static_cast<float>(p.x), static_cast<float>(p.y)};
+			}) | ranges::to_vector;
+		}
+	}
+
+	RegionFinder::RegionFinder(glm::vec2 domainMin, glm::vec2 domainMax, const Settings& settings):
+		m_settings(settings), m_domainMin(domainMin), m_domainMax(domainMax)
+	{
+		m_domainMax.x = std::max(m_domainMax.x, m_domainMin.x + 1e-6);
+		m_settings.slabCount = std::max(m_settings.slabCount, 1u);
+	}
+
+	void RegionFinder::reset(const Settings& settings)
+	{
+		m_settings = settings;
+		m_settings.slabCount = std::max(m_settings.slabCount, 1u);
+		m_slabCrossings.clear();
+		m_ranges.clear();
+		m_bridges.clear();
+	}
+
+	uint32_t RegionFinder::slabOf(double x) const
+	{
+		double slab = (x - m_domainMin.x) / (m_domainMax.x - m_domainMin.x) * m_settings.slabCount;
+		return static_cast<uint32_t>(std::clamp(slab, 0.0, m_settings.slabCount - 1.0));
+	}
+
+	std::vector<RegionFinder::Segment> RegionFinder::bridgeGaps(std::span<const Polyline> polylines) const
+	{
+		const double gap = m_settings.gap;
+		if (gap <= 0.0) return {};
+
+		struct End
+		{
+			glm::dvec2 p;
+			uint64_t id; // polyline id << 1 | back
+			uint32_t polyline;
+		};
+
+		// Closed polylines have nothing to bridge.
+		std::vector<End> ends;
+		for (uint32_t i = 0; i < polylines.size(); ++i)
+		{
+			std::span<const Point> points = polylines[i].points;
+			if (points.size() < 2 || points.front() == points.back()) continue;
+			uint64_t id = static_cast<uint64_t>(polylines[i].id) << 1;
+			ends.push_back({toDvec2(points.front()), id, i});
+			ends.push_back({toDvec2(points.back()), id | 1u, i});
+		}
+
+		// Uniform grid of cell size gap, every end only looks at 3x3 cells around it.
+		auto cellOf = [gap](glm::dvec2 p)
+		{
+			return glm::i64vec2(glm::floor(p / gap));
+		};
+		auto cellKey = [](glm::i64vec2 cell)
+		{
+			return static_cast<uint64_t>(static_cast<uint32_t>(cell.x)) << 32 | static_cast<uint32_t>(cell.y);
+		};
+		std::unordered_map<uint64_t, std::vector<uint32_t>> grid;
+		for (uint32_t i = 0; i < ends.size(); ++i)
+		{
+			grid[cellKey(cellOf(ends[i].p))].push_back(i);
+		}
+
+		std::vector<Segment> bridges;
+		for (const End& end : ends)
+		{
+			const End* nearest = nullptr;
+			double nearestDistance = gap;
+			glm::i64vec2 cell = cellOf(end.p);
+			for (int64_t dy = -1; dy <= 1; ++dy)
+			{
+				for (int64_t dx = -1; dx <= 1; ++dx)
+				{
+					auto it = grid.find(cellKey(cell + glm::i64vec2(dx, dy)));
+					if (it == grid.end()) continue;
+					for (uint32_t j : it->second)
+					{
+						const End& other = ends[j];
+						if (other.id == end.id) continue;
+						// A single segment closing on itself encloses nothing.
+						if (other.polyline == end.polyline && polylines[end.polyline].points.size() < 3) continue;
+						double distance = glm::distance(end.p, other.p);
+						// Touching ends are joined by the graph already.
+						if (distance == 0.0 || distance >= nearestDistance) continue;
+						nearest = &other;
+						nearestDistance = distance;
+					}
+				}
+			}
+			if (!nearest) continue;
+			const End& first = end.id < nearest->id ? end : *nearest;
+			const End& second = end.id < nearest->id ? *nearest : end;
+			bridges.push_back({first.p, second.p, {BridgeFlag | first.id, second.id}});
+		}
+		// Ends nearest to each other find the same bridge twice.
+		std::ranges::sort(bridges, {}, &Segment::key);
+		auto duplicates = std::ranges::unique(bridges, {}, &Segment::key);
+		bridges.erase(duplicates.begin(), duplicates.end());
+		return bridges;
+	}
+
+	std::vector<RegionFinder::Crossing> RegionFinder::sweep(uint32_t slab, std::vector<uint32_t>& segments) const
+	{
+		auto minX = [this](uint32_t i) { return std::min(m_segments[i].a.x, m_segments[i].b.x); };
+		auto maxX = [this](uint32_t i) { return std::max(m_segments[i].a.x, m_segments[i].b.x); };
+		auto minY = [this](uint32_t i) { return std::min(m_segments[i].a.y, m_segments[i].b.y); };
+		auto maxY = [this](uint32_t i) { return std::max(m_segments[i].a.y, m_segments[i].b.y); };
+		std::ranges::sort(segments, {}, minX);
+
+		// Active segments ordered by lower y. One reaching down to y starts at most the tallest height below it,
+		// so a segment only visits the y window it overlaps instead of every active segment.
+		std::vector<Crossing> crossings;
+		std::set<std::pair<double, uint32_t>> active;
+		std::multiset<double> heights;
+		std::priority_queue<std::pair<double, uint32_t>, std::vector<std::pair<double, uint32_t>>, std::greater<>>
+			leaving; // by max x
+		for (uint32_t i : segments)
+		{
+			const Segment& s = m_segments[i];
+			double x = minX(i);
+			while (!leaving.empty() && leaving.top().first < x)
+			{
+				uint32_t j = leaving.top().second;
+				leaving.pop();
+				active.erase({minY(j), j});
+				heights.erase(heights.find(maxY(j) - minY(j)));
+			}
+			glm::dvec2 d0 = s.b - s.a;
+			double bottom = minY(i), top = maxY(i);
+			double reach = heights.empty() ? 0.0 : *heights.rbegin();
+			for (auto it = active.lower_bound({bottom - reach, 0u}); it != active.end() && it->first <= top; ++it)
+			{
+				uint32_t j = it->second;
+				const Segment& other = m_segments[j];
+				if (maxY(j) < bottom) continue;
+				// Neighbours in a polyline only meet at their shared vertex.
+				bool strokes = !(s.key.a & BridgeFlag) && !(other.key.a & BridgeFlag);
+				if (strokes && s.key.a == other.key.a && (s.key.b == other.key.b + 1 || other.key.b == s.key.b + 1))
+					continue;
+
+				glm::dvec2 d1 = other.b - other.a;
+				double denominator = cross(d0, d1);
+				// Parallel, overlapping collinear segments add no vertex of their own.
+				if (std::abs(denominator) <= 1e-12 * glm::length(d0) * glm::length(d1)) continue;
+				glm::dvec2 offset = other.a - s.a;
+				double t0 = cross(offset, d1) / denominator;
+				double t1 = cross(offset, d0) / denominator;
+				if (t0 < -ParameterEpsilon || t0 > 1.0 + ParameterEpsilon || t1 < -ParameterEpsilon ||
+					t1 > 1.0 + ParameterEpsilon)
+					continue;
+				t0 = std::clamp(t0, 0.0, 1.0);
+				t1 = std::clamp(t1, 0.0, 1.0);
+				// Crossings at endpoints snap onto them, so they end up as the same graph vertex.
+				glm::dvec2 point = s.a + t0 * d0;
+				if (t0 < ParameterEpsilon) point = s.a;
+				else if (t0 > 1.0 - ParameterEpsilon) point = s.b;
+				else if (t1 < ParameterEpsilon) point = other.a;
+				else if (t1 > 1.0 - ParameterEpsilon) point = other.b;
+				// A crossing belongs to one slab, even if both segments span several.
+				if (slabOf(point.x) != slab) continue;
+				crossings.push_back({s.key, other.key, t0, t1, point});
+			}
+			active.emplace(bottom, i);
+			heights.insert(top - bottom);
+			leaving.emplace(maxX(i), i);
+		}
+		return crossings;
+	}
+
+	std::vector<Region> RegionFinder::find(std::span<const Polyline> polylines, std::span<const uint32_t> changed,
+	                                       JobSystem& jobs)
+	{
+		const uint32_t slabCount = m_settings.slabCount;
+		bool full = m_slabCrossings.empty();
+		if (full) m_slabCrossings.resize(slabCount);
+		std::vector<bool> dirty(slabCount, full);
+		auto markDirty = [&](glm::dvec2 range)
+		{
+			for (uint32_t slab = slabOf(range.x); slab <= slabOf(range.y); ++slab) dirty[slab] = true;
+		};
+
+		std::unordered_map<uint32_t, glm::dvec2> xRanges;
+		for (const Polyline& polyline : polylines)
+		{
+			if (polyline.points.empty()) continue;
+			glm::dvec2 range{std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest()};
+			for (const Point& p : polyline.points)
+			{
+				range = {std::min<double>(range.x, p.x()), std::max<double>(range.y, p.x())};
+			}
+			xRanges.emplace(polyline.id, range);
+		}
+		std::vector<Segment> bridges = bridgeGaps(polylines);
+
+		if (!full)
+		{
+			// Old extent of a changed polyline loses its crossings, new extent gains new ones.
+			for (uint32_t id : changed)
+			{
+				if (auto it = m_ranges.find(id); it != m_ranges.end()) markDirty(it->second);
+				if (auto it = xRanges.find(id); it != xRanges.end()) markDirty(it->second);
+			}
+			// Bridges appearing, vanishing or moving, both lists are sorted by key.
+			auto bridgeRange = [](const Segment& s)
+			{
+				return glm::dvec2{std::min(s.a.x, s.b.x), std::max(s.a.x, s.b.x)};
+			};
+			auto prev = m_bridges.begin(), curr = bridges.begin();
+			while (prev != m_bridges.end() || curr != bridges.end())
+			{
+				if (curr == bridges.end() || (prev != m_bridges.end() && prev->key < curr->key))
+				{
+					markDirty(bridgeRange(*prev++));
+				}
+				else if (prev == m_bridges.end() || curr->key < prev->key)
+				{
+					markDirty(bridgeRange(*curr++));
+				}
+				else
+				{
+					if (prev->a != curr->a || prev->b != curr->b)
+					{
+						markDirty(bridgeRange(*prev));
+						markDirty(bridgeRange(*curr));
+					}
+					++prev;
+					++curr;
+				}
+			}
+		}
+		m_ranges = std::move(xRanges);
+		m_bridges = bridges;
+
+		m_segments.clear();
+		for (const Polyline& polyline : polylines)
+		{
+			for (uint32_t i = 1; i < polyline.points.size(); ++i)
+			{
+				if (polyline.points[i - 1] == polyline.points[i]) continue;
+				SegmentKey key{polyline.id, i - 1};
+				m_segments.push_back({toDvec2(polyline.points[i - 1]), toDvec2(polyline.points[i]), key});
+			}
+		}
+		m_segments.insert(m_segments.end(), bridges.begin(), bridges.end());
+
+		// Clean slabs keep their crossings, segments in them are unchanged.
+		std::vector<std::vector<uint32_t>> buckets(slabCount);
+		for (uint32_t i = 0; i < m_segments.size(); ++i)
+		{
+			const Segment& s = m_segments[i];
+			uint32_t last = slabOf(std::max(s.a.x, s.b.x));
+			for (uint32_t slab = slabOf(std::min(s.a.x, s.b.x)); slab <= last; ++slab)
+			{
+				if (dirty[slab]) buckets[slab].push_back(i);
+			}
+		}
+		std::vector<uint32_t> dirtySlabs;
+		for (uint32_t slab = 0; slab < slabCount; ++slab)
+		{
+			if (dirty[slab]) dirtySlabs.push_back(slab);
+		}
+		jobs.parallelFor(dirtySlabs.size(), [&](size_t i)
+		{
+			uint32_t slab = dirtySlabs[i];
+			m_slabCrossings[slab] = sweep(slab, buckets[slab]);
+		}, 1);
+
+		return trace(jobs);
+	}
+
+	std::vector<Region> RegionFinder::trace(JobSystem& jobs) const
+	{
+		std::unordered_map<SegmentKey, uint32_t, SegmentKeyHash> indexOf;
+		for (uint32_t i = 0; i < m_segments.size(); ++i)
+		{
+			indexOf.emplace(m_segments[i].key, i);
+		}
+		std::vector<std::vector<std::pair<double, glm::dvec2>>> splits(m_segments.size());
+		for (const std::vector<Crossing>& crossings : m_slabCrossings)
+		{
+			for (const Crossing& c : crossings)
+			{
+				auto it0 = indexOf.find(c.s0), it1 = indexOf.find(c.s1);
+				if (it0 == indexOf.end() || it1 == indexOf.end()) continue;
+				splits[it0->second].emplace_back(c.t0, c.point);
+				splits[it1->second].emplace_back(c.t1, c.point);
+			}
+		}
+		jobs.parallelFor(splits.size(), [&splits](size_t i)
+		{
+			std::ranges::sort(splits[i], {}, &std::pair<double, glm::dvec2>::first);
+		});
+
+		// Planar graph of segments split at crossings.
+		std::vector<glm::dvec2> vertices;
+		std::vector<std::vector<uint32_t>> adjacency;
+		std::map<std::pair<int64_t, int64_t>, uint32_t> vertexIds;
+		auto vertexOf = [&](glm::dvec2 p)
+		{
+			std::pair key{std::llround(p.x / VertexQuantum), std::llround(p.y / VertexQuantum)};
+			auto [it, inserted] = vertexIds.try_emplace(key, static_cast<uint32_t>(vertices.size()));
+			if (inserted)
+			{
+				vertices.push_back(p);
+				adjacency.emplace_back();
+			}
+			return it->second;
+		};
+		auto addEdge = [&](uint32_t u, uint32_t v)
+		{
+			if (u == v || std::ranges::find(adjacency[u], v) != adjacency[u].end()) return;
+			adjacency[u].push_back(v);
+			adjacency[v].push_back(u);
+		};
+		for (uint32_t i = 0; i < m_segments.size(); ++i)
+		{
+			uint32_t prev = vertexOf(m_segments[i].a);
+			for (const auto& [t, point] : splits[i])
+			{
+				uint32_t v = vertexOf(point);
+				addEdge(prev, v);
+				prev = v;
+			}
+			addEdge(prev, vertexOf(m_segments[i].b));
+		}
+
+		// Dangling edges bound nothing.
+		std::vector<uint32_t> degree = adjacency | views::transform([](const std::vector<uint32_t>& neighbours)
+		{
+			return static_cast<uint32_t>(neighbours.size());
+		}) | ranges::to_vector;
+		std::vector<bool> pruned(vertices.size(), false);
+		std::vector<uint32_t> stack;
+		for (uint32_t v = 0; v < vertices.size(); ++v)
+		{
+			if (degree[v] <= 1) stack.push_back(v);
+		}
+		while (!stack.empty())
+		{
+			uint32_t v = stack.back();
+			stack.pop_back();
+			if (pruned[v]) continue;
+			pruned[v] = true;
+			for (uint32_t n : adjacency[v])
+			{
+				if (!pruned[n] && --degree[n] <= 1) stack.push_back(n);
+			}
+		}
+
+		// Neighbours counterclockwise by angle.
+		jobs.parallelFor(adjacency.size(), [&](size_t v)
+		{
+			std::vector<uint32_t>& neighbours = adjacency[v];
+			if (pruned[v])
+			{
+				neighbours.clear();
+				return;
+			}
+			std::erase_if(neighbours, [&pruned](uint32_t n) { return pruned[n]; });
+			std::ranges::sort(neighbours, {}, [&](uint32_t n)
+			{
+				glm::dvec2 d = vertices[n] - vertices[v];
+				return std::atan2(d.y, d.x);
+			});
+		});
+
+		// Every half edge is walked once, turning clockwise-most at each vertex keeps the face on the left.
+		// Bounded faces come out counterclockwise, outer boundaries of connected components clockwise.
+		std::vector<uint32_t> offsets(vertices.size() + 1, 0);
+		for (uint32_t v = 0; v < vertices.size(); ++v)
+		{
+			offsets[v + 1] = offsets[v] + static_cast<uint32_t>(adjacency[v].size());
+		}
+		std::vector<bool> visited(offsets.back(), false);
+		std::vector<std::vector<glm::dvec2>> outers, holes;
+		std::vector<double> outerAreas, holeAreas;
+		for (uint32_t u = 0; u < vertices.size(); ++u)
+		{
+			for (uint32_t k = 0; k < adjacency[u].size(); ++k)
+			{
+				if (visited[offsets[u] + k]) continue;
+				std::vector<glm::dvec2> cycle;
+				uint32_t cu = u, ck = k;
+				do
+				{
+					visited[offsets[cu] + ck] = true;
+					cycle.push_back(vertices[cu]);
+					uint32_t v = adjacency[cu][ck];
+					const std::vector<uint32_t>& neighbours = adjacency[v];
+					auto back = static_cast<uint32_t>(std::ranges::find(neighbours, cu) - neighbours.begin());
+					ck = (back + static_cast<uint32_t>(neighbours.size()) - 1) % neighbours.size();
+					cu = v;
+				}
+				while (!visited[offsets[cu] + ck]);
+
+				double area = shoelace(cycle);
+				if (area > m_settings.minArea)
+				{
+					outers.push_back(std::move(cycle));
+					outerAreas.push_back(area);
+				}
+				else if (area < -m_settings.minArea)
+				{
+					holes.push_back(std::move(cycle));
+					holeAreas.push_back(-area);
+				}
+			}
+		}
+
+		// A component boundary is a hole of the smallest face around it. Probe just left of its first edge,
+		// which is outside of the component.
+		std::vector<int32_t> owners(holes.size(), -1);
+		jobs.parallelFor(holes.size(), [&](size_t h)
+		{
+			const std::vector<glm::dvec2>& hole = holes[h];
+			glm::dvec2 d = hole[1] - hole[0];
+			glm::dvec2 probe = (hole[0] + hole[1]) * 0.5 + glm::dvec2(-d.y, d.x) / glm::length(d) * VertexQuantum;
+			double smallest = std::numeric_limits<double>::max();
+			for (size_t i = 0; i < outers.size(); ++i)
+			{
+				if (outerAreas[i] <= holeAreas[h] || outerAreas[i] >= smallest) continue;
+				if (!insidePolygon(outers[i], probe, std::identity{})) continue;
+				owners[h] = static_cast<int32_t>(i);
+				smallest = outerAreas[i];
+			}
+		});
+
+		std::vector<Region> regions = outers | views::transform([](const std::vector<glm::dvec2>& outer)
+		{
+			return Region{toPoints(outer), {}};
+		}) | ranges::to_vector;
+		for (size_t h = 0; h < holes.size(); ++h)
+		{
+			if (owners[h] >= 0) regions[owners[h]].holes.push_back(toPoints(holes[h]));
+		}
+		return regions;
+	}
+
+	std::optional<Tessellation> earClip(std::span<const Point> polygon)
+	{
+		if (polygon.size() < 3) return std::nullopt;
+		std::vector<glm::dvec2> p = polygon | views::transform(toDvec2) | ranges::to_vector;
+		auto insideTriangle = [&p](uint32_t a, uint32_t b, uint32_t c, uint32_t q)
+		{
+			if (p[q] == p[a] || p[q] == p[b] || p[q] == p[c]) return false;
+			return cross(p[b] - p[a], p[q] - p[a]) >= 0.0 && cross(p[c] - p[b], p[q] - p[b]) >= 0.0 &&
+				cross(p[a] - p[c], p[q] - p[c]) >= 0.0;
+		};
+
+		Tessellation tessellation;
+		tessellation.vertices.assign(polygon.begin(), polygon.end());
+		std::vector<uint32_t> remaining(polygon.size());
+		std::iota(remaining.begin(), remaining.end(), 0u);
+		// Walk around the polygon clipping ears, a full round without one means there is none.
+		size_t k = 0, misses = 0;
+		while (remaining.size() > 3)
+		{
+			size_t m = remaining.size();
+			if (misses >= m) return std::nullopt;
+			k %= m;
+			uint32_t a = remaining[(k + m - 1) % m], b = remaining[k], c = remaining[(k + 1) % m];
+			bool ear = cross(p[b] - p[a], p[c] - p[b]) > 0.0 && std::ranges::none_of(remaining, [&](uint32_t q)
+			{
+				return q != a && q != b && q != c && insideTriangle(a, b, c, q);
+			});
+			if (!ear)
+			{
+				++k;
+				++misses;
+				continue;
+			}
+			tessellation.indices.insert(tessellation.indices.end(), {a, b, c});
+			remaining.erase(remaining.begin() + static_cast<ptrdiff_t>(k));
+			misses = 0;
+		}
+		tessellation.indices.insert(tessellation.indices.end(), remaining.begin(), remaining.end());
+		return tessellation;
+	}
+
+	Tessellation stencilFan(const Region& region)
+	{
+		Tessellation tessellation;
+		auto addRing = [&tessellation](const std::vector<Point>& ring)
+		{
+			auto base = static_cast<uint32_t>(tessellation.vertices.size());
+			auto n = static_cast<uint32_t>(ring.size());
+			tessellation.vertices.insert(tessellation.vertices.end(), ring.begin(), ring.end());
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				tessellation.indices.insert(tessellation.indices.end(), {0u, base + i, base + (i + 1) % n});
+			}
+		};
+		addRing(region.outer);
+		for (const std::vector<Point>& hole : region.holes) addRing(hole);
+
+		// Holes are inside the outline, its bounding box covers everything.
+		glm::vec2 min{std::numeric_limits<float>::max()}, max{std::numeric_limits<float>::lowest()};
+		for (const Point& p : region.outer)
+		{
+			min = glm::min(min, {p.x(), p.y()});
+			max = glm::max(max, {p.x(), p.y()});
+		}
+		auto base = static_cast<uint32_t>(tessellation.vertices.size());
+		tessellation.vertices.insert(tessellation.vertices.end(), {
+			                             {min.x, min.y}, {max.x, min.y}, {max.x, max.y}, {min.x, max.y}
+		                             });
+		tessellation.coverIndices = {base, base + 1, base + 2, base, base + 2, base + 3};
+		return tessellation;
+	}
+
+	Tessellation tessellate(const Region& region)
+	{
+		if (region.holes.empty() && region.outer.size() <= EarClipMaxVertices)
+		{
+			if (std::optional<Tessellation> clipped = earClip(region.outer)) return std::move(*clipped);
+		}
+		return stencilFan(region);
+	}
+
+	bool contains(const Region& region, const Point& p)
+	{
+		glm::dvec2 q = toDvec2(p);
+		if (!insidePolygon(region.outer, q, toDvec2)) return false;
+		return std::ranges::none_of(region.holes, [q](const std::vector<Point>& hole)
+		{
+			return insidePolygon(hole, q, toDvec2);
+		});
+	}
+}
+
+namespace ciallo
+{
+	namespace
+	{
+		uint32_t polylineId(entt::entity e)
+		{
+			return static_cast<uint32_t>(entt::to_integral(e));
+		}
+
+		uint64_t hashRegion(const geom::Region& region)
+		{
+			// FNV-1a over coordinates, outline first then holes.
+			uint64_t hash = 0xcbf29ce484222325ull;
+			auto add = [&hash](const std::vector<geom::Point>& polygon)
+			{
+				for (const geom::Point& p : polygon)
+				{
+					for (float c : {p.x(), p.y()})
+					{
+						hash ^= std::bit_cast<uint32_t>(c);
+						hash *= 0x100000001b3ull;
+					}
+				}
+				hash ^= polygon.size();
+				hash *= 0x100000001b3ull;
+			};
+			add(region.outer);
+			for (const std::vector<geom::Point>& hole : region.holes) add(hole);
+			return hash;
+		}
+	}
+
+	int32_t FillRegionsCpo::find(glm::vec2 p) const
+	{
+		if (gridSize.x == 0) return -1;
+		glm::vec2 cellf = glm::floor((p - gridMin) / cellSize);
+		// Points on the far edge of the grid belong to its last cell.
+		if (cellf.x < 0.0f || cellf.y < 0.0f || cellf.x > static_cast<float>(gridSize.x) ||
+			cellf.y > static_cast<float>(gridSize.y))
+			return -1;
+		glm::uvec2 cell = glm::min(glm::uvec2(cellf), gridSize - 1u);
+		size_t c = static_cast<size_t>(cell.y) * gridSize.x + cell.x;
+		for (uint32_t k = cellStarts[c]; k < cellStarts[c + 1]; ++k)
+		{
+			uint32_t i = cellRegions[k];
+			const glm::vec4& b = bounds[i];
+			if (p.x < b.x || p.y < b.y || p.x > b.z || p.y > b.w) continue;
+			if (geom::contains(regions[i], {p.x, p.y})) return static_cast<int32_t>(i);
+		}
+		return -1;
+	}
+
+	void FillRegionsCpo::index()
+	{
+		cellStarts.clear();
+		cellRegions.clear();
+		if (bounds.empty())
+		{
+			gridSize = glm::uvec2(0u);
+			return;
+		}
+		glm::vec2 max{std::numeric_limits<float>::lowest()};
+		gridMin = glm::vec2(std::numeric_limits<float>::max());
+		for (const glm::vec4& b : bounds)
+		{
+			gridMin = glm::min(gridMin, glm::vec2(b.x, b.y));
+			max = glm::max(max, glm::vec2(b.z, b.w));
+		}
+		auto side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(bounds.size()))));
+		gridSize = glm::uvec2(std::clamp(side, 1u, 256u));
+		cellSize = glm::max((max - gridMin) / glm::vec2(gridSize), glm::vec2(1e-6f));
+
+		auto cellRange = [this](const glm::vec4& b)
+		{
+			glm::uvec2 lo = glm::uvec2(glm::max(glm::floor((glm::vec2(b.x, b.y) - gridMin) / cellSize), 0.0f));
+			glm::uvec2 hi = glm::uvec2(glm::max(glm::floor((glm::vec2(b.z, b.w) - gridMin) / cellSize), 0.0f));
+			return std::pair{glm::min(lo, gridSize - 1u), glm::min(hi, gridSize - 1u)};
+		};
+		// Count, then fill in region order, so find() returns what a scan of all regions would.
+		cellStarts.assign(static_cast<size_t>(gridSize.x) * gridSize.y + 1, 0u);
+		for (const glm::vec4& b : bounds)
+		{
+			auto [lo, hi] = cellRange(b);
+			for (uint32_t y = lo.y; y <= hi.y; ++y)
+			{
+				for (uint32_t x = lo.x; x <= hi.x; ++x)
+				{
+					++cellStarts[static_cast<size_t>(y) * gridSize.x + x + 1];
+				}
+			}
+		}
+		std::partial_sum(cellStarts.begin(), cellStarts.end(), cellStarts.begin());
+		cellRegions.resize(cellStarts.back());
+		std::vector<uint32_t> next{cellStarts.begin(), cellStarts.end() - 1};
+		for (uint32_t i = 0; i < bounds.size(); ++i)
+		{
+			auto [lo, hi] = cellRange(bounds[i]);
+			for (uint32_t y = lo.y; y <= hi.y; ++y)
+			{
+				for (uint32_t x = lo.x; x <= hi.x; ++x)
+				{
+					cellRegions[next[static_cast<size_t>(y) * gridSize.x + x]++] = i;
+				}
+			}
+		}
+	}
+
+	void FillRegionBuilder::connect(entt::registry& r)
+	{
+		ob.connect(r, entt::collector.group<StrokeCpo, LayerMemberCpo>().update<StrokeCpo>()
+		                             .update<LayerMemberCpo>());
+		r.on_destroy<StrokeCpo>().connect<&FillRegionBuilder::onDestroy>();
+		r.on_destroy<LayerMemberCpo>().connect<&FillRegionBuilder::onDestroy>();
+	}
+
+	void FillRegionBuilder::onDestroy(entt::registry& r, entt::entity e)
+	{
+		if (r.all_of<StrokeCpo>(e)) removed.push_back(e);
+	}
+
+	FillRegionsCpo& FillRegionBuilder::ensure(entt::registry& r, entt::entity drawing)
+	{
+		if (auto* cpo = r.try_get<FillRegionsCpo>(drawing)) return *cpo;
+
+		const auto& view = r.get<ViewRectCpo>(drawing);
+		auto& cpo = r.emplace<FillRegionsCpo>(drawing, std::make_unique<geom::RegionFinder>(view.min, view.max));
+		// Polylines of strokes are only kept up to date while some drawing has regions.
+		std::unordered_set<entt::entity> layers = layersOf(r, drawing);
+		std::vector<entt::entity> strokes;
+		for (auto&& [e, stroke, member] : r.view<StrokeCpo, LayerMemberCpo>().each())
+		{
+			if (!r.all_of<LiveStrokeCpo>(e) && layers.contains(member.layer)) strokes.push_back(e);
+		}
+		simplify(r, strokes);
+		rebuild(r, drawing, cpo, {});
+		return cpo;
+	}
+
+	void FillRegionBuilder::update(entt::registry& r)
+	{
+		// Fills may show up without a tap, loaded or brought back by undo.
+		std::unordered_set<entt::entity> fillLayers;
+		for (auto&& [e, fill, member] : r.view<FillCpo, LayerMemberCpo>().each())
+		{
+			fillLayers.insert(member.layer);
+		}
+		std::vector<entt::entity> drawings;
+		for (auto&& [drawing, stack] : r.view<LayerStackCpo>(entt::exclude<FillRegionsCpo>).each())
+		{
+			if (std::ranges::any_of(stack.layers, [&](entt::entity layer) { return fillLayers.contains(layer); }))
+			{
+				drawings.push_back(drawing);
+			}
+		}
+		for (entt::entity drawing : drawings)
+		{
+			ensure(r, drawing);
+		}
+
+		if (r.view<FillRegionsCpo>().empty())
+		{
+			ob.clear();
+			deferred.clear();
+			removed.clear();
+			return;
+		}
+		std::vector<entt::entity> changed{ob.begin(), ob.end()};
+		ob.clear();
+		changed.insert(changed.end(), deferred.begin(), deferred.end());
+		deferred.clear();
+		changed.insert(changed.end(), removed.begin(), removed.end());
+		removed.clear();
+		if (changed.empty()) return;
+
+		std::vector<entt::entity> finished;
+		std::vector<uint32_t> changedIds;
+		for (entt::entity e : changed)
+		{
+			if (!r.valid(e) || !r.all_of<StrokeCpo, LayerMemberCpo>(e))
+			{
+				if (r.valid(e)) r.remove<FillPolylineCpo>(e);
+				changedIds.push_back(polylineId(e));
+				continue;
+			}
+			// Regions of a half drawn stroke are of no use, it's picked up once finished.
+			if (r.all_of<LiveStrokeCpo>(e))
+			{
+				deferred.insert(e);
+				continue;
+			}
+			finished.push_back(e);
+			changedIds.push_back(polylineId(e));
+		}
+		if (changedIds.empty()) return;
+		std::ranges::sort(changedIds);
+		auto duplicates = std::ranges::unique(changedIds);
+		changedIds.erase(duplicates.begin(), duplicates.end());
+		simplify(r, finished);
+
+		// Drawings gaining or losing any of the strokes are rebuilt.
+		for (auto&& [drawing, cpo] : r.view<FillRegionsCpo>().each())
+		{
+			std::unordered_set<entt::entity> layers = layersOf(r, drawing);
+			bool affected = std::ranges::any_of(changedIds, [&cpo](uint32_t id) { return cpo.finder->contains(id); })
+				|| std::ranges::any_of(finished, [&](entt::entity e)
+				{
+					return layers.contains(r.get<LayerMemberCpo>(e).layer);
+				});
+			if (affected) rebuild(r, drawing, cpo, changedIds);
+		}
+	}
+
+	void FillRegionBuilder::simplify(entt::registry& r, const std::vector<entt::entity>& strokes)
+	{
+		// Fetch components on this thread, workers touch nothing but their own stroke.
+		std::vector<const StrokeCpo*> strokeCpos = strokes | views::transform([&r](entt::entity e)
+		{
+			return &r.get<StrokeCpo>(e);
+		}) | ranges::to_vector;
+		std::vector<std::vector<geom::Point>> polylines(strokes.size());
+		r.ctx().at<JobSystem*>()->parallelFor(strokes.size(), [&](size_t i)
+		{
+			const std::vector<geom::Point>& position = strokeCpos[i]->position;
+			if (position.size() < 3)
+			{
+				polylines[i] = position;
+				return;
+			}
+			for (uint32_t kept : geom::douglasPeucker(position, SimplifyTolerance))
+			{
+				polylines[i].push_back(position[kept]);
+			}
+		});
+
+		for (size_t i = 0; i < strokes.size(); ++i)
+		{
+			r.emplace_or_replace<FillPolylineCpo>(strokes[i], std::move(polylines[i]));
+		}
+	}
+
+	void FillRegionBuilder::rebuild(entt::registry& r, entt::entity drawing, FillRegionsCpo& cpo,
+	                                std::span<const uint32_t> changed)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		JobSystem& jobs = *r.ctx().at<JobSystem*>();
+		std::unordered_set<entt::entity> layers = layersOf(r, drawing);
+
+		// Sorted by id, so regions come out in the same order no matter the order of the view.
+		std::vector<geom::RegionFinder::Polyline> polylines;
+		for (auto&& [e, polyline, member] : r.view<FillPolylineCpo, LayerMemberCpo>().each())
+		{
+			if (layers.contains(member.layer)) polylines.push_back({polylineId(e), polyline.polyline});
+		}
+		std::ranges::sort(polylines, {}, &geom::RegionFinder::Polyline::id);
+		cpo.regions = cpo.finder->find(polylines, changed, jobs);
+
+		// Unchanged outlines keep their tessellation, the rest are tessellated in parallel.
+		std::unordered_map<uint64_t, size_t> previous;
+		for (size_t i = 0; i < cpo.hashes.size(); ++i)
+		{
+			previous.emplace(cpo.hashes[i], i);
+		}
+		std::vector<uint64_t> hashes = cpo.regions | views::transform(hashRegion) | ranges::to_vector;
+		std::vector<geom::Tessellation> tessellations(cpo.regions.size());
+		std::vector<size_t> missing;
+		for (size_t i = 0; i < hashes.size(); ++i)
+		{
+			if (auto it = previous.find(hashes[i]); it != previous.end())
+			{
+				tessellations[i] = std::move(cpo.tessellations[it->second]);
+				previous.erase(it);
+			}
+			else
+			{
+				missing.push_back(i);
+			}
+		}
+		jobs.parallelFor(missing.size(), [&](size_t i)
+		{
+			tessellations[missing[i]] = geom::tessellate(cpo.regions[missing[i]]);
+		}, 1);
+		cpo.hashes = std::move(hashes);
+		cpo.tessellations = std::move(tessellations);
+
+		cpo.bounds.clear();
+		cpo.vertices.clear();
+		cpo.indices.clear();
+		cpo.draws.clear();
+		cpo.stencilCount = 0;
+		for (size_t i = 0; i < cpo.regions.size(); ++i)
+		{
+			glm::vec2 min{std::numeric_limits<float>::max()}, max{std::numeric_limits<float>::lowest()};
+			for (const geom::Point& p : cpo.regions[i].outer)
+			{
+				min = glm::min(min, {p.x(), p.y()});
+				max = glm::max(max, {p.x(), p.y()});
+			}
+			cpo.bounds.emplace_back(min, max);
+
+			const geom::Tessellation& tessellation = cpo.tessellations[i];
+			auto base = static_cast<uint32_t>(cpo.vertices.size());
+			FillDraw draw{};
+			draw.first = static_cast<uint32_t>(cpo.indices.size());
+			draw.count = static_cast<uint32_t>(tessellation.indices.size());
+			draw.coverFirst = draw.first + draw.count;
+			draw.coverCount = static_cast<uint32_t>(tessellation.coverIndices.size());
+			cpo.draws.push_back(draw);
+			if (draw.coverCount > 0) ++cpo.stencilCount;
+			cpo.vertices.insert(cpo.vertices.end(), tessellation.vertices.begin(), tessellation.vertices.end());
+			for (uint32_t index : tessellation.indices)
+			{
+				cpo.indices.push_back(base + index);
+			}
+			for (uint32_t index : tessellation.coverIndices)
+			{
+				cpo.indices.push_back(base + index);
+			}
+		}
+		cpo.index();
+		++cpo.version;
+		auto end = std::chrono::high_resolution_clock::now();
+		cpo.buildMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+		// Fills follow the regions containing their seeds.
+		for (auto&& [e, fill, member] : r.view<FillCpo, LayerMemberCpo>().each())
+		{
+			if (layers.contains(member.layer)) r.emplace_or_replace<LayerDirtyTag>(member.layer);
+		}
+	}
+
+	std::unordered_set<entt::entity> FillRegionBuilder::layersOf(const entt::registry& r, entt::entity drawing)
+	{
+		const auto* stack = r.try_get<LayerStackCpo>(drawing);
+		if (!stack) return {};
+		return {stack->layers.begin(), stack->layers.end()};
+	}
+
+	void FillRegionBuilder::drawWindow(entt::registry& r, entt::entity drawing, bool* open)
+	{
+		if (!ImGui::Begin("Fill Regions", open))
+		{
+			ImGui::End();
+			return;
+		}
+		auto* cpo = r.try_get<FillRegionsCpo>(drawing);
+		if (!cpo)
+		{
+			ImGui::TextUnformatted("Regions are built on the first fill of the drawing.");
+			if (ImGui::Button("Build Now")) ensure(r, drawing);
+			ImGui::End();
+			return;
+		}
+
+		// Any change sweeps everything again.
+		geom::RegionFinder::Settings settings = cpo->finder->settings();
+		float gap = settings.gap * 1000.0f;
+		bool changed = ImGui::SliderFloat("Gap Closing (mm)", &gap, 0.0f, 5.0f, "%.2f");
+		const uint32_t minSlabs = 1, maxSlabs = 256;
+		changed |= ImGui::SliderScalar("Slabs", ImGuiDataType_U32, &settings.slabCount, &minSlabs, &maxSlabs);
+		settings.gap = gap / 1000.0f;
+		if (ImGui::Button("Rebuild") || changed)
+		{
+			cpo->finder->reset(settings);
+			rebuild(r, drawing, *cpo, {});
+		}
+
+		ImGui::Text("%zu regions, %zu ear clipped, %zu stencil then cover", cpo->regions.size(),
+		            cpo->regions.size() - cpo->stencilCount, cpo->stencilCount);
+		ImGui::Text("Last build: %.2f ms", cpo->buildMs);
+		ImGui::End();
+	}
+}
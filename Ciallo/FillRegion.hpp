@@ -0,0 +1,199 @@
+#pragma once
+
+#include <span>
+
+#include "JobSystem.hpp"
+
+namespace ciallo::geom
+{
+	/**
+	 * \brief Closed regions enclosed by polylines, with small gaps of line art closed.
+	 * 1. Polyline ends closer than gap are bridged by virtual segments, found through a grid of endpoints.
+	 * 2. The domain is cut into vertical slabs and every slab sweeps its segments for crossings in parallel,
+	 *    testing only active segments in the y window of the new one. Crossings are cached per slab. Next call only sweeps slabs touched by changed polylines or bridges.
+	 * 3. Segments split at crossings form a planar graph. Dangling edges are pruned, faces are traced from
+	 *    half edges sorted by angle, and component boundaries become holes of the faces around them.
+	 */
+	class RegionFinder
+	{
+	public:
+		struct Settings
+		{
+			float gap = 1e-3f; // meter, polyline ends closer than it are joined
+			float minArea = 1e-8f; // square meter, slivers at crossings are dropped
+			uint32_t slabCount = 64;
+
+			bool operator==(const Settings& other) const = default;
+		};
+
+		struct Polyline
+		{
+			uint32_t id; // stable across calls, changed lists refer to it
+			std::span<const Point> points;
+		};
+
+	private:
+		// Stroke segment {polyline id, segment index}, or bridge {BridgeFlag | end, end} between two ends.
+		struct SegmentKey
+		{
+			uint64_t a;
+			uint64_t b;
+
+			auto operator<=>(const SegmentKey& other) const = default;
+		};
+
+		struct SegmentKeyHash
+		{
+			size_t operator()(const SegmentKey& key) const
+			{
+				return std::hash<uint64_t>{}(key.a * 0x9E3779B97F4A7C15ull ^ key.b);
+			}
+		};
+
+		struct Segment
+		{
+			glm::dvec2 a;
+			glm::dvec2 b;
+			SegmentKey key;
+		};
+
+		struct Crossing
+		{
+			SegmentKey s0;
+			SegmentKey s1;
+			double t0;
+			double t1;
+			glm::dvec2 point;
+		};
+
+		constexpr static uint64_t BridgeFlag = 1ull << 63;
+
+		Settings m_settings;
+		glm::dvec2 m_domainMin;
+		glm::dvec2 m_domainMax;
+		std::vector<Segment> m_segments;
+		std::vector<std::vector<Crossing>> m_slabCrossings;
+		std::unordered_map<uint32_t, glm::dvec2> m_ranges; // x range of every polyline last call
+		std::vector<Segment> m_bridges; // sorted by key, last call
+
+		uint32_t slabOf(double x) const;
+		std::vector<Segment> bridgeGaps(std::span<const Polyline> polylines) const;
+		std::vector<Crossing> sweep(uint32_t slab, std::vector<uint32_t>& segments) const;
+		std::vector<Region> trace(JobSystem& jobs) const;
+	public:
+		RegionFinder(glm::vec2 domainMin, glm::vec2 domainMax, const Settings& settings = {});
+
+		const Settings& settings() const { return m_settings; }
+		bool contains(uint32_t id) const { return m_ranges.contains(id); }
+		// Forget cached crossings, next call sweeps everything.
+		void reset(const Settings& settings);
+		/**
+		 * \brief Regions of all polylines.
+		 * \param changed Ids of polylines added, changed or removed since the last call. Ignored on the first call.
+		 */
+		std::vector<Region> find(std::span<const Polyline> polylines, std::span<const uint32_t> changed,
+		                         JobSystem& jobs);
+	};
+
+	constexpr uint32_t EarClipMaxVertices = 256;
+
+	/**
+	 * \brief Triangles of a region, drawn one of two ways.
+	 * Direct: indices are the region itself.
+	 * Stencil then cover: indices are a fan from one vertex over every edge of outline and holes. Drawn into
+	 * stencil inverting a bit, pixels covered an odd number of times are inside. coverIndices then draw the
+	 * bounding box of the region where the bit is set. No triangulation at all, linear in vertex count.
+	 */
+	struct Tessellation
+	{
+		std::vector<Point> vertices;
+		std::vector<uint32_t> indices; // triangle list
+		std::vector<uint32_t> coverIndices; // empty when direct
+	};
+
+	// Ear clipping of a simple counterclockwise polygon, O(n^2). None when no ear is left, e.g. self touching.
+	std::optional<Tessellation> earClip(std::span<const Point> polygon);
+	Tessellation stencilFan(const Region& region);
+	// Ear clipping for small regions without holes, stencil then cover for the rest or when clipping fails.
+	Tessellation tessellate(const Region& region);
+	bool contains(const Region& region, const Point& p);
+}
+
+namespace ciallo
+{
+	// On fill entity, along with LayerMemberCpo. Fills the region of its drawing containing seed.
+	struct FillCpo
+	{
+		glm::vec2 seed{0.0f, 0.0f}; // world coordinate
+		glm::vec4 color{0.0f, 0.0f, 0.0f, 1.0f};
+	};
+
+	// On stroke entity, centerline simplified for region finding. Rebuilt when StrokeCpo changes.
+	struct FillPolylineCpo
+	{
+		std::vector<geom::Point> polyline;
+	};
+
+	// Index ranges of one region in FillRegionsCpo::indices, see geom::Tessellation.
+	struct FillDraw
+	{
+		uint32_t first;
+		uint32_t count;
+		uint32_t coverFirst;
+		uint32_t coverCount; // zero when direct
+	};
+
+	// On drawing entity, closed regions of its strokes and their tessellation.
+	struct FillRegionsCpo
+	{
+		std::unique_ptr<geom::RegionFinder> finder;
+		std::vector<geom::Region> regions;
+		std::vector<glm::vec4> bounds; // min in xy, max in zw
+		std::vector<uint64_t> hashes; // of outlines, unchanged regions keep their tessellation
+		std::vector<geom::Tessellation> tessellations;
+		// All tessellations packed for upload, indices point into vertices.
+		std::vector<geom::Point> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<FillDraw> draws; // of every region
+		size_t stencilCount = 0; // regions drawn with stencil then cover
+		uint32_t version = 0; // bumped on every rebuild
+		double buildMs = 0.0;
+		// Uniform grid over all bounds, every cell lists the regions whose bounds touch it in index order.
+		glm::vec2 gridMin{0.0f};
+		glm::vec2 cellSize{1.0f};
+		glm::uvec2 gridSize{0u};
+		std::vector<uint32_t> cellStarts; // one past the last cell too, offsets into cellRegions
+		std::vector<uint32_t> cellRegions;
+
+		// Index of region containing p, -1 if none does. Only regions listed in the cell of p are tested.
+		int32_t find(glm::vec2 p) const;
+		// Rebuild the grid from bounds, about one cell per region.
+		void index();
+	};
+
+	/**
+	 * \brief Keep FillRegionsCpo of drawings up to date with their strokes.
+	 * Only drawings with fills pay for regions. A rebuild re-sweeps slabs touched by changed strokes, and only
+	 * regions whose outline changed are tessellated again. Layers holding fills of the drawing are marked dirty.
+	 */
+	struct FillRegionBuilder
+	{
+		constexpr static float SimplifyTolerance = 2e-5f; // 0.02mm
+
+		static inline entt::observer ob;
+		static inline std::unordered_set<entt::entity> deferred; // live strokes, picked up once finished
+		static inline std::vector<entt::entity> removed;
+
+		static void connect(entt::registry& r);
+		// Regions of drawing, built now if the drawing had none.
+		static FillRegionsCpo& ensure(entt::registry& r, entt::entity drawing);
+		static void update(entt::registry& r);
+		static void drawWindow(entt::registry& r, entt::entity drawing, bool* open);
+	private:
+		static void onDestroy(entt::registry& r, entt::entity e);
+		static void simplify(entt::registry& r, const std::vector<entt::entity>& strokes);
+		static void rebuild(entt::registry& r, entt::entity drawing, FillRegionsCpo& cpo,
+		                    std::span<const uint32_t> changed);
+		static std::unordered_set<entt::entity> layersOf(const entt::registry& r, entt::entity drawing);
+	};
+}
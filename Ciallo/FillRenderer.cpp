@@ -0,0 +1,203 @@
+#include "pch.hpp"
+#include "FillRenderer.hpp"
+
+#include <bit>
+
+#include "vku.hpp"
+#include "CanvasFormat.hpp"
+#include "Drawing.hpp"
+#include "FillRegion.hpp"
+
+namespace ciallo
+{
+	namespace
+	{
+		constexpr vk::ShaderStageFlags Stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+	}
+
+	FillRenderer::FillRenderer(vulkan::Device* device): m_device(device)
+	{
+		m_vertShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eVertex, "./shaders/fill.vert.spv");
+		m_fragShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eFragment, "./shaders/fill.frag.spv");
+		m_stencilFormat = pickStencilFormat();
+		genPipelines();
+	}
+
+	vk::Format FillRenderer::pickStencilFormat() const
+	{
+		// Stencil only is optional, one of the combined formats is always there.
+		for (vk::Format format : {vk::Format::eS8Uint, vk::Format::eD24UnormS8Uint, vk::Format::eD32SfloatS8Uint})
+		{
+			vk::FormatProperties properties = m_device->physicalDevice().getFormatProperties(format);
+			if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment) return format;
+		}
+		throw std::runtime_error("No stencil attachment format supported!");
+	}
+
+	void FillRenderer::genPipelines()
+	{
+		vk::Device device = m_device->device();
+		vku::PipelineLayoutMaker layoutMaker;
+		layoutMaker.pushConstantRange(Stages, 0, sizeof(PushConstant));
+		m_pipelineLayout = layoutMaker.createUnique(device);
+
+		auto baseMaker = [this]
+		{
+			vku::PipelineMaker maker;
+			maker.topology(vk::PrimitiveTopology::eTriangleList)
+			     .dynamicState(vk::DynamicState::eViewport)
+			     .dynamicState(vk::DynamicState::eScissor)
+			     .shader(vk::ShaderStageFlagBits::eVertex, m_vertShader)
+			     .shader(vk::ShaderStageFlagBits::eFragment, m_fragShader)
+			     .cullMode(vk::CullModeFlagBits::eNone)
+			     .vertexBinding(0, sizeof(geom::Point))
+			     .vertexAttribute(0, 0, vk::Format::eR32G32Sfloat, 0);
+			return maker;
+		};
+		// Premultiplied over, regions of a fill never overlap each other.
+		auto premultipliedOver = [](vku::PipelineMaker& maker)
+		{
+			maker.blendBegin(VK_TRUE)
+			     .blendSrcColorBlendFactor(vk::BlendFactor::eOne)
+			     .blendDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+			     .blendSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+			     .blendDstAlphaBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha);
+		};
+
+		vku::PipelineMaker directMaker = baseMaker();
+		premultipliedOver(directMaker);
+
+		// Even-odd rule: every triangle of the fan flips bit 0 of pixels it covers.
+		vku::PipelineMaker stencilMaker = baseMaker();
+		vk::StencilOpState invert{
+			vk::StencilOp::eKeep, vk::StencilOp::eInvert, vk::StencilOp::eKeep, vk::CompareOp::eAlways, 1u, 1u, 0u
+		};
+		stencilMaker.blendBegin(VK_FALSE)
+		            .blendColorWriteMask({})
+		            .stencilTestEnable(VK_TRUE)
+		            .front(invert)
+		            .back(invert);
+
+		vku::PipelineMaker coverMaker = baseMaker();
+		premultipliedOver(coverMaker);
+		vk::StencilOpState cover{
+			vk::StencilOp::eKeep, vk::StencilOp::eZero, vk::StencilOp::eKeep, vk::CompareOp::eNotEqual, 1u, 1u, 0u
+		};
+		coverMaker.stencilTestEnable(VK_TRUE)
+		          .front(cover)
+		          .back(cover);
+
+		bool depth = static_cast<bool>(vulkan::Image::aspectOf(m_stencilFormat) & vk::ImageAspectFlagBits::eDepth);
+		for (CanvasFormat format : supportedCanvasFormats(m_device->physicalDevice()))
+		{
+			std::vector colorAttachmentsFormats{toVkFormat(format)};
+			vk::PipelineRenderingCreateInfo renderingCreateInfo{
+				0, colorAttachmentsFormats, depth ? m_stencilFormat : vk::Format::eUndefined, m_stencilFormat
+			};
+			Pipelines& pipelines = m_pipelines[toVkFormat(format)];
+			pipelines.direct = directMaker.createUnique(device, nullptr, *m_pipelineLayout, renderingCreateInfo);
+			pipelines.stencil = stencilMaker.createUnique(device, nullptr, *m_pipelineLayout, renderingCreateInfo);
+			pipelines.cover = coverMaker.createUnique(device, nullptr, *m_pipelineLayout, renderingCreateInfo);
+		}
+	}
+
+	rendering::RenderGraph::Resource FillRenderer::createStencil(rendering::RenderGraph& graph,
+	                                                            vk::Extent2D extent) const
+	{
+		return graph.createImage("Fill Stencil", m_stencilFormat, extent,
+		                         vk::ImageUsageFlagBits::eDepthStencilAttachment);
+	}
+
+	FillBufferCpo& FillRenderer::upload(entt::registry& r, entt::entity drawing, const FillRegionsCpo& regions)
+	{
+		auto& buffers = r.get_or_emplace<FillBufferCpo>(drawing);
+		if (buffers.version == regions.version && buffers.vertices.allocated()) return buffers;
+
+		// Previous frame is finished, buffers are free to change.
+		VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+		vk::DeviceSize vertexSize = std::max<size_t>(regions.vertices.size(), 1024) * sizeof(geom::Point);
+		if (!buffers.vertices.allocated() || buffers.vertices.size() < vertexSize)
+		{
+			buffers.vertices = vulkan::Buffer(*m_device, info, std::bit_ceil(vertexSize),
+			                                  vk::BufferUsageFlagBits::eVertexBuffer);
+		}
+		vk::DeviceSize indexSize = std::max<size_t>(regions.indices.size(), 2048) * sizeof(uint32_t);
+		if (!buffers.indices.allocated() || buffers.indices.size() < indexSize)
+		{
+			buffers.indices = vulkan::Buffer(*m_device, info, std::bit_ceil(indexSize),
+			                                 vk::BufferUsageFlagBits::eIndexBuffer);
+		}
+		if (!regions.vertices.empty())
+		{
+			buffers.vertices.uploadLocal(regions.vertices.data(), regions.vertices.size() * sizeof(geom::Point));
+			buffers.indices.uploadLocal(regions.indices.data(), regions.indices.size() * sizeof(uint32_t));
+		}
+		buffers.version = regions.version;
+		return buffers;
+	}
+
+	void FillRenderer::render(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing,
+	                          const vulkan::Image& target, const vulkan::Image& stencil,
+	                          const std::vector<entt::entity>& fills)
+	{
+		auto* regions = r.try_get<FillRegionsCpo>(drawing);
+		auto pipelines = m_pipelines.find(target.format());
+		if (fills.empty() || !regions || pipelines == m_pipelines.end()) return;
+		const auto& view = r.get<ViewRectCpo>(drawing);
+		const FillBufferCpo& buffers = upload(r, drawing, *regions);
+		// Graph brought stencil into its layout, fills of the layer rasterized before in the pass may still write it.
+		vk::MemoryBarrier2 stencilBarrier{
+			vk::PipelineStageFlagBits2::eLateFragmentTests, vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+			rendering::AccessStencilAttachment.stages, rendering::AccessStencilAttachment.access
+		};
+		cb.pipelineBarrier2({{}, stencilBarrier, {}, {}});
+
+		vk::Rect2D area{{0, 0}, target.extent2D()};
+		vk::RenderingAttachmentInfo renderingAttachmentInfo{target.imageView(), target.imageLayout()};
+		std::vector colorAttachments{renderingAttachmentInfo};
+		vk::RenderingAttachmentInfo stencilAttachmentInfo{
+			stencil.imageView(), rendering::AccessStencilAttachment.layout, {}, {}, {}, vk::AttachmentLoadOp::eClear,
+			vk::AttachmentStoreOp::eDontCare, vk::ClearDepthStencilValue{1.0f, 0u}
+		};
+		bool depth = static_cast<bool>(vulkan::Image::aspectOf(m_stencilFormat) & vk::ImageAspectFlagBits::eDepth);
+		vk::RenderingInfo renderingInfo{
+			{}, area, 1, 0, colorAttachments, depth ? &stencilAttachmentInfo : nullptr, &stencilAttachmentInfo
+		};
+		cb.beginRendering(renderingInfo);
+		vk::Viewport fullViewport{
+			0, 0, static_cast<float>(target.width()), static_cast<float>(target.height()), 0.0f, 1.0f
+		};
+		cb.setViewport(0, fullViewport);
+		cb.setScissor(0, area);
+		cb.bindVertexBuffers(0, buffers.vertices.buffer(), {0});
+		cb.bindIndexBuffer(buffers.indices, 0, vk::IndexType::eUint32);
+		vk::Pipeline bound = nullptr;
+		auto bind = [&](const vk::UniquePipeline& pipeline)
+		{
+			if (*pipeline == bound) return;
+			cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline);
+			bound = *pipeline;
+		};
+		for (entt::entity e : fills)
+		{
+			const auto& fill = r.get<FillCpo>(e);
+			int32_t region = regions->find(fill.seed);
+			if (region < 0) continue;
+			const FillDraw& draw = regions->draws[region];
+			PushConstant pushConstant{view.min, view.max, canvasColor(fromVkFormat(target.format()), fill.color)};
+			cb.pushConstants<PushConstant>(*m_pipelineLayout, Stages, 0, pushConstant);
+			if (draw.coverCount == 0)
+			{
+				bind(pipelines->second.direct);
+				cb.drawIndexed(draw.count, 1, draw.first, 0, 0);
+				continue;
+			}
+			// Fragment tests follow primitive order, cover sees the stencil of the fan right before it.
+			bind(pipelines->second.stencil);
+			cb.drawIndexed(draw.count, 1, draw.first, 0, 0);
+			bind(pipelines->second.cover);
+			cb.drawIndexed(draw.coverCount, 1, draw.coverFirst, 0, 0);
+		}
+		cb.endRendering();
+	}
+}
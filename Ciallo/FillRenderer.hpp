@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "RenderGraph.hpp"
+#include "ShaderModule.hpp"
+
+namespace ciallo
+{
+	struct FillRegionsCpo;
+
+	// On drawing entity, tessellated regions of FillRegionsCpo on device. Host visible, rewritten on new version.
+	struct FillBufferCpo
+	{
+		vulkan::Buffer vertices;
+		vulkan::Buffer indices;
+		uint32_t version = 0;
+	};
+
+	/**
+	 * \brief Draws fills as the tessellation of their regions, see geom::Tessellation.
+	 * Regions of a drawing are uploaded once per rebuild, every fill is one or two indexed draws into that buffer,
+	 * so recoloring a fill costs draw calls and nothing else. Direct regions are drawn as is, the rest go through
+	 * stencil then cover in the same rendering. Their stencil attachment is a transient of the render graph, it
+	 * only lives through the pass rasterizing layers and shares memory with other transients of its size.
+	 */
+	class FillRenderer
+	{
+		struct PushConstant
+		{
+			glm::vec2 viewMin;
+			glm::vec2 viewMax;
+			glm::vec4 color;
+		};
+
+		struct Pipelines
+		{
+			vk::UniquePipeline direct;
+			vk::UniquePipeline stencil; // color writes off, inverts stencil
+			vk::UniquePipeline cover; // where stencil is set, clearing it for the next fill
+		};
+
+		vulkan::Device* m_device;
+		vulkan::ShaderModule m_vertShader;
+		vulkan::ShaderModule m_fragShader;
+		vk::UniquePipelineLayout m_pipelineLayout;
+		std::unordered_map<vk::Format, Pipelines> m_pipelines;
+		vk::Format m_stencilFormat;
+
+		vk::Format pickStencilFormat() const;
+		void genPipelines();
+		FillBufferCpo& upload(entt::registry& r, entt::entity drawing, const FillRegionsCpo& regions);
+	public:
+		explicit FillRenderer(vulkan::Device* device);
+
+		// Stencil attachment for targets of extent, passes calling render() write it with AccessStencilAttachment.
+		rendering::RenderGraph::Resource createStencil(rendering::RenderGraph& graph, vk::Extent2D extent) const;
+
+		/**
+		 * \brief Fills into target, outside of rendering, the same way as EquidistantDotEngine::renderDynamic.
+		 * Fills whose seed is in no region of drawing draw nothing. Stencil is one of createStencil(), of the target
+		 * size, its content is discarded.
+		 */
+		void render(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing, const vulkan::Image& target,
+		            const vulkan::Image& stencil, const std::vector<entt::entity>& fills);
+	};
+}
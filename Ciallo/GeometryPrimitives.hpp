@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include <CGAL/Simple_cartesian.h>
+#include <CGAL/Exact_predicates_exact_constructions_kernel.h>
 #include <CGAL/Bbox_2.h>
 #include <iterator>
 
@@ -21,5 +22,14 @@ namespace ciallo::geom
 	template <typename Iter>
 	concept point_iter = iter_value_same<Point, Iter>;
 
-	// using ExKernel = CGAL::Exact_predicates_exact_constructions_kernel; // Ex means exact, reserve for arrangement
+	// Ex means exact, for arrangement. Predicates are filtered with interval arithmetic, exact numbers are only
+	// built when the filter fails near degeneracies.
+	using ExKernel = CGAL::Exact_predicates_exact_constructions_kernel;
+
+	// Polygon with holes, outer boundary counterclockwise and holes clockwise.
+	struct Region
+	{
+		std::vector<Point> outer;
+		std::vector<std::vector<Point>> holes;
+	};
 }
@@ -0,0 +1,118 @@
+#include "pch.hpp"
+#include "GpuReadback.hpp"
+
+#include <bit>
+
+namespace ciallo
+{
+	GpuReadback::GpuReadback(vulkan::Device* device, JobSystem* jobs): m_device(device), m_jobs(jobs)
+	{
+	}
+
+	GpuReadback::~GpuReadback()
+	{
+		// Recorded copies never submitted, or never waited for, are broken promises.
+		m_jobs->wait(m_copies);
+	}
+
+	vulkan::Buffer GpuReadback::acquire(vk::DeviceSize size)
+	{
+		{
+			std::lock_guard lock(m_poolMutex);
+			auto best = m_pool.end();
+			for (auto it = m_pool.begin(); it != m_pool.end(); ++it)
+			{
+				if (it->size() >= size && (best == m_pool.end() || it->size() < best->size())) best = it;
+			}
+			if (best != m_pool.end())
+			{
+				vulkan::Buffer buffer = std::move(*best);
+				m_pool.erase(best);
+				return buffer;
+			}
+		}
+		VmaAllocationCreateInfo info{
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_AUTO
+		};
+		return vulkan::Buffer(*m_device, info, std::bit_ceil(size), vk::BufferUsageFlagBits::eTransferDst);
+	}
+
+	void GpuReadback::recycle(vulkan::Buffer buffer)
+	{
+		std::lock_guard lock(m_poolMutex);
+		if (m_pool.size() < MaxPooledBuffers) m_pool.push_back(std::move(buffer));
+	}
+
+	std::future<ReadbackImage> GpuReadback::read(vk::CommandBuffer cb, const vulkan::Image& image)
+	{
+		auto request = std::make_shared<Request>();
+		request->buffer = acquire(image.size());
+		request->extent = image.extent2D();
+		request->format = image.format();
+
+		vk::MemoryBarrier2 before{
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eComputeShader |
+			vk::PipelineStageFlagBits2::eAllTransfer,
+			vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+			vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferRead
+		};
+		cb.pipelineBarrier2({{}, before, {}, {}});
+		vk::BufferImageCopy copy{};
+		copy.setImageExtent({image.width(), image.height(), 1u});
+		copy.setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+		cb.copyImageToBuffer(image, image.imageLayout(), request->buffer, copy);
+		vk::MemoryBarrier2 after{
+			vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead
+		};
+		cb.pipelineBarrier2({{}, after, {}, {}});
+
+		std::future<ReadbackImage> future = request->promise.get_future();
+		m_recorded.push_back(std::move(request));
+		return future;
+	}
+
+	void GpuReadback::submitted(vulkan::GpuPoint point)
+	{
+		for (auto& request : m_recorded)
+		{
+			request->copied = point;
+			m_submitted.push_back(std::move(request));
+		}
+		m_recorded.clear();
+	}
+
+	void GpuReadback::update()
+	{
+		vk::Device device = m_device->device();
+		auto reached = std::partition(m_submitted.begin(), m_submitted.end(), [device](const auto& request)
+		{
+			return !request->copied.reached(device);
+		});
+		for (auto it = reached; it != m_submitted.end(); ++it)
+		{
+			std::shared_ptr<Request> request = *it;
+			// Large images would hitch the frame if copied out here.
+			m_jobs->run(m_copies, [this, request]
+			{
+				try
+				{
+					request->buffer.invalidate();
+					ReadbackImage image{request->extent, request->format};
+					image.pixels.resize(static_cast<size_t>(request->extent.width) * request->extent.height *
+					                    vk::blockSize(request->format));
+					std::memcpy(image.pixels.data(), request->buffer.mappedData(), image.pixels.size());
+					recycle(std::move(request->buffer));
+					request->promise.set_value(std::move(image));
+				}
+				catch (...)
+				{
+					// The future gets the error instead of the group.
+					request->promise.set_exception(std::current_exception());
+				}
+			});
+		}
+		m_submitted.erase(reached, m_submitted.end());
+	}
+}
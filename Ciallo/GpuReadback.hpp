@@ -0,0 +1,67 @@
+#pragma once
+#include <future>
+#include <mutex>
+
+#include "Buffer.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "JobSystem.hpp"
+#include "Timeline.hpp"
+
+namespace ciallo
+{
+	// Pixels of an image copied back to host, rows tightly packed.
+	struct ReadbackImage
+	{
+		vk::Extent2D extent;
+		vk::Format format = vk::Format::eUndefined;
+		std::vector<std::byte> pixels;
+	};
+
+	/**
+	 * \brief Copies images back to host without stalling, lives in registry ctx.
+	 * Copies are recorded into the frame's command buffer and their futures are fulfilled once the frame's point on
+	 * the device timeline is reached, so nothing waits on the GPU and no command buffer or fence is made per call.
+	 * Readback buffers are persistently mapped and pooled. Pixels are copied out of them on the job system, the
+	 * next frame records into other buffers of the pool meanwhile.
+	 */
+	class GpuReadback
+	{
+		struct Request
+		{
+			vulkan::Buffer buffer;
+			vk::Extent2D extent;
+			vk::Format format;
+			std::promise<ReadbackImage> promise;
+			vulkan::GpuPoint copied;
+		};
+
+		vulkan::Device* m_device;
+		JobSystem* m_jobs;
+		std::vector<std::shared_ptr<Request>> m_recorded; // in the frame being recorded
+		std::vector<std::shared_ptr<Request>> m_submitted;
+		JobSystem::TaskGroup m_copies;
+		std::mutex m_poolMutex;
+		std::vector<vulkan::Buffer> m_pool;
+
+		vulkan::Buffer acquire(vk::DeviceSize size);
+		void recycle(vulkan::Buffer buffer);
+	public:
+		constexpr static size_t MaxPooledBuffers = 8;
+
+		GpuReadback(vulkan::Device* device, JobSystem* jobs);
+		GpuReadback(const GpuReadback& other) = delete;
+		GpuReadback& operator=(const GpuReadback& other) = delete;
+		~GpuReadback();
+
+		/**
+		 * \brief Record a copy of a color image in general layout into cb, which must be submitted this frame.
+		 * Writes into the image recorded before are waited for.
+		 */
+		std::future<ReadbackImage> read(vk::CommandBuffer cb, const vulkan::Image& image);
+		// Everything recorded so far was submitted, in work reaching point.
+		void submitted(vulkan::GpuPoint point);
+		// Completes requests whose copies reached their point, without waiting.
+		void update();
+	};
+}
@@ -105,13 +105,19 @@ namespace ciallo::vulkan
 	vk::ImageMemoryBarrier2 Image::createLayoutTransitionMemoryBarrier(vk::ImageLayout newLayout,
 	                                                                   vk::ImageAspectFlags aspectMask) const
 	{
+		// Reads have nothing to make available, only writes are waited for.
 		vk::ImageMemoryBarrier2 barrier{
-			vk::PipelineStageFlagBits2::eAllCommands,
-			vk::AccessFlagBits2::eMemoryWrite | vk::AccessFlagBits2::eMemoryRead,
+			vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryWrite,
 			vk::PipelineStageFlagBits2::eAllCommands,
 			vk::AccessFlagBits2::eMemoryWrite | vk::AccessFlagBits2::eMemoryRead,
 			m_layout, newLayout
 		};
+		// Content is discarded, nothing before needs waiting for.
+		if (m_layout == vk::ImageLayout::eUndefined)
+		{
+			barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+			       .setSrcAccessMask(vk::AccessFlagBits2::eNone);
+		}
 		barrier.image = m_image;
 		barrier.subresourceRange = {aspectMask, 0, 1, 0, 1};
 
@@ -171,10 +177,29 @@ namespace ciallo::vulkan
 		info.setViewType(viewType);
 		info.setFormat(format);
 		info.setComponents({});
-		info.setSubresourceRange({vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+		info.setSubresourceRange({aspectOf(format), 0, 1, 0, 1});
 		return device().createImageViewUnique(info);
 	}
 
+	vk::ImageAspectFlags Image::aspectOf(vk::Format format)
+	{
+		switch (format)
+		{
+		case vk::Format::eS8Uint:
+			return vk::ImageAspectFlagBits::eStencil;
+		case vk::Format::eD16UnormS8Uint:
+		case vk::Format::eD24UnormS8Uint:
+		case vk::Format::eD32SfloatS8Uint:
+			return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+		case vk::Format::eD16Unorm:
+		case vk::Format::eX8D24UnormPack32:
+		case vk::Format::eD32Sfloat:
+			return vk::ImageAspectFlagBits::eDepth;
+		default:
+			return vk::ImageAspectFlagBits::eColor;
+		}
+	}
+
 	// Only color image for now. Refer to vulkan spec struct VkImageSubresourceRange for aspectMask information
 	void Image::uploadStaging(vk::CommandBuffer cb, const void* data, vk::DeviceSize size,
 	                          vk::Buffer stagingBuffer) const
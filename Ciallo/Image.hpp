@@ -7,7 +7,7 @@
 namespace ciallo::vulkan
 {
 	/**
-	 * \brief 2D image (color image only, changes on AspectMask needed).
+	 * \brief 2D image. Views cover the aspects of the format, transfers only handle color images.
 	 * Copy constructor/assignment only allocate memory and create object, do not copy content.
 	 */
 	class Image : public AllocationBase
@@ -32,7 +32,7 @@ namespace ciallo::vulkan
 		Image(VmaAllocator allocator, VmaAllocationCreateInfo allocCreateInfo, vk::ImageCreateInfo info);
 		Image(VmaAllocator allocator, VmaAllocationCreateInfo allocCreateInfo, vk::Format format,
 		      uint32_t width, uint32_t height, vk::SampleCountFlagBits sampleCount, vk::ImageUsageFlags usage);
-		~Image();
+		virtual ~Image();
 
 		Image() = default;
 		Image(const Image& other);
@@ -40,9 +40,13 @@ namespace ciallo::vulkan
 		Image& operator=(const Image& other);
 		Image& operator=(Image&& other) noexcept;
 		operator vk::Image() const { return m_image; }
+
+		// Every aspect of format, depth and stencil for combined formats.
+		static vk::ImageAspectFlags aspectOf(vk::Format format);
 	public:
 		void changeLayout(vk::CommandBuffer cb, vk::ImageLayout newLayout,
 		                  vk::ImageAspectFlags aspectMask = vk::ImageAspectFlagBits::eColor);
+		// Waits for any earlier command unless the layout is undefined, passes of RenderGraph get precise ones.
 		vk::ImageMemoryBarrier2 createLayoutTransitionMemoryBarrier(
 			vk::ImageLayout newLayout,
 			vk::ImageAspectFlags aspectMask = vk::ImageAspectFlagBits::eColor) const;
@@ -50,6 +54,11 @@ namespace ciallo::vulkan
 		void upload(vk::CommandBuffer cb, const void* data, vk::DeviceSize size);
 		void uploadLocal(const void* data, vk::DeviceSize size) const;
 		vk::DeviceSize size() const;
+		// Extra view reinterpreting the image, which needs eMutableFormat when format differs.
+		vk::UniqueImageView createImageView(vk::Format format) const
+		{
+			return createImageView(m_image, vk::ImageViewType::e2D, format);
+		}
 
 		// Upload with provided stagingBuffer
 		void uploadStaging(vk::CommandBuffer cb, const void* data, vk::DeviceSize size, vk::Buffer stagingBuffer) const;
@@ -84,6 +93,17 @@ namespace ciallo::vulkan
 		{
 			return {width(), height()};
 		}
+
+		vk::Format format() const
+		{
+			return m_format;
+		}
+
+		// Device memory held by the image.
+		virtual vk::DeviceSize deviceMemorySize() const
+		{
+			return allocated() ? memorySize() : 0;
+		}
 	};
 }
 
@@ -0,0 +1,173 @@
+#include "pch.hpp"
+#include "ImageFile.hpp"
+
+#include <fstream>
+#include "CanvasFormat.hpp"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace ciallo
+{
+	namespace
+	{
+		// OpenEXR pixel types.
+		constexpr int32_t ExrHalf = 1;
+		constexpr int32_t ExrFloat = 2;
+
+		// Little endian, as EXR is, on every platform we build for.
+		class ExrHeader
+		{
+			std::vector<char> m_bytes;
+		public:
+			void bytes(const void* data, size_t size)
+			{
+				auto* begin = static_cast<const char*>(data);
+				m_bytes.insert(m_bytes.end(), begin, begin + size);
+			}
+
+			template <typename T>
+			void value(const T& v)
+			{
+				bytes(&v, sizeof(T));
+			}
+
+			void string(std::string_view s)
+			{
+				bytes(s.data(), s.size());
+				m_bytes.push_back('\0');
+			}
+
+			void attribute(std::string_view name, std::string_view type, const void* data, int32_t size)
+			{
+				string(name);
+				string(type);
+				value(size);
+				bytes(data, size);
+			}
+
+			template <typename T>
+			void attribute(std::string_view name, std::string_view type, const T& v)
+			{
+				attribute(name, type, &v, sizeof(T));
+			}
+
+			const std::vector<char>& data() const
+			{
+				return m_bytes;
+			}
+		};
+	}
+
+	void ImageFile::writePng(const std::filesystem::path& path, vk::Extent2D extent, std::span<const std::byte> pixels)
+	{
+		if (pixels.size() < static_cast<size_t>(extent.width) * extent.height * 4)
+		{
+			throw std::runtime_error("Not enough pixels for PNG!");
+		}
+		int stride = static_cast<int>(extent.width) * 4;
+		if (!stbi_write_png(path.string().c_str(), static_cast<int>(extent.width), static_cast<int>(extent.height), 4,
+		                    pixels.data(), stride))
+		{
+			throw std::runtime_error(fmt::format("Failed to write {}!", path.string()));
+		}
+	}
+
+	void ImageFile::writeExr(const std::filesystem::path& path, vk::Extent2D extent, vk::Format format,
+	                         std::span<const std::byte> pixels)
+	{
+		int32_t pixelType = ExrFloat;
+		size_t srcChannelSize = 1;
+		bool srgb = true;
+		switch (format)
+		{
+		case vk::Format::eR16G16B16A16Sfloat:
+			pixelType = ExrHalf;
+			srcChannelSize = 2;
+			srgb = false;
+			break;
+		case vk::Format::eR32G32B32A32Sfloat:
+			srcChannelSize = 4;
+			srgb = false;
+			break;
+		case vk::Format::eR8G8B8A8Unorm:
+		case vk::Format::eR8G8B8A8Srgb:
+			break;
+		default:
+			throw std::runtime_error("Unsupported format for EXR!");
+		}
+		size_t width = extent.width;
+		size_t height = extent.height;
+		if (pixels.size() < width * height * 4 * srcChannelSize)
+		{
+			throw std::runtime_error("Not enough pixels for EXR!");
+		}
+		size_t channelSize = pixelType == ExrHalf ? 2 : 4;
+
+		ExrHeader header;
+		header.value(int32_t{20000630}); // magic
+		header.value(int32_t{2}); // version 2, single part scanline
+		// Channels are sorted by name, pixels of a scanline are stored channel by channel.
+		constexpr std::array<std::pair<const char*, size_t>, 4> Channels{{{"A", 3}, {"B", 2}, {"G", 1}, {"R", 0}}};
+		ExrHeader channels;
+		for (auto [name, index] : Channels)
+		{
+			channels.string(name);
+			channels.value(pixelType);
+			channels.value(std::array<uint8_t, 4>{}); // pLinear and reserved
+			channels.value(std::array<int32_t, 2>{1, 1}); // sampling
+		}
+		channels.value('\0');
+		header.attribute("channels", "chlist", channels.data().data(), static_cast<int32_t>(channels.data().size()));
+		header.attribute("compression", "compression", uint8_t{0});
+		std::array<int32_t, 4> window{0, 0, static_cast<int32_t>(width) - 1, static_cast<int32_t>(height) - 1};
+		header.attribute("dataWindow", "box2i", window);
+		header.attribute("displayWindow", "box2i", window);
+		header.attribute("lineOrder", "lineOrder", uint8_t{0}); // increasing y
+		header.attribute("pixelAspectRatio", "float", 1.0f);
+		header.attribute("screenWindowCenter", "v2f", std::array<float, 2>{0.0f, 0.0f});
+		header.attribute("screenWindowWidth", "float", 1.0f);
+		header.value('\0');
+
+		// Uncompressed files hold one scanline per block, led by a table of block offsets.
+		size_t lineSize = width * 4 * channelSize;
+		size_t blockSize = 2 * sizeof(int32_t) + lineSize;
+		size_t firstBlock = header.data().size() + height * sizeof(uint64_t);
+		for (size_t y = 0; y < height; ++y)
+		{
+			header.value(static_cast<uint64_t>(firstBlock + y * blockSize));
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file) throw std::runtime_error(fmt::format("Failed to open {}!", path.string()));
+		file.write(header.data().data(), static_cast<std::streamsize>(header.data().size()));
+
+		std::vector<std::byte> block(blockSize);
+		for (size_t y = 0; y < height; ++y)
+		{
+			auto lineHeader = std::array<int32_t, 2>{static_cast<int32_t>(y), static_cast<int32_t>(lineSize)};
+			std::memcpy(block.data(), lineHeader.data(), sizeof(lineHeader));
+			std::byte* out = block.data() + sizeof(lineHeader);
+			const std::byte* line = pixels.data() + y * width * 4 * srcChannelSize;
+			for (auto [name, index] : Channels)
+			{
+				for (size_t x = 0; x < width; ++x)
+				{
+					const std::byte* src = line + (x * 4 + index) * srcChannelSize;
+					if (srcChannelSize == channelSize)
+					{
+						std::memcpy(out, src, channelSize);
+					}
+					else
+					{
+						float v = static_cast<float>(std::to_integer<uint8_t>(*src)) / 255.0f;
+						if (srgb && index != 3) v = srgbToLinear(v);
+						std::memcpy(out, &v, sizeof(float));
+					}
+					out += channelSize;
+				}
+			}
+			file.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(block.size()));
+		}
+		if (!file) throw std::runtime_error(fmt::format("Failed to write {}!", path.string()));
+	}
+}
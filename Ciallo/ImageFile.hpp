@@ -0,0 +1,23 @@
+#pragma once
+#include <filesystem>
+#include <span>
+
+namespace ciallo
+{
+	/**
+	 * \brief Writers of tightly packed RGBA pixels, as copied out of an image with default buffer row length.
+	 * Both throw std::runtime_error on failure and are safe to call from job threads.
+	 */
+	class ImageFile
+	{
+	public:
+		// 8 bit RGBA, written as is.
+		static void writePng(const std::filesystem::path& path, vk::Extent2D extent, std::span<const std::byte> pixels);
+		/**
+		 * \brief Uncompressed scanline OpenEXR with half or float channels.
+		 * Half and float formats are written as is. 8 bit formats are decoded from sRGB into float, EXR is linear.
+		 */
+		static void writeExr(const std::filesystem::path& path, vk::Extent2D extent, vk::Format format,
+		                     std::span<const std::byte> pixels);
+	};
+}
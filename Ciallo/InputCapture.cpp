@@ -0,0 +1,226 @@
+#include "pch.hpp"
+#include "InputCapture.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#define GLFW_EXPOSE_NATIVE_WIN32
+#include <GLFW/glfw3native.h>
+#endif
+
+namespace ciallo
+{
+	namespace
+	{
+		/**
+		 * Pen reports with the time and position the device gave them. Window procedure pushes every report
+		 * coalesced into a pointer message on main thread, capture thread forwards them in order.
+		 */
+		struct PenReports
+		{
+			std::atomic<bool> inRange{false};
+			InputCapture::Queue queue;
+			std::atomic<uint32_t> dropped{0};
+			InputSample last; // main thread only
+		};
+
+		PenReports pen;
+
+#ifdef _WIN32
+		WNDPROC previousWindowProc = nullptr;
+
+		// Steady clock of MSVC counts performance counter ticks, reports carry the tick they were taken at.
+		double reportTime(const POINTER_INFO& info)
+		{
+			static const double frequency = []
+			{
+				LARGE_INTEGER f;
+				QueryPerformanceFrequency(&f);
+				return static_cast<double>(f.QuadPart);
+			}();
+			return info.PerformanceCount ? static_cast<double>(info.PerformanceCount) / frequency : InputCapture::now();
+		}
+
+		void pushReport(const InputSample& s)
+		{
+			if (!pen.queue.push(s)) pen.dropped.fetch_add(1, std::memory_order_relaxed);
+			pen.last = s;
+		}
+
+		void readPenHistory(HWND hwnd, UINT32 id)
+		{
+			// Messages are handled once per frame, all reports since the previous one wait in the history.
+			static std::vector<POINTER_PEN_INFO> history;
+			UINT32 count = 0;
+			if (!GetPointerPenInfoHistory(id, &count, nullptr) || count == 0) return;
+			history.resize(count);
+			if (!GetPointerPenInfoHistory(id, &count, history.data())) return;
+			history.resize(count);
+			pen.inRange.store(true, std::memory_order_relaxed);
+			// Newest first.
+			for (const POINTER_PEN_INFO& info : history | views::reverse)
+			{
+				POINT p = info.pointerInfo.ptPixelLocation;
+				ScreenToClient(hwnd, &p);
+				InputSample s;
+				s.time = reportTime(info.pointerInfo);
+				s.position = {static_cast<float>(p.x), static_cast<float>(p.y)};
+				s.pressure = info.penMask & PEN_MASK_PRESSURE ? info.pressure / 1024.0f : 1.0f;
+				s.tilt = {
+					info.penMask & PEN_MASK_TILT_X ? static_cast<float>(info.tiltX) : 0.0f,
+					info.penMask & PEN_MASK_TILT_Y ? static_cast<float>(info.tiltY) : 0.0f
+				};
+				POINTER_FLAGS flags = info.pointerInfo.pointerFlags;
+				s.down = flags & POINTER_FLAG_INCONTACT && !(flags & POINTER_FLAG_UP);
+				pushReport(s);
+			}
+		}
+
+		LRESULT CALLBACK penWindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
+		{
+			switch (message)
+			{
+			case WM_POINTERDOWN:
+			case WM_POINTERUPDATE:
+			case WM_POINTERUP:
+				{
+					UINT32 id = GET_POINTERID_WPARAM(wParam);
+					POINTER_INPUT_TYPE type;
+					if (GetPointerType(id, &type) && type == PT_PEN) readPenHistory(hwnd, id);
+					break;
+				}
+			case WM_POINTERLEAVE:
+				if (!pen.inRange.load(std::memory_order_relaxed)) break;
+				// Leaving without lifting the pen still ends the stroke.
+				if (pen.last.down)
+				{
+					InputSample s = pen.last;
+					s.time = InputCapture::now();
+					s.down = false;
+					pushReport(s);
+				}
+				pen.inRange.store(false, std::memory_order_relaxed);
+				break;
+			default:
+				break;
+			}
+			// Unhandled pointer messages are promoted to mouse messages, glfw and ImGui keep working.
+			return CallWindowProcW(previousWindowProc, hwnd, message, wParam, lParam);
+		}
+#endif
+	}
+
+	InputCapture::InputCapture(const vulkan::Window& window, uint32_t rate):
+		m_period(std::chrono::nanoseconds(1'000'000'000ull / rate))
+	{
+#ifdef _WIN32
+		HWND hwnd = glfwGetWin32Window(window.glfwWindow());
+		m_nativeWindow = hwnd;
+		previousWindowProc = reinterpret_cast<WNDPROC>(
+			SetWindowLongPtrW(hwnd, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(&penWindowProc)));
+#endif
+		m_thread = std::jthread([this](std::stop_token stop) { loop(stop); });
+	}
+
+	InputCapture::~InputCapture()
+	{
+		m_thread.request_stop();
+		if (m_thread.joinable()) m_thread.join();
+#ifdef _WIN32
+		SetWindowLongPtrW(static_cast<HWND>(m_nativeWindow), GWLP_WNDPROC,
+		                  reinterpret_cast<LONG_PTR>(previousWindowProc));
+		previousWindowProc = nullptr;
+#endif
+	}
+
+	uint32_t InputCapture::dropped() const
+	{
+		return m_dropped.load(std::memory_order_relaxed) + pen.dropped.load(std::memory_order_relaxed);
+	}
+
+	double InputCapture::now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool InputCapture::sample(InputSample& s) const
+	{
+#ifdef _WIN32
+		HWND hwnd = static_cast<HWND>(m_nativeWindow);
+		POINT p;
+		if (!GetCursorPos(&p) || !ScreenToClient(hwnd, &p)) return false;
+		s.time = now();
+		s.position = {static_cast<float>(p.x), static_cast<float>(p.y)};
+		s.down = (GetAsyncKeyState(GetSystemMetrics(SM_SWAPBUTTON) ? VK_RBUTTON : VK_LBUTTON) & 0x8000) != 0;
+		s.pressure = 1.0f;
+		s.tilt = {0.0f, 0.0f};
+		// Input going to other applications is not ours.
+		if (s.down && GetForegroundWindow() != hwnd) s.down = false;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void InputCapture::loop(std::stop_token stop)
+	{
+#ifdef _WIN32
+		// Sleep has 1ms granularity at best, which is a whole period. High resolution timer does better when present.
+		HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+		                                      TIMER_ALL_ACCESS);
+#endif
+		InputSample last;
+		auto next = std::chrono::steady_clock::now();
+		auto forward = [&](const InputSample& s)
+		{
+			if (s.down || last.down)
+			{
+				bool moved = s.position != last.position || s.pressure != last.pressure || s.tilt != last.tilt;
+				if (moved || s.down != last.down)
+				{
+					if (!m_queue.push(s)) m_dropped.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+			last = s;
+		};
+		while (!stop.stop_requested())
+		{
+			// Pen reports keep their own time, the cursor is only sampled while no pen is around.
+			InputSample s;
+			bool penReported = false;
+			while (pen.queue.pop(s))
+			{
+				forward(s);
+				penReported = true;
+			}
+			if (!penReported && !pen.inRange.load(std::memory_order_relaxed) && sample(s))
+			{
+				forward(s);
+			}
+
+			next += m_period;
+			auto current = std::chrono::steady_clock::now();
+			if (next < current) next = current; // fell behind, do not burst to catch up
+#ifdef _WIN32
+			if (timer)
+			{
+				LARGE_INTEGER due;
+				due.QuadPart = -std::max<int64_t>(1, (next - current).count() / 100); // relative, 100ns unit
+				SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE);
+				WaitForSingleObject(timer, INFINITE);
+				continue;
+			}
+#endif
+			std::this_thread::sleep_until(next);
+		}
+#ifdef _WIN32
+		if (timer) CloseHandle(timer);
+#endif
+	}
+}
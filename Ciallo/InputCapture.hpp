@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "SpscQueue.hpp"
+#include "Window.hpp"
+
+namespace ciallo
+{
+	struct InputSample
+	{
+		double time = 0.0; // seconds, steady clock, see InputCapture::now()
+		glm::vec2 position{0.0f, 0.0f}; // window client coordinate in pixel, same space as ImGui mouse position
+		float pressure = 1.0f; // 0 to 1, mouse reports 1
+		glm::vec2 tilt{0.0f, 0.0f}; // degree, pen only
+		bool down = false;
+	};
+
+	/**
+	 * \brief Samples pen and mouse on a dedicated thread at device rate, independent of frame rate.
+	 * Samples are pushed only while the button is down and on press and release, main thread drains them with pop().
+	 * Mouse cursor and button are read by the capture thread. On Windows pens are read from WM_POINTER messages of
+	 * the window with GetPointerPenInfoHistory, so every report coalesced between two frames arrives with its own
+	 * time, position, pressure and tilt, and the capture thread forwards them in order.
+	 * One instance at a time, it hooks the window procedure.
+	 */
+	class InputCapture
+	{
+	public:
+		constexpr static uint32_t DefaultRate = 1000; // Hz, above every common tablet report rate
+		using Queue = SpscQueue<InputSample, 4096>;
+
+	private:
+		void* m_nativeWindow = nullptr;
+		std::chrono::nanoseconds m_period;
+		Queue m_queue;
+		std::atomic<uint32_t> m_dropped{0};
+		std::jthread m_thread; // last, stops before everything above goes away
+
+		void loop(std::stop_token stop);
+		bool sample(InputSample& s) const;
+	public:
+		explicit InputCapture(const vulkan::Window& window, uint32_t rate = DefaultRate);
+		~InputCapture();
+
+		InputCapture(const InputCapture& other) = delete;
+		InputCapture(InputCapture&& other) = delete;
+		InputCapture& operator=(const InputCapture& other) = delete;
+		InputCapture& operator=(InputCapture&& other) = delete;
+
+		// Main thread only.
+		bool pop(InputSample& s) { return m_queue.pop(s); }
+		// Samples lost to a full queue, main thread fell behind by more than the queue capacity.
+		uint32_t dropped() const;
+
+		static double now();
+	};
+}
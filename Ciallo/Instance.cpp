@@ -69,14 +69,34 @@ namespace ciallo::vulkan
 		};
 		vk::ValidationFeaturesEXT validationFeatures{enableValidateFeatures};
 
+		// Machines without the SDK, like CI running a software driver, go on without validation.
+		std::vector<const char*> layers;
+		auto availableLayers = vk::enumerateInstanceLayerProperties();
+		for (const char* layer : m_validationLayers)
+		{
+			bool available = ranges::any_of(availableLayers, [layer](const vk::LayerProperties& properties)
+			{
+				return std::string_view(properties.layerName) == layer;
+			});
+			if (available)
+			{
+				layers.push_back(layer);
+			}
+			else
+			{
+				spdlog::warn("Layer {} is not available, running without it.", layer);
+			}
+		}
+
 		auto createInfo = vk::InstanceCreateInfo(
 			vk::InstanceCreateFlags(),
 			&appInfo,
-			m_validationLayers, // enabled layers
+			layers, // enabled layers
 			m_instanceExtensions // enabled extensions
 		);
 
 		vk::StructureChain c{createInfo, validationFeatures, messengerCreateInfo};
+		if (layers.size() != m_validationLayers.size()) c.unlink<vk::ValidationFeaturesEXT>();
 
 		m_instance = vk::createInstanceUnique(c.get<vk::InstanceCreateInfo>());
 
@@ -89,7 +109,14 @@ namespace ciallo::vulkan
 		m_instanceExtensions.insert(m_instanceExtensions.end(), extensions.begin(), extensions.end());
 	}
 
-		// need a queue family be able to graphics, compute, transfer and presents
+	std::vector<const char*> Instance::requiredDeviceExtensions(bool present)
+	{
+		std::vector<const char*> extensions = m_deviceExtensions;
+		if (present) extensions.insert(extensions.end(), m_presentExtensions.begin(), m_presentExtensions.end());
+		return extensions;
+	}
+
+		// need a queue family be able to graphics, compute, transfer and presents, presents only with a surface
 	int Instance::findRequiredQueueFamily(vk::PhysicalDevice device, vk::SurfaceKHR surface)
 	{
 		auto queueFamilies = device.getQueueFamilyProperties();
@@ -99,7 +126,7 @@ namespace ciallo::vulkan
 		{
 			if (qF.queueCount > 0 && (qF.queueFlags & req) == req)
 			{
-				if (bool support = device.getSurfaceSupportKHR(static_cast<uint32_t>(i), surface))
+				if (!surface || device.getSurfaceSupportKHR(static_cast<uint32_t>(i), surface))
 					return static_cast<int>(i);
 			}
 		}
@@ -119,7 +146,8 @@ namespace ciallo::vulkan
 
 		// device extension support
 		auto extensions = device.enumerateDeviceExtensionProperties();
-		std::unordered_set<std::string> requiredExtensions{m_deviceExtensions.begin(), m_deviceExtensions.end()};
+		auto required = requiredDeviceExtensions(static_cast<bool>(surface));
+		std::unordered_set<std::string> requiredExtensions{required.begin(), required.end()};
 
 		for (const auto& extension : extensions)
 		{
@@ -134,7 +162,7 @@ namespace ciallo::vulkan
 	/**
 	 * \brief Choose from available physical device
 	 * \param instance Vulkan instance
-	 * \param surface Vulkan surface, use it for checking present capability of queue 
+	 * \param surface Vulkan surface, use it for checking present capability of queue. Null for headless use.
 	 * \return Physical device index
 	 */
 	vk::PhysicalDevice Instance::pickPhysicalDevice(vk::Instance instance, vk::SurfaceKHR surface)
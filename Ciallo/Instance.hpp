@@ -20,11 +20,14 @@ namespace ciallo::vulkan
 			"VK_EXT_debug_utils"
 		};
 		static inline std::vector<const char*> m_deviceExtensions{
-			"VK_KHR_swapchain",
 			//ShenCiao's AMD Gpu(integrated) does not support these :(. I need them!!!
 			// "VK_EXT_blend_operation_advanced",
 			// "VK_EXT_vertex_input_dynamic_state",
 		};
+		// Only required by devices presenting to a surface.
+		static inline std::vector<const char*> m_presentExtensions{
+			"VK_KHR_swapchain",
+		};
 
 	public:
 		Instance();
@@ -51,6 +54,8 @@ namespace ciallo::vulkan
 		}
 
 		static void addExtensions(const std::vector<const char *>& extensions);
+		static std::vector<const char*> requiredDeviceExtensions(bool present);
+		// Null surface is for headless devices, which need neither presenting queues nor swapchains.
 		static int findRequiredQueueFamily(vk::PhysicalDevice device, vk::SurfaceKHR surface);
 		static bool isPhysicalDeviceValid(vk::PhysicalDevice device, vk::SurfaceKHR surface);
 		static vk::PhysicalDevice pickPhysicalDevice(vk::Instance instance, vk::SurfaceKHR surface);
@@ -0,0 +1,137 @@
+#include "pch.hpp"
+#include "JobSystem.hpp"
+
+namespace ciallo
+{
+	JobSystem::JobSystem(uint32_t workerCount)
+	{
+		for (uint32_t i = 0; i < workerCount + 1; ++i)
+		{
+			m_queues.push_back(std::make_unique<Queue>());
+		}
+		for (uint32_t i = 1; i < workerCount + 1; ++i)
+		{
+			m_workers.emplace_back([this, i] { workerLoop(i); });
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard lock(m_sleepMutex);
+			m_stop = true;
+		}
+		m_sleepCv.notify_all();
+		m_workers.clear(); // join
+	}
+
+	void JobSystem::run(TaskGroup& group, Job job)
+	{
+		group.m_pending.fetch_add(1, std::memory_order_relaxed);
+		Queue& queue = *m_queues[queueIndex()];
+		{
+			std::lock_guard lock(queue.mutex);
+			queue.tasks.push_back({std::move(job), &group});
+		}
+		m_queuedCount.fetch_add(1, std::memory_order_release);
+		// Empty critical section, prevents wake up from getting lost between predicate check and sleep.
+		{
+			std::lock_guard lock(m_sleepMutex);
+		}
+		m_sleepCv.notify_one();
+	}
+
+	void JobSystem::wait(TaskGroup& group)
+	{
+		uint32_t index = queueIndex();
+		while (!group.done())
+		{
+			Task task;
+			if (tryPop(index, task))
+			{
+				execute(task);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+		std::exception_ptr error;
+		{
+			std::lock_guard lock(group.m_errorMutex);
+			error = std::exchange(group.m_error, nullptr);
+		}
+		if (error) std::rethrow_exception(error);
+	}
+
+	uint32_t JobSystem::queueIndex() const
+	{
+		return t_owner == this ? t_queueIndex : 0u;
+	}
+
+	bool JobSystem::tryPop(uint32_t index, Task& task)
+	{
+		if (m_queuedCount.load(std::memory_order_acquire) == 0) return false;
+
+		const auto n = static_cast<uint32_t>(m_queues.size());
+		for (uint32_t k = 0; k < n; ++k)
+		{
+			uint32_t victim = (index + k) % n;
+			Queue& queue = *m_queues[victim];
+			std::lock_guard lock(queue.mutex);
+			if (queue.tasks.empty()) continue;
+
+			// Own queue is LIFO for cache locality, stealing takes the oldest and usually the largest job.
+			if (victim == index)
+			{
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else
+			{
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			m_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	void JobSystem::execute(Task& task)
+	{
+		// Escaping a worker would terminate, and the group would never be done.
+		try
+		{
+			task.job();
+		}
+		catch (...)
+		{
+			std::lock_guard lock(task.group->m_errorMutex);
+			if (!task.group->m_error) task.group->m_error = std::current_exception();
+		}
+		task.group->m_pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	void JobSystem::workerLoop(uint32_t index)
+	{
+		t_owner = this;
+		t_queueIndex = index;
+		while (true)
+		{
+			Task task;
+			if (tryPop(index, task))
+			{
+				execute(task);
+				continue;
+			}
+
+			std::unique_lock lock(m_sleepMutex);
+			m_sleepCv.wait(lock, [this]
+			{
+				return m_stop || m_queuedCount.load(std::memory_order_acquire) > 0;
+			});
+			if (m_stop && m_queuedCount.load(std::memory_order_acquire) == 0) return;
+		}
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace ciallo
+{
+	/**
+	 * \brief Work stealing job system.
+	 * Every worker owns a queue, pops its own jobs in LIFO order and steals from others in FIFO order.
+	 * Threads outside the system share queue 0. Waiting threads execute jobs instead of blocking, so jobs
+	 * are free to fork and join nested jobs.
+	 * Results are deterministic as long as a job writes only to its own slots, scheduling order is not.
+	 * A job throwing still counts as finished, the first exception of a group is rethrown by wait().
+	 */
+	class JobSystem
+	{
+	public:
+		using Job = std::function<void()>;
+
+		class TaskGroup
+		{
+			friend class JobSystem;
+			std::atomic<uint32_t> m_pending{0};
+			std::mutex m_errorMutex;
+			std::exception_ptr m_error; // first one thrown since the last wait()
+		public:
+			bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+		};
+
+	private:
+		struct Task
+		{
+			Job job;
+			TaskGroup* group = nullptr;
+		};
+
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> m_queues;
+		std::vector<std::jthread> m_workers;
+		std::atomic<uint32_t> m_queuedCount{0};
+		std::atomic<bool> m_stop{false};
+		std::mutex m_sleepMutex;
+		std::condition_variable m_sleepCv;
+
+		static inline thread_local const JobSystem* t_owner = nullptr;
+		static inline thread_local uint32_t t_queueIndex = 0;
+
+		uint32_t queueIndex() const;
+		bool tryPop(uint32_t index, Task& task);
+		void execute(Task& task);
+		void workerLoop(uint32_t index);
+	public:
+		// Worker count excludes the main thread, which works in wait().
+		explicit JobSystem(uint32_t workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1u);
+		JobSystem(const JobSystem& other) = delete;
+		JobSystem(JobSystem&& other) = delete;
+		JobSystem& operator=(const JobSystem& other) = delete;
+		JobSystem& operator=(JobSystem&& other) = delete;
+		~JobSystem();
+
+		// Fork
+		void run(TaskGroup& group, Job job);
+		// Join, executes queued jobs while waiting. Rethrows the first exception of a job once all are done.
+		void wait(TaskGroup& group);
+
+		uint32_t threadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1u; }
+
+		/**
+		 * \brief Call func(i) for i in [0, count), split into chunks of grain. Blocks until all done.
+		 * \param grain Zero picks a chunk size giving every thread a few chunks.
+		 */
+		template <typename Func>
+		void parallelFor(size_t count, Func&& func, size_t grain = 0)
+		{
+			if (count == 0) return;
+			if (grain == 0) grain = std::max<size_t>(1, count / (threadCount() * 4));
+			TaskGroup group;
+			for (size_t begin = 0; begin < count; begin += grain)
+			{
+				size_t end = std::min(count, begin + grain);
+				run(group, [&func, begin, end]
+				{
+					for (size_t i = begin; i < end; ++i) func(i);
+				});
+			}
+			wait(group);
+		}
+
+		/**
+		 * \brief Parallel version of view.each(func), func is called with entity followed by components.
+		 * Only components can be touched in func, creating or destroying anything in registry is a data race.
+		 */
+		template <typename View, typename Func>
+		void parallelEach(View view, Func&& func, size_t grain = 0)
+		{
+			std::vector<entt::entity> entities{view.begin(), view.end()};
+			parallelFor(entities.size(), [&view, &entities, &func](size_t i)
+			{
+				entt::entity e = entities[i];
+				std::apply(func, std::tuple_cat(std::make_tuple(e), view.get(e)));
+			}, grain);
+		}
+	};
+}
@@ -1,2 +1,16 @@
 #include "pch.hpp"
 #include "Layer.hpp"
+
+namespace ciallo
+{
+	LayerMemberCpo& joinLayer(entt::registry& r, entt::entity e, entt::entity layer)
+	{
+		uint64_t order = r.get<LayerCpo>(layer).nextOrder++;
+		return r.emplace<LayerMemberCpo>(e, layer, order);
+	}
+
+	void sortByLayerOrder(const entt::registry& r, std::vector<entt::entity>& members)
+	{
+		std::ranges::sort(members, {}, [&](entt::entity e) { return r.get<LayerMemberCpo>(e).order; });
+	}
+}
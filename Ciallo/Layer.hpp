@@ -13,5 +13,24 @@ namespace ciallo
 	{
 		float alpha = 1.0f;
 		BlendMode blend = BlendMode::Normal;
+		uint64_t nextOrder = 0; // given to the next member joining
 	};
+
+	// On drawing entity, layers from bottom to top.
+	struct LayerStackCpo
+	{
+		std::vector<entt::entity> layers;
+	};
+
+	// On stroke entity, the layer it is drawn in. Members are drawn from low to high order, ties never happen.
+	struct LayerMemberCpo
+	{
+		entt::entity layer{entt::null};
+		uint64_t order = 0;
+	};
+
+	// Put e on top of layer. Undo restores LayerMemberCpo as it was, so a restored stroke keeps its place.
+	LayerMemberCpo& joinLayer(entt::registry& r, entt::entity e, entt::entity layer);
+	// By order, the order members of a layer are drawn in.
+	void sortByLayerOrder(const entt::registry& r, std::vector<entt::entity>& members);
 }
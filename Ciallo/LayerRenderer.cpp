@@ -1,7 +1,501 @@
 ﻿#include "pch.hpp"
 #include "LayerRenderer.hpp"
 
+#include "vku.hpp"
+#include "ArticulatedLineRenderer.hpp"
+#include "BezierTransformer.hpp"
+#include "CanvasDisplay.hpp"
+#include "CanvasPanel.hpp"
+#include "Drawing.hpp"
+#include "FillRegion.hpp"
+#include "Layer.hpp"
+#include "LayerResidency.hpp"
+#include "Stroke.hpp"
+#include "StrokeLod.hpp"
+
 namespace ciallo
 {
-	
+	namespace
+	{
+		// Image format qualifier, the composite shader of a storage format is named after it.
+		const char* formatQualifier(vk::Format format)
+		{
+			switch (format)
+			{
+			case vk::Format::eR16G16B16A16Sfloat:
+				return "rgba16f";
+			case vk::Format::eR32G32B32A32Sfloat:
+				return "rgba32f";
+			default:
+				return "rgba8";
+			}
+		}
+
+		// Screen scale rounded up to a power of two, zooming by less than double keeps the level of detail.
+		float quantizedScale(float screenPixelsPerMeter, float targetPixelsPerMeter)
+		{
+			if (screenPixelsPerMeter <= 0.0f) return targetPixelsPerMeter;
+			return std::min(std::exp2(std::ceil(std::log2(screenPixelsPerMeter))), targetPixelsPerMeter);
+		}
+	}
+
+	LayerRenderer::LayerRenderer(vulkan::Device* device, UploadScheduler& uploads): m_device(*device)
+	{
+		for (CanvasFormat format : supportedCanvasFormats(device->physicalDevice()))
+		{
+			vk::Format storage = storageFormat(format);
+			if (m_compShaders.contains(storage)) continue;
+			m_compShaders[storage] = vulkan::ShaderModule(
+				*device, vk::ShaderStageFlagBits::eCompute,
+				fmt::format("./shaders/layerComposite.{}.comp.spv", formatQualifier(storage)));
+		}
+		m_sampler = vku::SamplerMaker().createUnique(m_device);
+		VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+		m_layerParams = vulkan::Buffer(*device, info, MaxLayers * sizeof(LayerParams),
+		                               vk::BufferUsageFlagBits::eStorageBuffer);
+		genEmptyLayer(device, uploads);
+		genDescriptorSet(device->descriptorPool());
+		genCompPipeline();
+	}
+
+	void LayerRenderer::genEmptyLayer(vulkan::Device* device, UploadScheduler& uploads)
+	{
+		m_emptyLayer = vulkan::Image(*device, vulkan::MemoryAuto, vk::Format::eR8G8B8A8Unorm, 1u, 1u,
+		                             vk::SampleCountFlagBits::e1,
+		                             vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+		constexpr std::array<std::byte, 4> transparent{};
+		uploads.upload(m_emptyLayer, transparent);
+	}
+
+	void LayerRenderer::genDescriptorSet(vk::DescriptorPool pool)
+	{
+		vku::DescriptorSetLayoutMaker layoutMaker;
+		layoutMaker.image(0, vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute, 1)
+		           .image(1, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, MaxLayers)
+		           .buffer(2, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute, 1)
+		           .image(3, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 1);
+		m_descriptorSetLayout = layoutMaker.createUnique(m_device);
+		// More sets are made once a drawing has more than MaxLayers layers.
+		m_descriptorPool = pool;
+		vku::DescriptorSetMaker maker;
+		maker.layout(*m_descriptorSetLayout);
+		m_descriptorSets = maker.create(m_device, pool);
+	}
+
+	void LayerRenderer::genCompPipeline()
+	{
+		vku::PipelineLayoutMaker layoutMaker;
+		layoutMaker.descriptorSetLayout(*m_descriptorSetLayout)
+		           .pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstant));
+		m_pipelineLayout = layoutMaker.createUnique(m_device);
+
+		for (auto& [format, shader] : m_compShaders)
+		{
+			vku::ComputePipelineMaker maker{};
+			maker.shader(vk::ShaderStageFlagBits::eCompute, shader);
+			m_pipelines[format] = maker.createUnique(m_device, nullptr, *m_pipelineLayout);
+		}
+	}
+
+	void LayerRenderer::updateDescriptorSet(uint32_t batch, const CanvasTargetCpo& canvas,
+	                                        std::span<const vulkan::Image* const> layers)
+	{
+		while (m_descriptorSets.size() <= batch)
+		{
+			vku::DescriptorSetMaker maker;
+			maker.layout(*m_descriptorSetLayout);
+			m_descriptorSets.push_back(maker.create(m_device, m_descriptorPool)[0]);
+		}
+		// Previous frame is finished, rewriting the set is safe. Always rewritten, handles of evicted targets may
+		// be reused by new ones, and the params buffer grows with the layer count.
+		vku::DescriptorSetUpdater updater(1, MaxLayers + 2);
+		updater.beginDescriptorSet(m_descriptorSets[batch])
+		       .beginImages(0, 0, vk::DescriptorType::eStorageImage)
+		       .image(nullptr, canvas.storage(), vk::ImageLayout::eGeneral)
+		       .beginImages(1, 0, vk::DescriptorType::eCombinedImageSampler);
+		for (uint32_t i = 0; i < MaxLayers; ++i)
+		{
+			const vulkan::Image& layer = i < layers.size() ? *layers[i] : m_emptyLayer;
+			updater.image(*m_sampler, layer.imageView(), vk::ImageLayout::eGeneral);
+		}
+		// Sampled through the view of the canvas format, sRGB canvases are decoded again.
+		updater.beginImages(3, 0, vk::DescriptorType::eCombinedImageSampler)
+		       .image(*m_sampler, canvas.image.imageView(), vk::ImageLayout::eGeneral)
+		       .beginBuffers(2, 0, vk::DescriptorType::eStorageBuffer)
+		       .buffer(m_layerParams);
+		updater.update(m_device);
+	}
+
+	void LayerRenderer::markDirty(entt::registry& r, entt::entity e)
+	{
+		auto* member = r.try_get<LayerMemberCpo>(e);
+		if (member && r.valid(member->layer))
+		{
+			r.emplace_or_replace<LayerDirtyTag>(member->layer);
+		}
+	}
+
+	void LayerRenderer::connect(entt::registry& r)
+	{
+		r.on_construct<StrokeCpo>().connect<&LayerRenderer::markDirty>();
+		r.on_update<StrokeCpo>().connect<&LayerRenderer::markDirty>();
+		r.on_destroy<StrokeCpo>().connect<&LayerRenderer::markDirty>();
+		// Moving a stroke to another layer: remove LayerMemberCpo then emplace, so both layers are marked.
+		r.on_construct<LayerMemberCpo>().connect<&LayerRenderer::markDirty>();
+		r.on_update<LayerMemberCpo>().connect<&LayerRenderer::markDirty>();
+		r.on_destroy<LayerMemberCpo>().connect<&LayerRenderer::markDirty>();
+		// Strokes under StrokeTransformer leave their layer until the session ends.
+		r.on_construct<TransformingTag>().connect<&LayerRenderer::markDirty>();
+		r.on_destroy<TransformingTag>().connect<&LayerRenderer::markDirty>();
+		r.on_construct<FillCpo>().connect<&LayerRenderer::markDirty>();
+		r.on_update<FillCpo>().connect<&LayerRenderer::markDirty>();
+		r.on_destroy<FillCpo>().connect<&LayerRenderer::markDirty>();
+	}
+
+	std::unique_ptr<vulkan::Image> LayerRenderer::createTarget(vulkan::Device& device, vk::Extent2D extent,
+	                                                         vk::Format format, bool sparse)
+	{
+		vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled |
+			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc;
+		if (sparse && device.sparseResidencySupported())
+		{
+			return std::make_unique<vulkan::SparseImage>(device, format, extent.width, extent.height, usage);
+		}
+		return std::make_unique<vulkan::Image>(device.allocator(), vulkan::MemoryAuto, format, extent.width,
+		                                       extent.height, vk::SampleCountFlagBits::e1, usage);
+	}
+
+	vk::DeviceSize LayerRenderer::commitTiles(entt::registry& r, vulkan::SparseImage& target, entt::entity drawing,
+	                                          const std::vector<entt::entity>& strokes,
+	                                          const std::vector<entt::entity>& fills)
+	{
+		const auto& view = r.get<ViewRectCpo>(drawing);
+		glm::vec2 extent{target.width(), target.height()};
+		std::vector<vulkan::SparseImage::Region> regions;
+		auto addRegion = [&](glm::vec2 min, glm::vec2 max)
+		{
+			min = (min - view.min) / (view.max - view.min) * extent;
+			max = (max - view.min) / (view.max - view.min) * extent;
+			min = glm::clamp(glm::floor(min), glm::vec2(0.0f), extent);
+			max = glm::clamp(glm::ceil(max) + 1.0f, glm::vec2(0.0f), extent);
+			if (min.x >= max.x || min.y >= max.y) return;
+			regions.push_back({glm::uvec2(min), glm::uvec2(max)});
+		};
+		for (entt::entity e : strokes)
+		{
+			const auto& stroke = r.get<StrokeCpo>(e);
+			if (stroke.position.empty()) continue;
+			glm::vec2 min{std::numeric_limits<float>::max()}, max{std::numeric_limits<float>::lowest()};
+			for (const geom::Point& p : stroke.position)
+			{
+				min = glm::min(min, {p.x(), p.y()});
+				max = glm::max(max, {p.x(), p.y()});
+			}
+			float radius = stroke.thickness.empty() ? 0.0f : *std::ranges::max_element(stroke.thickness);
+			addRegion(min - radius, max + radius);
+		}
+		if (auto* fillRegions = r.try_get<FillRegionsCpo>(drawing))
+		{
+			for (entt::entity e : fills)
+			{
+				int32_t region = fillRegions->find(r.get<FillCpo>(e).seed);
+				if (region < 0) continue;
+				const glm::vec4& bounds = fillRegions->bounds[region];
+				addRegion({bounds.x, bounds.y}, {bounds.z, bounds.w});
+			}
+		}
+		return target.makeResident(regions);
+	}
+
+	void LayerRenderer::rasterize(entt::registry& r, vk::CommandBuffer cb, ArticulatedLineEngine& engine,
+	                              StrokeAccumulator& accumulator, FillRenderer& fillRenderer,
+	                              const vulkan::Image* fillStencil, entt::entity drawing, entt::entity layer,
+	                              const LayerCoverageCpo& coverage, const std::vector<entt::entity>& strokes,
+	                              const std::vector<entt::entity>& fills)
+	{
+		vulkan::Image& target = *r.get<LayerTargetCpo>(layer).image;
+		// Absent from registries of exports, which never evict.
+		LayerResidency* const* residency = r.ctx().find<LayerResidency*>();
+		if (auto* sparse = dynamic_cast<vulkan::SparseImage*>(&target))
+		{
+			vk::DeviceSize missing = commitTiles(r, *sparse, drawing, strokes, fills);
+			if (missing > 0 && residency) (*residency)->allocationFailed(layer, missing);
+		}
+		if (residency) (*residency)->markEdited(r, layer);
+		cb.clearColorImage(target, vk::ImageLayout::eGeneral, vk::ClearColorValue{},
+		                   vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0u, 1u, 0u, 1u});
+		vk::MemoryBarrier2 clearBarrier{
+			vk::PipelineStageFlagBits2::eClear, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+			vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite
+		};
+		cb.pipelineBarrier2({{}, clearBarrier, {}, {}});
+
+		if (!fills.empty() && fillStencil)
+		{
+			fillRenderer.render(r, cb, drawing, target, *fillStencil, fills);
+			vk::MemoryBarrier2 fillBarrier{
+				vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+				vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eComputeShader,
+				vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite |
+				vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite
+			};
+			cb.pipelineBarrier2({{}, fillBarrier, {}, {}});
+		}
+
+		// Consecutive strokes of the same kind are drawn together, order between kinds is kept.
+		size_t begin = 0;
+		while (begin < strokes.size())
+		{
+			bool accumulated = StrokeAccumulator::accumulated(r, strokes[begin]);
+			size_t end = begin + 1;
+			while (end < strokes.size() && StrokeAccumulator::accumulated(r, strokes[end]) == accumulated) ++end;
+			std::vector run(strokes.begin() + begin, strokes.begin() + end);
+			if (accumulated)
+			{
+				accumulator.render(cb, target, run);
+			}
+			else
+			{
+				drawLines(r, cb, engine, target, coverage.pixelsPerMeter, run);
+			}
+			begin = end;
+		}
+	}
+
+	void LayerRenderer::drawLines(entt::registry& r, vk::CommandBuffer cb, ArticulatedLineEngine& engine,
+	                              const vulkan::Image& target, float pixelsPerMeter,
+	                              const std::vector<entt::entity>& strokes)
+	{
+		vk::Rect2D area{{0, 0}, target.extent2D()};
+		vk::RenderingAttachmentInfo renderingAttachmentInfo{target.imageView(), vk::ImageLayout::eGeneral};
+		std::vector colorAttachments{renderingAttachmentInfo};
+		vk::RenderingInfo renderingInfo{{}, area, 1, 0, colorAttachments, {}, {}};
+		cb.beginRendering(renderingInfo);
+		vk::Viewport fullViewport{
+			0, 0, static_cast<float>(target.width()), static_cast<float>(target.height()), 0.0f, 1.0f
+		};
+		cb.setViewport(0, fullViewport);
+		cb.setScissor(0, area);
+		for (entt::entity stroke : strokes)
+		{
+			entt::entity brush = r.get<StrokeCpo>(stroke).brush;
+			if (!r.all_of<ArticulatedLineStrokeCpo>(stroke) || !r.valid(brush) ||
+				!r.all_of<ArticulatedLineBrushCpo>(brush))
+				continue;
+			engine.render(r, brush, stroke, cb, target.format(), pixelsPerMeter);
+		}
+		cb.endRendering();
+	}
+
+	void LayerRenderer::render(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing,
+	                           ArticulatedLineEngine& engine, StrokeAccumulator& accumulator,
+	                           FillRenderer& fillRenderer, const vulkan::Image* fillStencil)
+	{
+		const auto& canvasTarget = r.get<CanvasTargetCpo>(drawing);
+		const vulkan::Image& canvas = canvasTarget.image;
+
+		std::vector<entt::entity> layers;
+		if (auto* stack = r.try_get<LayerStackCpo>(drawing))
+		{
+			for (entt::entity layer : stack->layers)
+			{
+				if (r.valid(layer) && r.all_of<LayerCpo>(layer)) layers.push_back(layer);
+			}
+		}
+
+		// Targets follow canvas size and format, a new target has nothing in it yet.
+		bool newTarget = false;
+		for (entt::entity layer : layers)
+		{
+			auto* target = r.try_get<LayerTargetCpo>(layer);
+			if (target && target->image->extent2D() == canvas.extent2D() &&
+				target->image->format() == canvas.format())
+				continue;
+			auto& image = r.emplace_or_replace<LayerTargetCpo>(
+				layer, createTarget(*r.ctx().at<vulkan::Device*>(), canvas.extent2D(), canvas.format(),
+				                    sparseTargets)).image;
+			image->changeLayout(cb, vk::ImageLayout::eGeneral);
+			r.emplace_or_replace<LayerDirtyTag>(layer);
+			newTarget = true;
+		}
+		if (newTarget)
+		{
+			vk::MemoryBarrier2 layoutBarrier{
+				vk::PipelineStageFlagBits2::eAllCommands, {},
+				vk::PipelineStageFlagBits2::eClear, vk::AccessFlagBits2::eTransferWrite
+			};
+			cb.pipelineBarrier2({{}, layoutBarrier, {}, {}});
+		}
+
+		// Only dirty layers are rasterized again, strokes of the rest are not touched.
+		std::unordered_map<entt::entity, std::vector<entt::entity>> dirtyStrokes;
+		for (entt::entity layer : layers)
+		{
+			if (r.all_of<LayerDirtyTag>(layer)) dirtyStrokes[layer];
+		}
+		if (!dirtyStrokes.empty())
+		{
+			// Strokes outside coverage are left out of the target, their bounds include thickness.
+			LayerCoverageCpo coverage = ViewportCuller::coverage(r, drawing, canvas.width());
+			auto members = r.view<StrokeCpo, LayerMemberCpo>(entt::exclude<TransformingTag>);
+			for (auto&& [e, stroke, member] : members.each())
+			{
+				auto it = dirtyStrokes.find(member.layer);
+				if (it == dirtyStrokes.end()) continue;
+				auto* bounds = r.try_get<StrokeBoundsCpo>(e);
+				if (bounds && !bounds->intersects(coverage.coveredMin, coverage.coveredMax)) continue;
+				it->second.push_back(e);
+			}
+			std::unordered_map<entt::entity, std::vector<entt::entity>> dirtyFills;
+			for (auto&& [e, fill, member] : r.view<FillCpo, LayerMemberCpo>().each())
+			{
+				if (dirtyStrokes.contains(member.layer)) dirtyFills[member.layer].push_back(e);
+			}
+			// Views iterate in no useful order, overlapping members stack by their order in the layer.
+			for (auto& [layer, strokes] : dirtyStrokes)
+			{
+				sortByLayerOrder(r, strokes);
+			}
+			for (auto& [layer, fills] : dirtyFills)
+			{
+				sortByLayerOrder(r, fills);
+			}
+			// One upload for the accumulated strokes of all dirty layers.
+			std::vector<entt::entity> accumulated;
+			for (auto& [layer, strokes] : dirtyStrokes)
+			{
+				std::ranges::copy_if(strokes, std::back_inserter(accumulated), [&](entt::entity e)
+				{
+					return StrokeAccumulator::accumulated(r, e);
+				});
+			}
+			accumulator.upload(r, cb, drawing, canvas.extent2D(), accumulated);
+			for (auto& [layer, strokes] : dirtyStrokes)
+			{
+				rasterize(r, cb, engine, accumulator, fillRenderer, fillStencil, drawing, layer, coverage, strokes,
+				          dirtyFills[layer]);
+				r.emplace_or_replace<LayerCoverageCpo>(layer, coverage);
+				r.remove<LayerDirtyTag>(layer);
+			}
+			vk::MemoryBarrier2 rasterBarrier{
+				vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+				vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead
+			};
+			cb.pipelineBarrier2({{}, rasterBarrier, {}, {}});
+		}
+
+		std::vector<const vulkan::Image*> targets;
+		std::vector<LayerParams> params;
+		for (entt::entity layer : layers)
+		{
+			const auto& layerCpo = r.get<LayerCpo>(layer);
+			targets.push_back(r.get<LayerTargetCpo>(layer).image.get());
+			params.push_back({layerCpo.alpha, static_cast<uint32_t>(layerCpo.blend)});
+		}
+		if (params.size() > m_layerParamsCapacity)
+		{
+			m_layerParamsCapacity = static_cast<uint32_t>((params.size() + MaxLayers - 1) / MaxLayers * MaxLayers);
+			VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+			m_layerParams = vulkan::Buffer(*r.ctx().at<vulkan::Device*>(), info,
+			                               m_layerParamsCapacity * sizeof(LayerParams),
+			                               vk::BufferUsageFlagBits::eStorageBuffer);
+		}
+		if (!params.empty())
+		{
+			m_layerParams.uploadLocal(params.data(), params.size() * sizeof(LayerParams));
+		}
+
+		cb.bindPipeline(vk::PipelineBindPoint::eCompute, *m_pipelines.at(storageFormat(canvasFormatOf(r, drawing))));
+		// No layers still clears the canvas to background.
+		uint32_t batchCount = std::max((static_cast<uint32_t>(targets.size()) + MaxLayers - 1) / MaxLayers, 1u);
+		for (uint32_t batch = 0; batch < batchCount; ++batch)
+		{
+			uint32_t first = batch * MaxLayers;
+			uint32_t count = std::min(static_cast<uint32_t>(targets.size()) - first, MaxLayers);
+			if (batch > 0)
+			{
+				// Next batch samples what the last one stored.
+				vk::MemoryBarrier2 batchBarrier{
+					vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+					vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead
+				};
+				cb.pipelineBarrier2({{}, batchBarrier, {}, {}});
+			}
+			updateDescriptorSet(batch, canvasTarget, std::span(targets).subspan(first, count));
+			PushConstant pushConstant{
+				canvasColor(canvasFormatOf(r, drawing), background), count, canvasTarget.storageView ? 1u : 0u,
+				first, batch > 0 ? 1u : 0u
+			};
+			cb.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *m_pipelineLayout, 0, m_descriptorSets[batch], {});
+			cb.pushConstants<PushConstant>(*m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pushConstant);
+			cb.dispatch((canvas.width() + 15) / 16, (canvas.height() + 15) / 16, 1);
+		}
+	}
+
+	bool LayerCoverageCpo::contains(glm::vec2 min, glm::vec2 max) const
+	{
+		return coveredMin.x <= min.x && coveredMin.y <= min.y && max.x <= coveredMax.x && max.y <= coveredMax.y;
+	}
+
+	void ViewportCuller::update(entt::registry& r)
+	{
+		r.clear<DrawingVisibilityCpo>();
+		for (auto&& [e, panel] : r.view<CanvasPanelCpo>().each())
+		{
+			if (!r.valid(panel.drawing) || panel.pixelsPerMeter <= 0.0f) continue;
+			if (auto* visibility = r.try_get<DrawingVisibilityCpo>(panel.drawing))
+			{
+				visibility->visibleMin = glm::min(visibility->visibleMin, panel.visibleMin);
+				visibility->visibleMax = glm::max(visibility->visibleMax, panel.visibleMax);
+				visibility->pixelsPerMeter = std::max(visibility->pixelsPerMeter, panel.pixelsPerMeter);
+			}
+			else
+			{
+				r.emplace<DrawingVisibilityCpo>(panel.drawing, panel.visibleMin, panel.visibleMax,
+				                                panel.pixelsPerMeter);
+			}
+		}
+
+		for (auto&& [drawing, visibility, stack] : r.view<DrawingVisibilityCpo, LayerStackCpo>().each())
+		{
+			auto* canvas = r.try_get<CanvasTargetCpo>(drawing);
+			if (!canvas) continue;
+			float scale = coverage(r, drawing, canvas->image.width()).pixelsPerMeter;
+			for (entt::entity layer : stack.layers)
+			{
+				auto* covered = r.valid(layer) ? r.try_get<LayerCoverageCpo>(layer) : nullptr;
+				if (!covered) continue;
+				if (!covered->contains(visibility.visibleMin, visibility.visibleMax) || covered->pixelsPerMeter < scale)
+				{
+					r.emplace_or_replace<LayerDirtyTag>(layer);
+				}
+			}
+		}
+	}
+
+	LayerCoverageCpo ViewportCuller::coverage(entt::registry& r, entt::entity drawing, uint32_t targetWidth)
+	{
+		const auto& view = r.get<ViewRectCpo>(drawing);
+		float targetScale = view.pixelsPerMeter(targetWidth);
+		auto* visibility = r.try_get<DrawingVisibilityCpo>(drawing);
+		if (!visibility) return {view.min, view.max, targetScale};
+		glm::vec2 margin = (visibility->visibleMax - visibility->visibleMin) * Margin;
+		return {
+			glm::max(visibility->visibleMin - margin, view.min), glm::min(visibility->visibleMax + margin, view.max),
+			quantizedScale(visibility->pixelsPerMeter, targetScale)
+		};
+	}
+
+	bool ViewportCuller::culled(entt::registry& r, entt::entity drawing)
+	{
+		auto* stack = r.try_get<LayerStackCpo>(drawing);
+		if (!stack) return false;
+		const auto& view = r.get<ViewRectCpo>(drawing);
+		return std::ranges::any_of(stack->layers, [&](entt::entity layer)
+		{
+			auto* covered = r.valid(layer) ? r.try_get<LayerCoverageCpo>(layer) : nullptr;
+			return covered && !covered->contains(view.min, view.max);
+		});
+	}
 }
@@ -1,15 +1,144 @@
 ﻿#pragma once
+#include <span>
 
 #include "ArticulatedLine.hpp"
+#include "Buffer.hpp"
+#include "FillRenderer.hpp"
+#include "Image.hpp"
+#include "ShaderModule.hpp"
+#include "SparseImage.hpp"
+#include "StrokeAccumulator.hpp"
+#include "UploadScheduler.hpp"
 
 namespace ciallo
 {
+	struct CanvasTargetCpo;
+
+	// Cached rasterization of a layer, on layer entity. Premultiplied alpha. Dense or vulkan::SparseImage.
+	struct LayerTargetCpo
+	{
+		std::unique_ptr<vulkan::Image> image;
+	};
+
+	// Layer target is out of date and re-rasterized in next LayerRenderer::render.
+	struct LayerDirtyTag
+	{
+	};
+
+	// Union of regions of drawing visible in canvas panels, on drawing entity. Rebuilt by ViewportCuller every frame.
+	struct DrawingVisibilityCpo
+	{
+		glm::vec2 visibleMin; // world coordinate, unit is meter
+		glm::vec2 visibleMax;
+		float pixelsPerMeter; // finest screen scale over the panels
+	};
+
+	// What the layer target holds, on layer entity: strokes touching covered region, at level of detail of
+	// pixelsPerMeter. Kept apart from LayerTargetCpo so it survives eviction of the target.
+	struct LayerCoverageCpo
+	{
+		glm::vec2 coveredMin; // world coordinate, unit is meter
+		glm::vec2 coveredMax;
+		float pixelsPerMeter;
+
+		bool contains(glm::vec2 min, glm::vec2 max) const;
+	};
+
+	/**
+	 * \brief Fits layer targets to what canvas panels show. A target is rasterized for the visible region grown by
+	 * Margin on each side, strokes outside are culled, and lines take the level of detail of the screen scale
+	 * rounded up to a power of two, at most the scale of the target. Layers are marked dirty only once the view
+	 * leaves their coverage or zooms in past its scale, so scrolling and zooming within it rasterize nothing.
+	 */
+	struct ViewportCuller
+	{
+		constexpr static float Margin = 0.5f; // of the visible size
+
+		static void update(entt::registry& r);
+		// Coverage a target of drawing gets when rasterized now. Whole drawing at the scale of the target when no
+		// panel shows it, as in exports.
+		static LayerCoverageCpo coverage(entt::registry& r, entt::entity drawing, uint32_t targetWidth);
+		// Some layer target of drawing leaves part of it out.
+		static bool culled(entt::registry& r, entt::entity drawing);
+	};
+
+	/**
+	 * \brief Every layer is rasterized into its own cached target, only when strokes or fills of it change.
+	 * Fills of a layer are drawn under its strokes.
+	 * Targets are composited into drawing image by one compute dispatch applying all opacities and blend modes,
+	 * one dispatch per MaxLayers layers when there are more, each going on from the canvas left by the last one.
+	 */
 	class LayerRenderer
 	{
-	public:
-		void update()
+		struct LayerParams
+		{
+			float alpha;
+			uint32_t blend;
+		};
+
+		struct PushConstant
 		{
-			
-		}
+			glm::vec4 background;
+			uint32_t layerCount;
+			uint32_t encodeSrgb;
+			uint32_t firstLayer; // index of layers[0] into params
+			uint32_t onCanvas; // start from the canvas instead of background
+		};
+
+		vk::Device m_device;
+		// By storage format of the canvas, the composite shader is compiled for each.
+		std::unordered_map<vk::Format, vulkan::ShaderModule> m_compShaders;
+		vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+		vk::UniquePipelineLayout m_pipelineLayout;
+		std::unordered_map<vk::Format, vk::UniquePipeline> m_pipelines;
+		vk::DescriptorPool m_descriptorPool;
+		// One per batch of MaxLayers layers, a set can't be rewritten between dispatches of a frame.
+		std::vector<vk::DescriptorSet> m_descriptorSets;
+		vk::UniqueSampler m_sampler;
+		vulkan::Buffer m_layerParams;
+		uint32_t m_layerParamsCapacity = MaxLayers;
+		// Bound to unused slots of the layer array.
+		vulkan::Image m_emptyLayer;
+
+		void genDescriptorSet(vk::DescriptorPool pool);
+		void genCompPipeline();
+		void genEmptyLayer(vulkan::Device* device, UploadScheduler& uploads);
+		void updateDescriptorSet(uint32_t batch, const CanvasTargetCpo& canvas,
+		                         std::span<const vulkan::Image* const> layers);
+		void rasterize(entt::registry& r, vk::CommandBuffer cb, ArticulatedLineEngine& engine,
+		               StrokeAccumulator& accumulator, FillRenderer& fillRenderer, const vulkan::Image* fillStencil,
+		               entt::entity drawing, entt::entity layer, const LayerCoverageCpo& coverage,
+		               const std::vector<entt::entity>& strokes, const std::vector<entt::entity>& fills);
+		static void drawLines(entt::registry& r, vk::CommandBuffer cb, ArticulatedLineEngine& engine,
+		                      const vulkan::Image& target, float pixelsPerMeter,
+		                      const std::vector<entt::entity>& strokes);
+
+		static void markDirty(entt::registry& r, entt::entity e);
+		// Bind tiles of sparse target covering strokes with thickness, and regions of fills. Returns bytes missing.
+		static vk::DeviceSize commitTiles(entt::registry& r, vulkan::SparseImage& target, entt::entity drawing,
+		                                  const std::vector<entt::entity>& strokes,
+		                                  const std::vector<entt::entity>& fills);
+	public:
+		constexpr static uint32_t MaxLayers = 64;
+		glm::vec4 background = {0.0f, 0.0f, 0.0f, 1.0f};
+		// Sparse targets only hold memory for tiles touched by strokes, ignored when device lacks support.
+		bool sparseTargets = false;
+
+		// The empty layer is cleared through uploads, ready for frames acquiring uploads after the next flush.
+		LayerRenderer(vulkan::Device* device, UploadScheduler& uploads);
+
+		// Strokes or fills changing, joining or leaving a layer mark the layer dirty.
+		static void connect(entt::registry& r);
+		static std::unique_ptr<vulkan::Image> createTarget(vulkan::Device& device, vk::Extent2D extent,
+		                                                   vk::Format format, bool sparse);
+		/**
+		 * \brief Re-rasterize dirty layers of drawing and composite all layers into its CanvasTargetCpo.
+		 * Layer targets follow format and size of the canvas, see CanvasDisplayPass::prepareCanvas.
+		 * Airbrush strokes go through accumulator, the rest through engine, fills through fillRenderer into
+		 * fillStencil, see FillRenderer::createStencil. Fills are left out without one.
+		 * Strokes outside the coverage of a layer are culled, see ViewportCuller.
+		 */
+		void render(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing, ArticulatedLineEngine& engine,
+		            StrokeAccumulator& accumulator, FillRenderer& fillRenderer, const vulkan::Image* fillStencil);
 	};
 }
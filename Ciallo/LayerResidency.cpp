@@ -0,0 +1,278 @@
+#include "pch.hpp"
+#include "LayerResidency.hpp"
+
+#include "Device.hpp"
+#include "Layer.hpp"
+#include "LayerRenderer.hpp"
+#include "RegistrySnapshot.hpp"
+#include "SparseImage.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo
+{
+	namespace
+	{
+		template <typename Func>
+		vk::DeviceSize sumDeviceLocalHeaps(VmaAllocator allocator, Func&& func)
+		{
+			const VkPhysicalDeviceMemoryProperties* properties;
+			vmaGetMemoryProperties(allocator, &properties);
+			std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+			vmaGetHeapBudgets(allocator, budgets.data());
+
+			vk::DeviceSize sum = 0;
+			for (uint32_t i = 0; i < properties->memoryHeapCount; ++i)
+			{
+				if (properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				{
+					sum += func(budgets[i]);
+				}
+			}
+			return sum;
+		}
+
+		void restore(entt::registry& r, vk::CommandBuffer cb, entt::entity layer, vk::Buffer pixels,
+		             vk::Extent2D extent, vk::Format format)
+		{
+			auto image = LayerRenderer::createTarget(*r.ctx().at<vulkan::Device*>(), extent, format, false);
+			image->changeLayout(cb, vk::ImageLayout::eGeneral);
+			vk::BufferImageCopy copy{};
+			copy.setImageExtent({extent.width, extent.height, 1u});
+			copy.setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+			cb.copyBufferToImage(pixels, *image, vk::ImageLayout::eGeneral, copy);
+			vk::MemoryBarrier2 barrier{
+				vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+				vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eClear,
+				vk::AccessFlagBits2::eShaderSampledRead | vk::AccessFlagBits2::eTransferWrite
+			};
+			cb.pipelineBarrier2({{}, barrier, {}, {}});
+			r.emplace_or_replace<LayerTargetCpo>(layer, std::move(image));
+		}
+	}
+
+	vk::DeviceSize LayerResidency::deviceLocalUsage(VmaAllocator allocator)
+	{
+		return sumDeviceLocalHeaps(allocator, [](const VmaBudget& budget) { return budget.usage; });
+	}
+
+	vk::DeviceSize LayerResidency::deviceLocalBudget(VmaAllocator allocator)
+	{
+		return sumDeviceLocalHeaps(allocator, [](const VmaBudget& budget) { return budget.budget; });
+	}
+
+	LayerResidency::LayerResidency(JobSystem* jobs): m_jobs(jobs)
+	{
+	}
+
+	LayerResidency::~LayerResidency()
+	{
+		// Running compressions count down their group.
+		m_jobs->wait(m_compressions);
+	}
+
+	void LayerResidency::markEdited(entt::registry& r, entt::entity layer)
+	{
+		r.get_or_emplace<LayerResidencyCpo>(layer).lastEdit = m_frame;
+	}
+
+	void LayerResidency::allocationFailed(entt::entity layer, vk::DeviceSize missing)
+	{
+		m_starved.push_back(layer);
+		m_shortfall += missing;
+	}
+
+	void LayerResidency::update(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing)
+	{
+		++m_frame;
+		m_retiredBuffers.clear();
+		finishReadbacks(r);
+
+		if (auto* stack = r.try_get<LayerStackCpo>(drawing))
+		{
+			for (entt::entity layer : stack->layers)
+			{
+				if (!r.valid(layer) || !r.all_of<LayerCpo>(layer)) continue;
+				r.get_or_emplace<LayerResidencyCpo>(layer).lastUse = m_frame;
+				pageIn(r, cb, layer);
+			}
+		}
+		vk::DeviceSize freed = evict(r, cb, m_shortfall);
+		if (!m_starved.empty())
+		{
+			if (freed > 0)
+			{
+				// Try again with the memory made room for.
+				for (entt::entity layer : m_starved)
+				{
+					if (r.valid(layer) && r.all_of<LayerCpo>(layer)) r.emplace_or_replace<LayerDirtyTag>(layer);
+				}
+			}
+			else
+			{
+				spdlog::warn("{} layers lack {} bytes of tiles, nothing left to evict", m_starved.size(), m_shortfall);
+			}
+		}
+		m_starved.clear();
+		m_shortfall = 0;
+	}
+
+	void LayerResidency::finishReadbacks(entt::registry& r)
+	{
+		JobSystem* jobs = m_jobs;
+		auto readbacks = r.view<LayerReadbackCpo>();
+		for (auto&& [e, readback] : readbacks.each())
+		{
+			if (readback.compressed || readback.frame == m_frame) continue;
+			// Copy is done, device memory of the target can go.
+			r.remove<LayerTargetCpo>(e);
+			readback.buffer->invalidate();
+			readback.compressed = std::make_shared<std::vector<std::byte>>();
+			// The layer may be destroyed while the job runs, the job holds the buffer it reads.
+			jobs->run(m_compressions, [jobs, buffer = readback.buffer, out = readback.compressed]
+			{
+				std::span pixels{static_cast<const std::byte*>(buffer->mappedData()), buffer->size()};
+				try
+				{
+					*out = RegistrySnapshot::compress(pixels, *jobs);
+				}
+				catch (std::exception& e)
+				{
+					// Left empty, the layer gets rasterized again.
+					spdlog::warn("Failed to compress layer: {}", e.what());
+				}
+			});
+		}
+
+		if (!m_compressions.done()) return;
+		std::vector<entt::entity> finished;
+		for (auto&& [e, readback] : readbacks.each())
+		{
+			if (readback.compressed) finished.push_back(e);
+		}
+		for (entt::entity e : finished)
+		{
+			auto& readback = r.get<LayerReadbackCpo>(e);
+			// Strokes changed after the copy, the copy is worthless.
+			if (!r.all_of<LayerDirtyTag>(e))
+			{
+				r.emplace_or_replace<EvictedLayerCpo>(e, std::move(*readback.compressed), readback.extent,
+				                                      readback.format);
+			}
+			r.remove<LayerReadbackCpo>(e);
+		}
+	}
+
+	void LayerResidency::pageIn(entt::registry& r, vk::CommandBuffer cb, entt::entity layer)
+	{
+		bool dirty = r.all_of<LayerDirtyTag>(layer);
+		if (auto* readback = r.try_get<LayerReadbackCpo>(layer))
+		{
+			if (!readback->compressed)
+			{
+				// Copy is recorded but not finished, the target is still there.
+				r.remove<LayerReadbackCpo>(layer);
+				return;
+			}
+			// Raw pixels are still in the readback buffer, no need to decompress.
+			m_jobs->wait(m_compressions);
+			if (!dirty)
+			{
+				restore(r, cb, layer, *readback->buffer, readback->extent, readback->format);
+				m_retiredBuffers.push_back(std::move(*readback->buffer));
+			}
+			r.remove<LayerReadbackCpo>(layer);
+			return;
+		}
+
+		auto* evicted = r.try_get<EvictedLayerCpo>(layer);
+		if (!evicted) return;
+		// A dirty or failed layer is rasterized by LayerRenderer instead.
+		if (!dirty && !evicted->compressed.empty())
+		{
+			auto* device = r.ctx().at<vulkan::Device*>();
+			std::vector<std::byte> pixels = RegistrySnapshot::decompress(evicted->compressed,
+			                                                             *r.ctx().at<JobSystem*>());
+			VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+			vulkan::Buffer staging(*device, info, pixels.size(), vk::BufferUsageFlagBits::eTransferSrc);
+			staging.uploadLocal(pixels.data(), pixels.size());
+			restore(r, cb, layer, staging, evicted->extent, evicted->format);
+			m_retiredBuffers.push_back(std::move(staging));
+		}
+		r.remove<EvictedLayerCpo>(layer);
+	}
+
+	vk::DeviceSize LayerResidency::evict(entt::registry& r, vk::CommandBuffer cb, vk::DeviceSize needed)
+	{
+		auto* device = r.ctx().at<vulkan::Device*>();
+		// Memory starved layers are about to ask for counts as used already.
+		vk::DeviceSize usage = deviceLocalUsage(*device) + needed;
+		auto budget = static_cast<vk::DeviceSize>(static_cast<double>(deviceLocalBudget(*device)) * BudgetUsage);
+		if (usage <= budget) return 0;
+
+		std::vector<entt::entity> candidates;
+		for (auto&& [e, target, residency] : r.view<LayerTargetCpo, LayerResidencyCpo>(
+			     entt::exclude<LayerReadbackCpo>).each())
+		{
+			if (residency.lastUse != m_frame) candidates.push_back(e);
+		}
+		std::ranges::sort(candidates, {}, [&r](entt::entity e) { return r.get<LayerResidencyCpo>(e).lastEdit; });
+
+		std::unordered_map<entt::entity, size_t> vertexCounts;
+		for (auto&& [e, stroke, member] : r.view<StrokeCpo, LayerMemberCpo>().each())
+		{
+			vertexCounts[member.layer] += stroke.position.size();
+		}
+
+		uint32_t readbackCount = 0;
+		vk::DeviceSize freed = 0;
+		for (entt::entity layer : candidates)
+		{
+			if (usage <= budget) break;
+			const vulkan::Image& image = *r.get<LayerTargetCpo>(layer).image;
+			vk::DeviceSize size = image.deviceMemorySize();
+			bool sparse = dynamic_cast<const vulkan::SparseImage*>(&image) != nullptr;
+			if (sparse || vertexCounts[layer] < DropVertexCount)
+			{
+				r.remove<LayerTargetCpo>(layer);
+			}
+			else
+			{
+				if (readbackCount == MaxReadbacksPerFrame) continue;
+				readback(r, cb, layer);
+				++readbackCount;
+			}
+			usage -= std::min(size, usage);
+			freed += size;
+		}
+		return freed;
+	}
+
+	void LayerResidency::readback(entt::registry& r, vk::CommandBuffer cb, entt::entity layer)
+	{
+		const vulkan::Image& image = *r.get<LayerTargetCpo>(layer).image;
+		VmaAllocationCreateInfo info{
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_AUTO
+		};
+		vulkan::Buffer buffer(*r.ctx().at<vulkan::Device*>(), info, image.size(),
+		                      vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc);
+
+		vk::MemoryBarrier2 before{
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eAllTransfer,
+			vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferRead
+		};
+		cb.pipelineBarrier2({{}, before, {}, {}});
+		vk::BufferImageCopy copy{};
+		copy.setImageExtent({image.width(), image.height(), 1u});
+		copy.setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+		cb.copyImageToBuffer(image, vk::ImageLayout::eGeneral, buffer, copy);
+		vk::MemoryBarrier2 after{
+			vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead
+		};
+		cb.pipelineBarrier2({{}, after, {}, {}});
+
+		r.emplace<LayerReadbackCpo>(layer, std::make_shared<vulkan::Buffer>(std::move(buffer)), image.extent2D(),
+		                            image.format(), m_frame, nullptr);
+	}
+}
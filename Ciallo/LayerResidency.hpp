@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "JobSystem.hpp"
+
+namespace ciallo
+{
+	// On layer entity, frame numbers of last rasterization and last composite.
+	struct LayerResidencyCpo
+	{
+		uint64_t lastEdit = 0;
+		uint64_t lastUse = 0;
+	};
+
+	// Layer target being copied to host. Compressed on the job system once the copy is done.
+	struct LayerReadbackCpo
+	{
+		// Host visible, persistently mapped. Shared with the compression job, so it outlives the component.
+		std::shared_ptr<vulkan::Buffer> buffer;
+		vk::Extent2D extent;
+		vk::Format format;
+		uint64_t frame = 0;
+		std::shared_ptr<std::vector<std::byte>> compressed; // null until compression starts
+	};
+
+	// Layer target evicted to host memory, LZ4 compressed.
+	struct EvictedLayerCpo
+	{
+		std::vector<std::byte> compressed;
+		vk::Extent2D extent;
+		vk::Format format;
+	};
+
+	/**
+	 * \brief Keeps layer targets within device local memory budget reported by vmaGetHeapBudgets.
+	 * Over budget, least recently edited layers not shown this frame are evicted. Layers cheap to rasterize and
+	 * sparse layers are dropped and re-rasterized from strokes later, the rest are read back and compressed.
+	 * Layers needed by the drawing are paged back in before compositing.
+	 * Sparse layers short of device memory are reported back, more is evicted and they are rasterized again.
+	 * Lives in ctx of registry as a pointer, registries without it are never evicted from.
+	 */
+	class LayerResidency
+	{
+		JobSystem* m_jobs;
+		uint64_t m_frame = 0;
+		JobSystem::TaskGroup m_compressions;
+		// Staging buffers of last frame, free to go after its fence.
+		std::vector<vulkan::Buffer> m_retiredBuffers;
+		// Sparse layers that got fewer tiles than they needed, and the memory they lacked.
+		std::vector<entt::entity> m_starved;
+		vk::DeviceSize m_shortfall = 0;
+
+		void finishReadbacks(entt::registry& r);
+		void pageIn(entt::registry& r, vk::CommandBuffer cb, entt::entity layer);
+		// Returns bytes freed.
+		vk::DeviceSize evict(entt::registry& r, vk::CommandBuffer cb, vk::DeviceSize needed);
+		void readback(entt::registry& r, vk::CommandBuffer cb, entt::entity layer);
+	public:
+		// Fraction of device local budget that may be used before evicting.
+		static inline float BudgetUsage = 0.8f;
+		// Layers with fewer vertices are dropped instead of compressed.
+		static inline size_t DropVertexCount = 1u << 16;
+		static inline uint32_t MaxReadbacksPerFrame = 4;
+
+		explicit LayerResidency(JobSystem* jobs);
+		LayerResidency(const LayerResidency& other) = delete;
+		LayerResidency& operator=(const LayerResidency& other) = delete;
+		~LayerResidency();
+
+		void markEdited(entt::registry& r, entt::entity layer);
+		// Layer was rasterized without `missing` bytes of tiles, see vulkan::SparseImage::makeResident.
+		void allocationFailed(entt::entity layer, vk::DeviceSize missing);
+		/**
+		 * \brief Page in layers of drawing, evict others when over budget.
+		 * Call after the previous frame is finished and before LayerRenderer::render.
+		 */
+		void update(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing);
+
+		// Sum over device local heaps.
+		static vk::DeviceSize deviceLocalUsage(VmaAllocator allocator);
+		static vk::DeviceSize deviceLocalBudget(VmaAllocator allocator);
+	};
+}
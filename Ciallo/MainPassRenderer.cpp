@@ -86,8 +86,6 @@ namespace ciallo::vulkan
 
 	void MainPassRenderer::genSyncObject()
 	{
-		vk::FenceCreateInfo fci(vk::FenceCreateFlagBits::eSignaled);
-		m_renderingCompleteFence = d->device().createFenceUnique(fci);
 		vk::SemaphoreCreateInfo sci({});
 		m_renderingCompleteSemaphore = d->device().createSemaphoreUnique(sci);
 	}
@@ -16,7 +16,6 @@ namespace ciallo::vulkan
 		Device* d;
 		bool m_imguiInitialized = false;
 
-		vk::UniqueFence m_renderingCompleteFence;
 		vk::UniqueSemaphore m_renderingCompleteSemaphore;
 		vk::UniqueRenderPass m_renderPass;
 		std::vector<vk::UniqueFramebuffer> m_framebuffers;
@@ -40,11 +39,6 @@ namespace ciallo::vulkan
 	public:
 		void genFramebuffers();
 
-		vk::Fence renderingCompleteFence() const
-		{
-			return *m_renderingCompleteFence;
-		}
-
 		vk::Semaphore renderingCompleteSemaphore() const
 		{
 			return *m_renderingCompleteSemaphore;
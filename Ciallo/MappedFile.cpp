@@ -0,0 +1,103 @@
+#include "pch.hpp"
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ciallo
+{
+	MappedFile::MappedFile(const std::filesystem::path& path)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error(std::format("Failed to open file {}!", path.string()));
+		}
+		m_file = file;
+
+		LARGE_INTEGER size;
+		GetFileSizeEx(file, &size);
+		m_size = static_cast<size_t>(size.QuadPart);
+		if (m_size == 0) return;
+
+		m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_mapping)
+		{
+			close();
+			throw std::runtime_error(std::format("Failed to map file {}!", path.string()));
+		}
+		m_data = static_cast<const std::byte*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		m_file = open(path.c_str(), O_RDONLY);
+		if (m_file < 0)
+		{
+			throw std::runtime_error(std::format("Failed to open file {}!", path.string()));
+		}
+		struct stat st{};
+		fstat(m_file, &st);
+		m_size = static_cast<size_t>(st.st_size);
+		if (m_size == 0) return;
+
+		void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+		m_data = data == MAP_FAILED ? nullptr : static_cast<const std::byte*>(data);
+#endif
+		if (!m_data)
+		{
+			close();
+			throw std::runtime_error(std::format("Failed to map file {}!", path.string()));
+		}
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		using std::swap;
+		swap(m_data, other.m_data);
+		swap(m_size, other.m_size);
+		swap(m_file, other.m_file);
+#ifdef _WIN32
+		swap(m_mapping, other.m_mapping);
+#endif
+		return *this;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	void MappedFile::close()
+	{
+#ifdef _WIN32
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_mapping) CloseHandle(m_mapping);
+		if (m_file) CloseHandle(m_file);
+		m_mapping = nullptr;
+		m_file = nullptr;
+#else
+		if (m_data) munmap(const_cast<std::byte*>(m_data), m_size);
+		if (m_file >= 0) ::close(m_file);
+		m_file = -1;
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
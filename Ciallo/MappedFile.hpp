@@ -0,0 +1,32 @@
+#pragma once
+#include <filesystem>
+#include <span>
+
+namespace ciallo
+{
+	/**
+	 * \brief Read only memory mapped file. Pages are loaded by OS on first touch.
+	 */
+	class MappedFile
+	{
+		const std::byte* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#else
+		int m_file = -1;
+#endif
+		void close();
+	public:
+		explicit MappedFile(const std::filesystem::path& path);
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(const MappedFile& other) = delete;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		~MappedFile();
+
+		std::span<const std::byte> bytes() const { return {m_data, m_size}; }
+		size_t size() const { return m_size; }
+	};
+}
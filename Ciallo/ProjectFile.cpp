@@ -0,0 +1,515 @@
+#include "pch.hpp"
+#include "ProjectFile.hpp"
+
+#include <fstream>
+#include <yaml-cpp/yaml.h>
+
+#include "Brush.hpp"
+#include "CanvasFormat.hpp"
+#include "CurveFitting.hpp"
+#include "Drawing.hpp"
+#include "FalloffCurve.hpp"
+#include "FillRegion.hpp"
+#include "Layer.hpp"
+#include "MappedFile.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo
+{
+	static_assert(sizeof(geom::Point) == 2 * sizeof(float), "geom::Point is uploaded and mapped as float2.");
+
+	namespace
+	{
+		constexpr uint32_t ManifestChunk = ProjectFile::fourcc("MANI");
+		constexpr uint32_t BrushChunk = ProjectFile::fourcc("BRSH");
+		constexpr uint32_t StrokeChunk = ProjectFile::fourcc("STRK");
+		constexpr uint32_t PositionChunk = ProjectFile::fourcc("POSI");
+		constexpr uint32_t ThicknessChunk = ProjectFile::fourcc("THIC");
+		constexpr uint32_t AirbrushChunk = ProjectFile::fourcc("AIRB");
+		constexpr uint32_t FalloffChunk = ProjectFile::fourcc("FALO");
+		constexpr uint32_t DotChunk = ProjectFile::fourcc("DOTS");
+		constexpr uint32_t CurveChunk = ProjectFile::fourcc("CURV");
+		constexpr uint32_t LayerChunk = ProjectFile::fourcc("LAYR");
+		constexpr uint32_t MemberChunk = ProjectFile::fourcc("MEMB");
+		constexpr uint32_t FillChunk = ProjectFile::fourcc("FILL");
+		constexpr uint32_t SplineChunk = ProjectFile::fourcc("SPLN");
+		constexpr uint32_t SplinePositionChunk = ProjectFile::fourcc("SPPO");
+		constexpr uint32_t SplineThicknessChunk = ProjectFile::fourcc("SPTH");
+
+		class ChunkWriter
+		{
+			std::ofstream& m_file;
+			std::vector<ProjectFile::ChunkEntry> m_entries;
+		public:
+			explicit ChunkWriter(std::ofstream& file): m_file(file)
+			{
+			}
+
+			void pad()
+			{
+				static constexpr std::array<char, ProjectFile::ChunkAlignment> zeros{};
+				auto position = static_cast<uint64_t>(m_file.tellp());
+				uint64_t padding = (ProjectFile::ChunkAlignment - position % ProjectFile::ChunkAlignment) %
+					ProjectFile::ChunkAlignment;
+				m_file.write(zeros.data(), static_cast<std::streamsize>(padding));
+			}
+
+			void write(uint32_t type, const void* data, uint64_t size)
+			{
+				pad();
+				m_entries.push_back({type, ProjectFile::Version, static_cast<uint64_t>(m_file.tellp()), size});
+				m_file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+			}
+
+			template <typename T>
+			void write(uint32_t type, const std::vector<T>& data)
+			{
+				write(type, data.data(), data.size() * sizeof(T));
+			}
+
+			const std::vector<ProjectFile::ChunkEntry>& entries() const
+			{
+				return m_entries;
+			}
+		};
+
+		std::string emitManifest(entt::registry& r, std::span<const entt::entity> drawings, uint64_t strokeCount,
+		                         uint64_t vertexCount, uint64_t brushCount, uint64_t layerCount, uint64_t fillCount)
+		{
+			YAML::Emitter out;
+			out << YAML::BeginMap;
+			out << YAML::Key << "format" << YAML::Value << "Ciallo";
+			out << YAML::Key << "version" << YAML::Value << ProjectFile::Version;
+			out << YAML::Key << "strokeCount" << YAML::Value << strokeCount;
+			out << YAML::Key << "vertexCount" << YAML::Value << vertexCount;
+			out << YAML::Key << "brushCount" << YAML::Value << brushCount;
+			out << YAML::Key << "layerCount" << YAML::Value << layerCount;
+			out << YAML::Key << "fillCount" << YAML::Value << fillCount;
+			out << YAML::Key << "drawings" << YAML::Value << YAML::BeginSeq;
+			for (entt::entity e : drawings)
+			{
+				const auto& viewRect = r.get<ViewRectCpo>(e);
+				out << YAML::BeginMap;
+				out << YAML::Key << "min" << YAML::Value << YAML::Flow
+					<< std::vector<float>{viewRect.min.x, viewRect.min.y};
+				out << YAML::Key << "max" << YAML::Value << YAML::Flow
+					<< std::vector<float>{viewRect.max.x, viewRect.max.y};
+				out << YAML::Key << "dpi" << YAML::Value << viewRect.dpi;
+				out << YAML::Key << "canvasFormat" << YAML::Value << canvasFormatName(canvasFormatOf(r, e));
+				out << YAML::EndMap;
+			}
+			out << YAML::EndSeq;
+			out << YAML::EndMap;
+			return out.c_str();
+		}
+
+		// Chunk is known to lie inside the file at ChunkAlignment.
+		template <typename T>
+		std::span<const T> chunkSpan(const MappedFile& file, const ProjectFile::ChunkEntry& chunk)
+		{
+			static_assert(ProjectFile::ChunkAlignment % alignof(T) == 0);
+			if (chunk.size % sizeof(T) != 0)
+			{
+				throw std::runtime_error("Project file chunk does not hold whole records!");
+			}
+			return {reinterpret_cast<const T*>(file.bytes().data() + chunk.offset), chunk.size / sizeof(T)};
+		}
+
+		// Bottom to top: by layer in the stacks of drawings, then by order in the layer. Loose strokes last.
+		std::vector<entt::entity> strokesInLayerOrder(entt::registry& r)
+		{
+			std::unordered_map<entt::entity, size_t> layerRanks;
+			for (auto&& [drawing, stack] : r.view<const LayerStackCpo>().each())
+			{
+				for (entt::entity layer : stack.layers)
+				{
+					layerRanks.try_emplace(layer, layerRanks.size());
+				}
+			}
+			auto key = [&](entt::entity e)
+			{
+				auto* member = r.try_get<LayerMemberCpo>(e);
+				if (!member) return std::pair{std::numeric_limits<size_t>::max(), uint64_t{0}};
+				auto it = layerRanks.find(member->layer);
+				size_t rank = it == layerRanks.end() ? std::numeric_limits<size_t>::max() : it->second;
+				return std::pair{rank, member->order};
+			};
+			auto strokes = r.view<const StrokeCpo>();
+			std::vector<entt::entity> sorted{strokes.begin(), strokes.end()};
+			std::ranges::stable_sort(sorted, {}, key);
+			return sorted;
+		}
+	}
+
+	void ProjectFile::save(Project& project, const std::filesystem::path& path)
+	{
+		entt::registry& r = project.registry();
+
+		std::vector<BrushRecord> brushes;
+		std::unordered_map<entt::entity, uint32_t> brushIndices;
+		std::vector<AirbrushRecord> airbrushes;
+		std::vector<FalloffRecord> falloffs;
+		std::vector<DotRecord> dots;
+		for (entt::entity e : r.view<BrushTag>())
+		{
+			auto* color = r.try_get<ColorCpo>(e);
+			brushIndices[e] = static_cast<uint32_t>(brushes.size());
+			brushes.push_back({color ? color->color : ColorCpo{}.color});
+			if (auto* airbrush = r.try_get<AirbrushCpo>(e))
+			{
+				airbrushes.push_back({brushIndices[e], airbrush->hardness});
+			}
+			if (auto* falloff = r.try_get<FalloffCurveCpo>(e))
+			{
+				falloffs.push_back({brushIndices[e], falloff->controlPoints});
+			}
+			if (auto* dot = r.try_get<EquidistantDotCpo>(e))
+			{
+				dots.push_back({brushIndices[e], dot->spacing});
+			}
+		}
+		auto brushIndex = [&brushIndices](entt::entity brush)
+		{
+			auto it = brushIndices.find(brush);
+			return it == brushIndices.end() ? NoBrush : it->second;
+		};
+
+		// Layers of stacks bottom to top, drawings in manifest order, then layers in no stack.
+		auto drawingView = r.view<const DrawingTag, const ViewRectCpo>();
+		std::vector<entt::entity> drawings{drawingView.begin(), drawingView.end()};
+		std::vector<LayerRecord> layers;
+		std::unordered_map<entt::entity, uint32_t> layerIndices;
+		auto addLayer = [&](entt::entity layer, uint32_t drawing)
+		{
+			const auto& layerCpo = r.get<LayerCpo>(layer);
+			if (!layerIndices.try_emplace(layer, static_cast<uint32_t>(layers.size())).second) return;
+			layers.push_back({layerCpo.nextOrder, drawing, layerCpo.alpha, static_cast<uint32_t>(layerCpo.blend)});
+		};
+		for (auto&& [i, drawing] : views::enumerate(drawings))
+		{
+			if (auto* stack = r.try_get<LayerStackCpo>(drawing))
+			{
+				for (entt::entity layer : stack->layers)
+				{
+					if (r.valid(layer) && r.all_of<LayerCpo>(layer)) addLayer(layer, static_cast<uint32_t>(i));
+				}
+			}
+		}
+		for (entt::entity layer : r.view<LayerCpo>())
+		{
+			addLayer(layer, NoIndex);
+		}
+		auto member = [&](entt::entity e)
+		{
+			auto* memberCpo = r.try_get<LayerMemberCpo>(e);
+			if (!memberCpo) return MemberRecord{0, NoIndex};
+			auto it = layerIndices.find(memberCpo->layer);
+			return MemberRecord{memberCpo->order, it == layerIndices.end() ? NoIndex : it->second};
+		};
+
+		std::vector<StrokeRecord> strokes;
+		std::vector<geom::Point> position;
+		std::vector<float> thickness;
+		auto append = [&](std::span<const geom::Point> p, std::span<const float> t, entt::entity brush)
+		{
+			strokes.push_back({position.size(), static_cast<uint32_t>(p.size()), brushIndex(brush)});
+			position.insert(position.end(), p.begin(), p.end());
+			// Thickness is always as long as position in file.
+			thickness.insert(thickness.end(), t.begin(), t.begin() + std::min(t.size(), p.size()));
+			thickness.resize(position.size(), 0.0f);
+		};
+		std::vector<MemberRecord> members;
+		std::vector<SplineRecord> splines;
+		std::vector<geom::Point> splinePosition;
+		std::vector<float> splineThickness;
+		// Bottom to top, files of older versions put strokes back into one layer in this order.
+		for (entt::entity e : strokesInLayerOrder(r))
+		{
+			const auto& stroke = r.get<StrokeCpo>(e);
+			// The polyline is what is drawn, the curve is saved along to keep editing it.
+			if (auto* curve = r.try_get<StrokeCurveCpo>(e); curve && curve->spline.segmentCount() > 0)
+			{
+				const geom::BezierSpline& spline = curve->spline;
+				splines.push_back({
+					splinePosition.size(), static_cast<uint32_t>(spline.controlPoints.size()),
+					static_cast<uint32_t>(strokes.size()), curve->tolerance
+				});
+				splinePosition.insert(splinePosition.end(), spline.controlPoints.begin(), spline.controlPoints.end());
+				splineThickness.insert(splineThickness.end(), spline.thickness.begin(),
+				                       spline.thickness.begin() +
+				                       std::min(spline.thickness.size(), spline.controlPoints.size()));
+				splineThickness.resize(splinePosition.size(), 0.0f);
+			}
+			members.push_back(member(e));
+			append(stroke.position, stroke.thickness, stroke.brush);
+		}
+
+		std::vector<FillRecord> fills;
+		for (auto&& [e, fill] : r.view<const FillCpo>().each())
+		{
+			MemberRecord m = member(e);
+			fills.push_back({m.order, fill.color, fill.seed, m.layer});
+		}
+
+		// Write to a temporary file first, a crash in between never leaves a broken project.
+		std::filesystem::path temp = path;
+		temp += ".tmp";
+		{
+			std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				throw std::runtime_error(std::format("Failed to open file {}!", temp.string()));
+			}
+
+			FileHeader header{Magic, Version, 0, 0};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			ChunkWriter writer(file);
+			std::string manifest = emitManifest(r, drawings, strokes.size(), position.size(), brushes.size(),
+			                                    layers.size(), fills.size());
+			writer.write(ManifestChunk, manifest.data(), manifest.size());
+			writer.write(BrushChunk, brushes);
+			writer.write(StrokeChunk, strokes);
+			writer.write(PositionChunk, position);
+			writer.write(ThicknessChunk, thickness);
+			writer.write(AirbrushChunk, airbrushes);
+			writer.write(FalloffChunk, falloffs);
+			writer.write(DotChunk, dots);
+			writer.write(LayerChunk, layers);
+			writer.write(MemberChunk, members);
+			writer.write(FillChunk, fills);
+			writer.write(SplineChunk, splines);
+			writer.write(SplinePositionChunk, splinePosition);
+			writer.write(SplineThicknessChunk, splineThickness);
+
+			writer.pad();
+			header.chunkCount = static_cast<uint32_t>(writer.entries().size());
+			header.chunkTableOffset = static_cast<uint64_t>(file.tellp());
+			file.write(reinterpret_cast<const char*>(writer.entries().data()),
+			           static_cast<std::streamsize>(writer.entries().size() * sizeof(ChunkEntry)));
+			file.seekp(0);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			if (!file.good())
+			{
+				throw std::runtime_error(std::format("Failed to write file {}!", temp.string()));
+			}
+		}
+		std::filesystem::rename(temp, path);
+	}
+
+	Project ProjectFile::load(const std::filesystem::path& path)
+	{
+		auto file = std::make_unique<MappedFile>(path);
+		std::span<const std::byte> bytes = file->bytes();
+
+		auto fail = [&path](const char* reason)
+		{
+			return std::runtime_error(std::format("Invalid project file {}: {}", path.string(), reason));
+		};
+
+		if (bytes.size() < sizeof(FileHeader)) throw fail("too small");
+		const auto& header = *reinterpret_cast<const FileHeader*>(bytes.data());
+		if (header.magic != Magic) throw fail("not a Ciallo project");
+		if (header.version > Version) throw fail("made by a newer version of Ciallo");
+		// Subtraction instead of addition, offsets of a corrupt file may overflow.
+		if (header.chunkTableOffset > bytes.size() ||
+			header.chunkCount > (bytes.size() - header.chunkTableOffset) / sizeof(ChunkEntry))
+			throw fail("chunk table out of range");
+		if (header.chunkTableOffset % alignof(ChunkEntry) != 0) throw fail("chunk table misaligned");
+
+		std::span<const ChunkEntry> table{
+			reinterpret_cast<const ChunkEntry*>(bytes.data() + header.chunkTableOffset), header.chunkCount
+		};
+		std::unordered_map<uint32_t, ChunkEntry> chunks;
+		for (const ChunkEntry& chunk : table)
+		{
+			if (chunk.offset > bytes.size() || chunk.size > bytes.size() - chunk.offset)
+				throw fail("chunk out of range");
+			if (chunk.offset % ChunkAlignment != 0) throw fail("chunk misaligned");
+			chunks[chunk.type] = chunk;
+		}
+		for (uint32_t type : {ManifestChunk, BrushChunk, StrokeChunk, PositionChunk, ThicknessChunk})
+		{
+			if (!chunks.contains(type)) throw fail("chunk missing");
+		}
+
+		auto brushes = chunkSpan<BrushRecord>(*file, chunks[BrushChunk]);
+		auto strokes = chunkSpan<StrokeRecord>(*file, chunks[StrokeChunk]);
+		auto position = chunkSpan<geom::Point>(*file, chunks[PositionChunk]);
+		auto thickness = chunkSpan<float>(*file, chunks[ThicknessChunk]);
+		if (thickness.size() != position.size()) throw fail("thickness and position mismatch");
+
+		Project project;
+		entt::registry& r = project.registry();
+
+		const ChunkEntry& manifestChunk = chunks[ManifestChunk];
+		YAML::Node manifest = YAML::Load(std::string{
+			reinterpret_cast<const char*>(bytes.data() + manifestChunk.offset), manifestChunk.size
+		});
+		std::vector<entt::entity> drawings;
+		for (const YAML::Node& drawing : manifest["drawings"])
+		{
+			entt::entity e = drawings.emplace_back(r.create());
+			r.emplace<DrawingTag>(e);
+			r.emplace<ViewRectCpo>(e, ViewRectCpo{
+				                       {drawing["min"][0].as<float>(), drawing["min"][1].as<float>()},
+				                       {drawing["max"][0].as<float>(), drawing["max"][1].as<float>()},
+				                       drawing["dpi"].as<float>()
+			                       });
+			// Files written before formats were configurable have no canvasFormat.
+			if (drawing["canvasFormat"])
+			{
+				auto name = drawing["canvasFormat"].as<std::string>();
+				for (CanvasFormat format : CanvasFormats)
+				{
+					if (name == canvasFormatName(format)) r.emplace_or_replace<CanvasFormatCpo>(e, format);
+				}
+			}
+		}
+
+		std::vector<entt::entity> brushEntities(brushes.size());
+		r.create(brushEntities.begin(), brushEntities.end());
+		for (auto&& [e, brush] : views::zip(brushEntities, brushes))
+		{
+			r.emplace<BrushTag>(e);
+			r.emplace<ColorCpo>(e, brush.color);
+		}
+		if (auto it = chunks.find(AirbrushChunk); it != chunks.end())
+		{
+			for (const AirbrushRecord& airbrush : chunkSpan<AirbrushRecord>(*file, it->second))
+			{
+				if (airbrush.brush >= brushEntities.size()) throw fail("airbrush out of range");
+				r.emplace_or_replace<AirbrushCpo>(brushEntities[airbrush.brush], airbrush.hardness);
+			}
+		}
+		if (auto it = chunks.find(FalloffChunk); it != chunks.end())
+		{
+			for (const FalloffRecord& falloff : chunkSpan<FalloffRecord>(*file, it->second))
+			{
+				if (falloff.brush >= brushEntities.size()) throw fail("falloff out of range");
+				r.emplace_or_replace<FalloffCurveCpo>(brushEntities[falloff.brush], falloff.controlPoints);
+			}
+		}
+		if (auto it = chunks.find(DotChunk); it != chunks.end())
+		{
+			for (const DotRecord& dot : chunkSpan<DotRecord>(*file, it->second))
+			{
+				if (dot.brush >= brushEntities.size()) throw fail("dot brush out of range");
+				r.emplace_or_replace<EquidistantDotCpo>(brushEntities[dot.brush], dot.spacing);
+			}
+		}
+
+		std::vector<entt::entity> layerEntities;
+		if (auto it = chunks.find(LayerChunk); it != chunks.end())
+		{
+			auto layers = chunkSpan<LayerRecord>(*file, it->second);
+			layerEntities.resize(layers.size());
+			r.create(layerEntities.begin(), layerEntities.end());
+			for (auto&& [e, layer] : views::zip(layerEntities, layers))
+			{
+				if (layer.blend > static_cast<uint32_t>(BlendMode::Subtract)) throw fail("unknown blend mode");
+				r.emplace<LayerCpo>(e, layer.alpha, static_cast<BlendMode>(layer.blend), layer.nextOrder);
+				if (layer.drawing == NoIndex) continue;
+				if (layer.drawing >= drawings.size()) throw fail("layer drawing out of range");
+				r.get_or_emplace<LayerStackCpo>(drawings[layer.drawing]).layers.push_back(e);
+			}
+		}
+		// Members keep their order, layers give out orders past every member loaded.
+		auto join = [&](entt::entity e, uint64_t order, uint32_t layer)
+		{
+			if (layer == NoIndex) return;
+			if (layer >= layerEntities.size()) throw fail("member layer out of range");
+			auto& layerCpo = r.get<LayerCpo>(layerEntities[layer]);
+			layerCpo.nextOrder = std::max(layerCpo.nextOrder, order + 1);
+			r.emplace<LayerMemberCpo>(e, layerEntities[layer], order);
+		};
+
+		// Version 2 files keep control points of fitted strokes in place of their vertices.
+		std::vector<float> legacyCurveTolerances(strokes.size(), -1.0f); // negative for strokes stored as vertices
+		if (auto it = chunks.find(CurveChunk); it != chunks.end())
+		{
+			for (const CurveRecord& curve : chunkSpan<CurveRecord>(*file, it->second))
+			{
+				if (curve.stroke >= strokes.size()) throw fail("curve out of range");
+				legacyCurveTolerances[curve.stroke] = curve.tolerance;
+			}
+		}
+
+		std::vector<entt::entity> strokeEntities(strokes.size());
+		r.create(strokeEntities.begin(), strokeEntities.end());
+		for (auto&& [i, e, stroke] : views::zip(views::iota(size_t{0}), strokeEntities, strokes))
+		{
+			if (stroke.firstVertex > position.size() || stroke.vertexCount > position.size() - stroke.firstVertex)
+				throw fail("stroke out of range");
+			entt::entity brush = stroke.brush < brushEntities.size() ? brushEntities[stroke.brush] : entt::null;
+			auto p = position.subspan(stroke.firstVertex, stroke.vertexCount);
+			auto t = thickness.subspan(stroke.firstVertex, stroke.vertexCount);
+			auto& strokeCpo = r.emplace<StrokeCpo>(e);
+			strokeCpo.brush = brush;
+			if (legacyCurveTolerances[i] >= 0.0f)
+			{
+				StrokeCurveCpo curve{{{p.begin(), p.end()}, {t.begin(), t.end()}}, legacyCurveTolerances[i]};
+				StrokeCurveFitter::tessellate(curve, strokeCpo);
+				r.emplace<StrokeCurveCpo>(e, std::move(curve));
+				continue;
+			}
+			strokeCpo.position.assign(p.begin(), p.end());
+			strokeCpo.thickness.assign(t.begin(), t.end());
+		}
+
+		if (auto it = chunks.find(SplineChunk); it != chunks.end())
+		{
+			auto splinePositionIt = chunks.find(SplinePositionChunk);
+			auto splineThicknessIt = chunks.find(SplineThicknessChunk);
+			if (splinePositionIt == chunks.end() || splineThicknessIt == chunks.end()) throw fail("chunk missing");
+			auto splinePosition = chunkSpan<geom::Point>(*file, splinePositionIt->second);
+			auto splineThickness = chunkSpan<float>(*file, splineThicknessIt->second);
+			if (splineThickness.size() != splinePosition.size()) throw fail("spline thickness and position mismatch");
+			for (const SplineRecord& spline : chunkSpan<SplineRecord>(*file, it->second))
+			{
+				if (spline.stroke >= strokes.size()) throw fail("spline stroke out of range");
+				if (spline.firstControlPoint > splinePosition.size() ||
+					spline.controlPointCount > splinePosition.size() - spline.firstControlPoint)
+					throw fail("spline out of range");
+				auto p = splinePosition.subspan(spline.firstControlPoint, spline.controlPointCount);
+				auto t = splineThickness.subspan(spline.firstControlPoint, spline.controlPointCount);
+				// Polyline of the stroke is loaded as saved, the curve is only there to be edited.
+				r.emplace_or_replace<StrokeCurveCpo>(strokeEntities[spline.stroke], StrokeCurveCpo{
+					                                     {{p.begin(), p.end()}, {t.begin(), t.end()}}, spline.tolerance
+				                                     });
+			}
+		}
+
+		if (auto it = chunks.find(MemberChunk); it != chunks.end())
+		{
+			auto members = chunkSpan<MemberRecord>(*file, it->second);
+			if (members.size() != strokes.size()) throw fail("members and strokes mismatch");
+			for (auto&& [e, member] : views::zip(strokeEntities, members))
+			{
+				join(e, member.order, member.layer);
+			}
+		}
+		else if (!drawings.empty() && !strokeEntities.empty())
+		{
+			// Strokes were saved bottom to top, they go into one layer of the first drawing in that order.
+			entt::entity layer = r.create();
+			r.emplace<LayerCpo>(layer);
+			r.get_or_emplace<LayerStackCpo>(drawings.front()).layers.push_back(layer);
+			for (entt::entity e : strokeEntities)
+			{
+				joinLayer(r, e, layer);
+			}
+		}
+
+		if (auto it = chunks.find(FillChunk); it != chunks.end())
+		{
+			for (const FillRecord& fill : chunkSpan<FillRecord>(*file, it->second))
+			{
+				entt::entity e = r.create();
+				r.emplace<FillCpo>(e, fill.seed, fill.color);
+				join(e, fill.order, fill.layer);
+			}
+		}
+		return project;
+	}
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <filesystem>
+
+#include "Project.hpp"
+
+namespace ciallo
+{
+	/**
+	 * \brief Binary, chunked and versioned project file.
+	 * Layout: FileHeader | chunks | chunk table. Every chunk starts at ChunkAlignment, so arrays inside are
+	 * copied out of the mapped file as is, no parsing is involved.
+	 * Chunks:
+	 *  MANI YAML manifest, metadata only.
+	 *  BRSH BrushRecord[]
+	 *  STRK StrokeRecord[]
+	 *  POSI geom::Point[] of all strokes, contiguous. Always the polyline, even of strokes with a curve.
+	 *  THIC float[] of all strokes, contiguous.
+	 *  AIRB AirbrushRecord[], optional.
+	 *  FALO FalloffRecord[], optional.
+	 *  DOTS DotRecord[], optional.
+	 *  LAYR LayerRecord[], optional. Layers of each drawing bottom to top, drawings in manifest order.
+	 *  MEMB MemberRecord[], optional. One per stroke in STRK, the layer it is drawn in.
+	 *  FILL FillRecord[], optional.
+	 *  SPLN SplineRecord[], optional. Bezier curves of strokes, control points in SPPO and SPTH.
+	 *  SPPO geom::Point[] control points of all curves, contiguous.
+	 *  SPTH float[] thickness at control points, contiguous.
+	 *  CURV CurveRecord[], version 2 only. Strokes listed here keep Bezier control points in POSI and THIC
+	 *       instead of vertices, and are tessellated on load.
+	 * Readers skip unknown chunks, and refuse files with a newer major version. Offsets and sizes of chunks and
+	 * records are checked before anything is read through them.
+	 * Files without LAYR and MEMB are older, their strokes are bottom to top and go into one layer of the first
+	 * drawing.
+	 */
+	class ProjectFile
+	{
+	public:
+		constexpr static std::array<char, 8> Magic{'C', 'I', 'A', 'L', 'L', 'O', 'P', 'J'};
+		// 2 stores fitted strokes as curves, 3 keeps their polyline and stores layers, membership and fills
+		constexpr static uint32_t Version = 3;
+		constexpr static uint64_t ChunkAlignment = 256; // covers minStorageBufferOffsetAlignment of most GPUs
+
+		struct FileHeader
+		{
+			std::array<char, 8> magic;
+			uint32_t version;
+			uint32_t chunkCount;
+			uint64_t chunkTableOffset;
+		};
+
+		struct ChunkEntry
+		{
+			uint32_t type;
+			uint32_t version;
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		struct BrushRecord
+		{
+			glm::vec4 color;
+		};
+
+		struct AirbrushRecord
+		{
+			uint32_t brush; // index in BRSH
+			float hardness;
+		};
+
+		struct DotRecord
+		{
+			uint32_t brush; // index in BRSH
+			float spacing;
+		};
+
+		struct FalloffRecord
+		{
+			uint32_t brush; // index in BRSH
+			std::array<glm::vec2, 4> controlPoints;
+		};
+
+		struct CurveRecord
+		{
+			uint32_t stroke; // index in STRK
+			float tolerance;
+		};
+
+		struct SplineRecord
+		{
+			uint64_t firstControlPoint; // in SPPO and SPTH
+			uint32_t controlPointCount;
+			uint32_t stroke; // index in STRK
+			float tolerance;
+			uint32_t padding = 0;
+		};
+
+		struct LayerRecord
+		{
+			uint64_t nextOrder;
+			uint32_t drawing; // index in drawings of the manifest, NoIndex for a layer in no stack
+			float alpha;
+			uint32_t blend; // BlendMode
+			uint32_t padding = 0;
+		};
+
+		struct MemberRecord
+		{
+			uint64_t order;
+			uint32_t layer; // index in LAYR, NoIndex for none
+			uint32_t padding = 0;
+		};
+
+		struct FillRecord
+		{
+			uint64_t order;
+			glm::vec4 color;
+			glm::vec2 seed;
+			uint32_t layer; // index in LAYR, NoIndex for none
+			uint32_t padding = 0;
+		};
+
+		struct StrokeRecord
+		{
+			uint64_t firstVertex;
+			uint32_t vertexCount;
+			uint32_t brush; // index in BRSH, NoBrush for none
+		};
+
+		constexpr static uint32_t NoBrush = std::numeric_limits<uint32_t>::max();
+		constexpr static uint32_t NoIndex = std::numeric_limits<uint32_t>::max();
+
+		constexpr static uint32_t fourcc(const char (&s)[5])
+		{
+			return static_cast<uint32_t>(s[0]) | static_cast<uint32_t>(s[1]) << 8 |
+				static_cast<uint32_t>(s[2]) << 16 | static_cast<uint32_t>(s[3]) << 24;
+		}
+
+		static void save(Project& project, const std::filesystem::path& path);
+		// Throws std::runtime_error on files that are broken or too new.
+		static Project load(const std::filesystem::path& path);
+	};
+}
@@ -0,0 +1,216 @@
+#include "pch.hpp"
+#include "RedoUndo.hpp"
+
+#include <map>
+
+namespace ciallo
+{
+	StrokeDelta::StrokeDelta(entt::entity e, const StrokeCpo& before, const StrokeCpo& after):
+		Delta(e, entt::type_hash<StrokeCpo>::value()),
+		m_position(RangeDelta<geom::Point>::diff(before.position, after.position)),
+		m_thickness(RangeDelta<float>::diff(before.thickness, after.thickness)),
+		m_brushBefore(before.brush), m_brushAfter(after.brush)
+	{
+	}
+
+	bool StrokeDelta::empty() const
+	{
+		return m_position.empty() && m_thickness.empty() && m_brushBefore == m_brushAfter;
+	}
+
+	namespace
+	{
+		// Patch the stroke, keeping the curve the patch would drop.
+		template <typename Func>
+		void patchKeepingCurve(entt::registry& r, entt::entity e, Func func)
+		{
+			std::optional<StrokeCurveCpo> curve;
+			if (auto* c = r.try_get<StrokeCurveCpo>(e)) curve = std::move(*c);
+			r.patch<StrokeCpo>(e, func);
+			if (curve) r.emplace_or_replace<StrokeCurveCpo>(e, std::move(*curve));
+		}
+	}
+
+	void StrokeDelta::undo(entt::registry& r) const
+	{
+		patchKeepingCurve(r, entity, [this](StrokeCpo& stroke)
+		{
+			m_position.undo(stroke.position);
+			m_thickness.undo(stroke.thickness);
+			stroke.brush = m_brushBefore;
+		});
+	}
+
+	void StrokeDelta::redo(entt::registry& r) const
+	{
+		patchKeepingCurve(r, entity, [this](StrokeCpo& stroke)
+		{
+			m_position.redo(stroke.position);
+			m_thickness.redo(stroke.thickness);
+			stroke.brush = m_brushAfter;
+		});
+	}
+
+	size_t StrokeDelta::memory() const
+	{
+		return sizeof(*this) + m_position.memory() + m_thickness.memory();
+	}
+
+	bool StrokeDelta::merge(const Delta& next)
+	{
+		auto* delta = dynamic_cast<const StrokeDelta*>(&next);
+		if (!delta) return false;
+		// Merge into copies, position and thickness must both succeed.
+		RangeDelta<geom::Point> position = m_position;
+		RangeDelta<float> thickness = m_thickness;
+		if (!position.merge(delta->m_position) || !thickness.merge(delta->m_thickness)) return false;
+		m_position = std::move(position);
+		m_thickness = std::move(thickness);
+		m_brushAfter = delta->m_brushAfter;
+		return true;
+	}
+
+	std::unique_ptr<Delta> modifyDelta(entt::entity e, const StrokeCpo& before, const StrokeCpo& after)
+	{
+		auto delta = std::make_unique<StrokeDelta>(e, before, after);
+		if (delta->empty()) return nullptr;
+		return delta;
+	}
+
+	std::unique_ptr<Delta> modifyDelta(entt::entity e, const StrokeCurveCpo& before, const StrokeCurveCpo& after)
+	{
+		if (before.tolerance == after.tolerance && before.spline.controlPoints == after.spline.controlPoints &&
+			before.spline.thickness == after.spline.thickness)
+			return nullptr;
+		return std::make_unique<ValueDelta<StrokeCurveCpo>>(e, before, after);
+	}
+
+	void RedoUndoLog::push(RedoUndoStep step)
+	{
+		// New step drops everything redoable.
+		while (m_steps.size() > m_cursor)
+		{
+			m_memory -= m_steps.back().memory;
+			m_steps.pop_back();
+		}
+		step.memory = sizeof(RedoUndoStep) + step.name.capacity();
+		for (const auto& delta : step.deltas)
+		{
+			step.memory += delta->memory();
+		}
+		m_memory += step.memory;
+		m_steps.push_back(std::move(step));
+		m_cursor = m_steps.size();
+		enforceBudget();
+	}
+
+	void RedoUndoLog::undo(entt::registry& r)
+	{
+		if (!canUndo()) return;
+		const RedoUndoStep& step = m_steps[--m_cursor];
+		for (const auto& delta : step.deltas | views::reverse)
+		{
+			delta->undo(r);
+		}
+	}
+
+	void RedoUndoLog::redo(entt::registry& r)
+	{
+		if (!canRedo()) return;
+		const RedoUndoStep& step = m_steps[m_cursor++];
+		for (const auto& delta : step.deltas)
+		{
+			delta->redo(r);
+		}
+	}
+
+	void RedoUndoLog::coalesceOldest()
+	{
+		RedoUndoStep& older = m_steps[0];
+		RedoUndoStep& newer = m_steps[1];
+		m_memory -= older.memory + newer.memory;
+
+		// Latest delta of each entity and component in the merged step.
+		std::map<std::pair<entt::entity, entt::id_type>, Delta*> latest;
+		for (auto& delta : older.deltas)
+		{
+			latest[{delta->entity, delta->type}] = delta.get();
+		}
+		for (auto& delta : newer.deltas)
+		{
+			auto it = latest.find({delta->entity, delta->type});
+			if (it != latest.end() && it->second->merge(*delta)) continue;
+			latest[{delta->entity, delta->type}] = delta.get();
+			older.deltas.push_back(std::move(delta));
+		}
+		older.name = std::format("{}, {}", older.name, newer.name);
+		older.memory = sizeof(RedoUndoStep) + older.name.capacity();
+		for (const auto& delta : older.deltas)
+		{
+			older.memory += delta->memory();
+		}
+		m_memory += older.memory;
+		m_steps.erase(m_steps.begin() + 1);
+		--m_cursor;
+	}
+
+	void RedoUndoLog::enforceBudget()
+	{
+		while (m_memory > budget && !m_steps.empty())
+		{
+			if (m_cursor == 0)
+			{
+				// Only redoable steps left.
+				m_memory -= m_steps.back().memory;
+				m_steps.pop_back();
+				continue;
+			}
+			size_t before = m_memory;
+			if (m_cursor >= 2)
+			{
+				coalesceOldest();
+				if (m_memory < before) continue;
+			}
+			m_memory -= m_steps.front().memory;
+			m_steps.pop_front();
+			--m_cursor;
+		}
+	}
+
+	void RedoUndo::connect(Project& project)
+	{
+		project.redoUndoRegistry().ctx().emplace<RedoUndoLog>();
+		watchAll(project, Tracked{});
+	}
+
+	void RedoUndo::commit(Project& project, std::string name)
+	{
+		RedoUndoStep step{std::move(name)};
+		collectAll(project.registry(), project.redoUndoRegistry(), step, Tracked{});
+		// Copies taken for Modifying are consumed.
+		project.redoUndoRegistry().clear();
+		if (step.deltas.empty()) return;
+		log(project).push(std::move(step));
+	}
+
+	void RedoUndo::undo(Project& project)
+	{
+		log(project).undo(project.registry());
+	}
+
+	void RedoUndo::redo(Project& project)
+	{
+		log(project).redo(project.registry());
+	}
+
+	void RedoUndo::reset(Project& project)
+	{
+		project.redoUndoRegistry().clear();
+		log(project) = RedoUndoLog{};
+	}
+
+	RedoUndoLog& RedoUndo::log(Project& project)
+	{
+		return project.redoUndoRegistry().ctx().at<RedoUndoLog>();
+	}
+}
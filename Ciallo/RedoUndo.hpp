@@ -0,0 +1,352 @@
+#pragma once
+#include <cstring>
+#include <deque>
+
+#include "Brush.hpp"
+#include "CurveFitting.hpp"
+#include "Drawing.hpp"
+#include "FalloffCurve.hpp"
+#include "FillRegion.hpp"
+#include "Layer.hpp"
+#include "Project.hpp"
+#include "Stroke.hpp"
+#include "Tags.hpp"
+
+namespace ciallo
+{
+	/**
+	 * \brief Change of one component on one entity, able to go both ways.
+	 */
+	class Delta
+	{
+	public:
+		entt::entity entity;
+		entt::id_type type;
+
+		Delta(entt::entity entity, entt::id_type type): entity(entity), type(type)
+		{
+		}
+
+		virtual ~Delta() = default;
+		virtual void undo(entt::registry& r) const = 0;
+		virtual void redo(entt::registry& r) const = 0;
+		// Bytes held by this delta.
+		virtual size_t memory() const = 0;
+		// Fold a later delta of the same entity and component into this one. Return false if impossible.
+		virtual bool merge(const Delta& next) { return false; }
+	};
+
+	template <typename Cpo>
+	size_t componentMemory(const Cpo&)
+	{
+		return sizeof(Cpo);
+	}
+
+	inline size_t componentMemory(const StrokeCpo& stroke)
+	{
+		return sizeof(StrokeCpo) + stroke.position.size() * sizeof(geom::Point) + stroke.thickness.size() * sizeof(float);
+	}
+
+	inline size_t componentMemory(const StrokeCurveCpo& curve)
+	{
+		return sizeof(StrokeCurveCpo) + curve.spline.memory();
+	}
+
+	namespace detail
+	{
+		inline entt::entity revive(entt::registry& r, entt::entity e)
+		{
+			return r.valid(e) ? e : r.create(e);
+		}
+
+		inline void destroyOrphan(entt::registry& r, entt::entity e)
+		{
+			if (r.orphan(e)) r.destroy(e);
+		}
+	}
+
+	// Whole value before and after, for small components.
+	template <typename Cpo>
+	class ValueDelta : public Delta
+	{
+		Cpo m_before;
+		Cpo m_after;
+	public:
+		ValueDelta(entt::entity e, const Cpo& before, const Cpo& after):
+			Delta(e, entt::type_hash<Cpo>::value()), m_before(before), m_after(after)
+		{
+		}
+
+		void undo(entt::registry& r) const override { r.replace<Cpo>(entity, m_before); }
+		void redo(entt::registry& r) const override { r.replace<Cpo>(entity, m_after); }
+
+		size_t memory() const override
+		{
+			return sizeof(*this) - 2 * sizeof(Cpo) + componentMemory(m_before) + componentMemory(m_after);
+		}
+
+		bool merge(const Delta& next) override
+		{
+			auto* delta = dynamic_cast<const ValueDelta*>(&next);
+			if (!delta) return false;
+			m_after = delta->m_after;
+			return true;
+		}
+	};
+
+	// Component coming into or going out of existence.
+	template <typename Cpo>
+	class ExistenceDelta : public Delta
+	{
+		Cpo m_value;
+		bool m_constructed;
+
+		void construct(entt::registry& r) const { r.emplace<Cpo>(detail::revive(r, entity), m_value); }
+
+		void destruct(entt::registry& r) const
+		{
+			r.remove<Cpo>(entity);
+			detail::destroyOrphan(r, entity);
+		}
+
+	public:
+		ExistenceDelta(entt::entity e, Cpo value, bool constructed):
+			Delta(e, entt::type_hash<Cpo>::value()), m_value(std::move(value)), m_constructed(constructed)
+		{
+		}
+
+		void undo(entt::registry& r) const override { m_constructed ? destruct(r) : construct(r); }
+		void redo(entt::registry& r) const override { m_constructed ? construct(r) : destruct(r); }
+		size_t memory() const override { return sizeof(*this) - sizeof(Cpo) + componentMemory(m_value); }
+	};
+
+	/**
+	 * \brief Replacement of one contiguous range of a vector.
+	 * Elements [first, first + before.size()) became after.
+	 */
+	template <typename T>
+	struct RangeDelta
+	{
+		size_t first = 0;
+		std::vector<T> before;
+		std::vector<T> after;
+
+		// Common prefix and suffix are left out.
+		static RangeDelta diff(const std::vector<T>& before, const std::vector<T>& after)
+		{
+			size_t common = std::min(before.size(), after.size());
+			size_t prefix = 0;
+			while (prefix < common && before[prefix] == after[prefix]) ++prefix;
+			size_t suffix = 0;
+			while (suffix < common - prefix &&
+				before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix])
+				++suffix;
+			return {
+				prefix,
+				{before.begin() + prefix, before.end() - suffix},
+				{after.begin() + prefix, after.end() - suffix}
+			};
+		}
+
+		bool empty() const { return before.empty() && after.empty(); }
+		size_t memory() const { return (before.capacity() + after.capacity()) * sizeof(T); }
+
+		static void replace(std::vector<T>& v, size_t first, const std::vector<T>& from, const std::vector<T>& to)
+		{
+			if (from.size() == to.size())
+			{
+				std::copy(to.begin(), to.end(), v.begin() + first);
+				return;
+			}
+			auto it = v.erase(v.begin() + first, v.begin() + first + from.size());
+			v.insert(it, to.begin(), to.end());
+		}
+
+		void undo(std::vector<T>& v) const { replace(v, first, after, before); }
+		void redo(std::vector<T>& v) const { replace(v, first, before, after); }
+
+		/**
+		 * \brief Compose with the next delta, possible when both ranges overlap or touch.
+		 * Both ranges are laid into the intermediate state, giving the union range in all three states.
+		 */
+		bool merge(const RangeDelta& next)
+		{
+			if (next.empty()) return true;
+			if (empty())
+			{
+				*this = next;
+				return true;
+			}
+			size_t a0 = first, a1 = first + after.size();
+			size_t b0 = next.first, b1 = next.first + next.before.size();
+			if (a1 < b0 || b1 < a0) return false;
+
+			size_t lo = std::min(a0, b0), hi = std::max(a1, b1);
+			std::vector<T> middle(hi - lo);
+			std::copy(next.before.begin(), next.before.end(), middle.begin() + (b0 - lo));
+			std::copy(after.begin(), after.end(), middle.begin() + (a0 - lo));
+
+			std::vector<T> merged = middle;
+			replace(merged, a0 - lo, after, before);
+			before = std::move(merged);
+			replace(middle, b0 - lo, next.before, next.after);
+			after = std::move(middle);
+			first = lo;
+			return true;
+		}
+	};
+
+	/**
+	 * \brief Stroke stores only the changed vertex ranges, appending to a stroke costs the appended vertices.
+	 * Its curve is left as is, patching the stroke would drop it. Curves have deltas of their own.
+	 */
+	class StrokeDelta : public Delta
+	{
+		RangeDelta<geom::Point> m_position;
+		RangeDelta<float> m_thickness;
+		entt::entity m_brushBefore;
+		entt::entity m_brushAfter;
+	public:
+		StrokeDelta(entt::entity e, const StrokeCpo& before, const StrokeCpo& after);
+
+		bool empty() const;
+		void undo(entt::registry& r) const override;
+		void redo(entt::registry& r) const override;
+		size_t memory() const override;
+		bool merge(const Delta& next) override;
+	};
+
+	template <typename Cpo>
+	std::unique_ptr<Delta> modifyDelta(entt::entity e, const Cpo& before, const Cpo& after)
+	{
+		static_assert(std::is_trivially_copyable_v<Cpo>, "Components holding heap memory need their own delta.");
+		if (std::memcmp(&before, &after, sizeof(Cpo)) == 0) return nullptr;
+		return std::make_unique<ValueDelta<Cpo>>(e, before, after);
+	}
+
+	std::unique_ptr<Delta> modifyDelta(entt::entity e, const StrokeCpo& before, const StrokeCpo& after);
+	std::unique_ptr<Delta> modifyDelta(entt::entity e, const StrokeCurveCpo& before, const StrokeCurveCpo& after);
+
+	struct RedoUndoStep
+	{
+		std::string name;
+		std::vector<std::unique_ptr<Delta>> deltas;
+		size_t memory = 0;
+	};
+
+	/**
+	 * \brief Command log of steps made of deltas, lives in ctx of redo undo registry.
+	 * Steps before cursor are done and can be undone, steps after it can be redone.
+	 */
+	class RedoUndoLog
+	{
+		std::deque<RedoUndoStep> m_steps;
+		size_t m_cursor = 0;
+		size_t m_memory = 0;
+
+		// Oldest two steps become one, shares memory of deltas on same entity and component.
+		void coalesceOldest();
+		void enforceBudget();
+	public:
+		size_t budget = 256ull * 1024 * 1024;
+
+		void push(RedoUndoStep step);
+		bool canUndo() const { return m_cursor > 0; }
+		bool canRedo() const { return m_cursor < m_steps.size(); }
+		void undo(entt::registry& r);
+		void redo(entt::registry& r);
+
+		size_t memory() const { return m_memory; }
+		size_t stepCount() const { return m_steps.size(); }
+		const std::string& undoName() const { return m_steps[m_cursor - 1].name; }
+		const std::string& redoName() const { return m_steps[m_cursor].name; }
+	};
+
+	/**
+	 * \brief Delta based redo undo.
+	 * Edits put Constructed<Cpo>, Modifying<Cpo> or Destructed<Cpo> on entities of the main registry. Modifying
+	 * copies the current component into the redo undo registry, on an entity of the same identifier. Commit turns
+	 * tags into deltas of a step, costing the changed data instead of whole registry.
+	 */
+	class RedoUndo
+	{
+		template <typename Cpo>
+		static void captureBefore(entt::registry& redoUndoRegistry, entt::registry& r, entt::entity e)
+		{
+			if (!r.all_of<Cpo>(e)) return;
+			redoUndoRegistry.emplace_or_replace<Cpo>(detail::revive(redoUndoRegistry, e), r.get<Cpo>(e));
+		}
+
+		template <typename Cpo>
+		static void watch(Project& project)
+		{
+			project.registry().on_construct<Modifying<Cpo>>().template connect<&captureBefore<Cpo>>(
+				project.redoUndoRegistry());
+		}
+
+		template <typename Cpo>
+		static void collect(entt::registry& r, entt::registry& redoUndoRegistry, RedoUndoStep& step)
+		{
+			for (entt::entity e : r.view<Constructed<Cpo>, Cpo>())
+			{
+				step.deltas.push_back(std::make_unique<ExistenceDelta<Cpo>>(e, r.get<Cpo>(e), true));
+			}
+
+			for (entt::entity e : r.view<Modifying<Cpo>>(entt::exclude<Constructed<Cpo>>))
+			{
+				const Cpo* before = redoUndoRegistry.valid(e) ? redoUndoRegistry.try_get<Cpo>(e) : nullptr;
+				const Cpo* after = r.try_get<Cpo>(e);
+				// Derived components may come or go as a side effect of the modification.
+				if (!before && after)
+				{
+					step.deltas.push_back(std::make_unique<ExistenceDelta<Cpo>>(e, *after, true));
+				}
+				else if (before && !after)
+				{
+					step.deltas.push_back(std::make_unique<ExistenceDelta<Cpo>>(e, *before, false));
+				}
+				else if (before && after)
+				{
+					if (auto delta = modifyDelta(e, *before, *after)) step.deltas.push_back(std::move(delta));
+				}
+			}
+
+			std::vector<entt::entity> destructed{r.view<Destructed<Cpo>>().begin(), r.view<Destructed<Cpo>>().end()};
+			r.clear<Constructed<Cpo>, Modifying<Cpo>, Destructed<Cpo>>();
+			for (entt::entity e : destructed)
+			{
+				if (!r.all_of<Cpo>(e)) continue;
+				step.deltas.push_back(std::make_unique<ExistenceDelta<Cpo>>(e, r.get<Cpo>(e), false));
+				r.remove<Cpo>(e);
+				detail::destroyOrphan(r, e);
+			}
+		}
+
+		template <typename... Cpo>
+		static void watchAll(Project& project, entt::type_list<Cpo...>)
+		{
+			(watch<Cpo>(project), ...);
+		}
+
+		template <typename... Cpo>
+		static void collectAll(entt::registry& r, entt::registry& redoUndoRegistry, RedoUndoStep& step,
+		                       entt::type_list<Cpo...>)
+		{
+			(collect<Cpo>(r, redoUndoRegistry, step), ...);
+		}
+
+	public:
+		// Curves come after their strokes, redo constructs a stroke before its curve and undo goes the other way.
+		using Tracked = entt::type_list<StrokeCpo, StrokeCurveCpo, ColorCpo, AirbrushCpo, EquidistantDotCpo,
+		                                FalloffCurveCpo, LayerCpo, ViewRectCpo, FillCpo>;
+
+		static void connect(Project& project);
+		// Turn tags into a step. Nothing is recorded when nothing changed.
+		static void commit(Project& project, std::string name);
+		static void undo(Project& project);
+		static void redo(Project& project);
+		// Forget every step, after the main registry was replaced as a whole.
+		static void reset(Project& project);
+		static RedoUndoLog& log(Project& project);
+	};
+}
@@ -0,0 +1,413 @@
+#include "pch.hpp"
+#include "RegistrySnapshot.hpp"
+
+#include <fstream>
+#include <lz4.h>
+
+#include "Brush.hpp"
+#include "CanvasFormat.hpp"
+#include "CanvasPanel.hpp"
+#include "CurveFitting.hpp"
+#include "Drawing.hpp"
+#include "FalloffCurve.hpp"
+#include "FillRegion.hpp"
+#include "Layer.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo
+{
+	void SnapshotOutputArchive::write(const StrokeCpo& stroke)
+	{
+		write(stroke.position);
+		write(stroke.thickness);
+		write(stroke.brush);
+	}
+
+	void SnapshotOutputArchive::write(const StrokeCurveCpo& curve)
+	{
+		write(curve.spline.controlPoints);
+		write(curve.spline.thickness);
+		write(curve.tolerance);
+	}
+
+	void SnapshotOutputArchive::write(const CanvasPanelCpo& panel)
+	{
+		// Visible region is derived every frame, not saved.
+		write(panel.drawing);
+		write(panel.drawingRotation);
+		write(panel.zoom);
+		write(panel.scroll);
+		write(panel.onionSkinDrawings);
+		write(panel.onionSkinDrawingRotations);
+	}
+
+	void SnapshotOutputArchive::write(const LayerStackCpo& stack)
+	{
+		write(stack.layers);
+	}
+
+	std::span<const std::byte> SnapshotInputArchive::take(size_t size)
+	{
+		if (m_offset + size > m_data.size())
+		{
+			throw std::runtime_error("Snapshot is truncated!");
+		}
+		auto bytes = m_data.subspan(m_offset, size);
+		m_offset += size;
+		return bytes;
+	}
+
+	void SnapshotInputArchive::read(StrokeCpo& stroke)
+	{
+		read(stroke.position);
+		read(stroke.thickness);
+		read(stroke.brush);
+	}
+
+	void SnapshotInputArchive::read(StrokeCurveCpo& curve)
+	{
+		read(curve.spline.controlPoints);
+		read(curve.spline.thickness);
+		read(curve.tolerance);
+	}
+
+	void SnapshotInputArchive::read(CanvasPanelCpo& panel)
+	{
+		read(panel.drawing);
+		read(panel.drawingRotation);
+		read(panel.zoom);
+		read(panel.scroll);
+		read(panel.onionSkinDrawings);
+		read(panel.onionSkinDrawingRotations);
+	}
+
+	void SnapshotInputArchive::read(LayerStackCpo& stack)
+	{
+		read(stack.layers);
+	}
+
+	namespace
+	{
+		// Tags are saved too, they give meaning to entities.
+		// Curves follow their strokes, emplacing a stroke never drops a curve but patching one does.
+		using Persistent = entt::type_list<StrokeCpo, StrokeCurveCpo, BrushTag, ColorCpo, AirbrushCpo,
+		                                   EquidistantDotCpo, FalloffCurveCpo, LayerCpo, LayerStackCpo, LayerMemberCpo,
+		                                   FillCpo, DrawingTag, ViewRectCpo, CanvasFormatCpo, CanvasPanelCpo>;
+
+		template <typename Archive, typename Snapshot, typename... T>
+		void persistentComponents(Snapshot& snapshot, Archive& archive, entt::type_list<T...>)
+		{
+			snapshot.template component<T...>(archive);
+		}
+
+		template <typename T>
+		void copyComponents(const entt::registry& src, entt::registry& dst)
+		{
+			if constexpr (std::is_empty_v<T>)
+			{
+				for (entt::entity e : src.view<const T>())
+				{
+					dst.emplace<T>(e);
+				}
+			}
+			else
+			{
+				for (auto&& [e, value] : src.view<const T>().each())
+				{
+					dst.emplace<T>(e, value);
+				}
+			}
+		}
+
+		template <typename... T>
+		void copyPersistent(const entt::registry& src, entt::registry& dst, entt::type_list<T...>)
+		{
+			(copyComponents<T>(src, dst), ...);
+		}
+
+		// Of entities that scale with strokes, always patched or replaced when edited.
+		using Tracked = entt::type_list<StrokeCpo, StrokeCurveCpo, LayerMemberCpo, FillCpo>;
+		// The rest of Persistent.
+		using Whole = entt::type_list<BrushTag, ColorCpo, AirbrushCpo, EquidistantDotCpo, FalloffCurveCpo, LayerCpo,
+		                              LayerStackCpo, DrawingTag, ViewRectCpo, CanvasFormatCpo, CanvasPanelCpo>;
+		static_assert(Tracked::size + Whole::size == Persistent::size);
+
+		template <typename T>
+		void syncComponent(const entt::registry& src, entt::registry& dst, entt::entity e)
+		{
+			if (!src.all_of<T>(e))
+			{
+				dst.remove<T>(e);
+			}
+			else if constexpr (std::is_empty_v<T>)
+			{
+				if (!dst.all_of<T>(e)) dst.emplace<T>(e);
+			}
+			else
+			{
+				dst.emplace_or_replace<T>(e, src.get<T>(e));
+			}
+		}
+
+		template <typename... T>
+		void syncTracked(const entt::registry& src, entt::registry& dst, entt::entity e, entt::type_list<T...>)
+		{
+			(syncComponent<T>(src, dst, e), ...);
+		}
+
+		template <typename... T>
+		void copyWhole(const entt::registry& src, entt::registry& dst, entt::type_list<T...>)
+		{
+			(dst.clear<T>(), ...);
+			(copyComponents<T>(src, dst), ...);
+		}
+
+		template <auto Candidate, typename Instance, typename... T>
+		void connectAll(entt::registry& r, Instance& instance, entt::type_list<T...>)
+		{
+			(r.on_construct<T>().template connect<Candidate>(instance), ...);
+			(r.on_update<T>().template connect<Candidate>(instance), ...);
+			(r.on_destroy<T>().template connect<Candidate>(instance), ...);
+		}
+
+		struct CompressedHeader
+		{
+			std::array<char, 4> magic;
+			uint32_t version;
+			uint64_t rawSize;
+			uint32_t chunkSize;
+			uint32_t chunkCount;
+		};
+	}
+
+	std::vector<std::byte> RegistrySnapshot::take(const entt::registry& r)
+	{
+		SnapshotOutputArchive archive;
+		entt::snapshot snapshot{r};
+		snapshot.entities(archive);
+		persistentComponents(snapshot, archive, Persistent{});
+		return std::move(archive.data());
+	}
+
+	void RegistrySnapshot::restore(entt::registry& r, std::span<const std::byte> snapshot)
+	{
+		SnapshotInputArchive archive(snapshot);
+		entt::snapshot_loader loader{r};
+		loader.entities(archive);
+		persistentComponents(loader, archive, Persistent{});
+		loader.orphans();
+	}
+
+	void RegistrySnapshot::clone(const entt::registry& src, entt::registry& dst)
+	{
+		// Same identifiers, versions included, so entities referenced by components stay valid.
+		src.each([&dst](entt::entity e) { dst.create(e); });
+		copyPersistent(src, dst, Persistent{});
+	}
+
+	void RegistrySnapshot::sync(const entt::registry& src, entt::registry& dst,
+	                            const std::unordered_set<entt::entity>& changed)
+	{
+		// Destroyed first, a destroyed identifier may be in use again with a newer version.
+		for (entt::entity e : changed)
+		{
+			if (!src.valid(e) && dst.valid(e)) dst.destroy(e);
+		}
+		for (entt::entity e : changed)
+		{
+			if (!src.valid(e)) continue;
+			if (!dst.valid(e)) dst.create(e);
+			syncTracked(src, dst, e, Tracked{});
+		}
+		// Entities of those were created by the loop above, constructing any component marks them changed.
+		copyWhole(src, dst, Whole{});
+	}
+
+	std::vector<std::byte> RegistrySnapshot::compress(std::span<const std::byte> snapshot, JobSystem& jobs)
+	{
+		uint32_t chunkCount = static_cast<uint32_t>((snapshot.size() + ChunkSize - 1) / ChunkSize);
+		std::vector<std::vector<std::byte>> chunks(chunkCount);
+		std::atomic<bool> failed = false;
+		jobs.parallelFor(chunkCount, [&](size_t i)
+		{
+			auto src = snapshot.subspan(i * ChunkSize, std::min<size_t>(ChunkSize, snapshot.size() - i * ChunkSize));
+			auto& dst = chunks[i];
+			dst.resize(LZ4_compressBound(static_cast<int>(src.size())));
+			int size = LZ4_compress_default(reinterpret_cast<const char*>(src.data()),
+			                                reinterpret_cast<char*>(dst.data()),
+			                                static_cast<int>(src.size()), static_cast<int>(dst.size()));
+			if (size <= 0) failed = true;
+			else dst.resize(size);
+		}, 1);
+		// Jobs must not throw, report here.
+		if (failed)
+		{
+			throw std::runtime_error("Failed to compress snapshot!");
+		}
+
+		// Header | compressed size of every chunk | chunks
+		CompressedHeader header{Magic, Version, snapshot.size(), ChunkSize, chunkCount};
+		std::vector<uint32_t> sizes = chunks | views::transform([](const auto& c)
+		{
+			return static_cast<uint32_t>(c.size());
+		}) | ranges::to<std::vector>();
+
+		std::vector<std::byte> result;
+		auto append = [&result](std::span<const std::byte> bytes)
+		{
+			result.insert(result.end(), bytes.begin(), bytes.end());
+		};
+		append(std::as_bytes(std::span{&header, 1}));
+		append(std::as_bytes(std::span{sizes}));
+		for (const auto& chunk : chunks)
+		{
+			append(chunk);
+		}
+		return result;
+	}
+
+	std::vector<std::byte> RegistrySnapshot::decompress(std::span<const std::byte> compressed, JobSystem& jobs)
+	{
+		if (compressed.size() < sizeof(CompressedHeader))
+		{
+			throw std::runtime_error("Snapshot is truncated!");
+		}
+		CompressedHeader header;
+		std::memcpy(&header, compressed.data(), sizeof(header));
+		if (header.magic != Magic || header.version != Version)
+		{
+			throw std::runtime_error("Not a supported snapshot!");
+		}
+		size_t tableSize = header.chunkCount * sizeof(uint32_t);
+		if (sizeof(header) + tableSize > compressed.size() ||
+			header.chunkCount != (header.rawSize + header.chunkSize - 1) / header.chunkSize)
+		{
+			throw std::runtime_error("Snapshot is truncated!");
+		}
+		std::vector<uint32_t> sizes(header.chunkCount);
+		std::memcpy(sizes.data(), compressed.data() + sizeof(header), tableSize);
+
+		std::vector<size_t> offsets(header.chunkCount);
+		size_t offset = sizeof(header) + tableSize;
+		for (uint32_t i = 0; i < header.chunkCount; ++i)
+		{
+			offsets[i] = offset;
+			offset += sizes[i];
+		}
+		if (offset > compressed.size())
+		{
+			throw std::runtime_error("Snapshot is truncated!");
+		}
+
+		std::vector<std::byte> result(header.rawSize);
+		std::atomic<bool> failed = false;
+		jobs.parallelFor(header.chunkCount, [&](size_t i)
+		{
+			size_t rawSize = std::min<size_t>(header.chunkSize, header.rawSize - i * header.chunkSize);
+			int size = LZ4_decompress_safe(reinterpret_cast<const char*>(compressed.data() + offsets[i]),
+			                               reinterpret_cast<char*>(result.data() + i * header.chunkSize),
+			                               static_cast<int>(sizes[i]), static_cast<int>(rawSize));
+			if (size != static_cast<int>(rawSize)) failed = true;
+		}, 1);
+		if (failed)
+		{
+			throw std::runtime_error("Snapshot is corrupted!");
+		}
+		return result;
+	}
+
+	void RegistrySnapshot::write(const std::filesystem::path& path, std::span<const std::byte> compressed)
+	{
+		std::filesystem::path temp = path;
+		temp += ".tmp";
+		{
+			std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(compressed.data()),
+			           static_cast<std::streamsize>(compressed.size()));
+			if (!file.good())
+			{
+				throw std::runtime_error(std::format("Failed to write file {}!", temp.string()));
+			}
+		}
+		std::filesystem::rename(temp, path);
+	}
+
+	std::vector<std::byte> RegistrySnapshot::read(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			throw std::runtime_error(std::format("Failed to open file {}!", path.string()));
+		}
+		std::vector<std::byte> data(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		return data;
+	}
+
+	Autosaver::Autosaver(JobSystem& jobs, std::filesystem::path path, std::chrono::steady_clock::duration interval):
+		m_jobs(jobs), m_path(std::move(path)), m_interval(interval), m_lastSave(std::chrono::steady_clock::now())
+	{
+	}
+
+	Autosaver::~Autosaver()
+	{
+		flush();
+	}
+
+	void Autosaver::connect(entt::registry& r)
+	{
+		connectAll<&Autosaver::markChanged>(r, *this, Persistent{});
+	}
+
+	void Autosaver::markChanged(entt::registry&, entt::entity e)
+	{
+		m_changed.insert(e);
+	}
+
+	void Autosaver::update(const entt::registry& r)
+	{
+		if (std::chrono::steady_clock::now() - m_lastSave >= m_interval)
+		{
+			save(r);
+		}
+	}
+
+	void Autosaver::save(const entt::registry& r)
+	{
+		if (m_pending.valid())
+		{
+			if (m_pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+			flush();
+		}
+		m_lastSave = std::chrono::steady_clock::now();
+		// No save is running, the shadow is free to change.
+		if (!m_cloned)
+		{
+			RegistrySnapshot::clone(r, m_shadow);
+			m_cloned = true;
+		}
+		else
+		{
+			RegistrySnapshot::sync(r, m_shadow, m_changed);
+		}
+		m_changed.clear();
+		m_pending = std::async(std::launch::async, [this]
+		{
+			RegistrySnapshot::write(m_path, RegistrySnapshot::compress(RegistrySnapshot::take(m_shadow), m_jobs));
+		});
+	}
+
+	void Autosaver::flush()
+	{
+		if (!m_pending.valid()) return;
+		try
+		{
+			m_pending.get();
+		}
+		catch (std::exception& e)
+		{
+			spdlog::error("Autosave failed: {}", e.what());
+		}
+	}
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <span>
+#include <unordered_set>
+
+#include "JobSystem.hpp"
+
+namespace ciallo
+{
+	struct StrokeCpo;
+	struct StrokeCurveCpo;
+	struct CanvasPanelCpo;
+	struct LayerStackCpo;
+
+	/**
+	 * \brief Binary archive for entt::snapshot. Trivially copyable values are written as is,
+	 * components holding heap memory have their own overloads.
+	 */
+	class SnapshotOutputArchive
+	{
+		std::vector<std::byte> m_data;
+
+		template <typename T> requires std::is_trivially_copyable_v<T>
+		void write(const T& value)
+		{
+			auto bytes = std::as_bytes(std::span{&value, 1});
+			m_data.insert(m_data.end(), bytes.begin(), bytes.end());
+		}
+
+		template <typename T> requires std::is_trivially_copyable_v<T>
+		void write(const std::vector<T>& values)
+		{
+			write(static_cast<uint64_t>(values.size()));
+			auto bytes = std::as_bytes(std::span{values});
+			m_data.insert(m_data.end(), bytes.begin(), bytes.end());
+		}
+
+		void write(const StrokeCpo& stroke);
+		void write(const StrokeCurveCpo& curve);
+		void write(const CanvasPanelCpo& panel);
+		void write(const LayerStackCpo& stack);
+	public:
+		template <typename... T>
+		void operator()(const T&... values)
+		{
+			(write(values), ...);
+		}
+
+		std::vector<std::byte>& data() { return m_data; }
+	};
+
+	class SnapshotInputArchive
+	{
+		std::span<const std::byte> m_data;
+		size_t m_offset = 0;
+
+		std::span<const std::byte> take(size_t size);
+
+		template <typename T> requires std::is_trivially_copyable_v<T>
+		void read(T& value)
+		{
+			std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+		}
+
+		template <typename T> requires std::is_trivially_copyable_v<T>
+		void read(std::vector<T>& values)
+		{
+			uint64_t size;
+			read(size);
+			auto bytes = take(size * sizeof(T));
+			values.resize(size);
+			std::memcpy(values.data(), bytes.data(), bytes.size());
+		}
+
+		void read(StrokeCpo& stroke);
+		void read(StrokeCurveCpo& curve);
+		void read(CanvasPanelCpo& panel);
+		void read(LayerStackCpo& stack);
+	public:
+		explicit SnapshotInputArchive(std::span<const std::byte> data): m_data(data)
+		{
+		}
+
+		template <typename... T>
+		void operator()(T&... values)
+		{
+			(read(values), ...);
+		}
+	};
+
+	/**
+	 * \brief Snapshot and restore of the persistent components of a registry, on top of entt::snapshot.
+	 * Compressed snapshots are split into chunks compressed and decompressed in parallel with LZ4.
+	 */
+	class RegistrySnapshot
+	{
+	public:
+		constexpr static std::array<char, 4> Magic{'C', 'S', 'N', 'P'};
+		constexpr static uint32_t Version = 8; // the archived component list is part of the format
+		constexpr static uint32_t ChunkSize = 256 * 1024; // small enough to never hold a waiting thread for long
+
+		// Raw snapshot, a flat copy of everything persistent. No compression.
+		static std::vector<std::byte> take(const entt::registry& r);
+		// r should be empty.
+		static void restore(entt::registry& r, std::span<const std::byte> snapshot);
+		/**
+		 * \brief Copy persistent components into dst under the same identifiers, dst should be empty.
+		 * Nothing is serialized, far cheaper than take() followed by restore().
+		 */
+		static void clone(const entt::registry& src, entt::registry& dst);
+		/**
+		 * \brief Bring dst, a clone of src, up to date. Changed holds every entity a persistent component was added
+		 * to, replaced, patched or removed from since. Components of brushes, layers, drawings and panels are few
+		 * and edited in place too, they are copied whole.
+		 */
+		static void sync(const entt::registry& src, entt::registry& dst,
+		                 const std::unordered_set<entt::entity>& changed);
+
+		static std::vector<std::byte> compress(std::span<const std::byte> snapshot, JobSystem& jobs);
+		static std::vector<std::byte> decompress(std::span<const std::byte> compressed, JobSystem& jobs);
+
+		static void write(const std::filesystem::path& path, std::span<const std::byte> compressed);
+		static std::vector<std::byte> read(const std::filesystem::path& path);
+	};
+
+	/**
+	 * \brief Saves the main registry periodically without stalling frames.
+	 * A shadow registry keeps the persistent components as of the last save. Main thread only copies entities
+	 * changed since into it, serializing the shadow, compression and file writing happen on another thread.
+	 */
+	class Autosaver
+	{
+		JobSystem& m_jobs;
+		std::filesystem::path m_path;
+		std::chrono::steady_clock::duration m_interval;
+		std::chrono::steady_clock::time_point m_lastSave;
+		std::future<void> m_pending; // reads m_shadow until done
+		entt::registry m_shadow;
+		bool m_cloned = false; // shadow was cloned from the registry once
+		std::unordered_set<entt::entity> m_changed; // since the shadow was synced
+
+		void markChanged(entt::registry& r, entt::entity e);
+	public:
+		Autosaver(JobSystem& jobs, std::filesystem::path path,
+		          std::chrono::steady_clock::duration interval = std::chrono::minutes(2));
+		Autosaver(const Autosaver& other) = delete;
+		Autosaver(Autosaver&& other) = delete;
+		Autosaver& operator=(const Autosaver& other) = delete;
+		Autosaver& operator=(Autosaver&& other) = delete;
+		~Autosaver();
+
+		// Track changes of r from now on, before the first save. r is destroyed before the autosaver.
+		void connect(entt::registry& r);
+		void update(const entt::registry& r);
+		// Start saving now, if no save is running.
+		void save(const entt::registry& r);
+		// Block until the running save is done.
+		void flush();
+	};
+}
@@ -0,0 +1,387 @@
+#include "pch.hpp"
+#include "RenderGraph.hpp"
+
+namespace ciallo::rendering
+{
+	namespace
+	{
+		constexpr vk::AccessFlags2 WriteAccess =
+			vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+			vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+			vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite;
+
+		RenderGraph::Pass& use(RenderGraph::Pass& pass, RenderGraph::Resource resource, ResourceAccess access)
+		{
+			auto it = ranges::find(pass.uses, resource, &RenderGraph::Pass::Use::resource);
+			if (it == pass.uses.end())
+			{
+				pass.uses.push_back({resource, access});
+				return pass;
+			}
+			if (it->access.layout != access.layout)
+			{
+				throw std::runtime_error("Pass uses a resource in two layouts!");
+			}
+			it->access.stages |= access.stages;
+			it->access.access |= access.access;
+			return pass;
+		}
+	}
+
+	bool ResourceAccess::writes() const
+	{
+		return bool(access & WriteAccess);
+	}
+
+	bool ResourceAccess::reads() const
+	{
+		return bool(access & ~WriteAccess);
+	}
+
+	RenderGraph::Pass& RenderGraph::Pass::read(Resource resource, ResourceAccess access)
+	{
+		if (access.writes()) throw std::runtime_error("Read access of a pass writes!");
+		return use(*this, resource, access);
+	}
+
+	RenderGraph::Pass& RenderGraph::Pass::write(Resource resource, ResourceAccess access)
+	{
+		if (!access.writes()) throw std::runtime_error("Write access of a pass does not write!");
+		return use(*this, resource, access);
+	}
+
+	RenderGraph::Pass& RenderGraph::Pass::commands(std::function<void(vk::CommandBuffer)> func)
+	{
+		record = std::move(func);
+		return *this;
+	}
+
+	RenderGraph::Pass& RenderGraph::Pass::keep()
+	{
+		sideEffect = true;
+		return *this;
+	}
+
+	RenderGraph::RenderGraph(vulkan::Device* device): m_device(device)
+	{
+	}
+
+	void RenderGraph::reset()
+	{
+		m_passes.clear();
+		m_resources.clear();
+	}
+
+	RenderGraph::Resource RenderGraph::importImage(std::string name, vulkan::Image& image, ResourceAccess last)
+	{
+		ResourceNode node{std::move(name), &image};
+		node.written = {vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, image.imageLayout()};
+		if (last.writes())
+		{
+			node.written = {last.stages, last.access & WriteAccess, image.imageLayout()};
+		}
+		else
+		{
+			node.readStages = last.stages;
+			node.visible = last.access;
+		}
+		m_resources.push_back(std::move(node));
+		return static_cast<Resource>(m_resources.size() - 1);
+	}
+
+	RenderGraph::Resource RenderGraph::importBuffer(std::string name, ResourceAccess last)
+	{
+		ResourceNode node{std::move(name)};
+		node.written = {vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, vk::ImageLayout::eUndefined};
+		if (last.writes())
+		{
+			node.written.stages = last.stages;
+			node.written.access = last.access & WriteAccess;
+		}
+		else
+		{
+			node.readStages = last.stages;
+			node.visible = last.access;
+		}
+		m_resources.push_back(std::move(node));
+		return static_cast<Resource>(m_resources.size() - 1);
+	}
+
+	RenderGraph::Resource RenderGraph::createImage(std::string name, vk::Format format, vk::Extent2D extent,
+	                                               vk::ImageUsageFlags usage)
+	{
+		ResourceNode node{std::move(name)};
+		node.transient = TransientDesc{format, extent, usage};
+		// Previous frame is done, first users of transients wait for nothing.
+		node.written = {vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, vk::ImageLayout::eUndefined};
+		m_resources.push_back(std::move(node));
+		return static_cast<Resource>(m_resources.size() - 1);
+	}
+
+	void RenderGraph::exportResource(Resource resource, ResourceAccess access)
+	{
+		m_resources[resource].exported = access;
+	}
+
+	RenderGraph::Pass& RenderGraph::addPass(std::string name)
+	{
+		return m_passes.emplace_back(Pass{std::move(name)});
+	}
+
+	std::vector<bool> RenderGraph::cull()
+	{
+		std::vector<bool> needed(m_resources.size());
+		for (size_t i = 0; i < m_resources.size(); ++i)
+		{
+			needed[i] = m_resources[i].exported.has_value();
+		}
+		std::vector<bool> kept(m_passes.size());
+		for (size_t i = m_passes.size(); i-- > 0;)
+		{
+			const Pass& pass = m_passes[i];
+			kept[i] = pass.sideEffect || ranges::any_of(pass.uses, [&needed](const Pass::Use& u)
+			{
+				return u.access.writes() && needed[u.resource];
+			});
+			if (!kept[i]) continue;
+			// Writing without reading replaces the whole content, earlier writers are not needed for it.
+			for (const Pass::Use& u : pass.uses)
+			{
+				needed[u.resource] = u.access.reads();
+			}
+		}
+		return kept;
+	}
+
+	void RenderGraph::assignTransients(const std::vector<bool>& kept)
+	{
+		struct Lifetime
+		{
+			Resource resource;
+			size_t first;
+			size_t last;
+		};
+
+		std::vector<Lifetime> lifetimes;
+		for (size_t i = 0; i < m_passes.size(); ++i)
+		{
+			if (!kept[i]) continue;
+			for (const Pass::Use& u : m_passes[i].uses)
+			{
+				if (!m_resources[u.resource].transient) continue;
+				auto it = ranges::find(lifetimes, u.resource, &Lifetime::resource);
+				if (it == lifetimes.end())
+				{
+					lifetimes.push_back({u.resource, i, i});
+				}
+				else
+				{
+					it->last = i;
+				}
+			}
+		}
+
+		// Lifetimes come sorted by their first pass, each takes the first free image of its description.
+		for (PhysicalImage& physical : m_transients)
+		{
+			physical.freeAfter = 0;
+			physical.user.reset();
+		}
+		std::vector<bool> used(m_transients.size(), false);
+		std::vector<size_t> assigned;
+		for (const Lifetime& lifetime : lifetimes)
+		{
+			const TransientDesc& desc = *m_resources[lifetime.resource].transient;
+			size_t index = 0;
+			while (index < m_transients.size() &&
+				(m_transients[index].desc != desc || m_transients[index].freeAfter > lifetime.first))
+			{
+				++index;
+			}
+			if (index == m_transients.size())
+			{
+				vulkan::Image image(*m_device, vulkan::MemoryAuto, desc.format, desc.extent.width,
+				                    desc.extent.height, vk::SampleCountFlagBits::e1, desc.usage);
+				m_transients.push_back({desc, std::move(image)});
+				used.push_back(false);
+			}
+			m_resources[lifetime.resource].previousAlias = m_transients[index].user;
+			m_transients[index].freeAfter = lifetime.last + 1;
+			m_transients[index].user = lifetime.resource;
+			used[index] = true;
+			assigned.push_back(index);
+		}
+
+		// Images nobody used this frame are let go, pointers are taken once the vector stopped moving.
+		std::vector<size_t> remap(m_transients.size());
+		std::vector<PhysicalImage> retained;
+		for (size_t i = 0; i < m_transients.size(); ++i)
+		{
+			remap[i] = retained.size();
+			if (used[i]) retained.push_back(std::move(m_transients[i]));
+		}
+		m_transients = std::move(retained);
+		for (size_t i = 0; i < lifetimes.size(); ++i)
+		{
+			m_resources[lifetimes[i].resource].image = &m_transients[remap[assigned[i]]].image;
+		}
+	}
+
+	void RenderGraph::transition(Resource resource, ResourceAccess access, const std::string& pass,
+	                             std::vector<vk::MemoryBarrier2>& memoryBarriers,
+	                             std::vector<vk::ImageMemoryBarrier2>& imageBarriers)
+	{
+		ResourceNode& node = m_resources[resource];
+		if (node.previousAlias)
+		{
+			// Content of the previous user is discarded, its accesses are still waited for.
+			const ResourceNode& previous = m_resources[*node.previousAlias];
+			node.written = {
+				previous.written.stages | previous.readStages, previous.written.access, vk::ImageLayout::eUndefined
+			};
+			node.previousAlias.reset();
+		}
+		bool layoutChange = node.image && node.written.layout != access.layout;
+		ResourceAccess src{};
+		if (access.writes() || layoutChange)
+		{
+			// Writes wait for reads too, layout changes are writes.
+			src = {node.written.stages | node.readStages, node.written.access, node.written.layout};
+			if (access.writes())
+			{
+				node.written = {access.stages, access.access & WriteAccess, access.layout};
+				node.readStages = {};
+				node.visible = {};
+				node.transitionStages = {};
+			}
+			else
+			{
+				node.written.layout = access.layout;
+				node.readStages |= access.stages;
+				node.visible |= access.access;
+				node.transitionStages = access.stages;
+			}
+			if (!src.stages && !layoutChange) return;
+		}
+		else
+		{
+			bool covered = (access.stages & node.readStages) == access.stages &&
+				(access.access & node.visible) == access.access;
+			src = {node.written.stages | node.transitionStages, node.written.access, node.written.layout};
+			node.readStages |= access.stages;
+			node.visible |= access.access;
+			if (covered || !src.stages) return;
+		}
+
+		if (node.image)
+		{
+			vk::ImageMemoryBarrier2 barrier{
+				src.stages, src.access, access.stages, access.access, src.layout, access.layout,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, *node.image,
+				{vulkan::Image::aspectOf(node.image->format()), 0, 1, 0, 1}
+			};
+			imageBarriers.push_back(barrier);
+		}
+		else
+		{
+			memoryBarriers.emplace_back(src.stages, src.access, access.stages, access.access);
+		}
+		m_barriers.push_back({pass, node.name, src, access});
+	}
+
+	void RenderGraph::execute(vk::CommandBuffer cb)
+	{
+		m_barriers.clear();
+		m_culled.clear();
+		std::vector<bool> kept = cull();
+		assignTransients(kept);
+
+		std::vector<vk::MemoryBarrier2> memoryBarriers;
+		std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+		auto flushBarriers = [&]
+		{
+			if (memoryBarriers.empty() && imageBarriers.empty()) return;
+			cb.pipelineBarrier2({{}, memoryBarriers, {}, imageBarriers});
+			memoryBarriers.clear();
+			imageBarriers.clear();
+		};
+		for (size_t i = 0; i < m_passes.size(); ++i)
+		{
+			const Pass& pass = m_passes[i];
+			if (!kept[i])
+			{
+				m_culled.push_back(pass.name);
+				continue;
+			}
+			for (const Pass::Use& u : pass.uses)
+			{
+				transition(u.resource, u.access, pass.name, memoryBarriers, imageBarriers);
+			}
+			flushBarriers();
+			if (pass.record) pass.record(cb);
+		}
+		for (Resource resource = 0; resource < m_resources.size(); ++resource)
+		{
+			if (auto& exported = m_resources[resource].exported)
+			{
+				transition(resource, *exported, "Export", memoryBarriers, imageBarriers);
+			}
+		}
+		flushBarriers();
+
+		for (ResourceNode& node : m_resources)
+		{
+			if (node.image && !node.transient) node.image->setImageLayout(node.written.layout);
+		}
+		for (PhysicalImage& physical : m_transients)
+		{
+			physical.image.setImageLayout(m_resources[*physical.user].written.layout);
+		}
+	}
+
+	void RenderGraph::drawDebug(bool* open) const
+	{
+		if (!ImGui::Begin("Render Graph", open))
+		{
+			ImGui::End();
+			return;
+		}
+		ImGui::Text("%zu passes, %zu culled, %zu barriers, %zu transient images", m_passes.size(),
+		            m_culled.size(), m_barriers.size(), m_transients.size());
+		for (const std::string& name : m_culled)
+		{
+			ImGui::TextDisabled("Culled: %s", name.c_str());
+		}
+
+		constexpr ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+			ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY;
+		if (ImGui::BeginTable("Barriers", 5, flags))
+		{
+			ImGui::TableSetupColumn("Before");
+			ImGui::TableSetupColumn("Resource");
+			ImGui::TableSetupColumn("Stages");
+			ImGui::TableSetupColumn("Access");
+			ImGui::TableSetupColumn("Layout");
+			ImGui::TableHeadersRow();
+			for (const BarrierRecord& barrier : m_barriers)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(barrier.pass.c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(barrier.resource.c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextWrapped("%s\n-> %s", vk::to_string(barrier.src.stages).c_str(),
+				                   vk::to_string(barrier.dst.stages).c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextWrapped("%s\n-> %s", vk::to_string(barrier.src.access).c_str(),
+				                   vk::to_string(barrier.dst.access).c_str());
+				ImGui::TableNextColumn();
+				ImGui::TextWrapped("%s\n-> %s", vk::to_string(barrier.src.layout).c_str(),
+				                   vk::to_string(barrier.dst.layout).c_str());
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	}
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <functional>
+#include <string>
+
+#include "Buffer.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+
+namespace ciallo::rendering
+{
+	// How a pass touches a resource. Layout only matters for images.
+	struct ResourceAccess
+	{
+		vk::PipelineStageFlags2 stages;
+		vk::AccessFlags2 access;
+		vk::ImageLayout layout = vk::ImageLayout::eGeneral;
+
+		bool writes() const;
+		bool reads() const;
+	};
+
+	// Blending reads what is already in the attachment.
+	constexpr ResourceAccess AccessColorAttachment{
+		vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+		vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite
+	};
+	// Stencil tests read and write it, clearing at load is a write too.
+	constexpr ResourceAccess AccessStencilAttachment{
+		vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+		vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite
+	};
+	constexpr ResourceAccess AccessComputeWrite{
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite
+	};
+	constexpr ResourceAccess AccessComputeSampled{
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead
+	};
+	constexpr ResourceAccess AccessFragmentSampled{
+		vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead
+	};
+	constexpr ResourceAccess AccessVertexInput{
+		vk::PipelineStageFlagBits2::eVertexAttributeInput, vk::AccessFlagBits2::eVertexAttributeRead
+	};
+	constexpr ResourceAccess AccessTransferRead{
+		vk::PipelineStageFlagBits2::eAllTransfer, vk::AccessFlagBits2::eTransferRead,
+		vk::ImageLayout::eTransferSrcOptimal
+	};
+
+	/**
+	 * \brief Passes of a frame declaring the resources they read and write, barriers are derived from them.
+	 * Every barrier waits for exactly the stages and accesses the previous users declared, those in front of one
+	 * pass are issued in a single pipelineBarrier2. Passes whose writes reach no exported resource are culled.
+	 * Transient images live from their first to their last pass and share one image with transients of the same
+	 * description when those lifetimes do not overlap. Barriers inside a pass are the pass's own business.
+	 * Rebuilt every frame with reset(), which assumes the previous frame completed, as the main loop ensures.
+	 */
+	class RenderGraph
+	{
+	public:
+		using Resource = uint32_t;
+
+		struct Pass
+		{
+			struct Use
+			{
+				Resource resource;
+				ResourceAccess access;
+			};
+
+			std::string name;
+			std::vector<Use> uses;
+			std::function<void(vk::CommandBuffer)> record;
+			bool sideEffect = false; // kept even when nothing exported depends on it
+
+			Pass& read(Resource resource, ResourceAccess access);
+			Pass& write(Resource resource, ResourceAccess access);
+			Pass& commands(std::function<void(vk::CommandBuffer)> func);
+			// Work outside the graph depends on the pass, a host write for example.
+			Pass& keep();
+		};
+
+		// Barriers generated for the last executed frame, for drawDebug().
+		struct BarrierRecord
+		{
+			std::string pass; // the one waiting
+			std::string resource;
+			ResourceAccess src;
+			ResourceAccess dst;
+		};
+
+	private:
+		struct TransientDesc
+		{
+			vk::Format format;
+			vk::Extent2D extent;
+			vk::ImageUsageFlags usage;
+
+			bool operator==(const TransientDesc& other) const = default;
+		};
+
+		struct ResourceNode
+		{
+			std::string name;
+			vulkan::Image* image = nullptr; // imported, or transient once assigned, null for buffers
+			std::optional<TransientDesc> transient;
+			std::optional<Resource> previousAlias; // transient using the same image before, until first use
+			ResourceAccess written; // last write, its layout is the current one
+			vk::PipelineStageFlags2 readStages; // reads since the last write
+			vk::AccessFlags2 visible; // read accesses made visible since the last write
+			vk::PipelineStageFlags2 transitionStages; // reads waiting for a layout change since the last write
+			std::optional<ResourceAccess> exported;
+		};
+
+		struct PhysicalImage
+		{
+			TransientDesc desc;
+			vulkan::Image image;
+			std::optional<Resource> user; // latest this frame
+			size_t freeAfter = 0; // index of the last pass using it this frame, plus one
+		};
+
+		vulkan::Device* m_device;
+		std::vector<Pass> m_passes;
+		std::vector<ResourceNode> m_resources;
+		std::vector<PhysicalImage> m_transients; // kept across frames
+		std::vector<BarrierRecord> m_barriers;
+		std::vector<std::string> m_culled;
+
+		std::vector<bool> cull();
+		void assignTransients(const std::vector<bool>& kept);
+		// Barrier bringing resource to access, nothing when it is already there.
+		void transition(Resource resource, ResourceAccess access, const std::string& pass,
+		                std::vector<vk::MemoryBarrier2>& memoryBarriers,
+		                std::vector<vk::ImageMemoryBarrier2>& imageBarriers);
+	public:
+		explicit RenderGraph(vulkan::Device* device);
+
+		void reset();
+		/**
+		 * \brief Image written or read outside of the graph.
+		 * \param last What its previous user did, the frame's first barrier waits for it.
+		 */
+		Resource importImage(std::string name, vulkan::Image& image, ResourceAccess last);
+		// Buffers get global memory barriers, a pass may even reallocate its buffer while recording.
+		Resource importBuffer(std::string name, ResourceAccess last);
+		// Image created by the graph, content undefined at its first pass.
+		Resource createImage(std::string name, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage);
+		// The resource leaves the frame in access, only passes leading to exported resources are kept.
+		void exportResource(Resource resource, ResourceAccess access);
+		Pass& addPass(std::string name);
+		// Transient images are valid during execute() only.
+		const vulkan::Image& image(Resource resource) const { return *m_resources[resource].image; }
+		void execute(vk::CommandBuffer cb);
+
+		void drawDebug(bool* open) const;
+	};
+}
@@ -0,0 +1,335 @@
+#include "pch.hpp"
+#include "Simplification.hpp"
+
+#include <queue>
+#include <glm/gtc/constants.hpp>
+
+#include "JobSystem.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo::geom
+{
+	namespace
+	{
+		/**
+		 * \brief Squared deviation of vertex i from segment ab. With thickness, it's the larger one of
+		 * position deviation and thickness deviation from linear interpolation.
+		 */
+		float squaredDeviation(const std::vector<Point>& polyline, const std::vector<float>* thickness,
+		                       uint32_t a, uint32_t b, uint32_t i)
+		{
+			const Point& pa = polyline[a];
+			Vector ab = polyline[b] - pa;
+			float length2 = ab.squared_length();
+			float t = length2 > 0.0f ? glm::clamp((polyline[i] - pa) * ab / length2, 0.0f, 1.0f) : 0.0f;
+			float d = CGAL::squared_distance(polyline[i], pa + t * ab);
+			if (thickness)
+			{
+				float dt = (*thickness)[i] - glm::mix((*thickness)[a], (*thickness)[b], t);
+				d = std::max(d, dt * dt);
+			}
+			return d;
+		}
+
+		std::vector<uint32_t> douglasPeuckerImpl(const std::vector<Point>& polyline,
+		                                         const std::vector<float>* thickness, float tolerance)
+		{
+			const auto n = static_cast<uint32_t>(polyline.size());
+			if (n <= 2)
+			{
+				return views::iota(0u, n) | ranges::to_vector;
+			}
+
+			const float squaredTolerance = tolerance * tolerance;
+			std::vector<bool> kept(n, false);
+			kept.front() = kept.back() = true;
+
+			// Iterative version, polylines from tablet could be long enough to blow up the stack.
+			std::vector<std::pair<uint32_t, uint32_t>> stack{{0u, n - 1}};
+			while (!stack.empty())
+			{
+				auto [first, last] = stack.back();
+				stack.pop_back();
+				if (last - first < 2) continue;
+
+				float maxDeviation = -1.0f;
+				uint32_t farthest = first;
+				for (uint32_t i = first + 1; i < last; ++i)
+				{
+					float d = squaredDeviation(polyline, thickness, first, last, i);
+					if (d > maxDeviation)
+					{
+						maxDeviation = d;
+						farthest = i;
+					}
+				}
+
+				if (maxDeviation > squaredTolerance)
+				{
+					kept[farthest] = true;
+					stack.emplace_back(first, farthest);
+					stack.emplace_back(farthest, last);
+				}
+			}
+
+			std::vector<uint32_t> indices;
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				if (kept[i]) indices.push_back(i);
+			}
+			return indices;
+		}
+
+		std::vector<uint32_t> visvalingamWhyattImpl(const std::vector<Point>& polyline,
+		                                            const std::vector<float>* thickness, float tolerance)
+		{
+			const auto n = static_cast<uint32_t>(polyline.size());
+			if (n <= 2)
+			{
+				return views::iota(0u, n) | ranges::to_vector;
+			}
+
+			std::vector<uint32_t> prev(n), next(n), version(n, 0u);
+			std::vector<bool> removed(n, false);
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				prev[i] = i == 0 ? 0 : i - 1;
+				next[i] = i == n - 1 ? n - 1 : i + 1;
+			}
+
+			auto effectiveArea = [&](uint32_t i)
+			{
+				uint32_t a = prev[i], b = next[i];
+				float area = std::abs(CGAL::area(polyline[a], polyline[i], polyline[b]));
+				if (thickness)
+				{
+					// Thickness deviation times base length, so it has the same unit as area.
+					float base = std::sqrt(CGAL::squared_distance(polyline[a], polyline[b]));
+					Vector ab = polyline[b] - polyline[a];
+					float length2 = ab.squared_length();
+					float t = length2 > 0.0f ? glm::clamp((polyline[i] - polyline[a]) * ab / length2, 0.0f, 1.0f) : 0.0f;
+					float dt = std::abs((*thickness)[i] - glm::mix((*thickness)[a], (*thickness)[b], t));
+					area = std::max(area, dt * base);
+				}
+				return area;
+			};
+
+			// Lazy deletion, outdated items are recognized by version.
+			using Item = std::tuple<float, uint32_t, uint32_t>; // area, index, version
+			std::priority_queue<Item, std::vector<Item>, std::greater<>> heap;
+			for (uint32_t i = 1; i < n - 1; ++i)
+			{
+				heap.emplace(effectiveArea(i), i, 0u);
+			}
+
+			const float threshold = tolerance * tolerance;
+			while (!heap.empty())
+			{
+				auto [area, i, v] = heap.top();
+				if (removed[i] || v != version[i])
+				{
+					heap.pop();
+					continue;
+				}
+				if (area >= threshold) break;
+				heap.pop();
+
+				removed[i] = true;
+				uint32_t a = prev[i], b = next[i];
+				next[a] = b;
+				prev[b] = a;
+				for (uint32_t j : {a, b})
+				{
+					if (j == 0 || j == n - 1) continue;
+					// Area never decreases, otherwise a neighbour could be removed before the vertex it depends on.
+					heap.emplace(std::max(effectiveArea(j), area), j, ++version[j]);
+				}
+			}
+
+			std::vector<uint32_t> indices;
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				if (!removed[i]) indices.push_back(i);
+			}
+			return indices;
+		}
+
+		const std::vector<float>* validThickness(const std::vector<Point>& polyline,
+		                                         const std::vector<float>& thickness)
+		{
+			return thickness.size() == polyline.size() ? &thickness : nullptr;
+		}
+	}
+
+	std::vector<uint32_t> douglasPeucker(const std::vector<Point>& polyline, float tolerance)
+	{
+		return douglasPeuckerImpl(polyline, nullptr, tolerance);
+	}
+
+	std::vector<uint32_t> douglasPeucker(const std::vector<Point>& polyline, const std::vector<float>& thickness,
+	                                     float tolerance)
+	{
+		return douglasPeuckerImpl(polyline, validThickness(polyline, thickness), tolerance);
+	}
+
+	std::vector<uint32_t> visvalingamWhyatt(const std::vector<Point>& polyline, float tolerance)
+	{
+		return visvalingamWhyattImpl(polyline, nullptr, tolerance);
+	}
+
+	std::vector<uint32_t> visvalingamWhyatt(const std::vector<Point>& polyline, const std::vector<float>& thickness,
+	                                        float tolerance)
+	{
+		return visvalingamWhyattImpl(polyline, validThickness(polyline, thickness), tolerance);
+	}
+
+	StreamingSimplifier::StreamingSimplifier(float tolerance): m_tolerance(tolerance)
+	{
+	}
+
+	void StreamingSimplifier::push(const Point& p, float thickness)
+	{
+		if (m_position.empty())
+		{
+			m_position.push_back(p);
+			m_thickness.push_back(thickness);
+			return;
+		}
+
+		if (m_position.size() >= 2 && fits(p, thickness))
+		{
+			// Latest vertex moves forward, vertices between are dropped.
+			narrow(p, thickness);
+			m_position.back() = p;
+			m_thickness.back() = thickness;
+			return;
+		}
+
+		// Previous latest vertex is committed and becomes the new anchor.
+		m_position.push_back(p);
+		m_thickness.push_back(thickness);
+		resetCone();
+		narrow(p, thickness);
+	}
+
+	void StreamingSimplifier::clear()
+	{
+		m_position.clear();
+		m_thickness.clear();
+		resetCone();
+	}
+
+	void StreamingSimplifier::resetCone()
+	{
+		m_hasDirection = false;
+		m_angleMin = -glm::pi<float>();
+		m_angleMax = glm::pi<float>();
+		m_slopeMin = std::numeric_limits<float>::lowest();
+		m_slopeMax = std::numeric_limits<float>::max();
+		m_maxDistance = 0.0f;
+	}
+
+	bool StreamingSimplifier::fits(const Point& p, float thickness) const
+	{
+		Vector v = p - anchor();
+		float d = std::sqrt(v.squared_length());
+		float dt = thickness - anchorThickness();
+		// Turning back makes previous vertices fall outside of the segment.
+		if (d < m_maxDistance - m_tolerance) return false;
+		if (d <= m_tolerance) return std::abs(dt) <= m_tolerance;
+
+		if (m_hasDirection)
+		{
+			float angle = relativeAngle(v);
+			if (angle < m_angleMin || angle > m_angleMax) return false;
+		}
+		float slope = dt / d;
+		return slope >= m_slopeMin && slope <= m_slopeMax;
+	}
+
+	void StreamingSimplifier::narrow(const Point& p, float thickness)
+	{
+		Vector v = p - anchor();
+		float d = std::sqrt(v.squared_length());
+		m_maxDistance = std::max(m_maxDistance, d);
+		if (d <= m_tolerance) return;
+
+		if (!m_hasDirection)
+		{
+			m_direction = v / d;
+			m_hasDirection = true;
+		}
+		float angle = relativeAngle(v);
+		float halfAngle = std::asin(std::min(1.0f, m_tolerance / d));
+		m_angleMin = std::max(m_angleMin, angle - halfAngle);
+		m_angleMax = std::min(m_angleMax, angle + halfAngle);
+
+		float dt = thickness - anchorThickness();
+		m_slopeMin = std::max(m_slopeMin, (dt - m_tolerance) / d);
+		m_slopeMax = std::min(m_slopeMax, (dt + m_tolerance) / d);
+	}
+
+	float StreamingSimplifier::relativeAngle(const Vector& v) const
+	{
+		float cross = m_direction.x() * v.y() - m_direction.y() * v.x();
+		return std::atan2(cross, m_direction * v);
+	}
+
+	const Point& StreamingSimplifier::anchor() const
+	{
+		return m_position[m_position.size() - 2];
+	}
+
+	float StreamingSimplifier::anchorThickness() const
+	{
+		return m_thickness[m_thickness.size() - 2];
+	}
+}
+
+namespace ciallo
+{
+	void StrokeSimplifier::simplify(StrokeCpo& stroke, SimplificationMethod method, float tolerance)
+	{
+		std::vector<uint32_t> kept;
+		switch (method)
+		{
+		case SimplificationMethod::DouglasPeucker:
+			kept = geom::douglasPeucker(stroke.position, stroke.thickness, tolerance);
+			break;
+		case SimplificationMethod::VisvalingamWhyatt:
+			kept = geom::visvalingamWhyatt(stroke.position, stroke.thickness, tolerance);
+			break;
+		}
+		if (kept.size() == stroke.position.size()) return;
+
+		bool hasThickness = stroke.thickness.size() == stroke.position.size();
+		for (size_t i = 0; i < kept.size(); ++i)
+		{
+			// kept[i] >= i, compact in place
+			stroke.position[i] = stroke.position[kept[i]];
+			if (hasThickness) stroke.thickness[i] = stroke.thickness[kept[i]];
+		}
+		stroke.position.resize(kept.size());
+		if (hasThickness) stroke.thickness.resize(kept.size());
+	}
+
+	void StrokeSimplifier::simplify(entt::registry& r, const std::vector<entt::entity>& strokes,
+	                                SimplificationMethod method, float tolerance)
+	{
+		// Fetch components on this thread, workers touch nothing but their own stroke.
+		std::vector<StrokeCpo*> strokeCpos = strokes | views::transform([&r](entt::entity e)
+		{
+			return &r.get<StrokeCpo>(e);
+		}) | ranges::to_vector;
+
+		r.ctx().at<JobSystem*>()->parallelFor(strokeCpos.size(), [&strokeCpos, method, tolerance](size_t i)
+		{
+			simplify(*strokeCpos[i], method, tolerance);
+		});
+
+		for (entt::entity e : strokes)
+		{
+			r.patch<StrokeCpo>(e);
+		}
+	}
+}
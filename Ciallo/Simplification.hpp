@@ -0,0 +1,87 @@
+#pragma once
+
+namespace ciallo::geom
+{
+	/*
+	 * Tolerances below are in world unit (meter), same as ViewRectCpo.
+	 * Thickness is optional. When given, it's treated as a third dimension: a vertex can only be removed
+	 * when its thickness is within tolerance from the linear interpolation of remaining neighbours.
+	 * All of them return indices of kept vertices in ascending order. The first and the last vertex are always kept.
+	 */
+
+	/**
+	 * \brief Douglas-Peucker polyline simplification.
+	 * \param tolerance Max distance from removed vertices to the simplified polyline.
+	 */
+	std::vector<uint32_t> douglasPeucker(const std::vector<Point>& polyline, float tolerance);
+	std::vector<uint32_t> douglasPeucker(const std::vector<Point>& polyline, const std::vector<float>& thickness,
+	                                     float tolerance);
+
+	/**
+	 * \brief Visvalingam-Whyatt polyline simplification. Keeps shapes of curve better than Douglas-Peucker.
+	 * \param tolerance Vertices whose effective triangle area is smaller than tolerance^2 get removed.
+	 */
+	std::vector<uint32_t> visvalingamWhyatt(const std::vector<Point>& polyline, float tolerance);
+	std::vector<uint32_t> visvalingamWhyatt(const std::vector<Point>& polyline, const std::vector<float>& thickness,
+	                                        float tolerance);
+
+	/**
+	 * \brief Online simplification for polylines still being captured. O(1) per vertex.
+	 * It's a sleeve fitting: a cone of valid directions from the last committed vertex shrinks with every
+	 * incoming vertex, once a vertex falls outside the cone the previous one gets committed.
+	 * The last vertex of output is always the latest pushed vertex, every vertex before it is final.
+	 */
+	class StreamingSimplifier
+	{
+		float m_tolerance;
+		std::vector<Point> m_position;
+		std::vector<float> m_thickness;
+
+		// cone of direction, angles relative to m_direction
+		Vector m_direction{1.0f, 0.0f};
+		bool m_hasDirection = false;
+		float m_angleMin = 0.0f;
+		float m_angleMax = 0.0f;
+		// cone of thickness slope along the direction
+		float m_slopeMin = 0.0f;
+		float m_slopeMax = 0.0f;
+		float m_maxDistance = 0.0f;
+
+		void resetCone();
+		bool fits(const Point& p, float thickness) const;
+		void narrow(const Point& p, float thickness);
+		float relativeAngle(const Vector& v) const;
+		const Point& anchor() const;
+		float anchorThickness() const;
+	public:
+		explicit StreamingSimplifier(float tolerance);
+
+		void push(const Point& p, float thickness = 0.0f);
+		void clear();
+
+		const std::vector<Point>& position() const { return m_position; }
+		const std::vector<float>& thickness() const { return m_thickness; }
+		float tolerance() const { return m_tolerance; }
+	};
+}
+
+namespace ciallo
+{
+	struct StrokeCpo;
+
+	enum class SimplificationMethod
+	{
+		DouglasPeucker,
+		VisvalingamWhyatt,
+	};
+
+	struct StrokeSimplifier
+	{
+		constexpr static float DefaultTolerance = 1e-5f; // 0.01mm
+
+		static void simplify(StrokeCpo& stroke, SimplificationMethod method, float tolerance);
+		// Simplify strokes in parallel, patch them afterwards so observers get notified.
+		static void simplify(entt::registry& r, const std::vector<entt::entity>& strokes,
+		                     SimplificationMethod method, float tolerance);
+	};
+}
@@ -0,0 +1,218 @@
+#include "pch.hpp"
+#include "SparseImage.hpp"
+
+namespace ciallo::vulkan
+{
+	namespace
+	{
+		constexpr VmaAllocationCreateInfo TileAllocationInfo{{}, VMA_MEMORY_USAGE_GPU_ONLY};
+	}
+
+	SparseImage::SparseImage(Device& device, vk::Format format, uint32_t width, uint32_t height,
+	                         vk::ImageUsageFlags usage): m_device(&device)
+	{
+		m_allocator = device.allocator();
+		m_format = format;
+		m_extent = vk::Extent3D{width, height, 1u};
+		m_sampleCount = vk::SampleCountFlagBits::e1;
+		m_usage = usage;
+		m_layout = vk::ImageLayout::eUndefined;
+
+		vk::ImageCreateInfo info{};
+		info.flags = vk::ImageCreateFlagBits::eSparseBinding | vk::ImageCreateFlagBits::eSparseResidency;
+		info.imageType = vk::ImageType::e2D;
+		info.format = format;
+		info.extent = m_extent;
+		info.mipLevels = 1;
+		info.arrayLayers = 1;
+		info.samples = m_sampleCount;
+		info.tiling = vk::ImageTiling::eOptimal;
+		info.usage = usage;
+		info.sharingMode = vk::SharingMode::eExclusive;
+		info.initialLayout = vk::ImageLayout::eUndefined;
+		m_image = device.device().createImage(info);
+		m_imageView = createImageView(m_image, vk::ImageViewType::e2D, format);
+
+		m_tileRequirements = device.device().getImageMemoryRequirements(m_image);
+		auto sparseRequirements = device.device().getImageSparseMemoryRequirements(m_image);
+		if (sparseRequirements.empty())
+		{
+			throw std::runtime_error("Sparse image has no memory requirements!");
+		}
+		const vk::SparseImageMemoryRequirements& requirements = sparseRequirements[0];
+		vk::Extent3D granularity = requirements.formatProperties.imageGranularity;
+		m_tileExtent = vk::Extent2D{granularity.width, granularity.height};
+		m_tileCountX = (width + m_tileExtent.width - 1) / m_tileExtent.width;
+		m_tileCountY = (height + m_tileExtent.height - 1) / m_tileExtent.height;
+		m_tiles.resize(static_cast<size_t>(m_tileCountX) * m_tileCountY, nullptr);
+
+		// Images smaller than a tile live entirely in mip tail, which is bound as a whole.
+		if (requirements.imageMipTailFirstLod == 0 && requirements.imageMipTailSize > 0)
+		{
+			vk::MemoryRequirements tailRequirements = m_tileRequirements;
+			tailRequirements.size = requirements.imageMipTailSize;
+			auto r = static_cast<VkMemoryRequirements>(tailRequirements);
+			VmaAllocationInfo allocationInfo;
+			if (vmaAllocateMemory(m_allocator, &r, &TileAllocationInfo, &m_mipTail, &allocationInfo) != VK_SUCCESS)
+			{
+				m_imageView.reset();
+				device.device().destroyImage(m_image);
+				m_image = VK_NULL_HANDLE;
+				throw std::runtime_error("Failed to allocate mip tail of sparse image!");
+			}
+			vk::SparseMemoryBind tailBind{
+				requirements.imageMipTailOffset, requirements.imageMipTailSize,
+				allocationInfo.deviceMemory, allocationInfo.offset
+			};
+			bind({}, {tailBind});
+			m_committedSize += requirements.imageMipTailSize;
+		}
+	}
+
+	SparseImage::~SparseImage()
+	{
+		if (!m_image) return;
+		// Binds still queued reference image and memory.
+		m_bound.wait(device());
+		freeRetired(true);
+		// View and image go first, memory is not referenced any more.
+		m_imageView.reset();
+		device().destroyImage(m_image);
+		m_image = VK_NULL_HANDLE;
+		for (VmaAllocation tile : m_tiles)
+		{
+			if (tile) vmaFreeMemory(m_allocator, tile);
+		}
+		if (m_mipTail) vmaFreeMemory(m_allocator, m_mipTail);
+	}
+
+	vk::SparseImageMemoryBind SparseImage::tileBind(uint32_t x, uint32_t y, VmaAllocation allocation) const
+	{
+		vk::Offset3D offset{
+			static_cast<int32_t>(x * m_tileExtent.width), static_cast<int32_t>(y * m_tileExtent.height), 0
+		};
+		// Tiles on right and bottom edges are cut by image extent.
+		vk::Extent3D extent{
+			std::min(m_tileExtent.width, m_extent.width - x * m_tileExtent.width),
+			std::min(m_tileExtent.height, m_extent.height - y * m_tileExtent.height),
+			1u
+		};
+		vk::SparseImageMemoryBind bind{{vk::ImageAspectFlagBits::eColor, 0, 0}, offset, extent};
+		if (allocation)
+		{
+			VmaAllocationInfo info;
+			vmaGetAllocationInfo(m_allocator, allocation, &info);
+			bind.memory = info.deviceMemory;
+			bind.memoryOffset = info.offset;
+		}
+		return bind;
+	}
+
+	void SparseImage::bind(const std::vector<vk::SparseImageMemoryBind>& binds,
+	                       const std::vector<vk::SparseMemoryBind>& opaqueBinds)
+	{
+		vk::SparseImageMemoryBindInfo imageBindInfo{m_image, binds};
+		vk::SparseImageOpaqueMemoryBindInfo opaqueBindInfo{m_image, opaqueBinds};
+		vk::BindSparseInfo info{};
+		if (!binds.empty()) info.setImageBinds(imageBindInfo);
+		if (!opaqueBinds.empty()) info.setImageOpaqueBinds(opaqueBindInfo);
+		m_bound = m_device->bindSparse(info);
+	}
+
+	void SparseImage::retire(std::vector<VmaAllocation> tiles)
+	{
+		if (!tiles.empty()) m_retired.emplace_back(m_bound, std::move(tiles));
+	}
+
+	void SparseImage::freeRetired(bool wait)
+	{
+		while (!m_retired.empty())
+		{
+			auto& [point, tiles] = m_retired.front();
+			if (wait) point.wait(device());
+			else if (!point.reached(device())) break;
+			vmaFreeMemoryPages(m_allocator, tiles.size(), tiles.data());
+			m_retired.pop_front();
+		}
+	}
+
+	vk::DeviceSize SparseImage::makeResident(const std::vector<Region>& regions)
+	{
+		std::vector<bool> needed(m_tiles.size(), false);
+		for (const Region& region : regions)
+		{
+			glm::uvec2 max = glm::min(region.max, glm::uvec2{m_extent.width, m_extent.height});
+			if (region.min.x >= max.x || region.min.y >= max.y) continue;
+			for (uint32_t y = region.min.y / m_tileExtent.height; y <= (max.y - 1) / m_tileExtent.height; ++y)
+			{
+				for (uint32_t x = region.min.x / m_tileExtent.width; x <= (max.x - 1) / m_tileExtent.width; ++x)
+				{
+					needed[y * m_tileCountX + x] = true;
+				}
+			}
+		}
+
+		std::vector<uint32_t> missing;
+		std::vector<vk::SparseImageMemoryBind> binds;
+		std::vector<VmaAllocation> unused;
+		for (uint32_t i = 0; i < m_tiles.size(); ++i)
+		{
+			if (needed[i] && !m_tiles[i]) missing.push_back(i);
+			if (!needed[i] && m_tiles[i])
+			{
+				binds.push_back(tileBind(i % m_tileCountX, i / m_tileCountX, nullptr));
+				unused.push_back(m_tiles[i]);
+				m_tiles[i] = nullptr;
+			}
+		}
+		freeRetired(false);
+		if (missing.empty() && unused.empty()) return 0;
+
+		auto r = static_cast<VkMemoryRequirements>(m_tileRequirements);
+		r.size = m_tileRequirements.alignment; // one tile
+		std::vector<VmaAllocation> allocations(missing.size(), nullptr);
+		if (!missing.empty() &&
+			vmaAllocateMemoryPages(m_allocator, &r, &TileAllocationInfo, allocations.size(), allocations.data(),
+			                       nullptr) != VK_SUCCESS)
+		{
+			// All or nothing, VMA freed whatever it got. Take tiles one by one until memory runs out.
+			size_t allocated = 0;
+			while (allocated < allocations.size() &&
+				vmaAllocateMemory(m_allocator, &r, &TileAllocationInfo, &allocations[allocated], nullptr) ==
+				VK_SUCCESS)
+				++allocated;
+			allocations.resize(allocated);
+		}
+		for (auto&& [i, allocation] : views::zip(missing, allocations))
+		{
+			m_tiles[i] = allocation;
+			binds.push_back(tileBind(i % m_tileCountX, i / m_tileCountX, allocation));
+		}
+		// Binding and unbinding in one batch.
+		if (!binds.empty()) bind(binds, {});
+		m_committedSize = m_committedSize + allocations.size() * r.size - unused.size() * r.size;
+		retire(std::move(unused));
+		return (missing.size() - allocations.size()) * r.size;
+	}
+
+	void SparseImage::releaseAll()
+	{
+		std::vector<vk::SparseImageMemoryBind> binds;
+		std::vector<VmaAllocation> allocations;
+		for (uint32_t y = 0; y < m_tileCountY; ++y)
+		{
+			for (uint32_t x = 0; x < m_tileCountX; ++x)
+			{
+				VmaAllocation& tile = m_tiles[y * m_tileCountX + x];
+				if (!tile) continue;
+				binds.push_back(tileBind(x, y, nullptr));
+				allocations.push_back(tile);
+				tile = nullptr;
+			}
+		}
+		if (allocations.empty()) return;
+		bind(binds, {});
+		m_committedSize -= allocations.size() * m_tileRequirements.alignment;
+		retire(std::move(allocations));
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <deque>
+
+#include "Device.hpp"
+#include "Image.hpp"
+
+namespace ciallo::vulkan
+{
+	/**
+	 * \brief 2D sparse residency image, device memory is bound tile by tile on demand.
+	 * Unbound tiles read as zero and writes to them are discarded, see Device::sparseResidencySupported.
+	 * Not copyable, Image copy semantics would allocate a fully resident image.
+	 */
+	class SparseImage : public Image
+	{
+		Device* m_device;
+		vk::Extent2D m_tileExtent;
+		uint32_t m_tileCountX = 0;
+		uint32_t m_tileCountY = 0;
+		vk::MemoryRequirements m_tileRequirements;
+		std::vector<VmaAllocation> m_tiles; // row major, null for unbound tiles
+		VmaAllocation m_mipTail = nullptr;
+		vk::DeviceSize m_committedSize = 0;
+		GpuPoint m_bound; // latest bind
+		// Unbound tiles, freed once the bind unbinding them is done.
+		std::deque<std::pair<GpuPoint, std::vector<VmaAllocation>>> m_retired;
+
+		void bind(const std::vector<vk::SparseImageMemoryBind>& binds,
+		          const std::vector<vk::SparseMemoryBind>& opaqueBinds);
+		void retire(std::vector<VmaAllocation> tiles);
+		void freeRetired(bool wait);
+		vk::SparseImageMemoryBind tileBind(uint32_t x, uint32_t y, VmaAllocation allocation) const;
+	public:
+		SparseImage(Device& device, vk::Format format, uint32_t width, uint32_t height, vk::ImageUsageFlags usage);
+		SparseImage(const SparseImage& other) = delete;
+		SparseImage(SparseImage&& other) = delete;
+		SparseImage& operator=(const SparseImage& other) = delete;
+		SparseImage& operator=(SparseImage&& other) = delete;
+		~SparseImage() override;
+
+		// Pixel rectangle [min, max).
+		struct Region
+		{
+			glm::uvec2 min;
+			glm::uvec2 max;
+		};
+
+		/**
+		 * \brief Make exactly the tiles overlapping regions resident, others are unbound and freed.
+		 * Returns without waiting, the next Device::submit waits for the bind. Call it when no submitted work
+		 * uses the image.
+		 * Out of device memory, tiles that could be allocated are bound and the rest stay unbound.
+		 * \return Bytes of tiles left unbound for lack of memory.
+		 */
+		vk::DeviceSize makeResident(const std::vector<Region>& regions);
+		// Unbind and free all tiles.
+		void releaseAll();
+
+		vk::Extent2D tileExtent() const { return m_tileExtent; }
+		vk::DeviceSize deviceMemorySize() const override { return m_committedSize; }
+	};
+}
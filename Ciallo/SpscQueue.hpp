@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace ciallo
+{
+	/**
+	 * \brief Bounded lock-free queue for exactly one producer thread and one consumer thread.
+	 * Indices grow freely and wrap by mask, so capacity is a power of two. Push fails when full rather than overwrite.
+	 * Each side keeps a cached copy of the other side's index and only reloads it when the cache says full or empty.
+	 */
+	template <typename T, size_t Capacity>
+	class SpscQueue
+	{
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+		constexpr static size_t Mask = Capacity - 1;
+		constexpr static size_t CacheLine = 64;
+
+		// Consumer side
+		alignas(CacheLine) std::atomic<size_t> m_head{0};
+		size_t m_cachedTail = 0;
+		// Producer side
+		alignas(CacheLine) std::atomic<size_t> m_tail{0};
+		size_t m_cachedHead = 0;
+
+		alignas(CacheLine) std::array<T, Capacity> m_slots{};
+	public:
+		// Producer thread only.
+		bool push(const T& value)
+		{
+			size_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_cachedHead == Capacity)
+			{
+				m_cachedHead = m_head.load(std::memory_order_acquire);
+				if (tail - m_cachedHead == Capacity) return false;
+			}
+			m_slots[tail & Mask] = value;
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer thread only.
+		bool pop(T& value)
+		{
+			size_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_cachedTail)
+			{
+				m_cachedTail = m_tail.load(std::memory_order_acquire);
+				if (head == m_cachedTail) return false;
+			}
+			value = m_slots[head & Mask];
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Exact only when called from one of the two threads while the other is idle.
+		size_t sizeApprox() const
+		{
+			return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+		}
+
+		constexpr static size_t capacity() { return Capacity; }
+	};
+}
@@ -0,0 +1,344 @@
+#include "pch.hpp"
+#include "Stabilizer.hpp"
+
+#include <chrono>
+#include <numbers>
+#include <random>
+
+#include "Bezier.hpp"
+
+namespace ciallo
+{
+	namespace
+	{
+		StrokeSample lerp(const StrokeSample& a, const StrokeSample& b, float t)
+		{
+			return {
+				glm::mix(a.position, b.position, t),
+				glm::mix(a.pressure, b.pressure, t),
+				a.time + (b.time - a.time) * t
+			};
+		}
+
+		geom::Point toPoint(glm::vec2 v)
+		{
+			return geom::Point{v.x, v.y};
+		}
+	}
+
+	void Stabilizer::reset()
+	{
+		m_windowCount = 0;
+		m_windowNext = 0;
+		m_positionSum = glm::dvec2{0.0};
+		m_pressureSum = 0.0;
+		m_controlCount = 0;
+		m_started = false;
+	}
+
+	void Stabilizer::push(const StrokeSample& s, std::vector<StrokeSample>& out)
+	{
+		switch (method)
+		{
+		case StabilizerMethod::None:
+			out.push_back(s);
+			break;
+		case StabilizerMethod::MovingWindow:
+			pushWindow(s, out);
+			break;
+		case StabilizerMethod::Exponential:
+			pushExponential(s, out);
+			break;
+		case StabilizerMethod::PulledString:
+			pushPulledString(s, out);
+			break;
+		case StabilizerMethod::CatmullRom:
+			pushCatmullRom(s, out);
+			break;
+		}
+		m_last = s;
+		m_started = true;
+	}
+
+	void Stabilizer::finish(std::vector<StrokeSample>& out)
+	{
+		if (!m_started) return;
+		switch (method)
+		{
+		case StabilizerMethod::None:
+			break;
+		case StabilizerMethod::MovingWindow:
+			// Shrink the window from the old end, the mean walks to the last sample.
+			while (m_windowCount > 1)
+			{
+				popWindow();
+				out.push_back(windowMean());
+			}
+			break;
+		case StabilizerMethod::Exponential:
+		case StabilizerMethod::PulledString:
+			if (m_state.position != m_last.position) out.push_back(m_last);
+			break;
+		case StabilizerMethod::CatmullRom:
+			// Last segment, end tangent from a repeated end point.
+			if (m_controlCount >= 2) emitSegment(m_control[2], out);
+			break;
+		}
+		reset();
+	}
+
+	void Stabilizer::pushWindow(const StrokeSample& s, std::vector<StrokeSample>& out)
+	{
+		uint32_t size = glm::clamp(windowSize, 1u, MaxWindowSize);
+		while (m_windowCount >= size) popWindow();
+		m_window[m_windowNext] = s;
+		m_windowNext = (m_windowNext + 1) % MaxWindowSize;
+		++m_windowCount;
+		m_positionSum += glm::dvec2(s.position);
+		m_pressureSum += s.pressure;
+		out.push_back(windowMean());
+	}
+
+	void Stabilizer::popWindow()
+	{
+		uint32_t oldest = (m_windowNext + MaxWindowSize - m_windowCount) % MaxWindowSize;
+		m_positionSum -= glm::dvec2(m_window[oldest].position);
+		m_pressureSum -= m_window[oldest].pressure;
+		--m_windowCount;
+	}
+
+	StrokeSample Stabilizer::windowMean() const
+	{
+		double n = static_cast<double>(m_windowCount);
+		uint32_t oldest = (m_windowNext + MaxWindowSize - m_windowCount) % MaxWindowSize;
+		uint32_t newest = (m_windowNext + MaxWindowSize - 1) % MaxWindowSize;
+		return {
+			glm::vec2(m_positionSum / n),
+			static_cast<float>(m_pressureSum / n),
+			(m_window[oldest].time + m_window[newest].time) * 0.5
+		};
+	}
+
+	void Stabilizer::pushExponential(const StrokeSample& s, std::vector<StrokeSample>& out)
+	{
+		if (!m_started)
+		{
+			m_state = s;
+			out.push_back(s);
+			return;
+		}
+		float dt = static_cast<float>(s.time - m_state.time);
+		float a = timeConstant > 0.0f ? 1.0f - glm::exp(-glm::max(dt, 0.0f) / timeConstant) : 1.0f;
+		m_state = lerp(m_state, s, a);
+		m_state.time = s.time;
+		out.push_back(m_state);
+	}
+
+	void Stabilizer::pushPulledString(const StrokeSample& s, std::vector<StrokeSample>& out)
+	{
+		if (!m_started)
+		{
+			m_state = s;
+			out.push_back(s);
+			return;
+		}
+		glm::vec2 d = s.position - m_state.position;
+		float length = glm::length(d);
+		// Pressure follows the pen even while the string is slack, it's applied once the brush moves.
+		m_state.pressure = s.pressure;
+		m_state.time = s.time;
+		if (length <= stringLength) return;
+		m_state.position += d * ((length - stringLength) / length);
+		out.push_back(m_state);
+	}
+
+	void Stabilizer::pushCatmullRom(const StrokeSample& s, std::vector<StrokeSample>& out)
+	{
+		if (m_controlCount == 0)
+		{
+			m_control = {s, s, s};
+			m_controlCount = 1;
+			out.push_back(s);
+			return;
+		}
+		// Segment between control 1 and 2 is known once the sample after them arrives.
+		if (m_controlCount >= 2) emitSegment(s, out);
+		m_control = {m_control[1], m_control[2], s};
+		++m_controlCount;
+	}
+
+	void Stabilizer::emitSegment(const StrokeSample& next, std::vector<StrokeSample>& out) const
+	{
+		const StrokeSample& p0 = m_control[0];
+		const StrokeSample& p1 = m_control[1];
+		const StrokeSample& p2 = m_control[2];
+		// Uniform Catmull-Rom as cubic Bezier, inner control points along the tangents of the ends.
+		std::array<geom::Point, 4> controlPoints{
+			toPoint(p1.position),
+			toPoint(p1.position + (p2.position - p0.position) / 6.0f),
+			toPoint(p2.position - (next.position - p1.position) / 6.0f),
+			toPoint(p2.position),
+		};
+		geom::Bezier<3> segment{controlPoints.begin(), controlPoints.end()};
+		uint32_t n = glm::max(subdivisions, 1u);
+		for (uint32_t i = 1; i <= n; ++i)
+		{
+			float t = static_cast<float>(i) / static_cast<float>(n);
+			StrokeSample sample = lerp(p1, p2, t);
+			geom::Point p = segment(t);
+			sample.position = {p.x(), p.y()};
+			out.push_back(sample);
+		}
+	}
+
+	const char* stabilizerMethodName(StabilizerMethod method)
+	{
+		switch (method)
+		{
+		case StabilizerMethod::None: return "None";
+		case StabilizerMethod::MovingWindow: return "Moving Window";
+		case StabilizerMethod::Exponential: return "Exponential";
+		case StabilizerMethod::PulledString: return "Pulled String";
+		case StabilizerMethod::CatmullRom: return "Catmull-Rom";
+		}
+		return "";
+	}
+
+	void StabilizerBenchmark::run(const Stabilizer& settings)
+	{
+		const double omega = 2.0 * std::numbers::pi / revolutionSeconds;
+		const uint32_t count = static_cast<uint32_t>(rate * revolutionSeconds * revolutions);
+
+		// Same jittered input for every method.
+		std::mt19937 rng{42};
+		std::normal_distribution<float> jitter{0.0f, noise};
+		std::vector<StrokeSample> input(count);
+		double rawSquared = 0.0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			double t = i / static_cast<double>(rate);
+			glm::vec2 truth = radius * glm::vec2(glm::cos(omega * t), glm::sin(omega * t));
+			input[i] = {truth + glm::vec2{jitter(rng), jitter(rng)}, 1.0f, t};
+			double e = glm::length(input[i].position) - radius;
+			rawSquared += e * e;
+		}
+		rawJitterRms = glm::sqrt(rawSquared / count);
+
+		results.clear();
+		std::vector<StrokeSample> out;
+		for (StabilizerMethod method : StabilizerMethods)
+		{
+			Stabilizer stabilizer = settings;
+			stabilizer.method = method;
+			stabilizer.reset();
+
+			// Timing pass, output storage reused.
+			out.reserve(count * glm::max(settings.subdivisions, 1u));
+			auto start = std::chrono::high_resolution_clock::now();
+			for (const StrokeSample& s : input)
+			{
+				stabilizer.push(s, out);
+				out.clear();
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			stabilizer.reset();
+
+			Result result{method};
+			result.nsPerSample = std::chrono::duration<double, std::nano>(end - start).count() / count;
+
+			// Measuring pass, every output is stamped with the time of the input that produced it.
+			double squared = 0.0, latencySum = 0.0;
+			size_t outputs = 0;
+			for (const StrokeSample& s : input)
+			{
+				out.clear();
+				stabilizer.push(s, out);
+				for (const StrokeSample& o : out)
+				{
+					double e = glm::length(o.position) - radius;
+					squared += e * e;
+					// Angle behind the true pen, wrapped to half a turn.
+					double behind = omega * s.time - glm::atan(o.position.y, o.position.x);
+					behind -= 2.0 * std::numbers::pi * glm::floor(behind / (2.0 * std::numbers::pi) + 0.5);
+					double latency = glm::max(behind, 0.0) / omega * 1000.0;
+					latencySum += latency;
+					result.maxLatencyMs = glm::max(result.maxLatencyMs, latency);
+					++outputs;
+				}
+			}
+			out.clear();
+			if (outputs > 0)
+			{
+				result.jitterRms = glm::sqrt(squared / outputs);
+				result.meanLatencyMs = latencySum / outputs;
+			}
+			result.jitterRemoved = rawJitterRms > 0.0 ? 1.0 - result.jitterRms / rawJitterRms : 0.0;
+			results.push_back(result);
+		}
+	}
+
+	void StabilizerBenchmark::drawWindow(Stabilizer& settings, bool* open)
+	{
+		if (!ImGui::Begin("Stabilizer", open))
+		{
+			ImGui::End();
+			return;
+		}
+		if (ImGui::BeginCombo("Method", stabilizerMethodName(settings.method)))
+		{
+			for (StabilizerMethod method : StabilizerMethods)
+			{
+				if (ImGui::Selectable(stabilizerMethodName(method), method == settings.method))
+				{
+					settings.method = method;
+				}
+			}
+			ImGui::EndCombo();
+		}
+		const uint32_t minWindow = 1, maxWindow = Stabilizer::MaxWindowSize;
+		ImGui::SliderScalar("Window Size", ImGuiDataType_U32, &settings.windowSize, &minWindow, &maxWindow);
+		ImGui::SliderFloat("Time Constant (s)", &settings.timeConstant, 0.001f, 0.2f, "%.3f");
+		ImGui::SliderFloat("String Length (px)", &settings.stringLength, 0.0f, 100.0f);
+		const uint32_t minSubdivisions = 1, maxSubdivisions = 16;
+		ImGui::SliderScalar("Subdivisions", ImGuiDataType_U32, &settings.subdivisions, &minSubdivisions,
+		                    &maxSubdivisions);
+
+		ImGui::Separator();
+		ImGui::TextUnformatted("Benchmark");
+		ImGui::SliderFloat("Pen Rate (Hz)", &rate, 60.0f, 1000.0f);
+		ImGui::SliderFloat("Noise (px)", &noise, 0.0f, 10.0f);
+		if (ImGui::Button("Run")) run(settings);
+		if (!results.empty())
+		{
+			ImGui::Text("Raw jitter: %.3f px RMS", rawJitterRms);
+		}
+		if (!results.empty() && ImGui::BeginTable("Results", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			for (const char* header : {
+				     "Method", "Jitter (px)", "Removed", "Mean Latency (ms)", "Max Latency (ms)", "ns/Sample"
+			     })
+			{
+				ImGui::TableSetupColumn(header);
+			}
+			ImGui::TableHeadersRow();
+			for (const Result& result : results)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(stabilizerMethodName(result.method));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", result.jitterRms);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.0f%%", result.jitterRemoved * 100.0);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", result.meanLatencyMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", result.maxLatencyMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", result.nsPerSample);
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	}
+}
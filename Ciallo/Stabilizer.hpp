@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+
+namespace ciallo
+{
+	struct StrokeSample
+	{
+		glm::vec2 position{0.0f, 0.0f};
+		float pressure = 1.0f;
+		double time = 0.0; // seconds
+	};
+
+	enum class StabilizerMethod
+	{
+		None,
+		MovingWindow, // mean of the last windowSize samples
+		Exponential, // first order low pass with timeConstant
+		PulledString, // lazy brush, the brush only moves when the pen pulls the string tight
+		CatmullRom, // interpolating spline through samples, converted to cubic Bezier segments
+	};
+
+	constexpr std::array StabilizerMethods{
+		StabilizerMethod::None, StabilizerMethod::MovingWindow, StabilizerMethod::Exponential,
+		StabilizerMethod::PulledString, StabilizerMethod::CatmullRom
+	};
+
+	/**
+	 * \brief Smooths a stream of samples before they become stroke vertices.
+	 * Every method costs O(1) per pushed sample and holds back a bounded amount of input: windowSize samples,
+	 * about timeConstant seconds, stringLength of distance, or one sample for Catmull-Rom.
+	 * finish() flushes what is held back so the stroke ends where the pen lifted.
+	 * Position unit is up to the caller, stringLength is in the same unit.
+	 */
+	class Stabilizer
+	{
+	public:
+		constexpr static uint32_t MaxWindowSize = 64;
+
+	private:
+		// moving window, ring of raw samples with running sums
+		std::array<StrokeSample, MaxWindowSize> m_window;
+		uint32_t m_windowCount = 0;
+		uint32_t m_windowNext = 0;
+		glm::dvec2 m_positionSum{0.0};
+		double m_pressureSum = 0.0;
+		// exponential and pulled string
+		StrokeSample m_state;
+		// Catmull-Rom, last three raw samples
+		std::array<StrokeSample, 3> m_control;
+		uint32_t m_controlCount = 0;
+
+		StrokeSample m_last;
+		bool m_started = false;
+
+		void pushWindow(const StrokeSample& s, std::vector<StrokeSample>& out);
+		void popWindow();
+		StrokeSample windowMean() const;
+		void pushExponential(const StrokeSample& s, std::vector<StrokeSample>& out);
+		void pushPulledString(const StrokeSample& s, std::vector<StrokeSample>& out);
+		void pushCatmullRom(const StrokeSample& s, std::vector<StrokeSample>& out);
+		void emitSegment(const StrokeSample& next, std::vector<StrokeSample>& out) const;
+	public:
+		StabilizerMethod method = StabilizerMethod::PulledString;
+		uint32_t windowSize = 8;
+		float timeConstant = 0.02f; // seconds
+		float stringLength = 12.0f;
+		uint32_t subdivisions = 4; // Bezier points per Catmull-Rom segment
+
+		// Call before the first sample of every stroke.
+		void reset();
+		// Smoothed samples are appended to out, zero or more per call.
+		void push(const StrokeSample& s, std::vector<StrokeSample>& out);
+		void finish(std::vector<StrokeSample>& out);
+	};
+
+	const char* stabilizerMethodName(StabilizerMethod method);
+
+	/**
+	 * \brief Measures every method on a synthetic pen circle with gaussian jitter, sampled at pen rate.
+	 * Jitter is the RMS distance from the true circle, latency is how far behind the true pen the output lags.
+	 */
+	class StabilizerBenchmark
+	{
+	public:
+		struct Result
+		{
+			StabilizerMethod method;
+			double jitterRms = 0.0; // same unit as position
+			double jitterRemoved = 0.0; // ratio of raw jitter
+			double meanLatencyMs = 0.0;
+			double maxLatencyMs = 0.0;
+			double nsPerSample = 0.0;
+		};
+
+		float rate = 240.0f; // Hz
+		float radius = 200.0f;
+		float revolutionSeconds = 1.5f;
+		float noise = 1.5f; // standard deviation of jitter
+		uint32_t revolutions = 8;
+		double rawJitterRms = 0.0;
+		std::vector<Result> results;
+
+		// Methods run with the settings of the given stabilizer.
+		void run(const Stabilizer& settings);
+		void drawWindow(Stabilizer& settings, bool* open);
+	};
+}
@@ -0,0 +1,390 @@
+#include "pch.hpp"
+#include "StrokeAccumulator.hpp"
+
+#include "vku.hpp"
+#include "BrushTable.hpp"
+#include "Drawing.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo
+{
+	namespace
+	{
+		constexpr vk::ShaderStageFlags PushStages = vk::ShaderStageFlagBits::eVertex |
+			vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
+		constexpr vk::Format CoverageFormat = vk::Format::eR16Sfloat;
+		constexpr vk::Format AccumulationFormat = vk::Format::eR16G16B16A16Sfloat;
+
+		vk::Rect2D toRect(const glm::ivec4& bounds)
+		{
+			return {
+				{bounds.x, bounds.y},
+				{static_cast<uint32_t>(bounds.z - bounds.x), static_cast<uint32_t>(bounds.w - bounds.y)}
+			};
+		}
+
+		bool empty(const glm::ivec4& bounds)
+		{
+			return bounds.x >= bounds.z || bounds.y >= bounds.w;
+		}
+	}
+
+	StrokeAccumulator::StrokeAccumulator(vulkan::Device* device, vk::DescriptorSetLayout brushTableLayout):
+		m_device(device)
+	{
+		m_coverageVertShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eVertex,
+		                                            "./shaders/strokeCoverage.vert.spv");
+		m_coverageFragShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eFragment,
+		                                            "./shaders/strokeCoverage.frag.spv");
+		m_compositeVertShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eVertex,
+		                                             "./shaders/strokeComposite.vert.spv");
+		m_compositeFragShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eFragment,
+		                                             "./shaders/strokeComposite.frag.spv");
+		m_binShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eCompute,
+		                                   "./shaders/strokeBin.comp.spv");
+		m_resolveShader = vulkan::ShaderModule(*device, vk::ShaderStageFlagBits::eCompute,
+		                                       "./shaders/strokeResolve.comp.spv");
+		m_sampler = vku::SamplerMaker().createUnique(device->device());
+		reserve(1024);
+		// Images are created and the descriptor set written by upload(), which always comes before rendering.
+		genDescriptorSet(device->descriptorPool());
+		genPipelines(brushTableLayout);
+	}
+
+	void StrokeAccumulator::genDescriptorSet(vk::DescriptorPool pool)
+	{
+		using S = vk::ShaderStageFlagBits;
+		vku::DescriptorSetLayoutMaker layoutMaker;
+		layoutMaker.buffer(0, vk::DescriptorType::eStorageBuffer, S::eVertex | S::eFragment | S::eCompute, 1)
+		           .buffer(2, vk::DescriptorType::eStorageBuffer, S::eCompute, 1)
+		           .image(3, vk::DescriptorType::eCombinedImageSampler, S::eFragment, 1)
+		           .image(4, vk::DescriptorType::eCombinedImageSampler, S::eFragment, 1)
+		           .image(5, vk::DescriptorType::eStorageImage, S::eCompute, 1);
+		m_descriptorSetLayout = layoutMaker.createUnique(m_device->device());
+
+		vku::DescriptorSetMaker maker;
+		maker.layout(*m_descriptorSetLayout);
+		m_descriptorSet = maker.create(m_device->device(), pool)[0];
+	}
+
+	void StrokeAccumulator::genPipelines(vk::DescriptorSetLayout brushTableLayout)
+	{
+		vk::Device device = m_device->device();
+		vku::PipelineLayoutMaker layoutMaker;
+		layoutMaker.descriptorSetLayout(*m_descriptorSetLayout)
+		           .descriptorSetLayout(brushTableLayout)
+		           .pushConstantRange(PushStages, 0, sizeof(PushConstant));
+		m_pipelineLayout = layoutMaker.createUnique(device);
+
+		// Coverage of segments merged with max, never summed.
+		vku::PipelineMaker coverageMaker;
+		coverageMaker.topology(vk::PrimitiveTopology::eTriangleStrip)
+		             .dynamicState(vk::DynamicState::eViewport)
+		             .dynamicState(vk::DynamicState::eScissor)
+		             .shader(vk::ShaderStageFlagBits::eVertex, m_coverageVertShader)
+		             .shader(vk::ShaderStageFlagBits::eFragment, m_coverageFragShader)
+		             .cullMode(vk::CullModeFlagBits::eNone)
+		             .blendBegin(VK_TRUE)
+		             .blendSrcColorBlendFactor(vk::BlendFactor::eOne)
+		             .blendDstColorBlendFactor(vk::BlendFactor::eOne)
+		             .blendColorBlendOp(vk::BlendOp::eMax)
+		             .blendSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+		             .blendDstAlphaBlendFactor(vk::BlendFactor::eOne)
+		             .blendAlphaBlendOp(vk::BlendOp::eMax);
+		std::vector coverageFormats{CoverageFormat};
+		m_coveragePipeline = coverageMaker.createUnique(device, nullptr, *m_pipelineLayout,
+		                                                vk::PipelineRenderingCreateInfo{0, coverageFormats});
+
+		// Premultiplied over.
+		vku::PipelineMaker compositeMaker;
+		compositeMaker.topology(vk::PrimitiveTopology::eTriangleList)
+		              .dynamicState(vk::DynamicState::eViewport)
+		              .dynamicState(vk::DynamicState::eScissor)
+		              .shader(vk::ShaderStageFlagBits::eVertex, m_compositeVertShader)
+		              .shader(vk::ShaderStageFlagBits::eFragment, m_compositeFragShader)
+		              .cullMode(vk::CullModeFlagBits::eNone)
+		              .blendBegin(VK_TRUE)
+		              .blendSrcColorBlendFactor(vk::BlendFactor::eOne)
+		              .blendDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+		              .blendSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+		              .blendDstAlphaBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha);
+		for (CanvasFormat format : supportedCanvasFormats(m_device->physicalDevice()))
+		{
+			std::vector colorAttachmentsFormats{toVkFormat(format)};
+			vk::PipelineRenderingCreateInfo renderingCreateInfo{0, colorAttachmentsFormats};
+			m_compositePipelines[toVkFormat(format)] = compositeMaker.createUnique(
+				device, nullptr, *m_pipelineLayout, renderingCreateInfo);
+		}
+
+		vku::ComputePipelineMaker binMaker{};
+		binMaker.shader(vk::ShaderStageFlagBits::eCompute, m_binShader);
+		m_binPipeline = binMaker.createUnique(device, nullptr, *m_pipelineLayout);
+		vku::ComputePipelineMaker resolveMaker{};
+		resolveMaker.shader(vk::ShaderStageFlagBits::eCompute, m_resolveShader);
+		m_resolvePipeline = resolveMaker.createUnique(device, nullptr, *m_pipelineLayout);
+	}
+
+	void StrokeAccumulator::reserve(vk::DeviceSize segmentCount)
+	{
+		VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+		if (!m_segments.allocated() || m_segments.size() < segmentCount * sizeof(Segment))
+		{
+			vk::DeviceSize capacity = std::bit_ceil(segmentCount);
+			m_segments = vulkan::Buffer(*m_device, info, capacity * sizeof(Segment),
+			                            vk::BufferUsageFlagBits::eStorageBuffer);
+			m_tiles = vulkan::Buffer(*m_device, vulkan::MemoryAuto, capacity * sizeof(glm::ivec4),
+			                         vk::BufferUsageFlagBits::eStorageBuffer);
+		}
+	}
+
+	void StrokeAccumulator::resize(vk::CommandBuffer cb, vk::Extent2D extent)
+	{
+		if (m_coverage.allocated() && m_coverage.extent2D() == extent) return;
+		m_coverage = vulkan::Image(*m_device, vulkan::MemoryAuto, CoverageFormat, extent.width, extent.height,
+		                           vk::SampleCountFlagBits::e1,
+		                           vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled);
+		m_coverage.changeLayout(cb, vk::ImageLayout::eGeneral);
+		m_accumulation = vulkan::Image(*m_device, vulkan::MemoryAuto, AccumulationFormat, extent.width,
+		                               extent.height, vk::SampleCountFlagBits::e1,
+		                               vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled);
+		m_accumulation.changeLayout(cb, vk::ImageLayout::eGeneral);
+	}
+
+	void StrokeAccumulator::updateDescriptorSet()
+	{
+		vku::DescriptorSetUpdater updater;
+		updater.beginDescriptorSet(m_descriptorSet)
+		       .beginBuffers(0, 0, vk::DescriptorType::eStorageBuffer)
+		       .buffer(m_segments)
+		       .beginBuffers(2, 0, vk::DescriptorType::eStorageBuffer)
+		       .buffer(m_tiles)
+		       .beginImages(3, 0, vk::DescriptorType::eCombinedImageSampler)
+		       .image(*m_sampler, m_coverage.imageView(), vk::ImageLayout::eGeneral)
+		       .beginImages(4, 0, vk::DescriptorType::eCombinedImageSampler)
+		       .image(*m_sampler, m_accumulation.imageView(), vk::ImageLayout::eGeneral)
+		       .beginImages(5, 0, vk::DescriptorType::eStorageImage)
+		       .image(nullptr, m_accumulation.imageView(), vk::ImageLayout::eGeneral);
+		updater.update(m_device->device());
+	}
+
+	bool StrokeAccumulator::accumulated(const entt::registry& r, entt::entity stroke)
+	{
+		entt::entity brush = r.get<StrokeCpo>(stroke).brush;
+		return r.valid(brush) && BrushTable::engineType(r, brush) == BrushEngineType::Airbrush;
+	}
+
+	void StrokeAccumulator::upload(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing,
+	                               vk::Extent2D extent, const std::vector<entt::entity>& strokes)
+	{
+		m_ranges.clear();
+		m_brushTableSet = r.ctx().at<BrushTable*>()->descriptorSet();
+		const auto& view = r.get<ViewRectCpo>(drawing);
+		glm::vec2 extentf{extent.width, extent.height};
+		glm::vec2 scale = extentf / (view.max - view.min);
+
+		std::vector<Segment> segments;
+		uint32_t order = 0;
+		for (entt::entity e : strokes)
+		{
+			if (!accumulated(r, e)) continue;
+			const auto& stroke = r.get<StrokeCpo>(e);
+			size_t n = stroke.position.size();
+			if (n == 0) continue;
+
+			uint32_t brush = BrushTable::index(r, stroke.brush);
+
+			auto pixel = [&](size_t i)
+			{
+				const geom::Point& p = stroke.position[i];
+				return (glm::vec2{p.x(), p.y()} - view.min) * scale;
+			};
+			auto radius = [&](size_t i)
+			{
+				return i < stroke.thickness.size() ? stroke.thickness[i] * scale.x : 0.0f;
+			};
+
+			Range range{static_cast<uint32_t>(segments.size()), 0, brush, {}};
+			glm::vec2 lo{std::numeric_limits<float>::max()}, hi{std::numeric_limits<float>::lowest()};
+			// A single point is a segment of zero length, a dot.
+			for (size_t i = 0; i < std::max<size_t>(n - 1, 1); ++i)
+			{
+				size_t j = std::min(i + 1, n - 1);
+				Segment segment{pixel(i), pixel(j), radius(i), radius(j), order, brush};
+				float reach = std::max(segment.r0, segment.r1) + 1.0f;
+				lo = glm::min(lo, glm::min(segment.p0, segment.p1) - reach);
+				hi = glm::max(hi, glm::max(segment.p0, segment.p1) + reach);
+				segments.push_back(segment);
+			}
+			range.segmentCount = static_cast<uint32_t>(segments.size()) - range.firstSegment;
+			lo = glm::clamp(glm::floor(lo), glm::vec2(0.0f), extentf);
+			hi = glm::clamp(glm::ceil(hi), glm::vec2(0.0f), extentf);
+			range.bounds = glm::ivec4(glm::vec4(lo, hi));
+			m_ranges[e] = range;
+			++order;
+		}
+
+		// Previous frame is finished, buffers and descriptor set are free to change.
+		reserve(std::max<size_t>(segments.size(), 1));
+		resize(cb, extent);
+		if (!segments.empty()) m_segments.uploadLocal(segments.data(), segments.size() * sizeof(Segment));
+		updateDescriptorSet();
+	}
+
+	void StrokeAccumulator::composite(vk::CommandBuffer cb, const vulkan::Image& target, const glm::ivec4& bounds,
+	                                  const PushConstant& pushConstant)
+	{
+		vk::Rect2D area = toRect(bounds);
+		vk::RenderingAttachmentInfo renderingAttachmentInfo{target.imageView(), vk::ImageLayout::eGeneral};
+		std::vector colorAttachments{renderingAttachmentInfo};
+		cb.beginRendering({{}, area, 1, 0, colorAttachments, {}, {}});
+		vk::Viewport fullViewport{
+			0, 0, static_cast<float>(target.width()), static_cast<float>(target.height()), 0.0f, 1.0f
+		};
+		cb.setViewport(0, fullViewport);
+		cb.setScissor(0, area);
+		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *m_compositePipelines.at(target.format()));
+		std::array sets{m_descriptorSet, m_brushTableSet};
+		cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *m_pipelineLayout, 0, sets, {});
+		cb.pushConstants<PushConstant>(*m_pipelineLayout, PushStages, 0, pushConstant);
+		cb.draw(3, 1, 0, 0);
+		cb.endRendering();
+	}
+
+	void StrokeAccumulator::renderRaster(vk::CommandBuffer cb, const vulkan::Image& target,
+	                                     const std::vector<Range>& ranges)
+	{
+		glm::vec2 extent{m_coverage.width(), m_coverage.height()};
+		vk::Viewport fullViewport{0, 0, extent.x, extent.y, 0.0f, 1.0f};
+		std::array sets{m_descriptorSet, m_brushTableSet};
+		vk::MemoryBarrier2 coverageBarrier{
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead
+		};
+		// Next stroke clears coverage read by this one and blends on the target written by this one.
+		vk::MemoryBarrier2 strokeBarrier{
+			vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+			vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+			vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite
+		};
+
+		for (const Range& range : ranges)
+		{
+			PushConstant pushConstant{range.firstSegment, range.segmentCount, range.brush, 0, {}, extent};
+			vk::Rect2D area = toRect(range.bounds);
+			vk::RenderingAttachmentInfo coverageAttachment{
+				m_coverage.imageView(), vk::ImageLayout::eGeneral, {}, {}, {},
+				vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, vk::ClearColorValue{}
+			};
+			std::vector colorAttachments{coverageAttachment};
+			cb.beginRendering({{}, area, 1, 0, colorAttachments, {}, {}});
+			cb.setViewport(0, fullViewport);
+			cb.setScissor(0, area);
+			cb.bindPipeline(vk::PipelineBindPoint::eGraphics, *m_coveragePipeline);
+			cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *m_pipelineLayout, 0, sets, {});
+			cb.pushConstants<PushConstant>(*m_pipelineLayout, PushStages, 0, pushConstant);
+			cb.draw(4, range.segmentCount, 0, 0);
+			cb.endRendering();
+			cb.pipelineBarrier2({{}, coverageBarrier, {}, {}});
+
+			composite(cb, target, range.bounds, pushConstant);
+			cb.pipelineBarrier2({{}, strokeBarrier, {}, {}});
+		}
+	}
+
+	void StrokeAccumulator::renderTileBinning(vk::CommandBuffer cb, const vulkan::Image& target,
+	                                          const std::vector<Range>& ranges)
+	{
+		glm::vec2 extent{m_accumulation.width(), m_accumulation.height()};
+		std::array sets{m_descriptorSet, m_brushTableSet};
+		vk::MemoryBarrier2 binBarrier{
+			vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+			vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead
+		};
+		vk::MemoryBarrier2 resolveBarrier{
+			vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+			vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead
+		};
+		// Next run overwrites accumulation read by this one and blends on the target written by this one.
+		std::array runBarriers{
+			vk::MemoryBarrier2{
+				vk::PipelineStageFlagBits2::eFragmentShader, {},
+				vk::PipelineStageFlagBits2::eComputeShader, {}
+			},
+			vk::MemoryBarrier2{
+				vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+				vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+				vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite
+			}
+		};
+
+		// Resolve walks a contiguous range of segments, split where strokes of the run are not adjacent.
+		size_t begin = 0;
+		while (begin < ranges.size())
+		{
+			size_t end = begin + 1;
+			glm::ivec4 bounds = ranges[begin].bounds;
+			while (end < ranges.size() &&
+				ranges[end].firstSegment == ranges[end - 1].firstSegment + ranges[end - 1].segmentCount)
+			{
+				const glm::ivec4& next = ranges[end].bounds;
+				bounds = {
+					std::min(bounds.x, next.x), std::min(bounds.y, next.y),
+					std::max(bounds.z, next.z), std::max(bounds.w, next.w)
+				};
+				++end;
+			}
+			uint32_t first = ranges[begin].firstSegment;
+			uint32_t count = ranges[end - 1].firstSegment + ranges[end - 1].segmentCount - first;
+			glm::ivec2 origin = glm::ivec2(bounds.x, bounds.y) / static_cast<int>(TileSize) *
+				static_cast<int>(TileSize);
+			glm::uvec2 tiles = (glm::uvec2(bounds.z, bounds.w) - glm::uvec2(origin) + TileSize - 1u) / TileSize;
+			PushConstant pushConstant{first, count, 0, 1, origin, extent};
+
+			cb.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *m_pipelineLayout, 0, sets, {});
+			cb.pushConstants<PushConstant>(*m_pipelineLayout, PushStages, 0, pushConstant);
+			cb.bindPipeline(vk::PipelineBindPoint::eCompute, *m_binPipeline);
+			cb.dispatch((count + 63) / 64, 1, 1);
+			cb.pipelineBarrier2({{}, binBarrier, {}, {}});
+			cb.bindPipeline(vk::PipelineBindPoint::eCompute, *m_resolvePipeline);
+			cb.dispatch(tiles.x, tiles.y, 1);
+			cb.pipelineBarrier2({{}, resolveBarrier, {}, {}});
+
+			composite(cb, target, bounds, pushConstant);
+			cb.pipelineBarrier2({{}, runBarriers, {}, {}});
+			begin = end;
+		}
+	}
+
+	void StrokeAccumulator::render(vk::CommandBuffer cb, const vulkan::Image& target,
+	                               const std::vector<entt::entity>& strokes)
+	{
+		std::vector<Range> ranges;
+		for (entt::entity e : strokes)
+		{
+			auto it = m_ranges.find(e);
+			if (it == m_ranges.end())
+			{
+				throw std::runtime_error("Stroke is not uploaded in this frame!");
+			}
+			if (it->second.segmentCount > 0 && !empty(it->second.bounds)) ranges.push_back(it->second);
+		}
+		if (ranges.empty()) return;
+
+		// Earlier draws into target finish before blending on it.
+		vk::MemoryBarrier2 targetBarrier{
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+			vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite
+		};
+		cb.pipelineBarrier2({{}, targetBarrier, {}, {}});
+		if (mode == Mode::TileBinning)
+		{
+			renderTileBinning(cb, target, ranges);
+		}
+		else
+		{
+			renderRaster(cb, target, ranges);
+		}
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "CanvasFormat.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "ShaderModule.hpp"
+
+namespace ciallo
+{
+	/**
+	 * \brief Order independent accumulation of airbrush strokes.
+	 * Coverage of all segments of a stroke is merged with max, then the stroke is blended once, so overlapping
+	 * segment caps never double blend. Raster mode draws segments into a transient coverage target and composites
+	 * every stroke with its own pair of passes. TileBinning mode bins segments into 16x16 tiles with compute and
+	 * resolves a whole run of strokes in one dispatch, composited by one pass.
+	 */
+	class StrokeAccumulator
+	{
+		struct Segment // pixel space
+		{
+			glm::vec2 p0;
+			glm::vec2 p1;
+			float r0;
+			float r1;
+			uint32_t stroke; // order in this frame, segments of one stroke are merged
+			uint32_t brush; // BrushIndexCpo::index
+		};
+
+		struct PushConstant
+		{
+			uint32_t first;
+			uint32_t count;
+			uint32_t brush;
+			uint32_t source;
+			glm::ivec2 origin; // pixel offset of dispatch or draw
+			glm::vec2 extent;
+		};
+
+		// Stroke uploaded this frame.
+		struct Range
+		{
+			uint32_t firstSegment;
+			uint32_t segmentCount;
+			uint32_t brush;
+			glm::ivec4 bounds; // pixel rectangle [xy, zw)
+		};
+
+		vulkan::Device* m_device;
+		vulkan::ShaderModule m_coverageVertShader;
+		vulkan::ShaderModule m_coverageFragShader;
+		vulkan::ShaderModule m_compositeVertShader;
+		vulkan::ShaderModule m_compositeFragShader;
+		vulkan::ShaderModule m_binShader;
+		vulkan::ShaderModule m_resolveShader;
+		vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+		vk::UniquePipelineLayout m_pipelineLayout;
+		vk::DescriptorSet m_descriptorSet;
+		vk::DescriptorSet m_brushTableSet; // set 1, brush parameters and falloff LUTs
+		vk::UniqueSampler m_sampler;
+		vk::UniquePipeline m_coveragePipeline;
+		std::unordered_map<vk::Format, vk::UniquePipeline> m_compositePipelines;
+		vk::UniquePipeline m_binPipeline;
+		vk::UniquePipeline m_resolvePipeline;
+
+		vulkan::Buffer m_segments;
+		vulkan::Buffer m_tiles; // tile rectangle of every segment
+		vulkan::Image m_coverage; // R16F, max of segment coverage
+		vulkan::Image m_accumulation; // RGBA16F, premultiplied run of strokes
+		std::unordered_map<entt::entity, Range> m_ranges;
+
+		void genDescriptorSet(vk::DescriptorPool pool);
+		void genPipelines(vk::DescriptorSetLayout brushTableLayout);
+		void reserve(vk::DeviceSize segmentCount);
+		void resize(vk::CommandBuffer cb, vk::Extent2D extent);
+		void updateDescriptorSet();
+		void renderRaster(vk::CommandBuffer cb, const vulkan::Image& target, const std::vector<Range>& ranges);
+		void renderTileBinning(vk::CommandBuffer cb, const vulkan::Image& target, const std::vector<Range>& ranges);
+		void composite(vk::CommandBuffer cb, const vulkan::Image& target, const glm::ivec4& bounds,
+		               const PushConstant& pushConstant);
+	public:
+		enum class Mode
+		{
+			Raster,
+			TileBinning,
+		};
+
+		constexpr static uint32_t TileSize = 16;
+		Mode mode = Mode::Raster;
+
+		StrokeAccumulator(vulkan::Device* device, vk::DescriptorSetLayout brushTableLayout);
+
+		// Stroke has a brush with AirbrushCpo.
+		static bool accumulated(const entt::registry& r, entt::entity stroke);
+		/**
+		 * \brief Upload all accumulated strokes rasterized this frame, in pixel space of drawing.
+		 * Call once per frame after the previous frame is finished and before render. Brushes are read from
+		 * BrushTable in registry ctx by their index, update it first.
+		 */
+		void upload(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing, vk::Extent2D extent,
+		            const std::vector<entt::entity>& strokes);
+		/**
+		 * \brief Blend strokes into target in order. Strokes must be uploaded this frame.
+		 * Record it outside of rendering, target is in general layout.
+		 */
+		void render(vk::CommandBuffer cb, const vulkan::Image& target, const std::vector<entt::entity>& strokes);
+	};
+}
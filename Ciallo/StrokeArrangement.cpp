@@ -0,0 +1,218 @@
+#include "pch.hpp"
+#include "StrokeArrangement.hpp"
+
+#include <chrono>
+
+#include "CanvasInteraction.hpp"
+#include "Layer.hpp"
+#include "Simplification.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo
+{
+	namespace
+	{
+		geom::ExKernel::Point_2 toExact(const geom::Point& p)
+		{
+			return {p.x(), p.y()};
+		}
+
+	}
+
+	StrokeArrangement::StrokeArrangement(): m_pointLocation(m_arrangement)
+	{
+	}
+
+	void StrokeArrangement::insert(entt::entity stroke, std::span<const geom::Point> polyline)
+	{
+		remove(stroke);
+		std::vector<Arrangement::Curve_handle> curves;
+		for (size_t i = 1; i < polyline.size(); ++i)
+		{
+			if (polyline[i - 1] == polyline[i]) continue;
+			Traits::Curve_2 segment{toExact(polyline[i - 1]), toExact(polyline[i])};
+			curves.push_back(CGAL::insert(m_arrangement, segment, m_pointLocation));
+		}
+		if (!curves.empty()) m_curves.emplace(stroke, std::move(curves));
+	}
+
+	void StrokeArrangement::remove(entt::entity stroke)
+	{
+		auto it = m_curves.find(stroke);
+		if (it == m_curves.end()) return;
+		for (Arrangement::Curve_handle curve : it->second)
+		{
+			CGAL::remove_curve(m_arrangement, curve);
+		}
+		m_curves.erase(it);
+	}
+
+	std::optional<StrokeArrangement::Face> StrokeArrangement::locate(const geom::Point& p) const
+	{
+		auto result = m_pointLocation.locate(toExact(p));
+		const Face* face = std::get_if<Face>(&result);
+		if (!face || (*face)->is_unbounded()) return std::nullopt;
+		return *face;
+	}
+
+	void StrokeArrangementBuilder::connect(entt::registry& r)
+	{
+		ob.connect(r, entt::collector.group<StrokeCpo, LayerMemberCpo>().update<StrokeCpo>()
+		                             .update<LayerMemberCpo>());
+		r.on_destroy<StrokeCpo>().connect<&StrokeArrangementBuilder::removeEverywhere>();
+		r.on_destroy<LayerMemberCpo>().connect<&StrokeArrangementBuilder::removeEverywhere>();
+	}
+
+	void StrokeArrangementBuilder::enable(entt::registry& r, entt::entity drawing)
+	{
+		if (r.all_of<StrokeArrangementCpo>(drawing)) return;
+
+		auto build = std::make_unique<StrokeArrangementBuild>(r.ctx().at<JobSystem*>());
+		for (auto&& [e, stroke, member] : r.view<StrokeCpo, LayerMemberCpo>().each())
+		{
+			if (r.all_of<LiveStrokeCpo>(e) || drawingOf(r, e) != drawing) continue;
+			build->polylines.emplace_back(e, stroke.position);
+			build->vertices += stroke.position.size();
+		}
+		// The job owns nothing but the build, which outlives it.
+		StrokeArrangementBuild* b = build.get();
+		b->jobs->run(b->done, [b]
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			b->arrangement = std::make_unique<StrokeArrangement>();
+			for (auto& [e, polyline] : b->polylines)
+			{
+				b->arrangement->insert(e, simplify(polyline));
+			}
+			b->polylines.clear();
+			auto end = std::chrono::high_resolution_clock::now();
+			b->ms = std::chrono::duration<double, std::milli>(end - start).count();
+		});
+		r.emplace<StrokeArrangementCpo>(drawing, nullptr, std::move(build));
+	}
+
+	void StrokeArrangementBuilder::finish(entt::registry& r, entt::entity drawing, StrokeArrangementCpo& cpo)
+	{
+		StrokeArrangementBuild& build = *cpo.build;
+		try
+		{
+			build.jobs->wait(build.done);
+		}
+		catch (std::exception& e)
+		{
+			// CGAL throws on degenerate input, the drawing goes without an arrangement until enabled again.
+			spdlog::error("Stroke arrangement of drawing {} failed: {}", drawing, e.what());
+			r.remove<StrokeArrangementCpo>(drawing);
+			return;
+		}
+		StrokeArrangement& arrangement = *build.arrangement;
+		for (entt::entity e : build.missed)
+		{
+			arrangement.remove(e);
+			// Live strokes are deferred, update() inserts them once finished.
+			if (!r.valid(e) || !r.all_of<StrokeCpo, LayerMemberCpo>(e) || r.all_of<LiveStrokeCpo>(e)) continue;
+			if (drawingOf(r, e) == drawing) insert(r, arrangement, e);
+		}
+		const auto& arr = arrangement.arrangement();
+		spdlog::info("Stroke arrangement of drawing {}: {} strokes of {} vertices, {} vertices {} edges {} faces, "
+		             "{} ms off the main thread, {} strokes changed meanwhile", drawing, arrangement.strokeCount(),
+		             build.vertices, arr.number_of_vertices(), arr.number_of_edges(), arr.number_of_faces(),
+		             build.ms, build.missed.size());
+		cpo.arrangement = std::move(build.arrangement);
+		cpo.build.reset();
+	}
+
+	void StrokeArrangementBuilder::disable(entt::registry& r, entt::entity drawing)
+	{
+		r.remove<StrokeArrangementCpo>(drawing);
+	}
+
+	void StrokeArrangementBuilder::update(entt::registry& r)
+	{
+		for (auto&& [drawing, cpo] : r.view<StrokeArrangementCpo>().each())
+		{
+			if (cpo.build && cpo.build->done.done()) finish(r, drawing, cpo);
+		}
+		if (r.view<StrokeArrangementCpo>().empty())
+		{
+			ob.clear();
+			deferred.clear();
+			return;
+		}
+		std::vector<entt::entity> changed{ob.begin(), ob.end()};
+		ob.clear();
+		changed.insert(changed.end(), deferred.begin(), deferred.end());
+		deferred.clear();
+
+		for (entt::entity e : changed)
+		{
+			if (!r.valid(e) || !r.all_of<StrokeCpo, LayerMemberCpo>(e)) continue;
+			// Live strokes change every frame, waiting for them keeps inserting and removing out of the way.
+			if (r.all_of<LiveStrokeCpo>(e))
+			{
+				deferred.insert(e);
+				continue;
+			}
+			// The stroke may have moved to a layer of another drawing.
+			removeEverywhere(r, e);
+			entt::entity drawing = drawingOf(r, e);
+			if (drawing == entt::null) continue;
+			auto* cpo = r.try_get<StrokeArrangementCpo>(drawing);
+			if (!cpo) continue;
+			if (cpo->arrangement)
+			{
+				insert(r, *cpo->arrangement, e);
+			}
+			else
+			{
+				cpo->build->missed.insert(e);
+			}
+		}
+	}
+
+	const StrokeArrangement* StrokeArrangementBuilder::find(const entt::registry& r, entt::entity drawing)
+	{
+		auto* cpo = r.try_get<StrokeArrangementCpo>(drawing);
+		return cpo ? cpo->arrangement.get() : nullptr;
+	}
+
+	std::vector<geom::Point> StrokeArrangementBuilder::simplify(const std::vector<geom::Point>& position)
+	{
+		if (position.size() < 3) return position;
+		std::vector<uint32_t> kept = geom::douglasPeucker(position, SimplifyTolerance);
+		return kept | views::transform([&position](uint32_t i)
+		{
+			return position[i];
+		}) | ranges::to_vector;
+	}
+
+	void StrokeArrangementBuilder::insert(entt::registry& r, StrokeArrangement& arrangement, entt::entity stroke)
+	{
+		arrangement.insert(stroke, simplify(r.get<StrokeCpo>(stroke).position));
+	}
+
+	void StrokeArrangementBuilder::removeEverywhere(entt::registry& r, entt::entity stroke)
+	{
+		for (auto&& [e, cpo] : r.view<StrokeArrangementCpo>().each())
+		{
+			if (cpo.arrangement)
+			{
+				cpo.arrangement->remove(stroke);
+			}
+			else
+			{
+				cpo.build->missed.insert(stroke);
+			}
+		}
+	}
+
+	entt::entity StrokeArrangementBuilder::drawingOf(const entt::registry& r, entt::entity stroke)
+	{
+		entt::entity layer = r.get<LayerMemberCpo>(stroke).layer;
+		for (auto&& [drawing, stack] : r.view<LayerStackCpo>().each())
+		{
+			if (std::ranges::find(stack.layers, layer) != stack.layers.end()) return drawing;
+		}
+		return entt::null;
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <span>
+#include <CGAL/Arr_segment_traits_2.h>
+#include <CGAL/Arr_trapezoid_ric_point_location.h>
+#include <CGAL/Arrangement_with_history_2.h>
+
+#include "JobSystem.hpp"
+
+namespace ciallo
+{
+	/**
+	 * \brief Planar map of stroke centerlines, every bounded face is a candidate fill region.
+	 * Float input converts to the exact kernel without error, so only intersections ever need exact numbers.
+	 * History links every edge to the segments that made it, a stroke is removed without rebuilding. Point
+	 * location uses a trapezoidal map, expected O(log n) per query, updated along with the arrangement.
+	 * Insertion cost grows with vertex count, strokes are simplified before they get here.
+	 */
+	class StrokeArrangement
+	{
+	public:
+		using Traits = CGAL::Arr_segment_traits_2<geom::ExKernel>;
+		using Arrangement = CGAL::Arrangement_with_history_2<Traits>;
+		using PointLocation = CGAL::Arr_trapezoid_ric_point_location<Arrangement>;
+		using Face = Arrangement::Face_const_handle;
+
+	private:
+		Arrangement m_arrangement;
+		PointLocation m_pointLocation;
+		std::unordered_map<entt::entity, std::vector<Arrangement::Curve_handle>> m_curves;
+
+	public:
+		StrokeArrangement();
+		StrokeArrangement(const StrokeArrangement& other) = delete;
+		StrokeArrangement& operator=(const StrokeArrangement& other) = delete;
+
+		// Segments of polyline replace whatever stroke inserted before. Zero length segments are skipped.
+		void insert(entt::entity stroke, std::span<const geom::Point> polyline);
+		void remove(entt::entity stroke);
+		bool contains(entt::entity stroke) const { return m_curves.contains(stroke); }
+		// Bounded face containing p. None on edges and vertices, or outside of every closed loop.
+		std::optional<Face> locate(const geom::Point& p) const;
+
+		const Arrangement& arrangement() const { return m_arrangement; }
+		size_t strokeCount() const { return m_curves.size(); }
+	};
+
+	// First build of an arrangement, run on the job system while the registry goes on changing.
+	struct StrokeArrangementBuild
+	{
+		JobSystem* jobs;
+		JobSystem::TaskGroup done;
+		// Simplified centerlines, copied when the build started.
+		std::vector<std::pair<entt::entity, std::vector<geom::Point>>> polylines;
+		std::unique_ptr<StrokeArrangement> arrangement;
+		size_t vertices = 0;
+		double ms = 0.0;
+		// Strokes changed or destroyed since the copy, brought up to date once the build is done.
+		std::unordered_set<entt::entity> missed;
+
+		explicit StrokeArrangementBuild(JobSystem* jobs): jobs(jobs) {}
+		StrokeArrangementBuild(const StrokeArrangementBuild& other) = delete;
+		StrokeArrangementBuild& operator=(const StrokeArrangementBuild& other) = delete;
+		~StrokeArrangementBuild()
+		{
+			// finish() already reported a failed build.
+			try { jobs->wait(done); }
+			catch (...) {}
+		}
+	};
+
+	// On drawing entity, arrangement of all strokes in its layers. Kept in sync by StrokeArrangementBuilder.
+	struct StrokeArrangementCpo
+	{
+		std::unique_ptr<StrokeArrangement> arrangement; // null until the first build is done
+		std::unique_ptr<StrokeArrangementBuild> build;
+	};
+
+	/**
+	 * \brief Keep StrokeArrangementCpo of drawings up to date with their strokes.
+	 * Only drawings enabled for it pay for the arrangement. Strokes still being drawn are inserted once finished.
+	 * Enabling builds on the job system, so the frames go on while a large drawing is inserted.
+	 */
+	struct StrokeArrangementBuilder
+	{
+		// Douglas-Peucker tolerance of centerlines before insertion.
+		constexpr static float SimplifyTolerance = 2e-5f; // 0.02mm
+
+		static inline entt::observer ob;
+		static inline std::unordered_set<entt::entity> deferred;
+
+		static void connect(entt::registry& r);
+		// Start building arrangement of drawing, update() picks it up once done and keeps it up to date.
+		static void enable(entt::registry& r, entt::entity drawing);
+		static void disable(entt::registry& r, entt::entity drawing);
+		static void update(entt::registry& r);
+		// Arrangement of drawing, null when not enabled or still building.
+		static const StrokeArrangement* find(const entt::registry& r, entt::entity drawing);
+	private:
+		static std::vector<geom::Point> simplify(const std::vector<geom::Point>& position);
+		static void insert(entt::registry& r, StrokeArrangement& arrangement, entt::entity stroke);
+		static void finish(entt::registry& r, entt::entity drawing, StrokeArrangementCpo& cpo);
+		static void removeEverywhere(entt::registry& r, entt::entity stroke);
+		static entt::entity drawingOf(const entt::registry& r, entt::entity stroke);
+	};
+}
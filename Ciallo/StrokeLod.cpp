@@ -0,0 +1,159 @@
+#include "pch.hpp"
+#include "StrokeLod.hpp"
+
+#include "Device.hpp"
+#include "Simplification.hpp"
+#include "Stroke.hpp"
+
+namespace ciallo
+{
+	bool StrokeBoundsCpo::intersects(glm::vec2 rectMin, glm::vec2 rectMax) const
+	{
+		return min.x <= rectMax.x && max.x >= rectMin.x && min.y <= rectMax.y && max.y >= rectMin.y;
+	}
+
+	float StrokeBoundsCpo::diagonal() const
+	{
+		return glm::length(max - min);
+	}
+
+	uint32_t StrokeLodCpo::levelCount() const
+	{
+		return levelOffsets.empty() ? 0u : static_cast<uint32_t>(levelOffsets.size()) - 1u;
+	}
+
+	uint32_t StrokeLodCpo::firstIndex(uint32_t level) const
+	{
+		return levelOffsets[level];
+	}
+
+	uint32_t StrokeLodCpo::indexCount(uint32_t level) const
+	{
+		return levelOffsets[level + 1] - levelOffsets[level];
+	}
+
+	uint32_t StrokeLodCpo::selectLevel(const StrokeBoundsCpo& bounds, float pixelsPerMeter) const
+	{
+		uint32_t coarsest = levelCount() - 1;
+		if (bounds.diagonal() * pixelsPerMeter < MinPixelSize)
+		{
+			return coarsest;
+		}
+
+		uint32_t level = 0;
+		while (level < coarsest && levelTolerances[level + 1] * pixelsPerMeter <= MaxPixelError)
+		{
+			++level;
+		}
+		return level;
+	}
+
+	void StrokeLodBuilder::connect(entt::registry& r)
+	{
+		ob.connect(r, entt::collector.group<StrokeCpo>().update<StrokeCpo>());
+	}
+
+	void StrokeLodBuilder::dispatch(entt::registry& r)
+	{
+		if (!pending.empty() || ob.empty()) return;
+
+		for (entt::entity e : ob)
+		{
+			pending.push_back({e, &r.get<StrokeCpo>(e)});
+		}
+		ob.clear();
+
+		auto* jobSystem = r.ctx().at<JobSystem*>();
+		for (Preprocessed& p : pending)
+		{
+			jobSystem->run(jobs, [&p] { preprocess(p); });
+		}
+	}
+
+	void StrokeLodBuilder::update(entt::registry& r)
+	{
+		dispatch(r); // in case nobody dispatched
+		r.ctx().at<JobSystem*>()->wait(jobs);
+		// Apply in dispatch order, results don't depend on scheduling.
+		for (Preprocessed& p : pending)
+		{
+			apply(r, p);
+		}
+		pending.clear();
+	}
+
+	void StrokeLodBuilder::build(entt::registry& r, entt::entity e)
+	{
+		Preprocessed p{e, &r.get<StrokeCpo>(e)};
+		preprocess(p);
+		apply(r, p);
+	}
+
+	void StrokeLodBuilder::preprocess(Preprocessed& p)
+	{
+		const StrokeCpo& stroke = *p.strokeCpo;
+		if (stroke.position.empty()) return;
+
+		StrokeBoundsCpo bounds{
+			{std::numeric_limits<float>::max(), std::numeric_limits<float>::max()},
+			{std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()}
+		};
+		for (size_t i = 0; i < stroke.position.size(); ++i)
+		{
+			// Stroke is as wide as its thickness, bounds should cover that.
+			float t = i < stroke.thickness.size() ? stroke.thickness[i] : 0.0f;
+			glm::vec2 v{stroke.position[i].x(), stroke.position[i].y()};
+			bounds.min = glm::min(bounds.min, v - t);
+			bounds.max = glm::max(bounds.max, v + t);
+		}
+		p.bounds = bounds;
+
+		StrokeLodCpo& lod = p.lod;
+		lod.levelOffsets.push_back(0u);
+		std::vector<uint32_t> level = views::iota(0u, static_cast<uint32_t>(stroke.position.size())) |
+			ranges::to_vector;
+		lod.indices.insert(lod.indices.end(), level.begin(), level.end());
+		lod.levelOffsets.push_back(static_cast<uint32_t>(lod.indices.size()));
+		lod.levelTolerances.push_back(0.0f);
+
+		float tolerance = StrokeLodCpo::BaseTolerance;
+		while (level.size() > 2 && lod.levelCount() < StrokeLodCpo::MaxLevelCount)
+		{
+			// Simplify the previous level instead of the full stroke, it's far quicker.
+			// Halving the tolerance keeps accumulated error of all previous levels under the tolerance.
+			std::vector<geom::Point> previous = level | views::transform([&stroke](uint32_t index)
+			{
+				return stroke.position[index];
+			}) | ranges::to_vector;
+			std::vector<uint32_t> kept = geom::douglasPeucker(previous, tolerance / 2.0f);
+			if (kept.size() < level.size())
+			{
+				level = kept | views::transform([&level](uint32_t index) { return level[index]; }) |
+					ranges::to_vector;
+				lod.indices.insert(lod.indices.end(), level.begin(), level.end());
+				lod.levelOffsets.push_back(static_cast<uint32_t>(lod.indices.size()));
+				lod.levelTolerances.push_back(tolerance);
+			}
+			tolerance *= 2.0f;
+		}
+	}
+
+	void StrokeLodBuilder::apply(entt::registry& r, Preprocessed& p)
+	{
+		if (!r.valid(p.stroke)) return;
+		if (!p.bounds)
+		{
+			r.remove<StrokeBoundsCpo, StrokeLodCpo>(p.stroke);
+			return;
+		}
+		r.emplace_or_replace<StrokeBoundsCpo>(p.stroke, *p.bounds);
+
+		StrokeLodCpo& lod = p.lod;
+		auto* device = r.ctx().at<vulkan::Device*>();
+		VmaAllocationCreateInfo info{VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO};
+		vk::DeviceSize size = lod.indices.size() * sizeof(uint32_t);
+		lod.indexBuffer = vulkan::Buffer(*device, info, size, vk::BufferUsageFlagBits::eIndexBuffer);
+		lod.indexBuffer.uploadLocal(lod.indices.data(), size);
+		r.emplace_or_replace<StrokeLodCpo>(p.stroke, std::move(lod));
+	}
+}
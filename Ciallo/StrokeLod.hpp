@@ -0,0 +1,71 @@
+#pragma once
+#include "Buffer.hpp"
+#include "JobSystem.hpp"
+
+namespace ciallo
+{
+	struct StrokeBoundsCpo
+	{
+		glm::vec2 min; // world coordinate, unit is meter.
+		glm::vec2 max;
+
+		bool intersects(glm::vec2 rectMin, glm::vec2 rectMax) const;
+		float diagonal() const;
+	};
+
+	/**
+	 * \brief Pre-built level of details of a stroke.
+	 * Every level is a subset of vertices in StrokeCpo, stored as indices so thickness stays untouched.
+	 * Level 0 is the full stroke, every next level at least doubles the tolerance of the previous one.
+	 */
+	struct StrokeLodCpo
+	{
+		constexpr static uint32_t MaxLevelCount = 10;
+		constexpr static float BaseTolerance = 5e-5f; // 0.05mm
+		constexpr static float MaxPixelError = 0.5f;
+		constexpr static float MinPixelSize = 1.0f; // strokes smaller than it go to the coarsest level
+
+		std::vector<uint32_t> indices; // indices of all levels, concatenated
+		std::vector<uint32_t> levelOffsets; // first index of each level, with an extra one at the end
+		std::vector<float> levelTolerances; // max deviation from the full stroke, in meter
+		vulkan::Buffer indexBuffer; // host visible, mirror of indices
+
+		uint32_t levelCount() const;
+		uint32_t firstIndex(uint32_t level) const;
+		uint32_t indexCount(uint32_t level) const;
+		// Coarsest level staying within MaxPixelError when drawn into an image of pixelsPerMeter.
+		uint32_t selectLevel(const StrokeBoundsCpo& bounds, float pixelsPerMeter) const;
+	};
+
+	struct StrokeCpo;
+
+	/**
+	 * \brief Keep StrokeBoundsCpo and StrokeLodCpo up to date with StrokeCpo.
+	 * Changed strokes are preprocessed on the job system, dispatch() before waiting for the previous frame
+	 * so it overlaps with GPU work, update() after.
+	 */
+	struct StrokeLodBuilder
+	{
+		// Computed on workers, applied to registry on main thread.
+		struct Preprocessed
+		{
+			entt::entity stroke = entt::null;
+			const StrokeCpo* strokeCpo = nullptr;
+			std::optional<StrokeBoundsCpo> bounds; // empty stroke has no bounds
+			StrokeLodCpo lod;
+		};
+
+		static inline entt::observer ob;
+		static inline JobSystem::TaskGroup jobs;
+		static inline std::vector<Preprocessed> pending;
+
+		static void connect(entt::registry& r);
+		// Fork. Registry must not be modified until update().
+		static void dispatch(entt::registry& r);
+		// Join and apply.
+		static void update(entt::registry& r);
+		static void build(entt::registry& r, entt::entity e);
+		static void preprocess(Preprocessed& p);
+		static void apply(entt::registry& r, Preprocessed& p);
+	};
+}
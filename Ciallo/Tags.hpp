@@ -1,17 +1,25 @@
 ﻿#pragma once
 
+/*
+ * Tags for redo undo, see RedoUndo.hpp. They are put on entities of the main registry during an edit
+ * and consumed by RedoUndo::commit.
+ */
+
+// Cpo was just emplaced on the entity.
 template<typename Cpo>
 struct Constructed
 {
 	
 };
 
+// Cpo is about to be modified. Emplace before touching it, a copy of current value is taken at that moment.
 template <typename Cpo>
 struct Modifying
 {
 	
 };
 
+// Cpo should be removed. It is removed by RedoUndo::commit after being recorded.
 template<typename Cpo>
 struct Destructed
 {
@@ -0,0 +1,89 @@
+#include "pch.hpp"
+#include "Thumbnail.hpp"
+
+#include "Layer.hpp"
+#include "LayerRenderer.hpp"
+
+namespace ciallo
+{
+	void ThumbnailBuilder::connect(entt::registry& r)
+	{
+		// Layers are marked dirty on every change of their content, thumbnails follow them.
+		r.on_construct<LayerDirtyTag>().connect<&ThumbnailBuilder::markStale>();
+		r.on_update<LayerDirtyTag>().connect<&ThumbnailBuilder::markStale>();
+	}
+
+	void ThumbnailBuilder::markStale(entt::registry& r, entt::entity layer)
+	{
+		for (auto&& [drawing, stack] : r.view<LayerStackCpo>().each())
+		{
+			if (ranges::find(stack.layers, layer) != stack.layers.end())
+			{
+				r.emplace_or_replace<ThumbnailStaleTag>(drawing);
+			}
+		}
+	}
+
+	void ThumbnailBuilder::update(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing)
+	{
+		// Finished requests of any drawing, the previous frame is done.
+		std::vector<entt::entity> finished;
+		for (auto&& [e, request] : r.view<ThumbnailRequestCpo>().each())
+		{
+			if (request.pixels.wait_for(std::chrono::seconds(0)) == std::future_status::ready) finished.push_back(e);
+		}
+		for (entt::entity e : finished)
+		{
+			ReadbackImage image = r.get<ThumbnailRequestCpo>(e).pixels.get();
+			auto& thumbnail = r.get_or_emplace<ThumbnailCpo>(e);
+			thumbnail.extent = image.extent;
+			thumbnail.pixels = std::move(image.pixels);
+			++thumbnail.version;
+			r.remove<ThumbnailRequestCpo>(e);
+		}
+
+		auto* display = r.try_get<GPUImageCpo>(drawing);
+		if (!display || !r.all_of<ThumbnailStaleTag>(drawing) || r.all_of<ThumbnailRequestCpo>(drawing)) return;
+		if (ViewportCuller::culled(r, drawing)) return;
+		auto now = std::chrono::steady_clock::now();
+		if (auto* thumbnail = r.try_get<ThumbnailCpo>(drawing); thumbnail && now - thumbnail->taken < MinInterval)
+		{
+			return;
+		}
+
+		const vulkan::Image& source = display->image;
+		float scale = static_cast<float>(Size) / static_cast<float>(std::max(source.width(), source.height()));
+		scale = std::min(scale, 1.0f);
+		vk::Extent2D extent{
+			std::max(1u, static_cast<uint32_t>(std::round(static_cast<float>(source.width()) * scale))),
+			std::max(1u, static_cast<uint32_t>(std::round(static_cast<float>(source.height()) * scale)))
+		};
+		auto* device = r.ctx().at<vulkan::Device*>();
+		vulkan::Image image(*device, vulkan::MemoryAuto, source.format(), extent.width, extent.height,
+		                    vk::SampleCountFlagBits::e1,
+		                    vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc);
+		image.changeLayout(cb, vk::ImageLayout::eGeneral);
+
+		// Display image is written by the display pass in compute.
+		vk::MemoryBarrier2 displayBarrier{
+			vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+			vk::PipelineStageFlagBits2::eBlit, vk::AccessFlagBits2::eTransferRead
+		};
+		cb.pipelineBarrier2({{}, displayBarrier, {}, {}});
+		vk::ImageSubresourceLayers subresource{vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+		vk::ImageBlit blit{
+			subresource,
+			{vk::Offset3D{0, 0, 0}, vk::Offset3D{static_cast<int32_t>(source.width()),
+			                                     static_cast<int32_t>(source.height()), 1}},
+			subresource,
+			{vk::Offset3D{0, 0, 0}, vk::Offset3D{static_cast<int32_t>(extent.width),
+			                                     static_cast<int32_t>(extent.height), 1}}
+		};
+		cb.blitImage(source, source.imageLayout(), image, image.imageLayout(), blit, vk::Filter::eLinear);
+
+		std::future<ReadbackImage> pixels = r.ctx().at<GpuReadback*>()->read(cb, image);
+		r.emplace<ThumbnailRequestCpo>(drawing, std::move(image), std::move(pixels));
+		r.get_or_emplace<ThumbnailCpo>(drawing).taken = now;
+		r.remove<ThumbnailStaleTag>(drawing);
+	}
+}
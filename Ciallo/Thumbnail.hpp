@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+
+#include "GpuReadback.hpp"
+
+namespace ciallo
+{
+	// On drawing entity, downscaled display image on host for the drawing list. RGBA8, sRGB encoded as displayed.
+	struct ThumbnailCpo
+	{
+		vk::Extent2D extent;
+		std::vector<std::byte> pixels; // empty until the first one is back
+		std::chrono::steady_clock::time_point taken; // when last requested
+		uint32_t version = 0; // counts pixels that came back
+	};
+
+	// On drawing entity, thumbnail is older than its layers.
+	struct ThumbnailStaleTag
+	{
+	};
+
+	// On drawing entity, thumbnail on its way back from GPU.
+	struct ThumbnailRequestCpo
+	{
+		vulkan::Image image; // blit target, alive until read back
+		std::future<ReadbackImage> pixels;
+	};
+
+	/**
+	 * \brief Keeps ThumbnailCpo of drawings up to date without stalling frames.
+	 * Display image is blitted down and read back through GpuReadback, at most once per MinInterval per drawing
+	 * while it is edited, so strokes drawn in quick succession take one thumbnail instead of one each.
+	 * Nothing is blitted unless update() is called, call it only while something shows thumbnails. Drawings edited
+	 * in between stay stale and are taken on the next call. So do drawings zoomed into, their layers only hold what
+	 * the view shows, see ViewportCuller.
+	 */
+	struct ThumbnailBuilder
+	{
+		constexpr static uint32_t Size = 128; // longer side in pixels
+		constexpr static std::chrono::milliseconds MinInterval{500};
+
+		static void connect(entt::registry& r);
+		// Record after the drawing is rendered into its display image this frame, while thumbnails are shown.
+		static void update(entt::registry& r, vk::CommandBuffer cb, entt::entity drawing);
+	private:
+		static void markStale(entt::registry& r, entt::entity layer);
+	};
+}
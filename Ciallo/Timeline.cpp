@@ -0,0 +1,26 @@
+#include "pch.hpp"
+#include "Timeline.hpp"
+
+namespace ciallo::vulkan
+{
+	bool GpuPoint::reached(vk::Device device) const
+	{
+		return !semaphore || device.getSemaphoreCounterValue(semaphore) >= value;
+	}
+
+	void GpuPoint::wait(vk::Device device) const
+	{
+		if (!semaphore) return;
+		vk::SemaphoreWaitInfo info{{}, semaphore, value};
+		[[maybe_unused]] auto result = device.waitSemaphores(info, std::numeric_limits<uint64_t>::max());
+	}
+
+	Timeline::Timeline(vk::Device device): m_device(device)
+	{
+		vk::StructureChain info{
+			vk::SemaphoreCreateInfo{},
+			vk::SemaphoreTypeCreateInfo{vk::SemaphoreType::eTimeline, 0}
+		};
+		m_semaphore = m_device.createSemaphoreUnique(info.get<vk::SemaphoreCreateInfo>());
+	}
+}
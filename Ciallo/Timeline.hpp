@@ -0,0 +1,47 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+namespace ciallo::vulkan
+{
+	/**
+	 * \brief A value on a timeline semaphore, reached once the submission signaling it completes.
+	 * GPU work declares what it depends on as points, CPU polls or waits on them instead of fences.
+	 * Default constructed points are reached from the start.
+	 */
+	struct GpuPoint
+	{
+		vk::Semaphore semaphore = VK_NULL_HANDLE;
+		uint64_t value = 0;
+
+		// Wait of a submission, stages of it holding until the point is reached.
+		vk::SemaphoreSubmitInfo waitInfo(
+			vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eAllCommands) const
+		{
+			return {semaphore, value, stages};
+		}
+
+		bool reached(vk::Device device) const;
+		void wait(vk::Device device) const;
+	};
+
+	/**
+	 * \brief Timeline semaphore of one queue, handing out increasing values to the submissions on it.
+	 * Not thread safe, submissions to a queue are made from one thread anyway.
+	 */
+	class Timeline
+	{
+		vk::Device m_device;
+		vk::UniqueSemaphore m_semaphore;
+		uint64_t m_last = 0; // last value handed out
+	public:
+		Timeline() = default;
+		explicit Timeline(vk::Device device);
+
+		// Reserve the value the next submission signals.
+		GpuPoint next() { return {*m_semaphore, ++m_last}; }
+		// Point of the last submission, every earlier one is reached with it.
+		GpuPoint last() const { return {*m_semaphore, m_last}; }
+		uint64_t completed() const { return m_device.getSemaphoreCounterValue(*m_semaphore); }
+		vk::Semaphore semaphore() const { return *m_semaphore; }
+	};
+}
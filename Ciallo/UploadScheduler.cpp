@@ -0,0 +1,220 @@
+#include "pch.hpp"
+#include "UploadScheduler.hpp"
+
+#include <numeric>
+
+namespace ciallo
+{
+	UploadScheduler::UploadScheduler(vulkan::Device* device): m_device(device)
+	{
+		vk::CommandPoolCreateInfo poolInfo{
+			vk::CommandPoolCreateFlagBits::eTransient,
+			m_device->transferQueueFamilyIndex()
+		};
+		m_commandPool = m_device->device().createCommandPoolUnique(poolInfo);
+		m_timeline = vulkan::Timeline(m_device->device());
+		m_pending.ticket = m_timeline.last().value + 1;
+	}
+
+	UploadScheduler::~UploadScheduler()
+	{
+		// Staging memory and command buffers must outlive the copies reading them.
+		m_timeline.last().wait(m_device->device());
+	}
+
+	vk::CommandBuffer UploadScheduler::pendingCommandBuffer()
+	{
+		if (!m_pending.cb)
+		{
+			vk::CommandBufferAllocateInfo info{*m_commandPool, vk::CommandBufferLevel::ePrimary, 1};
+			m_pending.cb = std::move(m_device->device().allocateCommandBuffersUnique(info)[0]);
+			m_pending.cb->begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+		}
+		return *m_pending.cb;
+	}
+
+	std::pair<vk::Buffer, vk::DeviceSize> UploadScheduler::stage(std::span<const std::byte> data,
+	                                                             vk::DeviceSize alignment)
+	{
+		VmaAllocationCreateInfo info{
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+			VMA_MEMORY_USAGE_AUTO
+		};
+		if (data.size() > BlockSize)
+		{
+			auto& buffer = m_pending.staging.emplace_back(*m_device, info, data.size(),
+			                                               vk::BufferUsageFlagBits::eTransferSrc);
+			std::memcpy(buffer.mappedData(), data.data(), data.size());
+			return {buffer, 0};
+		}
+
+		m_blockOffset = (m_blockOffset + alignment - 1) / alignment * alignment;
+		if (!m_block || m_blockOffset + data.size() > BlockSize)
+		{
+			if (!m_blockPool.empty())
+			{
+				m_pending.staging.push_back(std::move(m_blockPool.back()));
+				m_blockPool.pop_back();
+			}
+			else
+			{
+				m_pending.staging.emplace_back(*m_device, info, BlockSize, vk::BufferUsageFlagBits::eTransferSrc);
+			}
+			m_block = m_pending.staging.size() - 1;
+			m_blockOffset = 0;
+		}
+		const vulkan::Buffer& block = m_pending.staging[*m_block];
+		std::memcpy(static_cast<std::byte*>(block.mappedData()) + m_blockOffset, data.data(), data.size());
+		vk::DeviceSize offset = m_blockOffset;
+		m_blockOffset += data.size();
+		return {block, offset};
+	}
+
+	UploadScheduler::Ticket UploadScheduler::upload(const vulkan::Buffer& dst, std::span<const std::byte> data,
+	                                                vk::DeviceSize offset)
+	{
+		if (data.empty()) return m_pending.ticket;
+		auto [staging, stagingOffset] = stage(data, 16);
+		vk::CommandBuffer cb = pendingCommandBuffer();
+		vk::BufferCopy copy{stagingOffset, offset, data.size()};
+		cb.copyBuffer(staging, dst, copy);
+
+		vk::BufferMemoryBarrier2 release{
+			vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eAllCommands,
+			vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			dst, offset, data.size()
+		};
+		if (m_device->dedicatedTransferQueue())
+		{
+			// Release half waits for the copy, acquire half for the semaphore, the two halves match otherwise.
+			release.setSrcQueueFamilyIndex(m_device->transferQueueFamilyIndex())
+			       .setDstQueueFamilyIndex(m_device->queueFamilyIndex());
+			vk::BufferMemoryBarrier2 acquire = release;
+			acquire.setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+			       .setSrcAccessMask(vk::AccessFlagBits2::eNone);
+			release.setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+			       .setDstAccessMask(vk::AccessFlagBits2::eNone);
+			m_pending.bufferAcquires.push_back(acquire);
+		}
+		m_pending.bufferReleases.push_back(release);
+		return m_pending.ticket;
+	}
+
+	UploadScheduler::Ticket UploadScheduler::upload(vulkan::Image& dst, std::span<const std::byte> data)
+	{
+		vk::DeviceSize alignment = std::lcm(vk::DeviceSize{16}, vk::DeviceSize{vk::blockSize(dst.format())});
+		auto [staging, stagingOffset] = stage(data, alignment);
+		vk::CommandBuffer cb = pendingCommandBuffer();
+		vk::ImageSubresourceRange range{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+
+		vk::ImageMemoryBarrier2 toTransfer{
+			vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+			vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+			vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			dst, range
+		};
+		cb.pipelineBarrier2({{}, {}, {}, toTransfer});
+		vk::BufferImageCopy copy{};
+		copy.setBufferOffset(stagingOffset)
+		    .setImageExtent({dst.width(), dst.height(), 1u})
+		    .setImageSubresource({vk::ImageAspectFlagBits::eColor, 0, 0, 1});
+		cb.copyBufferToImage(staging, dst, vk::ImageLayout::eTransferDstOptimal, copy);
+
+		vk::ImageMemoryBarrier2 release{
+			vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eAllCommands,
+			vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite,
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eGeneral,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			dst, range
+		};
+		if (m_device->dedicatedTransferQueue())
+		{
+			release.setSrcQueueFamilyIndex(m_device->transferQueueFamilyIndex())
+			       .setDstQueueFamilyIndex(m_device->queueFamilyIndex());
+			vk::ImageMemoryBarrier2 acquire = release;
+			acquire.setSrcStageMask(vk::PipelineStageFlagBits2::eNone)
+			       .setSrcAccessMask(vk::AccessFlagBits2::eNone);
+			release.setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+			       .setDstAccessMask(vk::AccessFlagBits2::eNone);
+			m_pending.imageAcquires.push_back(acquire);
+		}
+		m_pending.imageReleases.push_back(release);
+		dst.setImageLayout(vk::ImageLayout::eGeneral);
+		return m_pending.ticket;
+	}
+
+	void UploadScheduler::flush()
+	{
+		collect();
+		if (!m_pending.cb) return;
+
+		vk::CommandBuffer cb = *m_pending.cb;
+		cb.pipelineBarrier2({{}, {}, m_pending.bufferReleases, m_pending.imageReleases});
+		cb.end();
+		for (const vulkan::Buffer& staging : m_pending.staging)
+		{
+			staging.flush();
+		}
+
+		vk::CommandBufferSubmitInfo cbInfo{cb};
+		vk::SemaphoreSubmitInfo signal{m_timeline.next().semaphore, m_pending.ticket,
+		                               vk::PipelineStageFlagBits2::eAllCommands};
+		vk::SubmitInfo2 si{{}, {}, cbInfo, signal};
+		m_device->transferQueue().submit2(si);
+
+		Ticket next = m_pending.ticket + 1;
+		m_submitted.push_back(std::move(m_pending));
+		m_pending = Batch{};
+		m_pending.ticket = next;
+		m_block.reset();
+		m_blockOffset = 0;
+	}
+
+	vulkan::GpuPoint UploadScheduler::acquire(vk::CommandBuffer cb)
+	{
+		std::vector<vk::BufferMemoryBarrier2> buffers;
+		std::vector<vk::ImageMemoryBarrier2> images;
+		for (Batch& batch : m_submitted)
+		{
+			if (batch.ticket <= m_acquired) continue;
+			buffers.insert(buffers.end(), batch.bufferAcquires.begin(), batch.bufferAcquires.end());
+			images.insert(images.end(), batch.imageAcquires.begin(), batch.imageAcquires.end());
+		}
+		if (!buffers.empty() || !images.empty())
+		{
+			cb.pipelineBarrier2({{}, {}, buffers, images});
+		}
+		if (!m_submitted.empty()) m_acquired = m_submitted.back().ticket;
+		return point(m_acquired);
+	}
+
+	void UploadScheduler::wait(Ticket ticket)
+	{
+		if (ticket >= m_pending.ticket)
+		{
+			if (!m_pending.cb) return; // nothing recorded, nothing to wait for
+			flush();
+		}
+		point(ticket).wait(m_device->device());
+	}
+
+	void UploadScheduler::collect()
+	{
+		uint64_t completed = m_timeline.completed();
+		while (!m_submitted.empty() && m_submitted.front().ticket <= std::min(completed, m_acquired))
+		{
+			for (vulkan::Buffer& staging : m_submitted.front().staging)
+			{
+				if (staging.size() == BlockSize && m_blockPool.size() < MaxPooledBlocks)
+				{
+					m_blockPool.push_back(std::move(staging));
+				}
+			}
+			m_submitted.pop_front();
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <deque>
+#include <span>
+
+#include "Buffer.hpp"
+#include "Device.hpp"
+#include "Image.hpp"
+#include "Timeline.hpp"
+
+namespace ciallo
+{
+	/**
+	 * \brief Uploads to device local resources without waiting for the GPU, lives in registry ctx.
+	 * Uploads are staged into pooled mapped blocks and recorded into one batch, flush() submits the batch to the
+	 * transfer queue where it signals its ticket on the scheduler's timeline. Nothing blocks unless wait() is asked to.
+	 * On devices with a transfer only family the queue family ownership of uploaded resources is released there
+	 * and acquired by acquire() in a graphics command buffer, so callers never write those barriers themselves.
+	 * Meant for filling fresh resources, the ones the GPU does not read while the upload is in flight.
+	 * Not thread safe, use it from the thread recording frames.
+	 */
+	class UploadScheduler
+	{
+	public:
+		using Ticket = uint64_t;
+	private:
+		struct Batch
+		{
+			Ticket ticket = 0;
+			vk::UniqueCommandBuffer cb; // null until something is recorded
+			std::vector<vulkan::Buffer> staging;
+			std::vector<vk::BufferMemoryBarrier2> bufferReleases;
+			std::vector<vk::ImageMemoryBarrier2> imageReleases;
+			std::vector<vk::BufferMemoryBarrier2> bufferAcquires; // empty without a dedicated transfer family
+			std::vector<vk::ImageMemoryBarrier2> imageAcquires;
+		};
+
+		vulkan::Device* m_device;
+		vk::UniqueCommandPool m_commandPool;
+		vulkan::Timeline m_timeline; // of the transfer queue, tickets are its values
+		Batch m_pending;
+		std::deque<Batch> m_submitted; // oldest first
+		Ticket m_acquired = 0; // last ticket acquire() has recorded barriers for
+		std::optional<size_t> m_block; // index of the staging block of m_pending being filled
+		vk::DeviceSize m_blockOffset = 0;
+		std::vector<vulkan::Buffer> m_blockPool;
+
+		vk::CommandBuffer pendingCommandBuffer();
+		// Copy data into staging memory of the pending batch, returns the buffer and offset it landed at.
+		std::pair<vk::Buffer, vk::DeviceSize> stage(std::span<const std::byte> data, vk::DeviceSize alignment);
+		void collect();
+	public:
+		constexpr static vk::DeviceSize BlockSize = 4u << 20; // larger uploads get a staging buffer of their own
+		constexpr static size_t MaxPooledBlocks = 4;
+
+		explicit UploadScheduler(vulkan::Device* device);
+		UploadScheduler(const UploadScheduler& other) = delete;
+		UploadScheduler& operator=(const UploadScheduler& other) = delete;
+		~UploadScheduler();
+
+		// Copy data into dst at offset. dst needs eTransferDst usage.
+		Ticket upload(const vulkan::Buffer& dst, std::span<const std::byte> data, vk::DeviceSize offset = 0);
+		/**
+		 * \brief Fill a color image with tightly packed rows. Previous content is discarded.
+		 * The image is in eGeneral layout once the ticket is done.
+		 */
+		Ticket upload(vulkan::Image& dst, std::span<const std::byte> data);
+		// Submit the pending batch, call once per frame before the frame's acquire().
+		void flush();
+		/**
+		 * \brief Record acquire barriers of everything flushed so far into cb, call right after cb begins.
+		 * Returns the point the submission of cb has to wait for.
+		 */
+		vulkan::GpuPoint acquire(vk::CommandBuffer cb);
+		// Data of the ticket is usable by commands recorded after the acquire() that took it.
+		bool done(Ticket ticket) const { return ticket <= m_acquired; }
+		// Flush if needed and block until copies of the ticket completed. Ownership still passes in acquire().
+		void wait(Ticket ticket);
+		vulkan::GpuPoint point(Ticket ticket) const { return {m_timeline.semaphore(), ticket}; }
+	};
+}
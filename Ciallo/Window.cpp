@@ -213,4 +213,9 @@ namespace ciallo::vulkan
 	{
 		return m_swapchainImageFormat;
 	}
+
+	GLFWwindow* Window::glfwWindow() const
+	{
+		return m_glfwWindow;
+	}
 }
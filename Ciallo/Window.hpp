@@ -75,5 +75,6 @@ namespace ciallo::vulkan
 		uint32_t swapchainImageCount() const;
 		vk::Instance instance() const;
 		vk::Format swapchainImageFormat() const;
+		GLFWwindow* glfwWindow() const;
 	};
 }
@@ -1,11 +1,30 @@
 #include "pch.hpp"
 #include "Application.hpp"
+#include "DrawingExporter.hpp"
 
-int main()
+int main(int argc, char** argv)
 {
     using namespace ciallo;
-    
+
+    std::span<char* const> args{argv + 1, static_cast<size_t>(argc - 1)};
+    if (!args.empty() && std::string_view(args[0]) == "export")
+    {
+        ExportOptions options;
+        try
+        {
+            options = ExportOptions::parse(args.subspan(1));
+        }
+        catch (std::runtime_error& e)
+        {
+            std::cerr << e.what() << '\n' << ExportOptions::usage();
+            return 2;
+        }
+        Application a;
+        return a.runHeadless(options);
+    }
+
+    // Optional project file to open, a default project otherwise.
     Application a;
-    a.run();
+    a.run(args.empty() ? std::filesystem::path{} : std::filesystem::path{args[0]});
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1 @@
+glslc canvasDisplay.comp -o canvasDisplay.comp.spv
\ No newline at end of file
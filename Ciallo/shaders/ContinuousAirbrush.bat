@@ -0,0 +1,3 @@
+glslc continuousAirbrush.vert -o continuousAirbrush.vert.spv
+glslc continuousAirbrush.geom -o continuousAirbrush.geom.spv
+glslc continuousAirbrush.frag -o continuousAirbrush.frag.spv
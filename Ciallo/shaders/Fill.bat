@@ -0,0 +1,2 @@
+glslc fill.vert -o fill.vert.spv
+glslc fill.frag -o fill.frag.spv
\ No newline at end of file
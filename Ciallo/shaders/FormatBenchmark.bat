@@ -0,0 +1,2 @@
+glslc formatBenchmark.vert -o formatBenchmark.vert.spv
+glslc formatBenchmark.frag -o formatBenchmark.frag.spv
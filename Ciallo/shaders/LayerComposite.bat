@@ -0,0 +1,3 @@
+glslc -DCANVAS_FORMAT=rgba8 layerComposite.comp -o layerComposite.rgba8.comp.spv
+glslc -DCANVAS_FORMAT=rgba16f layerComposite.comp -o layerComposite.rgba16f.comp.spv
+glslc -DCANVAS_FORMAT=rgba32f layerComposite.comp -o layerComposite.rgba32f.comp.spv
\ No newline at end of file
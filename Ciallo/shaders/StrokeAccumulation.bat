@@ -0,0 +1,6 @@
+glslc strokeCoverage.vert -o strokeCoverage.vert.spv
+glslc strokeCoverage.frag -o strokeCoverage.frag.spv
+glslc strokeComposite.vert -o strokeComposite.vert.spv
+glslc strokeComposite.frag -o strokeComposite.frag.spv
+glslc strokeBin.comp -o strokeBin.comp.spv
+glslc strokeResolve.comp -o strokeResolve.comp.spv
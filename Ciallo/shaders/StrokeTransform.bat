@@ -0,0 +1,3 @@
+glslc strokeTransform.comp -o strokeTransform.comp.spv
+glslc strokeTransformPreview.vert -o strokeTransformPreview.vert.spv
+glslc strokeTransformPreview.frag -o strokeTransformPreview.frag.spv
\ No newline at end of file
@@ -1,6 +1,5 @@
 #version 450
 
-layout(location = 0) in vec4 fragColor;
 layout(location = 1) in flat vec2 p0;
 layout(location = 2) in flat vec2 p1;
 layout(location = 3) in vec2 p;
@@ -8,14 +7,32 @@ layout(location = 4) in float width;
 
 layout(location = 0) out vec4 outColor;
 
-// For airbrush. Arbritry alpha falloff function. Will be user editable with bezier curve mapping
-float falloff_modulate(float h, float hardfac) {
-  /* Modulate the falloff profile */
-  float mod_val = pow(1.0 - abs(h), mix(0.01, 10.0, 1.0 - hardfac));
-  return smoothstep(0.0, 1.0, mod_val);
+struct Brush {
+    vec4 color;
+    float spacing;
+    float hardness;
+    uint falloffLut;
+    uint engine;
+};
+
+// BrushTable
+layout(std430, set = 1, binding = 0) readonly buffer Brushes {
+    Brush brushes[];
+};
+layout(set = 1, binding = 1) uniform sampler1D falloffLuts[64];
+
+layout(push_constant) uniform PushConstant {
+    uint brush;
+};
+
+// For airbrush. Falloff curve of the brush baked by FalloffLutBaker, texel centres span distance 0 to 1.
+float falloff_modulate(float h) {
+  uint lut = brushes[brush].falloffLut;
+  float n = float(textureSize(falloffLuts[lut], 0));
+  return texture(falloffLuts[lut], (clamp(abs(h), 0.0, 1.0) * (n - 1.0) + 0.5) / n).r;
 }
 float reverse_falloff(float v, float A) {
-    return 1.0 - A * falloff_modulate(v, 0.98);
+    return 1.0 - A * falloff_modulate(v);
 }
 
 void main() {
@@ -37,7 +54,8 @@ void main() {
     if((pLH.x > p1LH.x && d1LH > 1.0)){
         discard;
     }
-    float A = fragColor.a;
+    vec4 color = brushes[brush].color;
+    float A = color.a;
     // Airbrush begin. Can be discard.
     // Sadly Shen Ciao already forget about some details in this implementation.
     // And He just copy and paste old implementation. May Muse bless the poor boy.
@@ -59,5 +77,5 @@ void main() {
     A = clamp(1 - reverse_falloff_stroke/exceed1/exceed2, 0.0, 1.0);
     // Airbrush end. 
 
-    outColor = vec4(fragColor.rgb, A);
+    outColor = vec4(color.rgb, A);
 }
@@ -8,14 +8,15 @@ layout(location = 4) in float width;
 
 layout(location = 0) out vec4 outColor;
 
-// For airbrush. Arbritry alpha falloff function. Will be user editable with bezier curve mapping
-float falloff_modulate(float h, float hardfac) {
-  /* Modulate the falloff profile */
-  float mod_val = pow(1.0 - abs(h), mix(0.01, 10.0, 1.0 - hardfac));
-  return smoothstep(0.0, 1.0, mod_val);
+layout(set = 0, binding = 0) uniform sampler1D falloffLut;
+
+// For airbrush. Falloff curve of the brush baked by FalloffLutBaker, texel centres span distance 0 to 1.
+float falloff_modulate(float h) {
+  float n = float(textureSize(falloffLut, 0));
+  return texture(falloffLut, (clamp(abs(h), 0.0, 1.0) * (n - 1.0) + 0.5) / n).r;
 }
 float reverse_falloff(float v, float A) {
-    return 1.0 - A * falloff_modulate(v, 0.98);
+    return 1.0 - A * falloff_modulate(v);
 }
 
 void main() {
@@ -0,0 +1,66 @@
+#version 460
+
+layout(location = 0) in flat vec4 color0;
+layout(location = 1) in flat vec4 color1;
+layout(location = 2) in flat vec4 ends;
+layout(location = 3) in flat vec2 widths;
+layout(location = 4) in vec2 p;
+
+layout(location = 0) out vec4 outColor;
+
+layout(push_constant) uniform PushConstant {
+    float spacing;
+    float hardness;
+    uint integral; // 0 tabulated, 1 closed form
+    uint tableSize;
+};
+
+// T(h, u): integral of falloff from s = 0 to s = u * sqrt(1 - h^2), rows of h.
+layout(std430, binding = 0) readonly buffer IntegralTable {
+    float table[];
+};
+
+float tableAt(uint row, uint column) {
+    return table[row * tableSize + column];
+}
+
+float tableIntegral(float h, float u) {
+    float last = float(tableSize - 1);
+    vec2 f = clamp(vec2(h, u), 0.0, 1.0) * last;
+    uvec2 i0 = min(uvec2(f), uvec2(tableSize - 2));
+    vec2 t = f - vec2(i0);
+    float a = mix(tableAt(i0.x, i0.y), tableAt(i0.x, i0.y + 1), t.y);
+    float b = mix(tableAt(i0.x + 1, i0.y), tableAt(i0.x + 1, i0.y + 1), t.y);
+    return mix(a, b, t.x);
+}
+
+// Antiderivative over dots, s in radius units along the axis.
+float primitive(float s, float h, float w) {
+    float as = abs(s);
+    float v = integral == 1 ? (1.0 - h * h) * as - as * as * as / 3.0 : tableIntegral(h, as / w);
+    return sign(s) * v;
+}
+
+// Mirrors ContinuousAirbrushEngine::alpha.
+void main() {
+    vec2 p0 = ends.xy;
+    vec2 p1 = ends.zw;
+    float len = distance(p0, p1);
+    vec2 axis = (p1 - p0) / len;
+    vec2 normal = vec2(-axis.y, axis.x);
+    float x = dot(p - p0, axis);
+    float y = dot(p - p0, normal);
+    float t = clamp(x / len, 0.0, 1.0);
+    float r = mix(widths.x, widths.y, t);
+    if (r <= 0.0) discard;
+    float h = abs(y) / r;
+    if (h >= 1.0) discard;
+    float w = sqrt(1.0 - h * h);
+    float lo = max(-x / r, -w);
+    float hi = min((len - x) / r, w);
+    if (hi <= lo) discard;
+
+    vec4 color = mix(color0, color1, t);
+    float density = color.a * r / spacing * (primitive(hi, h, w) - primitive(lo, h, w));
+    outColor = vec4(color.rgb, 1.0 - exp(-density));
+}
@@ -0,0 +1,13 @@
+#version 460
+
+layout(push_constant) uniform PushConstant {
+    vec2 viewMin;
+    vec2 viewMax;
+    vec4 color;
+};
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(color.rgb * color.a, color.a);
+}
@@ -0,0 +1,13 @@
+#version 460
+
+layout(location = 0) in vec2 position;
+
+layout(push_constant) uniform PushConstant {
+    vec2 viewMin;
+    vec2 viewMax;
+    vec4 color;
+};
+
+void main() {
+    gl_Position = vec4((position - viewMin) / (viewMax - viewMin) * 2.0 - 1.0, 0.0, 1.0);
+}
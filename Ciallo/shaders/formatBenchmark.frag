@@ -0,0 +1,8 @@
+#version 460
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // Translucent, so every layer reads and blends with the target.
+    outColor = vec4(0.8, 0.4, 0.2, 0.05);
+}
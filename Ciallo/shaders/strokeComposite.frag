@@ -0,0 +1,44 @@
+#version 460
+
+const uint SourceCoverage = 0;
+const uint SourceAccumulation = 1;
+
+struct Brush {
+    vec4 color;
+    float spacing;
+    float hardness;
+    uint falloffLut;
+    uint engine;
+};
+
+// BrushTable
+layout(std430, set = 1, binding = 0) readonly buffer Brushes {
+    Brush brushes[];
+};
+
+layout(binding = 3) uniform sampler2D coverage;
+// Premultiplied run of strokes.
+layout(binding = 4) uniform sampler2D accumulation;
+
+layout(push_constant) uniform PushConstant {
+    uint first;
+    uint count;
+    uint brush;
+    uint source;
+    ivec2 origin;
+    vec2 extent;
+};
+
+// Premultiplied, blended with one and one minus source alpha.
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    if (source == SourceAccumulation) {
+        outColor = texelFetch(accumulation, p, 0);
+        return;
+    }
+    vec4 color = brushes[brush].color;
+    float a = color.a * texelFetch(coverage, p, 0).r;
+    outColor = vec4(color.rgb * a, a);
+}
@@ -0,0 +1,7 @@
+#version 460
+
+// One triangle covering the whole target, scissor limits it to the stroke.
+void main() {
+    vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
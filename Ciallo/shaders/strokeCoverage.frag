@@ -0,0 +1,55 @@
+#version 460
+
+struct Segment {
+    vec2 p0;
+    vec2 p1;
+    float r0;
+    float r1;
+    uint stroke;
+    uint brush;
+};
+
+struct Brush {
+    vec4 color;
+    float spacing;
+    float hardness;
+    uint falloffLut;
+    uint engine;
+};
+
+layout(std430, binding = 0) readonly buffer Segments {
+    Segment segments[];
+};
+
+// BrushTable, indexed per draw: every segment of a draw belongs to one stroke.
+layout(std430, set = 1, binding = 0) readonly buffer Brushes {
+    Brush brushes[];
+};
+layout(set = 1, binding = 1) uniform sampler1D falloffLuts[64];
+
+layout(location = 0) in flat uint segmentIndex;
+
+// Blended with max, the target holds coverage of the whole stroke.
+layout(location = 0) out float outCoverage;
+
+// Falloff curve of the brush baked by FalloffLutBaker, hardness of the airbrush included.
+float falloff(float h, Brush b) {
+    float n = float(textureSize(falloffLuts[b.falloffLut], 0));
+    return textureLod(falloffLuts[b.falloffLut], (clamp(h, 0.0, 1.0) * (n - 1.0) + 0.5) / n, 0.0).r;
+}
+
+// Capsule with radius interpolated along the segment.
+float segmentCoverage(Segment s, vec2 p, Brush b) {
+    vec2 d = s.p1 - s.p0;
+    float len2 = dot(d, d);
+    float t = len2 > 0.0 ? clamp(dot(p - s.p0, d) / len2, 0.0, 1.0) : 0.0;
+    float r = mix(s.r0, s.r1, t);
+    float dist = distance(p, s.p0 + t * d);
+    if (r <= 0.0 || dist >= r) return 0.0;
+    return falloff(dist / r, b);
+}
+
+void main() {
+    Segment s = segments[segmentIndex];
+    outCoverage = segmentCoverage(s, gl_FragCoord.xy, brushes[s.brush]);
+}
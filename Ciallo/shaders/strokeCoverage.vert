@@ -0,0 +1,36 @@
+#version 460
+
+struct Segment {
+    vec2 p0;
+    vec2 p1;
+    float r0;
+    float r1;
+    uint stroke;
+    uint brush;
+};
+
+layout(std430, binding = 0) readonly buffer Segments {
+    Segment segments[];
+};
+
+layout(push_constant) uniform PushConstant {
+    uint first;
+    uint count;
+    uint brush;
+    uint source;
+    ivec2 origin;
+    vec2 extent;
+};
+
+layout(location = 0) out flat uint segmentIndex;
+
+// One instance per segment, a quad bounding its capsule.
+void main() {
+    segmentIndex = first + gl_InstanceIndex;
+    Segment s = segments[segmentIndex];
+    float r = max(s.r0, s.r1) + 1.0;
+    vec2 lo = min(s.p0, s.p1) - r;
+    vec2 hi = max(s.p0, s.p1) + r;
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    gl_Position = vec4(mix(lo, hi, corner) / extent * 2.0 - 1.0, 0.0, 1.0);
+}